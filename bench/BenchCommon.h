@@ -0,0 +1,93 @@
+#pragma once
+
+// Helpers shared by the benchmarks and the replay driver: option lists and resident memory
+
+// Standard library headers
+#include <algorithm>  // find
+#include <cstdio>     // FILE
+#include <cstdlib>    // strtol
+#include <cstring>    // strncmp, strlen
+#include <string>     // List items
+#include <vector>     // Lists
+
+
+
+namespace BenchCommon
+{
+	// Splits a comma-separated option
+	inline std::vector<std::string> SplitList(const char* pszList)
+	{
+		std::vector<std::string> items;
+		std::string item;
+		for (const char* p = pszList; ; ++p) {
+			if (*p == ',' or !*p) {
+				if (!item.empty()) { items.push_back(item); }
+				item.clear();
+				if (!*p) { break; }
+			}
+			else {
+				item += *p;
+			}
+		}
+		return items;
+	}
+
+	inline bool Contains(const std::vector<std::string>& items, const char* pszItem)
+	{
+		return std::find(items.begin(), items.end(), pszItem) != items.end();
+	}
+
+
+
+	// Field of /proc/self/status in KB (VmRSS, VmHWM); -1 where it cannot be read
+	inline long ReadStatusKb(const char* pszField)
+	{
+#if defined(__linux__)
+		FILE* pFile = fopen("/proc/self/status", "r");
+		if (!pFile) { return -1; }
+		char szLine[256];
+		long kb = -1;
+		const size_t cchField = strlen(pszField);
+		while (fgets(szLine, sizeof(szLine), pFile)) {
+			if (strncmp(szLine, pszField, cchField) == 0) { kb = strtol(szLine + cchField, NULL, 10); break; }
+		}
+		fclose(pFile);
+		return kb;
+#else
+		(void)pszField;
+		return -1;
+#endif
+	}
+
+	// Restarts the peak (VmHWM) at the current RSS, Linux 4.0+
+	inline bool ResetPeakRss()
+	{
+#if defined(__linux__)
+		FILE* pFile = fopen("/proc/self/clear_refs", "w");
+		if (!pFile) { return false; }
+		const bool isReset = fputs("5", pFile) >= 0;
+		return fclose(pFile) == 0 and isReset;
+#else
+		return false;
+#endif
+	}
+}
+
+
+
+
+/*
+Usage example:
+
+	for (const std::string& size : BenchCommon::SplitList("1080p,4k")) {
+		// ...
+	}
+
+	const bool isPeakReset = BenchCommon::ResetPeakRss();
+	// ...work...
+	const long peakKb = BenchCommon::ReadStatusKb("VmHWM:");
+
+*/
+
+
+
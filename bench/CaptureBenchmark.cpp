@@ -0,0 +1,542 @@
+// Capture hot path benchmark over synthetic screenshot-like corpora (portable, runs on Linux).
+//
+// Every stage a clipboard capture goes through is measured on UI, text, photo and gradient
+// images at 1080p/4K/8K, stored as the DIB variants and CF_PNG payloads the clipboard hands
+// over. Each result has throughput, latency percentiles and the peak RSS the stage added.
+//
+// Build and run on Linux:
+//   g++ -O2 -std=c++17 -pthread -I bench/compat -I src bench/CaptureBenchmark.cpp src/{ContentHash,PixelConvert,DIBDecoder,PixelKey,PngEncoder,Deflate,PngReader,Inflate,Qoi,WhitelistMatcher,FilenameTemplate}.cpp -o capture_bench
+//   ./capture_bench [options]
+//
+// Options:
+//   --seconds S        Minimum time per measurement (default 0.3)
+//   --kinds LIST       ui,text,photo,gradient (default all)
+//   --sizes LIST       1080p,4k,8k (default all)
+//   --formats LIST     32,32a,101010,24,16,555,4444,8,4,1,rle8,rle4,png, "td" suffix for a
+//                      top-down DIB (32td); see SyntheticCorpus::BuildPayload (default 32,png)
+//   --formats all      Every DIB variant above, bottom-up and top-down, and png
+//   --stages LIST      Subset of the stage names below (default all)
+//   --json FILE        Writes the results as a JSON baseline
+//   --compare FILE     Compares median latencies with a baseline written by --json
+//   --threshold PCT    Slowdown reported as a regression by --compare (default 10)
+//   --rules N          Whitelist rules for the whitelist stages (default 5000)
+//   --history N        Fingerprints in the BK-tree for the bktree stages (default 65536,
+//                      the near-duplicate history cap)
+//
+// Stages and the code they stand for:
+//   copy.murmur3  CopyAndHash with the Murmur3 byte key (the MurmurHash path)
+//   copy.xxh3     CopyAndHash with the default XXH3 byte key
+//   sample        ComputeSampleKey (PixelKey::SampleDIB)
+//   key           ComputeDataKey in pixel mode (PixelKey::FromDIB / FromPNG)
+//   fingerprint   ComputeFingerprint (dHash) over DIBDecoder or PngReader rows
+//   fingerprint.ahash, fingerprint.phash  The same with [NearDuplicate] Algorithm aHash and pHash
+//   encode        SaveDIBToFile without the file write (DIBDecoder + EncodePng)
+//   spool         SaveDIBToSpool without the file write (DIBDecoder + Qoi::Encode)
+//   capture       HandleClipboardData for a new image with the default settings
+//   filename      The earlier GenerateFilename's timestamp formatting (snprintf), per call
+//   filename.template GenerateFilename: default FilenameTemplate, sequence and extension, per call
+//   whitelist     IsStringWhitelisted (WhitelistMatcher) over --rules rules, 70% names, 20%
+//                 name globs and 10% path prefixes; owner paths, half of them misses; per call
+//   whitelist.set The earlier TStringHash set, exact names only, a string built per lookup
+//   bktree        BKTree::FindWithin at the default distance (3) over --history fingerprints,
+//                 half of the queries 2 bits from a stored one, half random misses; per call
+//   bktree.build  Inserting --history fingerprints, as when the history is loaded or trimmed
+// GenerateFilename is tied to Win32 in ClipboardImageSaver.cpp; the filename stages run the
+// same formatting over a fixed local time.
+//
+// --compare exits with 1 when a stage regressed, so it can gate a CI job.
+
+// Implementation-specific headers
+#include "ContentHash.h"       // Byte keys
+#include "DIBDecoder.h"        // DIB rows
+#include "PngReader.h"         // PNG rows
+#include "MurmurHash3Stream.h" // TStringHash
+#include "PerceptualHash.h"    // Fingerprints
+#include "PixelKey.h"          // Pixel keys and samples
+#include "FilenameTemplate.h"  // Capture names
+#include "PngEncoder.h"        // EncodePng
+#include "Qoi.h"               // Spool format
+#include "WhitelistMatcher.h"  // Owner rules
+#include "SyntheticCorpus.h"   // Test images
+#include "BenchCommon.h"       // Option lists, resident memory
+
+// Standard library headers
+#include <algorithm>      // sort, min
+#include <chrono>         // steady_clock, system_clock
+#include <cstdio>         // printf, FILE
+#include <cstdlib>        // atof, strtod
+#include <cstring>        // strcmp, strstr, memcpy
+#include <ctime>          // localtime
+#include <random>         // Fingerprint history
+#include <string>         // Names
+#include <thread>         // hardware_concurrency
+#include <unordered_set>  // Earlier whitelist
+#include <vector>         // Buffers
+
+
+
+using namespace SyntheticCorpus;
+using namespace BenchCommon;
+
+
+
+// Anonymous namespace for the measurement helpers
+namespace
+{
+	volatile uint64_t g_sink;  // Keeps results observable
+
+	using Clock = std::chrono::steady_clock;
+
+	const char* const kAllKinds = "ui,text,photo,gradient";
+	const char* const kAllSizes = "1080p,4k,8k";
+	// One payload per DIBDecoder row instance (format and orientation), RLE being bottom-up only
+	const char* const kAllFormats = "32,32a,101010,24,16,555,4444,8,4,1,rle8,rle4,"
+		"32td,32atd,101010td,24td,16td,555td,4444td,8td,4td,1td,png";
+	const char* const kAllStages = "copy.murmur3,copy.xxh3,sample,key,fingerprint,fingerprint.ahash,fingerprint.phash,"
+		"encode,spool,capture,filename,filename.template,whitelist,whitelist.set,bktree,bktree.build";
+
+	struct StageResult
+	{
+		std::string stage;
+		std::string corpus;
+		size_t cbInput{};           // Bytes per operation, 0 for per-call stages
+		size_t cOperations{};
+		double mbPerSec{};
+		double opsPerSec{};
+		double p50Ms{}, p90Ms{}, p99Ms{}, maxMs{};
+		long peakRssKb{ -1 };       // Peak RSS above the RSS the stage started with
+	};
+
+	// Runs fn (cOpsPerCall operations each) for at least the given time and at least three times
+	template<typename Fn>
+	StageResult Measure(const char* pszStage, const std::string& corpus, size_t cbInput, size_t cOpsPerCall, double seconds, Fn fn)
+	{
+		StageResult result{ pszStage, corpus, cbInput };
+
+		const bool isPeakReset = ResetPeakRss();
+		const long startRssKb = ReadStatusKb("VmRSS:");
+
+		fn();  // Warm-up
+		std::vector<double> latencies;
+		const Clock::time_point start = Clock::now();
+		double elapsed{};
+		do {
+			const Clock::time_point callStart = Clock::now();
+			fn();
+			latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - callStart).count() / cOpsPerCall);
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < seconds or latencies.size() < 3);
+
+		const long peakKb = ReadStatusKb("VmHWM:");
+		if (isPeakReset and peakKb >= 0 and startRssKb >= 0) { result.peakRssKb = std::max(0L, peakKb - startRssKb); }
+
+		result.cOperations = latencies.size() * cOpsPerCall;
+		result.opsPerSec = result.cOperations / elapsed;
+		result.mbPerSec = (double)cbInput * result.opsPerSec / 1e6;
+
+		std::sort(latencies.begin(), latencies.end());
+		const auto Percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+		result.p50Ms = Percentile(0.50);
+		result.p90Ms = Percentile(0.90);
+		result.p99Ms = Percentile(0.99);
+		result.maxMs = latencies.back();
+		return result;
+	}
+
+	void PrintHeader()
+	{
+		printf("%-17s %-20s %10s %12s %10s %10s %10s %10s %10s\n",
+			"stage", "corpus", "MB/s", "ops/s", "p50 ms", "p90 ms", "p99 ms", "max ms", "peak MB");
+	}
+
+	void PrintResult(const StageResult& result)
+	{
+		printf("%-17s %-20s ", result.stage.c_str(), result.corpus.c_str());
+		if (result.cbInput) { printf("%10.1f", result.mbPerSec); } else { printf("%10s", "-"); }
+		printf(" %12.1f %10.4g %10.4g %10.4g %10.4g", result.opsPerSec, result.p50Ms, result.p90Ms, result.p99Ms, result.maxMs);
+		if (result.peakRssKb >= 0) { printf(" %10.1f\n", result.peakRssKb / 1024.0); } else { printf(" %10s\n", "-"); }
+		fflush(stdout);
+	}
+
+
+
+	// One result object per line, so --compare can read baselines without a JSON parser
+	bool WriteJson(const char* pszPath, const std::vector<StageResult>& results, double seconds)
+	{
+		FILE* pFile = fopen(pszPath, "w");
+		if (!pFile) { return false; }
+
+		const long long timestamp = (long long)std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		fprintf(pFile, "{\n  \"schema\": 1,\n  \"timestamp\": %lld,\n  \"seconds\": %g,\n  \"threads\": %u,\n  \"results\": [\n",
+			timestamp, seconds, std::thread::hardware_concurrency());
+		for (size_t i{}; i < results.size(); ++i) {
+			const StageResult& r = results[i];
+			fprintf(pFile, "    {\"stage\": \"%s\", \"corpus\": \"%s\", \"bytes\": %zu, \"operations\": %zu, "
+				"\"mbPerSec\": %.3f, \"opsPerSec\": %.3f, \"p50Ms\": %.9g, \"p90Ms\": %.9g, \"p99Ms\": %.9g, "
+				"\"maxMs\": %.9g, \"peakRssKb\": %ld}%s\n",
+				r.stage.c_str(), r.corpus.c_str(), r.cbInput, r.cOperations, r.mbPerSec, r.opsPerSec,
+				r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, r.peakRssKb, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(pFile, "  ]\n}\n");
+		return fclose(pFile) == 0;
+	}
+
+	// Value of "key": in a result line, as text
+	bool FindField(const char* pszLine, const char* pszKey, std::string* pValue)
+	{
+		const std::string pattern = std::string("\"") + pszKey + "\": ";
+		const char* p = strstr(pszLine, pattern.c_str());
+		if (!p) { return false; }
+		p += pattern.size();
+		const bool isString = *p == '"';
+		if (isString) { ++p; }
+		const char* pEnd = p;
+		while (*pEnd and (isString ? *pEnd != '"' : *pEnd != ',' and *pEnd != '}')) { ++pEnd; }
+		pValue->assign(p, pEnd);
+		return true;
+	}
+
+	// Compares median latencies; returns the number of regressions
+	size_t CompareWithBaseline(const char* pszPath, const std::vector<StageResult>& results, double threshold)
+	{
+		FILE* pFile = fopen(pszPath, "r");
+		if (!pFile) {
+			fprintf(stderr, "Cannot read baseline %s\n", pszPath);
+			return 1;
+		}
+
+		std::vector<StageResult> baseline;
+		char szLine[1024];
+		while (fgets(szLine, sizeof(szLine), pFile)) {
+			StageResult r;
+			std::string p50;
+			if (FindField(szLine, "stage", &r.stage) and FindField(szLine, "corpus", &r.corpus) and FindField(szLine, "p50Ms", &p50)) {
+				r.p50Ms = atof(p50.c_str());
+				baseline.push_back(r);
+			}
+		}
+		fclose(pFile);
+
+		printf("\n%-17s %-20s %12s %12s %9s\n", "stage", "corpus", "base p50", "p50", "change");
+		size_t cRegressions{};
+		for (const StageResult& current : results) {
+			const auto it = std::find_if(baseline.begin(), baseline.end(), [&](const StageResult& b) {
+				return b.stage == current.stage and b.corpus == current.corpus;
+			});
+			if (it == baseline.end() or it->p50Ms <= 0) { continue; }
+			const double change = (current.p50Ms / it->p50Ms - 1) * 100;
+			const bool isRegression = change > threshold;
+			cRegressions += isRegression;
+			printf("%-17s %-20s %12.4g %12.4g %+8.1f%%%s\n", current.stage.c_str(), current.corpus.c_str(),
+				it->p50Ms, current.p50Ms, change, isRegression ? "  REGRESSION" : "");
+		}
+		printf("%zu regression(s) above %.1f%%\n", cRegressions, threshold);
+		return cRegressions;
+	}
+
+
+
+	// Stages over one clipboard payload
+	void RunPayloadStages(const std::vector<std::string>& stages, const std::string& corpus, const std::string& format,
+		const std::vector<uint8_t>& payload, double seconds, std::vector<StageResult>* pResults)
+	{
+		const bool isPng = format == "png";
+		const BITMAPINFO* pbmi = reinterpret_cast<const BITMAPINFO*>(payload.data());
+		const uint8_t* pData = payload.data();
+		const size_t cbSize = payload.size();
+		const PixelConvert::Kernels* pKernels = &PixelConvert::GetBestKernels();
+
+		const auto Run = [&](const char* pszStage, auto fn) {
+			if (!Contains(stages, pszStage)) { return; }
+			pResults->push_back(Measure(pszStage, corpus, cbSize, 1, seconds, fn));
+			PrintResult(pResults->back());
+		};
+
+		std::vector<uint8_t> copy(cbSize);
+		Run("copy.murmur3", [&]() { g_sink = ContentHash::Compute(HashAlgorithm::Murmur3_32, pData, cbSize, 0, copy.data()).low; });
+		Run("copy.xxh3", [&]() { g_sink = ContentHash::Compute(HashAlgorithm::Xxh3_64, pData, cbSize, 0, copy.data()).low; });
+
+		uint64_t qwKey{};
+		uint64_t samples[2]{};
+		if (!isPng) {
+			Run("sample", [&]() { PixelKey::SampleDIB(pbmi, cbSize, pKernels, &samples[0], &samples[1]); g_sink = samples[0]; });
+		}
+		Run("key", [&]() {
+			if (isPng) { PixelKey::FromPNG(pData, cbSize, HashAlgorithm::Xxh3_64, &qwKey, &samples[0]); }
+			else { PixelKey::FromDIB(pbmi, cbSize, HashAlgorithm::Xxh3_64, pKernels, &qwKey, &samples[0]); }
+			g_sink = qwKey;
+		});
+
+		// Same decoders as ComputeFingerprint
+		const auto FingerprintWith = [&](PerceptualAlgorithm algorithm) {
+			uint64_t qwFingerprint{};
+			if (isPng) {
+				PngReader reader;
+				if (reader.Open(pData, cbSize)) {
+					PerceptualHash::Compute(algorithm, PngReader::ReadRowProc, &reader,
+						reader.GetWidth(), reader.GetHeight(), 4, &qwFingerprint);
+				}
+			}
+			else {
+				DIBDecoder decoder;
+				if (decoder.Open(pbmi, cbSize, pKernels, false)) {
+					PerceptualHash::Compute(algorithm, DIBDecoder::ReadRowProc, &decoder,
+						decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), &qwFingerprint);
+				}
+			}
+			g_sink = qwFingerprint;
+		};
+		const auto Fingerprint = [&]() { FingerprintWith(PerceptualAlgorithm::DifferenceHash); };
+		Run("fingerprint", Fingerprint);
+		Run("fingerprint.ahash", [&]() { FingerprintWith(PerceptualAlgorithm::AverageHash); });
+		Run("fingerprint.phash", [&]() { FingerprintWith(PerceptualAlgorithm::DctHash); });
+
+		std::vector<uint8_t> output;
+		const auto Encode = [&]() {
+			DIBDecoder decoder;
+			decoder.Open(pbmi, cbSize, pKernels);
+			const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+			EncodePng(image, PngEncodeOptions{}, &output);
+			g_sink = output.size();
+		};
+		if (!isPng) {
+			Run("encode", Encode);
+			Run("spool", [&]() {
+				DIBDecoder decoder;
+				decoder.Open(pbmi, cbSize, pKernels);
+				const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+				Qoi::Encode(image, &output);
+				g_sink = output.size();
+			});
+		}
+
+		// New image with pre-hash, pixel keys and near-duplicates on: the sample misses, the
+		// capture is saved and its full key computed afterwards. CF_PNG is written as is.
+		Run("capture", [&]() {
+			if (isPng) {
+				Fingerprint();
+				PixelKey::FromPNG(pData, cbSize, HashAlgorithm::Xxh3_64, &qwKey, &samples[0]);
+				return;
+			}
+			PixelKey::SampleDIB(pbmi, cbSize, pKernels, &samples[0], &samples[1]);
+			Fingerprint();
+			Encode();
+			PixelKey::FromDIB(pbmi, cbSize, HashAlgorithm::Xxh3_64, pKernels, &qwKey, &samples[0]);
+			g_sink = qwKey;
+		});
+	}
+
+	// Stages that do not depend on the image
+	void RunCallStages(const std::vector<std::string>& stages, size_t cRules, size_t cHistory, double seconds, std::vector<StageResult>* pResults)
+	{
+		constexpr size_t kCallsPerRun = 1000;
+
+		// Near-duplicate history: random fingerprints, and queries that hit one of them after a
+		// two-bit change or miss them all
+		if (Contains(stages, "bktree") or Contains(stages, "bktree.build")) {
+			std::mt19937_64 rng(42);
+			std::vector<uint64_t> history(cHistory);
+			for (uint64_t& fingerprint : history) { fingerprint = rng(); }
+			const std::string corpus = "history-" + std::to_string(cHistory);
+
+			BKTree tree;
+			for (uint64_t fingerprint : history) { tree.Insert(fingerprint); }
+
+			if (Contains(stages, "bktree")) {
+				std::vector<uint64_t> queries(kCallsPerRun);
+				for (size_t i{}; i < kCallsPerRun; ++i) {
+					queries[i] = i % 2 ? rng() : history[rng() % cHistory] ^ (1ull << (rng() % 64)) ^ (1ull << (rng() % 64));
+				}
+				pResults->push_back(Measure("bktree", corpus, 0, kCallsPerRun, seconds, [&]() {
+					for (uint64_t query : queries) { g_sink = tree.FindWithin(query, 3); }
+				}));
+				PrintResult(pResults->back());
+			}
+
+			if (Contains(stages, "bktree.build")) {
+				pResults->push_back(Measure("bktree.build", corpus, 0, 1, seconds, [&]() {
+					BKTree rebuilt;
+					for (uint64_t fingerprint : history) { rebuilt.Insert(fingerprint); }
+					g_sink = rebuilt.Size();
+				}));
+				PrintResult(pResults->back());
+			}
+		}
+
+		if (Contains(stages, "filename")) {
+			char szBuffer[260] = "C:\\Users\\user\\Pictures\\screenshot_";
+			const size_t cchBase = strlen(szBuffer);
+			pResults->push_back(Measure("filename", "-", 0, kCallsPerRun, seconds, [&]() {
+				for (size_t i{}; i < kCallsPerRun; ++i) {
+					const auto now = std::chrono::system_clock::now();
+					const time_t seconds = std::chrono::system_clock::to_time_t(now);
+					const int ms = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+					const tm* pTime = localtime(&seconds);
+					snprintf(szBuffer + cchBase, sizeof(szBuffer) - cchBase, "%04d%02d%02d_%02d%02d%02d%03d.png",
+						pTime->tm_year + 1900, pTime->tm_mon + 1, pTime->tm_mday, pTime->tm_hour, pTime->tm_min, pTime->tm_sec, ms);
+					g_sink = (uint8_t)szBuffer[cchBase + 17];
+				}
+			}));
+			PrintResult(pResults->back());
+		}
+
+		if (Contains(stages, "filename.template")) {
+			char szBuffer[260] = "C:\\Users\\user\\Pictures\\";
+			const size_t cchBase = strlen(szBuffer);
+			FilenameTemplate name;
+			name.Compile("screenshot_{date}_{time}_{seq}");
+			FilenameFields fields{ 2024, 5, 17, 9, 41, 7, 12 };
+			pResults->push_back(Measure("filename.template", "-", 0, kCallsPerRun, seconds, [&]() {
+				for (size_t i{}; i < kCallsPerRun; ++i) {
+					++fields.sequence;
+					const size_t cchName = name.Format(fields, NULL, szBuffer + cchBase, sizeof(szBuffer) - cchBase - 4);
+					memcpy(szBuffer + cchBase + cchName, ".png", 5);
+					g_sink = (uint8_t)szBuffer[cchBase + cchName - 1];
+				}
+			}));
+			PrintResult(pResults->back());
+		}
+
+		// Rule i is a name, a name glob or a path prefix; owners i hit it, owners i + cRules miss
+		const auto Rule = [](size_t i) {
+			const std::string id = std::to_string(i);
+			if (i % 10 < 7) { return "App_" + id + ".exe"; }
+			if (i % 10 < 8) { return "tool_" + id + "_*.exe"; }
+			if (i % 10 < 9) { return "*_" + id + ".scr"; }
+			return "C:\\Vendor" + id + "\\*";
+		};
+		const auto Owner = [](size_t i) {
+			const std::string id = std::to_string(i);
+			if (i % 10 < 7) { return "C:\\Program Files\\App\\app_" + id + ".exe"; }
+			if (i % 10 < 8) { return "C:\\Tools\\Tool_" + id + "_beta.exe"; }
+			if (i % 10 < 9) { return "C:\\Windows\\saver_" + id + ".scr"; }
+			return "c:/vendor" + id + "/bin/setup.exe";
+		};
+		std::vector<std::string> owners;
+		for (size_t i{}; i < 256; ++i) {
+			owners.push_back(Owner(i * cRules / 256));
+			owners.push_back(Owner(i * cRules / 256 + cRules));
+		}
+		const std::string corpus = "rules-" + std::to_string(cRules);
+
+		if (Contains(stages, "whitelist")) {
+			std::string rules;
+			for (size_t i{}; i < cRules; ++i) { rules += Rule(i) + "\r\n"; }
+			WhitelistMatcher matcher;
+			matcher.Compile(rules.c_str());
+			pResults->push_back(Measure("whitelist", corpus, 0, kCallsPerRun, seconds, [&]() {
+				for (size_t i{}; i < kCallsPerRun; ++i) {
+					g_sink = matcher.IsMatch(owners[i % owners.size()].c_str());
+				}
+			}));
+			PrintResult(pResults->back());
+		}
+
+		if (Contains(stages, "whitelist.set")) {
+			// TStringHash: MurmurHash3 over the UTF-16 code units
+			struct Utf16Hash
+			{
+				size_t operator()(const std::u16string& s) const
+				{
+					MurmurHash3Stream hasher(0);
+					hasher.Update(s.data(), s.size() * sizeof(char16_t));
+					return hasher.Finish();
+				}
+			};
+			const auto ToUtf16 = [](const std::string& text) {
+				std::u16string utf16;
+				for (char c : text) { utf16 += (char16_t)c; }
+				return utf16;
+			};
+			std::unordered_set<std::u16string, Utf16Hash> whitelist;
+			for (size_t i{}; i < cRules; ++i) { whitelist.insert(ToUtf16(Rule(i))); }
+			std::vector<std::u16string> names;
+			for (const std::string& owner : owners) { names.push_back(ToUtf16(owner.substr(owner.find_last_of("\\/") + 1))); }
+			pResults->push_back(Measure("whitelist.set", corpus, 0, kCallsPerRun, seconds, [&]() {
+				for (size_t i{}; i < kCallsPerRun; ++i) {
+					// IsStringWhitelisted built a tstring from the owner name for every lookup
+					g_sink = whitelist.find(std::u16string(names[i % names.size()].c_str())) != whitelist.end();
+				}
+			}));
+			PrintResult(pResults->back());
+		}
+	}
+}
+
+
+
+int main(int argc, char** argv)
+{
+	double seconds = 0.3;
+	double threshold = 10;
+	const char* pszKinds = kAllKinds;
+	const char* pszSizes = kAllSizes;
+	const char* pszFormats = "32,png";
+	const char* pszStages = kAllStages;
+	const char* pszJsonPath = NULL;
+	const char* pszBaselinePath = NULL;
+	size_t cRules = 5000;
+	size_t cHistory = 65536;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--seconds") == 0 and hasValue) { seconds = atof(argv[++i]); }
+		else if (strcmp(argv[i], "--kinds") == 0 and hasValue) { pszKinds = argv[++i]; }
+		else if (strcmp(argv[i], "--sizes") == 0 and hasValue) { pszSizes = argv[++i]; }
+		else if (strcmp(argv[i], "--formats") == 0 and hasValue) { pszFormats = strcmp(argv[++i], "all") == 0 ? kAllFormats : argv[i]; }
+		else if (strcmp(argv[i], "--stages") == 0 and hasValue) { pszStages = argv[++i]; }
+		else if (strcmp(argv[i], "--json") == 0 and hasValue) { pszJsonPath = argv[++i]; }
+		else if (strcmp(argv[i], "--compare") == 0 and hasValue) { pszBaselinePath = argv[++i]; }
+		else if (strcmp(argv[i], "--threshold") == 0 and hasValue) { threshold = atof(argv[++i]); }
+		else if (strcmp(argv[i], "--rules") == 0 and hasValue) { cRules = (size_t)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--history") == 0 and hasValue) { cHistory = (size_t)atol(argv[++i]); }
+		else {
+			fprintf(stderr, "Unknown option %s (see the comment at the top of CaptureBenchmark.cpp)\n", argv[i]);
+			return 2;
+		}
+	}
+
+	const std::vector<std::string> stages = SplitList(pszStages);
+	std::vector<StageResult> results;
+	PrintHeader();
+
+	for (const std::string& size : SplitList(pszSizes)) {
+		uint32_t width{};
+		uint32_t height{};
+		if (!ParseSize(size, &width, &height)) {
+			fprintf(stderr, "Unknown size %s\n", size.c_str());
+			return 2;
+		}
+
+		for (const std::string& kind : SplitList(pszKinds)) {
+			Canvas canvas;
+			if (!DrawCorpus(kind, width, height, &canvas)) {
+				fprintf(stderr, "Unknown corpus kind %s\n", kind.c_str());
+				return 2;
+			}
+
+			for (const std::string& format : SplitList(pszFormats)) {
+				std::vector<uint8_t> payload;
+				if (!BuildPayload(canvas, format, &payload)) {
+					fprintf(stderr, "Unknown format %s\n", format.c_str());
+					return 2;
+				}
+				RunPayloadStages(stages, kind + "-" + size + "-" + format, format, payload, seconds, &results);
+			}
+		}
+	}
+	RunCallStages(stages, cRules ? cRules : 1, cHistory ? cHistory : 1, seconds, &results);
+
+	printf("\nLatencies are per operation; peak MB is the resident memory a stage added on top of its\n"
+		"input (Linux only). %u hardware threads.\n", std::thread::hardware_concurrency());
+
+	if (pszJsonPath and !WriteJson(pszJsonPath, results, seconds)) {
+		fprintf(stderr, "Cannot write %s\n", pszJsonPath);
+		return 2;
+	}
+	if (pszBaselinePath and CompareWithBaseline(pszBaselinePath, results, threshold)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,926 @@
+// Clipboard event replay: load tests the capture path without a desktop (portable, runs on Linux).
+//
+// Events (timestamp, owner executable, clipboard format, payload) come from a trace file or are
+// generated, and are fed at their recorded times, or at a configurable rate, through the same
+// UpdateCoalescer, ClipboardOpenRetry and ClipboardMonitor the application runs on
+// WM_CLIPBOARDUPDATE and WM_TIMER. A worker pool with the queue size
+// and drop policy of CapturePipeline deduplicates on pixel keys and encodes like
+// HandleClipboardData does by default (the pre-hash and near-duplicate checks are left out).
+// The report has end-to-end throughput, drop counts by cause and latency percentiles per stage.
+//
+// Build and run on Linux:
+//   g++ -O2 -std=c++17 -pthread -I bench/compat -I src bench/ClipboardReplay.cpp src/{ContentHash,PixelConvert,DIBDecoder,PixelKey,PngEncoder,Deflate,PngReader,Inflate,Qoi,WhitelistMatcher,FilenameTemplate,PackStore}.cpp -o clipboard_replay
+//   ./clipboard_replay --synthetic 600 --rate 300 --burst 5
+//   ./clipboard_replay --trace captures.trace --speed 4
+//
+// Options:
+//   --trace FILE        Replays a trace file (format below)
+//   --synthetic N       Generates N events instead
+//   --rate PER_MIN      Synthetic events per minute (default 300)
+//   --burst N           Synthetic events come in bursts of N, 20 ms apart (default 1)
+//   --unique N          Distinct synthetic images (default 16); the other events repeat them
+//   --kinds LIST        Synthetic image kinds (default ui,text,photo,gradient)
+//   --sizes LIST        Synthetic image sizes (default 1080p)
+//   --formats LIST      Synthetic clipboard formats, dib,dibv5,png (default dib,png)
+//   --owners LIST       Synthetic owner executables (default a few common ones)
+//   --seed N            Synthetic trace seed (default 1)
+//   --write-trace FILE  Saves the generated trace for later runs
+//   --speed X           Plays the trace X times faster (default 1)
+//   --window MS         Coalescing window, the least quiet time before a burst is processed
+//                       (default 50, as [Coalesce] MinWindowMs)
+//   --max-window MS     Cap of the cost-adaptive window (default 500)
+//   --max-delay MS      Longest wait during a continuous stream (default 1000)
+//   --busy PCT          Share of clipboard opens that find it held by another process (default 0)
+//   --whitelist LIST    Whitelist rules, comma-separated (default: whitelist off)
+//   --workers N         Pipeline workers (default 2, as [Pipeline] Workers)
+//   --spool             Encodes QOI spool files instead of PNG
+//   --out DIR           Writes the files there, never over existing ones (default: encoded in memory only)
+//   --durability MODE   file, group or none, as [Writer] Durability (default file)
+//   --pack              Appends the captures to pack segments in --out instead, as [Pack] Enabled
+//   --name TEMPLATE     File name template, as [Output] Name (default replay_{seq:6})
+//   --json FILE         Writes the report as JSON
+//   --chrome-trace FILE Writes the trace zones as a Chrome trace (build with -DCIS_TRACE_ZONES=1)
+//
+// Trace format, one event per line, '#' starts a comment:
+//   <milliseconds> <owner> <png|dib|dibv5> <payload>
+// The owner is an executable name or a full path (without spaces), for path rules.
+// The payload is a file (a PNG, a .bmp whose file header is skipped, or raw clipboard bytes) or
+// synthetic:<kind>:<size>:<seed>, drawn by SyntheticCorpus.
+
+// Implementation-specific headers
+#include "ClipboardMonitor.h"  // The code under test
+#include "UpdateCoalescer.h"   // Burst coalescing in front of it
+#include "ClipboardOpenRetry.h"  // Retries of a held clipboard
+#include "WhitelistMatcher.h"  // Owner rules
+#include "LockFreeQueue.h"     // Worker queue, as in CapturePipeline
+#include "BufferPool.h"        // Payload copies
+#include "ContentHash.h"       // Byte keys
+#include "DIBDecoder.h"        // DIB rows
+#include "PixelKey.h"          // Dedup keys
+#include "PngEncoder.h"        // Saved files
+#include "Qoi.h"               // Spool files
+#include "SyntheticCorpus.h"   // Generated payloads
+#include "BenchCommon.h"       // Option lists, resident memory
+#include "TraceZones.h"        // Timeline of the run
+#include "AtomicFileWriter.h"  // --out files
+#include "FilenameTemplate.h"  // File names
+#include "PackStore.h"         // --pack segments
+
+// Standard library headers
+#include <algorithm>           // sort, min
+#include <atomic>              // Counters
+#include <chrono>              // Replay clock
+#include <condition_variable>  // Worker wakeup
+#include <cstdio>              // printf, FILE
+#include <cstdlib>             // atoi, atof
+#include <cstring>             // strcmp, memcpy
+#include <ctime>               // localtime
+#include <map>                 // Payload cache
+#include <mutex>               // Dedup state, results
+#include <random>              // Synthetic traces
+#include <string>              // Names
+#include <thread>              // Workers, pacing
+#include <unordered_map>       // Jobs in flight
+#include <unordered_set>       // Dedup keys
+#include <vector>              // Events, samples
+
+
+
+using namespace BenchCommon;
+
+
+
+// Anonymous namespace for the replay engine
+namespace
+{
+	constexpr INT kFormatDib = 8;                // CF_DIB
+	constexpr INT kFormatDibV5 = 17;             // CF_DIBV5
+	constexpr INT kFormatPng = 0xC000;           // Registered "PNG" format, any value outside the CF_ range
+	constexpr size_t kQueueCapacity = 64;        // CapturePipeline's queue
+	constexpr unsigned kMaxNameAttempts = 4096;  // Settings::MaxNameAttempts
+
+	using Clock = std::chrono::steady_clock;
+
+	struct ReplayEvent
+	{
+		double milliseconds{};
+		std::string owner;
+		std::string format;   // png | dib | dibv5
+		std::string payload;  // File or synthetic spec
+		const std::vector<uint8_t>* pData{};
+	};
+
+	bool ParseFormat(const std::string& format, INT* pnFormat)
+	{
+		if (format == "png") { *pnFormat = kFormatPng; return true; }
+		if (format == "dib") { *pnFormat = kFormatDib; return true; }
+		if (format == "dibv5") { *pnFormat = kFormatDibV5; return true; }
+		return false;
+	}
+
+	const char* FormatLabel(INT nFormat)
+	{
+		if (nFormat == kFormatPng) { return "PNG"; }
+		if (nFormat == kFormatDibV5) { return "DIBV5"; }
+		return "DIB";
+	}
+
+	bool ReadTrace(const char* pszPath, std::vector<ReplayEvent>* pEvents)
+	{
+		FILE* pFile = fopen(pszPath, "r");
+		if (!pFile) { return false; }
+
+		char szLine[4096];
+		unsigned nLine{};
+		bool isValid = true;
+		while (isValid and fgets(szLine, sizeof(szLine), pFile)) {
+			++nLine;
+			if (char* pComment = strchr(szLine, '#')) { *pComment = '\0'; }
+
+			char szOwner[MAX_PATH]{};
+			char szFormat[16]{};
+			char szPayload[2048]{};
+			double milliseconds{};
+			const int cFields = sscanf(szLine, "%lf %259s %15s %2047s", &milliseconds, szOwner, szFormat, szPayload);
+			if (cFields <= 0) { continue; }
+
+			INT nFormat{};
+			if (cFields != 4 or !ParseFormat(szFormat, &nFormat)) {
+				fprintf(stderr, "%s:%u: expected <milliseconds> <owner> <png|dib|dibv5> <payload>\n", pszPath, nLine);
+				isValid = false;
+				break;
+			}
+			pEvents->push_back({ milliseconds, szOwner, szFormat, szPayload });
+		}
+		fclose(pFile);
+
+		std::stable_sort(pEvents->begin(), pEvents->end(), [](const ReplayEvent& a, const ReplayEvent& b) {
+			return a.milliseconds < b.milliseconds;
+		});
+		return isValid;
+	}
+
+	bool WriteTrace(const char* pszPath, const std::vector<ReplayEvent>& events)
+	{
+		FILE* pFile = fopen(pszPath, "w");
+		if (!pFile) { return false; }
+		fprintf(pFile, "# <milliseconds> <owner> <png|dib|dibv5> <payload>\n");
+		for (const ReplayEvent& event : events) {
+			fprintf(pFile, "%.3f %s %s %s\n", event.milliseconds, event.owner.c_str(), event.format.c_str(), event.payload.c_str());
+		}
+		return fclose(pFile) == 0;
+	}
+
+	struct SyntheticOptions
+	{
+		size_t cEvents{};
+		double perMinute{ 300 };
+		size_t cBurst{ 1 };
+		size_t cUnique{ 16 };
+		unsigned seed{ 1 };
+		const char* pszKinds{ "ui,text,photo,gradient" };
+		const char* pszSizes{ "1080p" };
+		const char* pszFormats{ "dib,png" };
+		const char* pszOwners{ "chrome.exe,SnippingTool.exe,mspaint.exe,Teams.exe,autohotkey.exe" };
+	};
+
+	// Bursts of cBurst events 20 ms apart, spaced so that the average rate is perMinute
+	void GenerateTrace(const SyntheticOptions& options, std::vector<ReplayEvent>* pEvents)
+	{
+		std::mt19937 rng(options.seed);
+		const std::vector<std::string> kinds = SplitList(options.pszKinds);
+		const std::vector<std::string> sizes = SplitList(options.pszSizes);
+		const std::vector<std::string> formats = SplitList(options.pszFormats);
+		const std::vector<std::string> owners = SplitList(options.pszOwners);
+		const size_t cBurst = options.cBurst ? options.cBurst : 1;
+		const double burstSpacing = 60000.0 * cBurst / options.perMinute;
+
+		for (size_t i{}; i < options.cEvents; ++i) {
+			const size_t image = rng() % (options.cUnique ? options.cUnique : 1);
+			ReplayEvent event;
+			event.milliseconds = (double)(i / cBurst) * burstSpacing + (double)(i % cBurst) * 20;
+			event.owner = owners[rng() % owners.size()];
+			event.format = formats[rng() % formats.size()];
+			event.payload = "synthetic:" + kinds[image % kinds.size()] + ":" + sizes[image / kinds.size() % sizes.size()] +
+				":" + std::to_string(image + 1);
+			pEvents->push_back(event);
+		}
+	}
+
+	// Reads or draws every payload up front, once per (payload, format), so the replay only
+	// measures the capture path
+	bool LoadPayloads(std::vector<ReplayEvent>* pEvents, std::map<std::string, std::vector<uint8_t>>* pCache)
+	{
+		for (ReplayEvent& event : *pEvents) {
+			const std::string key = event.format + " " + event.payload;
+			auto it = pCache->find(key);
+			if (it == pCache->end()) {
+				std::vector<uint8_t> data;
+				if (event.payload.compare(0, 10, "synthetic:") == 0) {
+					std::vector<std::string> fields;
+					std::string field;
+					for (char c : event.payload.substr(10) + ":") {
+						if (c == ':') { fields.push_back(field); field.clear(); }
+						else { field += c; }
+					}
+					uint32_t width{};
+					uint32_t height{};
+					SyntheticCorpus::Canvas canvas;
+					if (fields.size() != 3 or !SyntheticCorpus::ParseSize(fields[1], &width, &height) or
+						!SyntheticCorpus::DrawCorpus(fields[0], width, height, &canvas, (uint32_t)atoi(fields[2].c_str())) or
+						!SyntheticCorpus::BuildPayload(canvas, event.format == "png" ? "png" : event.format == "dibv5" ? "32a" : "32", &data))
+					{
+						fprintf(stderr, "Bad synthetic payload %s\n", event.payload.c_str());
+						return false;
+					}
+				}
+				else {
+					FILE* pFile = fopen(event.payload.c_str(), "rb");
+					if (!pFile) {
+						fprintf(stderr, "Cannot read %s\n", event.payload.c_str());
+						return false;
+					}
+					uint8_t buffer[65536];
+					for (size_t cbRead; (cbRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0; ) {
+						data.insert(data.end(), buffer, buffer + cbRead);
+					}
+					fclose(pFile);
+
+					// A .bmp file is a DIB behind a BITMAPFILEHEADER
+					if (event.format != "png" and data.size() > sizeof(BITMAPFILEHEADER) and data[0] == 'B' and data[1] == 'M') {
+						data.erase(data.begin(), data.begin() + sizeof(BITMAPFILEHEADER));
+					}
+				}
+				it = pCache->emplace(key, std::move(data)).first;
+			}
+			event.pData = &it->second;
+		}
+		return true;
+	}
+
+
+
+	// Per-job record kept for the report
+	struct JobRecord
+	{
+		double endToEndMs{};
+		double stageMs[(size_t)CaptureStage::Count]{};
+		unsigned recordedStages{};  // CaptureTimings::recorded
+		ClipboardResult result{};
+		size_t cbPayload{};
+	};
+
+	// Replay state shared by the message loop (main thread) and the workers
+	class Replay : public ClipboardSource
+	{
+	private:
+		// Current event, set by the message loop before each OnUpdate
+		const ReplayEvent* pEvent_{};
+		LONGLONG llEventTime_{};
+
+		// Options
+		WhitelistMatcher whitelist_;
+		bool isWhitelistEnabled_{};
+		bool isSpooled_{};
+		std::string outputDirectory_;
+		std::string namePrefix_;  // outputDirectory_ and its separator
+		FilenameTemplate nameTemplate_;
+		AtomicFileWriter writer_;
+		PackWriter pack_;
+		bool isPacked_{};
+		unsigned busyPercent_{};
+		std::mt19937 busyRng_{ 7 };
+
+		// Pipeline
+		BufferPool bufferPool_;
+		LockFreeQueue<CaptureJob*> queue_{ kQueueCapacity };
+		std::vector<std::thread> workers_;
+		std::mutex wakeupMutex_;
+		std::condition_variable wakeup_;
+		size_t cWakeups_{};
+		bool isStopping_{};
+		std::atomic<size_t> cPeakQueueDepth_{};
+
+		// Dedup keys, as the application's dedupKeysInFlight and index
+		std::mutex dedupMutex_;
+		std::unordered_set<uint64_t> savedKeys_;
+		std::unordered_set<uint64_t> keysInFlight_;
+
+		// Results
+		std::mutex resultMutex_;
+		std::unordered_map<CaptureJob*, LONGLONG> eventTimes_;
+		std::vector<JobRecord> records_;
+		std::atomic<uint64_t> captureSequence_{};
+		std::atomic<size_t> cRenamed_{};
+
+	private:
+		static BOOL IsOwnerAllowedHook(void* pContext, LPCTSTR cszOwner)
+		{
+			const Replay* pReplay = static_cast<Replay*>(pContext);
+			return !pReplay->isWhitelistEnabled_ or pReplay->whitelist_.IsMatch(cszOwner);
+		}
+
+		// GenerateFilename: local time and the next sequence number, the hash left to the worker
+		static BOOL GenerateFilenameHook(void* pContext, CaptureJob* pJob)
+		{
+			Replay* pReplay = static_cast<Replay*>(pContext);
+			const auto now = std::chrono::system_clock::now();
+			const time_t seconds = std::chrono::system_clock::to_time_t(now);
+			const tm* pTime = localtime(&seconds);
+			pJob->nameFields = { (WORD)(pTime->tm_year + 1900), (WORD)(pTime->tm_mon + 1), (WORD)pTime->tm_mday,
+				(WORD)pTime->tm_hour, (WORD)pTime->tm_min, (WORD)pTime->tm_sec,
+				(WORD)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000),
+				++pReplay->captureSequence_ };
+			return pReplay->FormatName(pJob);
+		}
+
+		// FormatCaptureName: prefix, template, extension
+		bool FormatName(CaptureJob* pJob) const
+		{
+			const size_t cchPrefix = namePrefix_.size();
+			if (cchPrefix + 5 >= MAX_PATH) { return false; }
+
+			memcpy(pJob->szFilename, namePrefix_.c_str(), cchPrefix);
+			const size_t cchName = nameTemplate_.Format(pJob->nameFields, pJob->szOwner, pJob->szFilename + cchPrefix, MAX_PATH - cchPrefix - 4);
+			if (!cchName) { return false; }
+			memcpy(pJob->szFilename + cchPrefix + cchName, isSpooled_ ? ".qoi" : ".png", 5);
+			return true;
+		}
+
+		static bool SubmitHook(void* pContext, CaptureJob* pJob)
+		{
+			return static_cast<Replay*>(pContext)->Submit(pJob);
+		}
+
+		static void ReleaseBufferHook(void* pContext, PooledBuffer* pBuffer)
+		{
+			static_cast<Replay*>(pContext)->bufferPool_.Release(pBuffer);
+		}
+
+		// CapturePipeline::Submit: never blocks, fails when the queue is full
+		bool Submit(CaptureJob* pJob)
+		{
+			{
+				std::lock_guard<std::mutex> lock(resultMutex_);
+				eventTimes_[pJob] = llEventTime_;
+			}
+
+			pJob->llQueuedAt = CaptureTimings::Now();
+			if (!queue_.Push(pJob)) {
+				std::lock_guard<std::mutex> lock(resultMutex_);
+				eventTimes_.erase(pJob);
+				return false;
+			}
+
+			const size_t cDepth = queue_.Size();
+			size_t cPeak = cPeakQueueDepth_.load(std::memory_order_relaxed);
+			while (cDepth > cPeak and !cPeakQueueDepth_.compare_exchange_weak(cPeak, cDepth)) {}
+
+			{
+				std::lock_guard<std::mutex> lock(wakeupMutex_);
+				++cWakeups_;
+			}
+			wakeup_.notify_one();
+			return true;
+		}
+
+		void WorkerLoop()
+		{
+			TRACE_THREAD("replay worker");
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(wakeupMutex_);
+					wakeup_.wait(lock, [&]() { return cWakeups_ or isStopping_; });
+					if (cWakeups_) { --cWakeups_; }
+				}
+
+				CaptureJob* pJob{};
+				while (queue_.Pop(&pJob)) {
+					pJob->timings.Record(CaptureStage::Queue, pJob->llQueuedAt);
+					pJob->result = Process(pJob);
+					bufferPool_.Release(&pJob->buffer);
+					Complete(pJob);
+				}
+
+				std::lock_guard<std::mutex> lock(wakeupMutex_);
+				if (isStopping_ and !cWakeups_) { break; }
+			}
+		}
+
+		// HandleClipboardData with pixel keys, without the pre-hash and near-duplicate checks
+		ClipboardResult Process(CaptureJob* pJob)
+		{
+			const uint8_t* pData = pJob->buffer.pData;
+			const size_t cbSize = pJob->buffer.cbSize;
+			const BITMAPINFO* pbmi = reinterpret_cast<const BITMAPINFO*>(pData);
+			const bool isPng = pJob->nFormat == kFormatPng;
+			LONGLONG llStageStart = CaptureTimings::Now();
+
+			uint64_t qwKey{};
+			const bool isDecoded = isPng
+				? PixelKey::FromPNG(pData, cbSize, HashAlgorithm::Xxh3_64, &qwKey)
+				: PixelKey::FromDIB(pbmi, cbSize, HashAlgorithm::Xxh3_64, &PixelConvert::GetBestKernels(), &qwKey);
+			if (!isDecoded) {
+				qwKey = ContentHash::ToDedupKey(HashAlgorithm::Xxh3_64, ContentHash::Compute(HashAlgorithm::Xxh3_64, pData, cbSize, 0), cbSize);
+			}
+			{
+				std::lock_guard<std::mutex> lock(dedupMutex_);
+				if (savedKeys_.count(qwKey) or !keysInFlight_.insert(qwKey).second) {
+					pJob->timings.Record(CaptureStage::Hash, llStageStart);
+					return ClipboardResult::UnchangedContent;
+				}
+			}
+			if (nameTemplate_.IsHashUsed()) {
+				pJob->nameFields.contentHash = qwKey;
+				FormatName(pJob);
+			}
+			llStageStart = pJob->timings.Record(CaptureStage::Hash, llStageStart);
+
+			bool isSaved{};
+			std::vector<uint8_t> encoded;
+			const uint8_t* pFile = pData;
+			size_t cbFile = cbSize;
+			if (!isPng) {
+				DIBDecoder decoder;
+				if (decoder.Open(pbmi, cbSize, &PixelConvert::GetBestKernels())) {
+					const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+					isSaved = isSpooled_ ? Qoi::Encode(image, &encoded) : EncodePng(image, PngEncodeOptions{}, &encoded);
+				}
+				pFile = encoded.data();
+				cbFile = encoded.size();
+				llStageStart = pJob->timings.Record(CaptureStage::Encode, llStageStart);
+			}
+			else {
+				isSaved = true;
+			}
+			if (isSaved and isPacked_) {
+				isSaved = pack_.Append(pFile, cbFile, qwKey, PackWriter::Now(), pJob->szOwner);
+			}
+			else if (isSaved and !outputDirectory_.empty()) {
+				// As WriteCaptureFile: an existing file is kept and the next sequence numbers are tried
+				isSaved = writer_.Write(pJob->szFilename, pFile, cbFile, false);
+				for (unsigned cAttempts{}; !isSaved and GetLastError() == ERROR_ALREADY_EXISTS and cAttempts < kMaxNameAttempts; ++cAttempts) {
+					pJob->nameFields.sequence = ++captureSequence_;
+					if (!FormatName(pJob)) { break; }
+					cRenamed_.fetch_add(1, std::memory_order_relaxed);
+					isSaved = writer_.Write(pJob->szFilename, pFile, cbFile, false);
+				}
+			}
+			pJob->timings.Record(CaptureStage::Write, llStageStart);
+
+			std::lock_guard<std::mutex> lock(dedupMutex_);
+			keysInFlight_.erase(qwKey);
+			if (isSaved) { savedKeys_.insert(qwKey); }
+			return isSaved ? ClipboardResult::Success : ClipboardResult::SaveFailed;
+		}
+
+		void Complete(CaptureJob* pJob)
+		{
+			const LONGLONG llNow = CaptureTimings::Now();
+			JobRecord record;
+			record.result = pJob->result;
+			for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+				record.stageMs[i] = pJob->timings.Milliseconds((CaptureStage)i);
+			}
+			record.recordedStages = pJob->timings.recorded;
+
+			std::lock_guard<std::mutex> lock(resultMutex_);
+			auto it = eventTimes_.find(pJob);
+			if (it != eventTimes_.end()) {
+				record.endToEndMs = CaptureTimings::ToMilliseconds(llNow - it->second);
+				eventTimes_.erase(it);
+			}
+			records_.push_back(record);
+			delete pJob;
+		}
+
+	public:
+		Replay(const char* pszWhitelist, bool isSpooled, const char* pszOutputDirectory, unsigned busyPercent) :
+			isWhitelistEnabled_(pszWhitelist != NULL),
+			isSpooled_(isSpooled),
+			outputDirectory_(pszOutputDirectory ? pszOutputDirectory : ""),
+			namePrefix_(outputDirectory_.empty() ? "" : outputDirectory_ + "/"),
+			busyPercent_(busyPercent)
+		{
+			nameTemplate_.Compile("replay_{seq:6}");
+			if (pszWhitelist) {
+				std::string rules;
+				for (const std::string& rule : SplitList(pszWhitelist)) { rules += rule + "\n"; }
+				whitelist_.Compile(rules.c_str());
+			}
+		}
+
+		~Replay()
+		{
+			Stop();
+		}
+
+		bool SetNameTemplate(const char* pszTemplate)
+		{
+			return nameTemplate_.Compile(pszTemplate);
+		}
+
+		ClipboardMonitorHooks GetHooks()
+		{
+			return { this, IsOwnerAllowedHook, GenerateFilenameHook, SubmitHook, ReleaseBufferHook };
+		}
+
+		// isPacked appends to the pack segments of the output directory; false if they cannot be opened
+		bool Start(unsigned cWorkers, const AtomicFileWriterOptions& writerOptions, bool isPacked)
+		{
+			isPacked_ = isPacked and !outputDirectory_.empty();
+			if (isPacked_ and !pack_.Open(outputDirectory_.c_str(), PackWriterOptions{ writerOptions.durability, writerOptions.groupFlushMs })) {
+				return false;
+			}
+			writer_.Start(writerOptions);
+			for (unsigned i{}; i < (cWorkers ? cWorkers : 1); ++i) {
+				workers_.emplace_back([this]() { WorkerLoop(); });
+			}
+			return true;
+		}
+
+		// Lets the workers finish every queued job, then joins them
+		void Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(wakeupMutex_);
+				isStopping_ = true;
+			}
+			wakeup_.notify_all();
+			for (std::thread& worker : workers_) { worker.join(); }
+			workers_.clear();
+			writer_.Stop();
+			pack_.Close();
+		}
+
+		AtomicFileWriterStats GetWriterStats() const
+		{
+			return writer_.GetStats();
+		}
+
+		PackWriterStats GetPackStats() const
+		{
+			return pack_.GetStats();
+		}
+
+		void SetEvent(const ReplayEvent* pEvent, LONGLONG llEventTime)
+		{
+			pEvent_ = pEvent;
+			llEventTime_ = llEventTime;
+		}
+
+		// ClipboardSource over the current event; --busy makes some opens fail as if another
+		// process held the clipboard
+		BOOL Open() override
+		{
+			if (busyRng_() % 100 < busyPercent_) {
+				SetLastError(ERROR_ACCESS_DENIED);
+				return FALSE;
+			}
+			return pEvent_ != NULL;
+		}
+
+		void Close() override {}
+
+		LPCTSTR GetOwner() override { return pEvent_->owner.c_str(); }
+
+		BOOL CopyImage(CaptureJob* pJob) override
+		{
+			const std::vector<uint8_t>& data = *pEvent_->pData;
+			if (data.empty() or !ParseFormat(pEvent_->format, &pJob->nFormat)) { return FALSE; }
+			if (!bufferPool_.Acquire(data.size(), &pJob->buffer)) { return FALSE; }
+
+			// Plain copy: with the pre-hash on, the application leaves hashing to the workers
+			memcpy(pJob->buffer.pData, data.data(), data.size());
+			_tcscpy_s(pJob->szFormat, FormatLabel(pJob->nFormat));
+			return TRUE;
+		}
+
+		size_t GetPeakQueueDepth() const { return cPeakQueueDepth_.load(); }
+
+		// Names found taken by an earlier file and moved to the next sequence number
+		size_t GetRenamedCount() const { return cRenamed_.load(); }
+
+		const std::vector<JobRecord>& GetRecords() const { return records_; }
+	};
+
+
+
+	struct Percentiles
+	{
+		double p50{}, p90{}, p99{}, max{};
+	};
+
+	Percentiles ComputePercentiles(std::vector<double> values)
+	{
+		Percentiles result;
+		if (values.empty()) { return result; }
+		std::sort(values.begin(), values.end());
+		const auto At = [&](double p) { return values[std::min(values.size() - 1, (size_t)(p * values.size()))]; };
+		result.p50 = At(0.50);
+		result.p90 = At(0.90);
+		result.p99 = At(0.99);
+		result.max = values.back();
+		return result;
+	}
+
+	void PrintPercentiles(const char* pszName, const Percentiles& p)
+	{
+		printf("  %-14s %10.2f %10.2f %10.2f %10.2f\n", pszName, p.p50, p.p90, p.p99, p.max);
+	}
+
+	void WritePercentiles(FILE* pFile, const char* pszName, const Percentiles& p, bool isLast)
+	{
+		fprintf(pFile, "    \"%s\": {\"p50\": %.6g, \"p90\": %.6g, \"p99\": %.6g, \"max\": %.6g}%s\n",
+			pszName, p.p50, p.p90, p.p99, p.max, isLast ? "" : ",");
+	}
+}
+
+
+
+int main(int argc, char** argv)
+{
+	SyntheticOptions synthetic;
+	const char* pszTracePath = NULL;
+	const char* pszWriteTracePath = NULL;
+	const char* pszWhitelist = NULL;
+	const char* pszOutputDirectory = NULL;
+	const char* pszJsonPath = NULL;
+	const char* pszChromeTracePath = NULL;
+	double speed = 1;
+	UpdateCoalescerOptions coalescerOptions{};
+	unsigned busyPercent{};
+	unsigned cWorkers = 2;
+	bool isSpooled{};
+	bool isPacked{};
+	AtomicFileWriterOptions writerOptions{};
+	const char* pszNameTemplate = NULL;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--trace") == 0 and hasValue) { pszTracePath = argv[++i]; }
+		else if (strcmp(argv[i], "--synthetic") == 0 and hasValue) { synthetic.cEvents = (size_t)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--rate") == 0 and hasValue) { synthetic.perMinute = atof(argv[++i]); }
+		else if (strcmp(argv[i], "--burst") == 0 and hasValue) { synthetic.cBurst = (size_t)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--unique") == 0 and hasValue) { synthetic.cUnique = (size_t)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--kinds") == 0 and hasValue) { synthetic.pszKinds = argv[++i]; }
+		else if (strcmp(argv[i], "--sizes") == 0 and hasValue) { synthetic.pszSizes = argv[++i]; }
+		else if (strcmp(argv[i], "--formats") == 0 and hasValue) { synthetic.pszFormats = argv[++i]; }
+		else if (strcmp(argv[i], "--owners") == 0 and hasValue) { synthetic.pszOwners = argv[++i]; }
+		else if (strcmp(argv[i], "--seed") == 0 and hasValue) { synthetic.seed = (unsigned)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--write-trace") == 0 and hasValue) { pszWriteTracePath = argv[++i]; }
+		else if (strcmp(argv[i], "--speed") == 0 and hasValue) { speed = atof(argv[++i]); }
+		else if (strcmp(argv[i], "--window") == 0 and hasValue) { coalescerOptions.minWindowMs = (DWORD)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--max-window") == 0 and hasValue) { coalescerOptions.maxWindowMs = (DWORD)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--max-delay") == 0 and hasValue) { coalescerOptions.maxDelayMs = (DWORD)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--busy") == 0 and hasValue) { busyPercent = (unsigned)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--whitelist") == 0 and hasValue) { pszWhitelist = argv[++i]; }
+		else if (strcmp(argv[i], "--workers") == 0 and hasValue) { cWorkers = (unsigned)atol(argv[++i]); }
+		else if (strcmp(argv[i], "--spool") == 0) { isSpooled = true; }
+		else if (strcmp(argv[i], "--pack") == 0) { isPacked = true; }
+		else if (strcmp(argv[i], "--out") == 0 and hasValue) { pszOutputDirectory = argv[++i]; }
+		else if (strcmp(argv[i], "--name") == 0 and hasValue) { pszNameTemplate = argv[++i]; }
+		else if (strcmp(argv[i], "--durability") == 0 and hasValue) { writerOptions.durability = AtomicFileWriter::ParseDurability(argv[++i]); }
+		else if (strcmp(argv[i], "--json") == 0 and hasValue) { pszJsonPath = argv[++i]; }
+		else if (strcmp(argv[i], "--chrome-trace") == 0 and hasValue) { pszChromeTracePath = argv[++i]; }
+		else {
+			fprintf(stderr, "Unknown option %s (see the comment at the top of ClipboardReplay.cpp)\n", argv[i]);
+			return 2;
+		}
+	}
+	if (speed <= 0 or synthetic.perMinute <= 0) {
+		fprintf(stderr, "--speed and --rate must be positive\n");
+		return 2;
+	}
+	if (isPacked and (isSpooled or !pszOutputDirectory)) {
+		fprintf(stderr, "--pack needs --out and does not go with --spool\n");
+		return 2;
+	}
+	if (pszChromeTracePath and !CIS_TRACE_ZONES) {
+		fprintf(stderr, "--chrome-trace needs a build with -DCIS_TRACE_ZONES=1\n");
+		return 2;
+	}
+	TRACE_THREAD("message loop");
+
+	std::vector<ReplayEvent> events;
+	if (pszTracePath) {
+		if (!ReadTrace(pszTracePath, &events)) {
+			fprintf(stderr, "Cannot read trace %s\n", pszTracePath);
+			return 2;
+		}
+	}
+	else if (synthetic.cEvents) {
+		GenerateTrace(synthetic, &events);
+	}
+	else {
+		fprintf(stderr, "Nothing to replay: give --trace FILE or --synthetic N\n");
+		return 2;
+	}
+	if (pszWriteTracePath and !WriteTrace(pszWriteTracePath, events)) {
+		fprintf(stderr, "Cannot write %s\n", pszWriteTracePath);
+		return 2;
+	}
+
+	std::map<std::string, std::vector<uint8_t>> payloads;
+	printf("Preparing payloads for %zu events...\n", events.size());
+	if (!LoadPayloads(&events, &payloads)) { return 2; }
+	size_t cbPayloads{};
+	for (const auto& payload : payloads) { cbPayloads += payload.second.size(); }
+	printf("%zu distinct payloads, %.1f MB\n", payloads.size(), cbPayloads / 1e6);
+
+	Replay replay(pszWhitelist, isSpooled, pszOutputDirectory, busyPercent);
+	if (pszNameTemplate and !replay.SetNameTemplate(pszNameTemplate)) {
+		fprintf(stderr, "Invalid --name template %s\n", pszNameTemplate);
+		return 2;
+	}
+	ClipboardMonitor monitor;
+	monitor.SetHooks(replay.GetHooks());
+	UpdateCoalescer coalescer;
+	coalescer.SetOptions(coalescerOptions);
+	ClipboardOpenRetry openRetry;
+	if (!replay.Start(cWorkers, writerOptions, isPacked)) {
+		fprintf(stderr, "Cannot open the pack segments in %s\n", pszOutputDirectory);
+		return 2;
+	}
+
+	// Message loop: each event is received at its time, or as soon as the loop is free, and
+	// the coalescer's timer processes the latest one, as WM_CLIPBOARDUPDATE and WM_TIMER do.
+	// The event index stands for the clipboard sequence number.
+	const bool isPeakReset = ResetPeakRss();
+	const long startRssKb = ReadStatusKb("VmRSS:");
+	std::vector<double> lagMs;
+	size_t cbSubmitted{};
+	const ReplayEvent* pLatest{};
+	DWORD dwSequence{};
+	LONGLONG llLatestDue{};
+	LONGLONG llCoalesceDue{};  // Timers, 0 while not armed
+	LONGLONG llRetryDue{};
+	const auto NowMs = []() { return (ULONGLONG)(CaptureTimings::Now() / 1000000); };
+	const auto Arm = [](DWORD dwDelayMs) { return CaptureTimings::Now() + (LONGLONG)dwDelayMs * 1000000; };
+	const auto NextTimer = [&]() {
+		return !llRetryDue ? llCoalesceDue : !llCoalesceDue ? llRetryDue : (std::min)(llCoalesceDue, llRetryDue);
+	};
+	const auto SleepUntil = [](LONGLONG llTime) {
+		std::this_thread::sleep_until(Clock::time_point(std::chrono::nanoseconds(llTime)));
+	};
+	const auto OnTimer = [&]() {
+		if (llRetryDue and llRetryDue == NextTimer()) {
+			llRetryDue = 0;
+			if (!openRetry.IsRetryDue(dwSequence)) { return; }
+		}
+		else {
+			llCoalesceDue = 0;
+			DWORD dwDelayMs{};
+			if (!coalescer.IsDue(NowMs(), &dwDelayMs)) {
+				if (dwDelayMs) { llCoalesceDue = Arm(dwDelayMs); }
+				return;
+			}
+		}
+
+		const LONGLONG llProcessStart = CaptureTimings::Now();
+		replay.SetEvent(pLatest, llLatestDue);
+		const ClipboardUpdate update = monitor.OnUpdate(&replay, NULL);
+		const DWORD dwError = update == ClipboardUpdate::OpenFailed ? GetLastError() : ERROR_SUCCESS;
+		coalescer.OnProcessed(CaptureTimings::ToMilliseconds(CaptureTimings::Now() - llProcessStart));
+		if (update == ClipboardUpdate::Submitted) { cbSubmitted += pLatest->pData->size(); }
+
+		const DWORD dwRetryMs = openRetry.OnAttempt(dwError == ERROR_ACCESS_DENIED, dwSequence, NowMs());
+		if (dwRetryMs) { llRetryDue = Arm(dwRetryMs); }
+	};
+
+	const LONGLONG llStart = CaptureTimings::Now();
+	for (const ReplayEvent& event : events) {
+		const LONGLONG llDue = llStart + (LONGLONG)(event.milliseconds / speed * 1e6);
+		while (NextTimer() and NextTimer() <= llDue) {
+			SleepUntil(NextTimer());
+			OnTimer();
+		}
+
+		SleepUntil(llDue);
+		const LONGLONG llNow = CaptureTimings::Now();
+		lagMs.push_back(CaptureTimings::ToMilliseconds(llNow - llDue));
+		pLatest = &event;
+		llLatestDue = llDue;
+		++dwSequence;
+		if (openRetry.Supersede()) { llRetryDue = 0; }
+		llCoalesceDue = llNow + (LONGLONG)coalescer.OnUpdate(NowMs()) * 1000000;
+	}
+	while (NextTimer()) {
+		SleepUntil(NextTimer());
+		OnTimer();
+	}
+	replay.Stop();
+	const double elapsedSeconds = CaptureTimings::ToMilliseconds(CaptureTimings::Now() - llStart) / 1000;
+	const long peakKb = ReadStatusKb("VmHWM:");
+	const long peakRssKb = isPeakReset and peakKb >= 0 and startRssKb >= 0 ? peakKb - startRssKb : -1;
+
+	// Report
+	const std::vector<JobRecord>& records = replay.GetRecords();
+	size_t cSaved{};
+	size_t cDuplicates{};
+	size_t cFailed{};
+	std::vector<double> endToEnd;
+	std::vector<double> stages[(size_t)CaptureStage::Count];
+	for (const JobRecord& record : records) {
+		if (record.result == ClipboardResult::Success) { ++cSaved; }
+		else if (record.result == ClipboardResult::UnchangedContent) { ++cDuplicates; }
+		else { ++cFailed; }
+		endToEnd.push_back(record.endToEndMs);
+		for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+			if ((record.recordedStages >> i) & 1) { stages[i].push_back(record.stageMs[i]); }
+		}
+	}
+
+	const double traceSeconds = events.empty() ? 0 : events.back().milliseconds / speed / 1000;
+	const char* const stageNames[] = { "open", "owner", "filter", "copy", "queue", "hash", "encode", "write" };
+	static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == (size_t)CaptureStage::Count, "Stage names");
+
+	printf("\nEvents          %zu over %.2f s (%.1f/min offered), replayed in %.2f s\n",
+		events.size(), traceSeconds, traceSeconds > 0 ? events.size() / traceSeconds * 60 : 0.0, elapsedSeconds);
+	const UpdateCoalescerStats coalescerStats = coalescer.GetStats();
+	printf("Coalesced       %llu (window %lu ms at the end)\n", (unsigned long long)coalescerStats.cCoalesced, (unsigned long)coalescer.GetWindow());
+	printf("Processed       %llu\n", (unsigned long long)coalescerStats.cProcessed);
+	const ClipboardContentionStats contentionStats = openRetry.GetStats();
+	printf("Clipboard busy  %llu (%llu recovered, %llu superseded, %llu given up; %llu opens tried)\n",
+		(unsigned long long)contentionStats.cContended, (unsigned long long)contentionStats.cRecovered,
+		(unsigned long long)contentionStats.cSuperseded, (unsigned long long)contentionStats.cGaveUp,
+		(unsigned long long)contentionStats.cAttempts);
+	if (contentionStats.cRecovered) {
+		printf("  waited        %.1f ms on average, %llu ms at most\n",
+			(double)contentionStats.totalWaitMs / contentionStats.cRecovered, (unsigned long long)contentionStats.maxWaitMs);
+	}
+	printf("Not whitelisted %llu\n", (unsigned long long)monitor.GetCount(ClipboardUpdate::NotWhitelisted));
+	printf("No image        %llu\n", (unsigned long long)monitor.GetCount(ClipboardUpdate::NoImage));
+	printf("Dropped (full)  %llu\n", (unsigned long long)monitor.GetCount(ClipboardUpdate::Dropped));
+	printf("Submitted       %llu (%.1f MB)\n", (unsigned long long)monitor.GetCount(ClipboardUpdate::Submitted), cbSubmitted / 1e6);
+	printf("  saved         %zu\n", cSaved);
+	printf("  duplicates    %zu\n", cDuplicates);
+	printf("  failed        %zu\n", cFailed);
+	if (isPacked) {
+		const PackWriterStats packStats = replay.GetPackStats();
+		printf("  packed        %llu captures, %.1f MB in %llu segments (%llu failed)\n",
+			(unsigned long long)packStats.cEntries, packStats.cbWritten / 1e6,
+			(unsigned long long)packStats.cSegments, (unsigned long long)packStats.cFailed);
+	}
+	else if (pszOutputDirectory) {
+		const AtomicFileWriterStats writerStats = replay.GetWriterStats();
+		printf("  written       %llu files, %.1f MB (%llu failed, %llu group flushes)\n",
+			(unsigned long long)writerStats.cFiles, writerStats.cbWritten / 1e6,
+			(unsigned long long)writerStats.cFailed, (unsigned long long)writerStats.cGroupFlushes);
+		printf("  renamed       %zu (name taken by an earlier file)\n", replay.GetRenamedCount());
+	}
+	printf("Throughput      %.1f updates/s processed, %.1f saves/s, %.1f MB/s submitted\n",
+		coalescerStats.cProcessed / elapsedSeconds, cSaved / elapsedSeconds, cbSubmitted / 1e6 / elapsedSeconds);
+	printf("Peak queue      %zu of %zu\n", replay.GetPeakQueueDepth(), kQueueCapacity);
+	if (peakRssKb >= 0) { printf("Peak RSS        %.1f MB above the loaded payloads\n", peakRssKb / 1024.0); }
+
+	printf("\nLatency (ms)          p50        p90        p99        max\n");
+	const Percentiles lag = ComputePercentiles(lagMs);
+	const Percentiles total = ComputePercentiles(endToEnd);
+	PrintPercentiles("dispatch lag", lag);
+	for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+		PrintPercentiles(stageNames[i], ComputePercentiles(stages[i]));
+	}
+	PrintPercentiles("end to end", total);
+
+#if CIS_TRACE_ZONES
+	if (pszChromeTracePath) {
+		const std::string json = Trace::ToChromeJson();
+		FILE* pFile = fopen(pszChromeTracePath, "w");
+		if (!pFile or fwrite(json.data(), 1, json.size(), pFile) != json.size() or fclose(pFile) != 0) {
+			fprintf(stderr, "Cannot write %s\n", pszChromeTracePath);
+			return 2;
+		}
+	}
+#endif
+
+	if (pszJsonPath) {
+		FILE* pFile = fopen(pszJsonPath, "w");
+		if (!pFile) {
+			fprintf(stderr, "Cannot write %s\n", pszJsonPath);
+			return 2;
+		}
+		fprintf(pFile, "{\n  \"events\": %zu,\n  \"traceSeconds\": %.3f,\n  \"elapsedSeconds\": %.3f,\n"
+			"  \"workers\": %u,\n  \"coalesced\": %llu,\n  \"processed\": %llu,\n"
+			"  \"contended\": %llu,\n  \"recovered\": %llu,\n  \"superseded\": %llu,\n  \"gaveUp\": %llu,\n  \"notWhitelisted\": %llu,\n  \"noImage\": %llu,\n"
+			"  \"dropped\": %llu,\n  \"submitted\": %llu,\n  \"saved\": %zu,\n  \"duplicates\": %zu,\n  \"failed\": %zu,\n"
+			"  \"peakQueueDepth\": %zu,\n  \"peakRssKb\": %ld,\n  \"latencyMs\": {\n",
+			events.size(), traceSeconds, elapsedSeconds, cWorkers,
+			(unsigned long long)coalescerStats.cCoalesced, (unsigned long long)coalescerStats.cProcessed,
+			(unsigned long long)contentionStats.cContended, (unsigned long long)contentionStats.cRecovered,
+			(unsigned long long)contentionStats.cSuperseded, (unsigned long long)contentionStats.cGaveUp,
+			(unsigned long long)monitor.GetCount(ClipboardUpdate::NotWhitelisted),
+			(unsigned long long)monitor.GetCount(ClipboardUpdate::NoImage),
+			(unsigned long long)monitor.GetCount(ClipboardUpdate::Dropped),
+			(unsigned long long)monitor.GetCount(ClipboardUpdate::Submitted),
+			cSaved, cDuplicates, cFailed, replay.GetPeakQueueDepth(), peakRssKb);
+		WritePercentiles(pFile, "dispatchLag", lag, false);
+		for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+			WritePercentiles(pFile, stageNames[i], ComputePercentiles(stages[i]), false);
+		}
+		WritePercentiles(pFile, "endToEnd", total, true);
+		fprintf(pFile, "  }\n}\n");
+		if (fclose(pFile) != 0) { return 2; }
+	}
+	return 0;
+}
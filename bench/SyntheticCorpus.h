@@ -0,0 +1,443 @@
+#pragma once
+
+// Synthetic screenshot-like images for the benchmarks and the replay driver: UI windows, text
+// pages, photos and gradients, drawn deterministically from a seed and stored as any of the
+// clipboard payloads the capture path receives.
+
+// Implementation-specific headers
+#include "PngEncoder.h"  // CF_PNG payloads
+
+// Standard library headers
+#include <algorithm>  // min, max
+#include <cmath>      // sqrt
+#include <cstring>    // memcpy
+#include <random>     // Corpus noise
+#include <string>     // Names
+#include <vector>     // Pixels
+
+// Windows system headers
+#include <windows.h>  // DIB headers (bench/compat elsewhere)
+
+
+
+namespace SyntheticCorpus
+{
+	// Top-down BGRA image the corpora are drawn on
+	struct Canvas
+	{
+		uint32_t width{};
+		uint32_t height{};
+		std::vector<uint8_t> bgra;
+
+		uint8_t* At(uint32_t x, uint32_t y) { return &bgra[((size_t)y * width + x) * 4]; }
+
+		void Fill(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint32_t rgb)
+		{
+			const uint32_t x1 = std::min(width, x0 + w);
+			const uint32_t y1 = std::min(height, y0 + h);
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = x0; x < x1; ++x) {
+					uint8_t* p = At(x, y);
+					p[0] = (uint8_t)rgb;
+					p[1] = (uint8_t)(rgb >> 8);
+					p[2] = (uint8_t)(rgb >> 16);
+					p[3] = 255;
+				}
+			}
+		}
+
+		// Outlined rectangle, one pixel wide
+		void Frame(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint32_t rgb)
+		{
+			Fill(x0, y0, w, 1, rgb);
+			Fill(x0, y0 + h - 1, w, 1, rgb);
+			Fill(x0, y0, 1, h, rgb);
+			Fill(x0 + w - 1, y0, 1, h, rgb);
+		}
+	};
+
+	// Anti-aliased pseudo-glyphs, 8x14 coverage maps
+	struct GlyphAtlas
+	{
+		static constexpr uint32_t kWidth = 8;
+		static constexpr uint32_t kHeight = 14;
+		static constexpr size_t kCount = 64;
+		uint8_t coverage[kCount][kHeight][kWidth]{};
+
+		explicit GlyphAtlas(std::mt19937& rng)
+		{
+			for (size_t i{}; i < kCount; ++i) {
+				// Strokes: a vertical stem, a bowl or a bar, sometimes an ascender
+				const uint32_t stem = 1 + rng() % 5;
+				const bool hasBowl = rng() % 2;
+				const bool hasAscender = rng() % 3 == 0;
+				for (uint32_t y = hasAscender ? 1 : 5; y < 12; ++y) { coverage[i][y][stem] = 255; coverage[i][y][stem + 1] = 96; }
+				for (uint32_t x = 1; x < 7; ++x) {
+					coverage[i][hasBowl ? 5 : 8][x] = std::max<uint8_t>(coverage[i][hasBowl ? 5 : 8][x], 200);
+					if (hasBowl) { coverage[i][11][x] = std::max<uint8_t>(coverage[i][11][x], 220); }
+				}
+				if (hasBowl) { for (uint32_t y = 5; y < 12; ++y) { coverage[i][y][6] = 180; } }
+			}
+		}
+
+		void Draw(Canvas* pCanvas, size_t glyph, uint32_t x0, uint32_t y0, uint32_t rgb) const
+		{
+			for (uint32_t y{}; y < kHeight and y0 + y < pCanvas->height; ++y) {
+				for (uint32_t x{}; x < kWidth and x0 + x < pCanvas->width; ++x) {
+					const unsigned a = coverage[glyph][y][x];
+					if (!a) { continue; }
+					uint8_t* p = pCanvas->At(x0 + x, y0 + y);
+					for (unsigned c{}; c < 3; ++c) {
+						const unsigned fg = (rgb >> (8 * c)) & 0xFF;
+						p[c] = (uint8_t)((fg * a + p[c] * (255 - a)) / 255);
+					}
+				}
+			}
+		}
+	};
+
+	// Lines of text in a column starting at (x0, y0)
+	inline void DrawText(Canvas* pCanvas, const GlyphAtlas& atlas, std::mt19937& rng,
+		uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint32_t rgb)
+	{
+		const uint32_t lineHeight = GlyphAtlas::kHeight + 6;
+		for (uint32_t y = y0; y + lineHeight <= y0 + h; y += lineHeight) {
+			const uint32_t lineWidth = w - rng() % (w / 3 + 1);
+			for (uint32_t x = x0; x + GlyphAtlas::kWidth <= x0 + lineWidth; ) {
+				const uint32_t wordLength = 2 + rng() % 9;
+				for (uint32_t i{}; i < wordLength and x + GlyphAtlas::kWidth <= x0 + lineWidth; ++i) {
+					atlas.Draw(pCanvas, rng() % GlyphAtlas::kCount, x, y, rgb);
+					x += GlyphAtlas::kWidth;
+				}
+				x += GlyphAtlas::kWidth / 2;
+			}
+		}
+	}
+
+	// Desktop application window: title bar, toolbar, sidebar, panels, buttons, some text
+	inline void DrawUi(Canvas* pCanvas, std::mt19937& rng)
+	{
+		const GlyphAtlas atlas(rng);
+		const uint32_t w = pCanvas->width;
+		const uint32_t h = pCanvas->height;
+		const uint32_t unit = std::max<uint32_t>(1, h / 1080);
+
+		pCanvas->Fill(0, 0, w, h, 0xF3F3F3);
+		pCanvas->Fill(0, 0, w, 32 * unit, 0x202020);
+		pCanvas->Fill(0, 32 * unit, w, 40 * unit, 0xE6E6E6);
+		pCanvas->Fill(0, 72 * unit, 260 * unit, h, 0xEBEBEB);
+		for (uint32_t i{}; i < 24; ++i) {
+			pCanvas->Fill(12 * unit + i * 36 * unit, 40 * unit, 24 * unit, 24 * unit, rng() & 0xFFFFFF);
+			DrawText(pCanvas, atlas, rng, 16 * unit, 90 * unit + i * 40 * unit, 220 * unit, 20, 0x333333);
+		}
+
+		// Cards with a header line and body text
+		const uint32_t cardWidth = 420 * unit;
+		const uint32_t cardHeight = 260 * unit;
+		for (uint32_t y = 90 * unit; y + cardHeight < h; y += cardHeight + 20 * unit) {
+			for (uint32_t x = 280 * unit; x + cardWidth < w; x += cardWidth + 20 * unit) {
+				pCanvas->Fill(x, y, cardWidth, cardHeight, 0xFFFFFF);
+				pCanvas->Frame(x, y, cardWidth, cardHeight, 0xD0D0D0);
+				pCanvas->Fill(x + 1, y + 1, cardWidth - 2, 4 * unit, rng() & 0xFFFFFF);
+				DrawText(pCanvas, atlas, rng, x + 16 * unit, y + 20 * unit, cardWidth - 32 * unit, cardHeight - 80 * unit, 0x1A1A1A);
+				pCanvas->Fill(x + cardWidth - 120 * unit, y + cardHeight - 48 * unit, 100 * unit, 32 * unit, 0x0067C0);
+			}
+		}
+	}
+
+	// Document: black text on white, narrow margins
+	inline void DrawTextPage(Canvas* pCanvas, std::mt19937& rng)
+	{
+		const GlyphAtlas atlas(rng);
+		pCanvas->Fill(0, 0, pCanvas->width, pCanvas->height, 0xFFFFFF);
+		const uint32_t margin = pCanvas->width / 20;
+		DrawText(pCanvas, atlas, rng, margin, margin, pCanvas->width - 2 * margin, pCanvas->height - 2 * margin, 0x000000);
+	}
+
+	// Smooth multi-octave value noise plus sensor grain
+	inline void DrawPhoto(Canvas* pCanvas, std::mt19937& rng)
+	{
+		struct Octave { uint32_t cells; std::vector<float> grid; };
+		std::vector<Octave> octaves;
+		for (uint32_t cells : { 4u, 16u, 64u }) {
+			Octave octave{ cells, std::vector<float>((size_t)(cells + 1) * (cells + 1) * 3) };
+			for (float& value : octave.grid) { value = (float)(rng() % 256); }
+			octaves.push_back(std::move(octave));
+		}
+		const float weights[] = { 0.6f, 0.3f, 0.1f };
+
+		std::mt19937 grain(rng());
+		for (uint32_t y{}; y < pCanvas->height; ++y) {
+			for (uint32_t x{}; x < pCanvas->width; ++x) {
+				float rgb[3]{};
+				for (size_t o{}; o < octaves.size(); ++o) {
+					const Octave& octave = octaves[o];
+					const float fx = (float)x * octave.cells / pCanvas->width;
+					const float fy = (float)y * octave.cells / pCanvas->height;
+					const uint32_t ix = (uint32_t)fx;
+					const uint32_t iy = (uint32_t)fy;
+					const float tx = fx - ix;
+					const float ty = fy - iy;
+					const size_t stride = (size_t)(octave.cells + 1) * 3;
+					const float* p = &octave.grid[iy * stride + ix * 3];
+					for (unsigned c{}; c < 3; ++c) {
+						const float top = p[c] + (p[3 + c] - p[c]) * tx;
+						const float bottom = p[stride + c] + (p[stride + 3 + c] - p[stride + c]) * tx;
+						rgb[c] += weights[o] * (top + (bottom - top) * ty);
+					}
+				}
+				uint8_t* pPixel = pCanvas->At(x, y);
+				for (unsigned c{}; c < 3; ++c) {
+					const int value = (int)rgb[c] + (int)(grain() % 13) - 6;
+					pPixel[c] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+				}
+				pPixel[3] = 255;
+			}
+		}
+	}
+
+	// Diagonal two-color gradient with a radial highlight
+	inline void DrawGradient(Canvas* pCanvas, std::mt19937& rng)
+	{
+		const uint32_t from = rng() & 0xFFFFFF;
+		const uint32_t to = rng() & 0xFFFFFF;
+		const float cx = pCanvas->width * 0.7f;
+		const float cy = pCanvas->height * 0.3f;
+		const float radius = pCanvas->height * 0.5f;
+		for (uint32_t y{}; y < pCanvas->height; ++y) {
+			for (uint32_t x{}; x < pCanvas->width; ++x) {
+				const float t = ((float)x / pCanvas->width + (float)y / pCanvas->height) / 2;
+				const float d = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy)) / radius;
+				const float glow = d < 1 ? (1 - d) * 60 : 0;
+				uint8_t* p = pCanvas->At(x, y);
+				for (unsigned c{}; c < 3; ++c) {
+					const float a = (float)((from >> (8 * c)) & 0xFF);
+					const float b = (float)((to >> (8 * c)) & 0xFF);
+					const float value = a + (b - a) * t + glow;
+					p[c] = (uint8_t)(value > 255 ? 255 : value);
+				}
+				p[3] = 255;
+			}
+		}
+	}
+
+	inline bool ParseSize(const std::string& size, uint32_t* pWidth, uint32_t* pHeight)
+	{
+		if (size == "1080p") { *pWidth = 1920; *pHeight = 1080; return true; }
+		if (size == "4k") { *pWidth = 3840; *pHeight = 2160; return true; }
+		if (size == "8k") { *pWidth = 7680; *pHeight = 4320; return true; }
+		return false;
+	}
+
+	inline bool DrawCorpus(const std::string& kind, uint32_t width, uint32_t height, Canvas* pCanvas, uint32_t seed = 12345)
+	{
+		std::mt19937 rng(seed);
+		pCanvas->width = width;
+		pCanvas->height = height;
+		pCanvas->bgra.assign((size_t)width * height * 4, 0);
+		if (kind == "ui") { DrawUi(pCanvas, rng); }
+		else if (kind == "text") { DrawTextPage(pCanvas, rng); }
+		else if (kind == "photo") { DrawPhoto(pCanvas, rng); }
+		else if (kind == "gradient") { DrawGradient(pCanvas, rng); }
+		else { return false; }
+		return true;
+	}
+
+
+
+	// PngRowProc over the canvas as RGBA
+	inline bool CanvasRowProc(const void* pContext, uint32_t y, uint8_t* pRow)
+	{
+		const Canvas* pCanvas = static_cast<const Canvas*>(pContext);
+		const uint8_t* pSrc = &pCanvas->bgra[(size_t)y * pCanvas->width * 4];
+		for (uint32_t x{}; x < pCanvas->width; ++x, pSrc += 4, pRow += 4) {
+			pRow[0] = pSrc[2];
+			pRow[1] = pSrc[1];
+			pRow[2] = pSrc[0];
+			pRow[3] = pSrc[3];
+		}
+		return true;
+	}
+
+	// Clipboard payload of the canvas, bottom-up like most DIB producers, one per decoder path:
+	//   32      BITMAPINFOHEADER, BI_RGB, alpha bytes zero (screenshots, GDI)
+	//   32a     BITMAPV5HEADER, BI_BITFIELDS with an alpha mask and a translucent drop shadow
+	//   101010  BITMAPINFOHEADER, BI_BITFIELDS 10-10-10, the generic 32bpp mask reader
+	//   24      BITMAPINFOHEADER, BI_RGB, padded rows
+	//   16      BITMAPINFOHEADER, BI_BITFIELDS 5-6-5
+	//   555     BITMAPINFOHEADER, BI_RGB 5-5-5
+	//   4444    BITMAPV5HEADER, BI_BITFIELDS 4-4-4-4 with the drop shadow, the generic 16bpp mask reader
+	//   8       BITMAPINFOHEADER, BI_RGB with a 3-3-2 palette
+	//   4       BITMAPINFOHEADER, BI_RGB with 16 gray levels
+	//   1       BITMAPINFOHEADER, BI_RGB black and white, luma thresholded
+	//   rle8    BI_RLE8 of the 8 image, encoded runs only
+	//   rle4    BI_RLE4 of the 4 image, encoded runs only
+	//   png     CF_PNG, encoded once with the default options
+	// A "td" suffix on the uncompressed DIB formats (32td, 8td, ...) stores the rows top-down.
+	inline bool BuildPayload(const Canvas& canvas, const std::string& format, std::vector<uint8_t>* pPayload)
+	{
+		if (format == "png") {
+			const PngImage image{ canvas.width, canvas.height, 4, CanvasRowProc, &canvas };
+			return EncodePng(image, PngEncodeOptions{}, pPayload);
+		}
+
+		struct Layout {
+			const char* pszName;
+			unsigned bitCount;
+			DWORD compression;
+			bool isV5;
+			DWORD masks[4];
+		};
+		static const Layout layouts[] = {
+			{ "32", 32, BI_RGB, false, {} },
+			{ "32a", 32, BI_BITFIELDS, true, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 } },
+			{ "101010", 32, BI_BITFIELDS, false, { 0x3FF00000, 0x000FFC00, 0x000003FF, 0 } },
+			{ "24", 24, BI_RGB, false, {} },
+			{ "16", 16, BI_BITFIELDS, false, { 0xF800, 0x07E0, 0x001F, 0 } },
+			{ "555", 16, BI_RGB, false, {} },
+			{ "4444", 16, BI_BITFIELDS, true, { 0x0F00, 0x00F0, 0x000F, 0xF000 } },
+			{ "8", 8, BI_RGB, false, {} },
+			{ "4", 4, BI_RGB, false, {} },
+			{ "1", 1, BI_RGB, false, {} },
+			{ "rle8", 8, BI_RLE8, false, {} },
+			{ "rle4", 4, BI_RLE4, false, {} },
+		};
+
+		std::string name = format;
+		const bool isTopDown = name.size() > 2 and name.compare(name.size() - 2, 2, "td") == 0;
+		if (isTopDown) { name.resize(name.size() - 2); }
+		const Layout* pLayout{};
+		for (const Layout& layout : layouts) {
+			if (name == layout.pszName) { pLayout = &layout; }
+		}
+		if (!pLayout) { return false; }
+
+		// RLE bitmaps are bottom-up only
+		const bool isRle = pLayout->compression == BI_RLE8 or pLayout->compression == BI_RLE4;
+		if (isRle and isTopDown) { return false; }
+
+		const unsigned bitCount = pLayout->bitCount;
+		const size_t cbHeader = pLayout->isV5 ? sizeof(BITMAPV5HEADER) : sizeof(BITMAPINFOHEADER);
+		const size_t cbMasks = pLayout->compression == BI_BITFIELDS and !pLayout->isV5 ? 3 * sizeof(DWORD) : 0;
+		const size_t cbTable = cbMasks + (bitCount <= 8 ? ((size_t)1 << bitCount) * sizeof(RGBQUAD) : 0);
+		const size_t cbStride = ((size_t)canvas.width * bitCount + 31) / 32 * 4;
+		pPayload->assign(cbHeader + cbTable + (isRle ? 0 : cbStride * canvas.height), 0);
+
+		uint8_t* pTable = pPayload->data() + cbHeader;
+		memcpy(pTable, pLayout->masks, cbMasks);
+		for (unsigned i{}; bitCount <= 8 and i < (1u << bitCount); ++i) {
+			RGBQUAD color{};
+			if (bitCount == 8) {
+				color = { (BYTE)((i & 3) * 85), (BYTE)(((i >> 2) & 7) * 255 / 7), (BYTE)((i >> 5) * 255 / 7), 0 };
+			}
+			else {
+				const BYTE gray = (BYTE)(i * 255 / ((1u << bitCount) - 1));
+				color = { gray, gray, gray, 0 };
+			}
+			memcpy(pTable + i * sizeof(RGBQUAD), &color, sizeof(color));
+		}
+
+		// Drop shadow: alpha fades out over the outer border
+		const uint32_t shadow = std::max<uint32_t>(1, canvas.height / 64);
+		std::vector<uint8_t> indices(isRle ? canvas.width : 0);
+		for (uint32_t row{}; row < canvas.height; ++row) {
+			// Bottom-up payloads store the last canvas row first
+			const uint32_t y = isTopDown ? row : canvas.height - 1 - row;
+			const uint8_t* pSrc = &canvas.bgra[(size_t)y * canvas.width * 4];
+			uint8_t* pDst = isRle ? indices.data() : pTable + cbTable + row * cbStride;
+			for (uint32_t x{}; x < canvas.width; ++x, pSrc += 4) {
+				const uint32_t edge = std::min(std::min(x, canvas.width - 1 - x), std::min(y, canvas.height - 1 - y));
+				const uint32_t alpha = pLayout->isV5 ? (edge < shadow ? edge * 255 / shadow : 255) : 0;
+				const uint32_t luma = (pSrc[2] * 77 + pSrc[1] * 150 + pSrc[0] * 29) >> 8;
+				const uint8_t index = bitCount == 8 ? (uint8_t)((pSrc[2] >> 5) << 5 | (pSrc[1] >> 5) << 2 | pSrc[0] >> 6) :
+					bitCount == 4 ? (uint8_t)(luma >> 4) : (uint8_t)(luma >> 7);
+				if (isRle) {
+					pDst[x] = index;
+					continue;
+				}
+
+				switch (bitCount) {
+				case 32: {
+					uint32_t value = (uint32_t)pSrc[0] | (uint32_t)pSrc[1] << 8 | (uint32_t)pSrc[2] << 16 | alpha << 24;
+					if (pLayout->masks[0] == 0x3FF00000) {
+						value = (uint32_t)pSrc[2] << 22 | (uint32_t)pSrc[1] << 12 | (uint32_t)pSrc[0] << 2;
+					}
+					memcpy(pDst + x * 4, &value, sizeof(value));
+					break;
+				}
+				case 24:
+					pDst[x * 3 + 0] = pSrc[0];
+					pDst[x * 3 + 1] = pSrc[1];
+					pDst[x * 3 + 2] = pSrc[2];
+					break;
+				case 16: {
+					uint16_t value = (uint16_t)(((pSrc[2] >> 3) << 11) | ((pSrc[1] >> 2) << 5) | (pSrc[0] >> 3));
+					if (pLayout->compression == BI_RGB) {
+						value = (uint16_t)(((pSrc[2] >> 3) << 10) | ((pSrc[1] >> 3) << 5) | (pSrc[0] >> 3));
+					}
+					else if (pLayout->isV5) {
+						value = (uint16_t)(((alpha >> 4) << 12) | ((pSrc[2] >> 4) << 8) | ((pSrc[1] >> 4) << 4) | (pSrc[0] >> 4));
+					}
+					memcpy(pDst + x * 2, &value, sizeof(value));
+					break;
+				}
+				case 8:
+					pDst[x] = index;
+					break;
+				case 4:
+					pDst[x / 2] |= (uint8_t)(x & 1 ? index : index << 4);
+					break;
+				default:
+					pDst[x / 8] |= (uint8_t)(index << (7 - x % 8));
+					break;
+				}
+			}
+			if (!isRle) { continue; }
+
+			// Runs of up to 255 equal indices, each line closed by an end-of-line escape
+			for (uint32_t x{}; x < canvas.width;) {
+				uint32_t cRun = 1;
+				while (x + cRun < canvas.width and cRun < 255 and indices[x + cRun] == indices[x]) { ++cRun; }
+				pPayload->push_back((uint8_t)cRun);
+				pPayload->push_back(bitCount == 4 ? (uint8_t)(indices[x] << 4 | indices[x]) : indices[x]);
+				x += cRun;
+			}
+			pPayload->push_back(0);
+			pPayload->push_back(row + 1 < canvas.height ? 0 : 1);  // End of line, end of bitmap after the last
+		}
+
+		BITMAPV5HEADER header{};
+		header.bV5Size = (DWORD)cbHeader;
+		header.bV5Width = (LONG)canvas.width;
+		header.bV5Height = isTopDown ? -(LONG)canvas.height : (LONG)canvas.height;
+		header.bV5Planes = 1;
+		header.bV5BitCount = (WORD)bitCount;
+		header.bV5Compression = pLayout->compression;
+		header.bV5SizeImage = (DWORD)(pPayload->size() - cbHeader - cbTable);
+		header.bV5RedMask = pLayout->masks[0];
+		header.bV5GreenMask = pLayout->masks[1];
+		header.bV5BlueMask = pLayout->masks[2];
+		header.bV5AlphaMask = pLayout->masks[3];
+		memcpy(pPayload->data(), &header, cbHeader);
+		return true;
+	}
+}
+
+
+
+
+/*
+Usage example:
+
+	SyntheticCorpus::Canvas canvas;
+	std::vector<uint8_t> payload;
+	if (SyntheticCorpus::DrawCorpus("ui", 3840, 2160, &canvas, seed) and
+		SyntheticCorpus::BuildPayload(canvas, "32", &payload))
+	{
+		// payload holds a CF_DIB
+	}
+
+*/
+
+
+
@@ -0,0 +1,36 @@
+#pragma once
+
+// Minimal <tchar.h> for the portable sources on other platforms: TCHAR is char (see windows.h
+// in this directory) and only the routines the capture front end uses are mapped.
+
+// Standard library headers
+#include <cstdio>   // snprintf
+#include <cstring>  // strlen, memcpy
+#include <cstddef>  // size_t
+#include <strings.h> // strcasecmp
+
+
+
+#define _T(x) x
+
+// Truncates instead of raising the invalid parameter handler
+inline int _tcscpy_s(char* szDest, size_t cchDest, const char* cszSrc)
+{
+	if (!szDest or !cchDest) { return 22; }
+	const size_t cch = strlen(cszSrc);
+	const size_t cchCopy = cch < cchDest ? cch : cchDest - 1;
+	memcpy(szDest, cszSrc, cchCopy);
+	szDest[cchCopy] = '\0';
+	return cch < cchDest ? 0 : 34;
+}
+
+template<size_t N>
+int _tcscpy_s(char (&szDest)[N], const char* cszSrc)
+{
+	return _tcscpy_s(szDest, N, cszSrc);
+}
+
+#define _tcslen strlen
+#define _tcscmp strcmp
+#define _tcsicmp strcasecmp
+#define _stprintf_s snprintf
@@ -0,0 +1,204 @@
+#pragma once
+
+// Minimal <windows.h> for building the portable sources on other platforms (benchmarks and the
+// replay driver only). Declares the DIB types DIBDecoder and PixelKey use, with the same layout
+// as the Windows SDK, and the few calls behind CaptureJob, BufferPool and ClipboardMonitor
+// (performance counter, SRW locks, VirtualAlloc, last error) over POSIX. Windows builds never
+// put this directory on the include path.
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <cstdlib>  // aligned_alloc, free
+#include <cstring>  // memset
+#include <cerrno>   // Last error
+#include <chrono>   // Performance counter
+
+// POSIX headers
+#include <pthread.h>  // SRW locks
+
+
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int INT;
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef size_t SIZE_T;
+typedef BYTE* LPBYTE;
+typedef void* LPVOID;
+typedef char TCHAR;
+typedef TCHAR* LPTSTR;
+typedef const TCHAR* LPCTSTR;
+
+typedef union _LARGE_INTEGER {
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef pthread_rwlock_t SRWLOCK;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define MAX_PATH            260
+#define ERROR_SUCCESS       0
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_ALREADY_EXISTS EEXIST  // GetLastError returns errno here
+#define SRWLOCK_INIT        PTHREAD_RWLOCK_INITIALIZER
+#define MEM_COMMIT          0x1000
+#define MEM_RESERVE         0x2000
+#define MEM_RELEASE         0x8000
+#define PAGE_READWRITE      0x04
+
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+
+#define BI_RGB       0
+#define BI_RLE8      1
+#define BI_RLE4      2
+#define BI_BITFIELDS 3
+#define BI_JPEG      4
+#define BI_PNG       5
+
+#pragma pack(push, 2)
+typedef struct tagBITMAPFILEHEADER {
+	WORD  bfType;
+	DWORD bfSize;
+	WORD  bfReserved1;
+	WORD  bfReserved2;
+	DWORD bfOffBits;
+} BITMAPFILEHEADER;
+#pragma pack(pop)
+
+typedef struct tagBITMAPINFOHEADER {
+	DWORD biSize;
+	LONG  biWidth;
+	LONG  biHeight;
+	WORD  biPlanes;
+	WORD  biBitCount;
+	DWORD biCompression;
+	DWORD biSizeImage;
+	LONG  biXPelsPerMeter;
+	LONG  biYPelsPerMeter;
+	DWORD biClrUsed;
+	DWORD biClrImportant;
+} BITMAPINFOHEADER;
+
+typedef struct tagRGBQUAD {
+	BYTE rgbBlue;
+	BYTE rgbGreen;
+	BYTE rgbRed;
+	BYTE rgbReserved;
+} RGBQUAD;
+
+typedef struct tagBITMAPINFO {
+	BITMAPINFOHEADER bmiHeader;
+	RGBQUAD          bmiColors[1];
+} BITMAPINFO;
+
+typedef struct tagCIEXYZ {
+	LONG ciexyzX;
+	LONG ciexyzY;
+	LONG ciexyzZ;
+} CIEXYZ;
+
+typedef struct tagCIEXYZTRIPLE {
+	CIEXYZ ciexyzRed;
+	CIEXYZ ciexyzGreen;
+	CIEXYZ ciexyzBlue;
+} CIEXYZTRIPLE;
+
+typedef struct {
+	DWORD        bV4Size;
+	LONG         bV4Width;
+	LONG         bV4Height;
+	WORD         bV4Planes;
+	WORD         bV4BitCount;
+	DWORD        bV4V4Compression;
+	DWORD        bV4SizeImage;
+	LONG         bV4XPelsPerMeter;
+	LONG         bV4YPelsPerMeter;
+	DWORD        bV4ClrUsed;
+	DWORD        bV4ClrImportant;
+	DWORD        bV4RedMask;
+	DWORD        bV4GreenMask;
+	DWORD        bV4BlueMask;
+	DWORD        bV4AlphaMask;
+	DWORD        bV4CSType;
+	CIEXYZTRIPLE bV4Endpoints;
+	DWORD        bV4GammaRed;
+	DWORD        bV4GammaGreen;
+	DWORD        bV4GammaBlue;
+} BITMAPV4HEADER;
+
+typedef struct {
+	DWORD        bV5Size;
+	LONG         bV5Width;
+	LONG         bV5Height;
+	WORD         bV5Planes;
+	WORD         bV5BitCount;
+	DWORD        bV5Compression;
+	DWORD        bV5SizeImage;
+	LONG         bV5XPelsPerMeter;
+	LONG         bV5YPelsPerMeter;
+	DWORD        bV5ClrUsed;
+	DWORD        bV5ClrImportant;
+	DWORD        bV5RedMask;
+	DWORD        bV5GreenMask;
+	DWORD        bV5BlueMask;
+	DWORD        bV5AlphaMask;
+	DWORD        bV5CSType;
+	CIEXYZTRIPLE bV5Endpoints;
+	DWORD        bV5GammaRed;
+	DWORD        bV5GammaGreen;
+	DWORD        bV5GammaBlue;
+	DWORD        bV5Intent;
+	DWORD        bV5ProfileData;
+	DWORD        bV5ProfileSize;
+	DWORD        bV5Reserved;
+} BITMAPV5HEADER;
+
+
+
+// Nanosecond counter
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pCount)
+{
+	pCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000;
+	return TRUE;
+}
+
+inline void AcquireSRWLockExclusive(SRWLOCK* pLock) { pthread_rwlock_wrlock(pLock); }
+inline void ReleaseSRWLockExclusive(SRWLOCK* pLock) { pthread_rwlock_unlock(pLock); }
+inline void AcquireSRWLockShared(SRWLOCK* pLock) { pthread_rwlock_rdlock(pLock); }
+inline void ReleaseSRWLockShared(SRWLOCK* pLock) { pthread_rwlock_unlock(pLock); }
+
+// Page-aligned, zero-filled like committed pages
+inline LPVOID VirtualAlloc(LPVOID, SIZE_T cbSize, DWORD, DWORD)
+{
+	const SIZE_T cbPage = 4096;
+	void* p = aligned_alloc(cbPage, (cbSize + cbPage - 1) / cbPage * cbPage);
+	if (p) { memset(p, 0, cbSize); }
+	return p;
+}
+
+inline BOOL VirtualFree(LPVOID p, SIZE_T, DWORD)
+{
+	free(p);
+	return TRUE;
+}
+
+inline DWORD GetLastError() { return (DWORD)errno; }
+inline void SetLastError(DWORD dwError) { errno = (int)dwError; }
@@ -7,6 +7,10 @@
  *----------------------------------------------------------------------------*/
 #define WM_APP_TRAYICON             (WM_APP + 1)  // Custom tray icon notification message
 #define WM_APP_CUSTOM_MESSAGE       (WM_APP + 2)  // Custom message
+#define WM_APP_CAPTURE_RESULT       (WM_APP + 3)  // Finished capture job posted by a pipeline worker
+#define WM_APP_SPOOL_PROGRESS       (WM_APP + 4)  // Spool file converted to PNG, wParam = files still queued
+#define WM_APP_OPTIMIZER_PROGRESS   (WM_APP + 5)  // Idle optimizer shrank a file
+#define WM_APP_RULES_RELOADED       (WM_APP + 6)  // Owner rule list file recompiled, lParam = OwnerRules* to adopt
 
  /*-----------------------------------------------------------------------------
   * RESOURCE IDENTIFIERS
@@ -16,6 +20,8 @@
 #define IDC_EDIT                    (1000 + 2)  // Identifier for the edit control
 #define IDT_DIALOG_ERROR_TIMER      (1000 + 3)  // Dialog timer
 #define IDTT_DIALOG_TOOLTIP         (1000 + 4)  // Dialog tooltip
+#define IDT_CLIPBOARD_COALESCE      (1000 + 5)  // Trailing edge of a clipboard update burst
+#define IDT_CLIPBOARD_RETRY         (1000 + 6)  // Next attempt to open a clipboard held by another process
 
   /*-----------------------------------------------------------------------------
    * TRAY MENU COMMANDS
@@ -27,6 +33,7 @@
 #define IDM_TRAY_OPEN_FOLDER           (2000 + 4)  // Command to open the output folder
 #define IDM_TRAY_EXIT                  (2000 + 5)  // Command to exit the application
 #define IDM_TRAY_SEPARATOR             (2000 + 6)  // Separator item in the tray context menu
+#define IDM_TRAY_SAVE_TRACE            (2000 + 7)  // Command to save the trace zones (CIS_TRACE_ZONES builds)
 
    /*-----------------------------------------------------------------------------
    * CUSTOM IDENTIFIERS
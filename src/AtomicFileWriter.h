@@ -0,0 +1,351 @@
+#pragma once
+
+// Standard library headers
+#include <atomic>              // Counters
+#include <chrono>              // Group flush interval
+#include <condition_variable>  // Flusher wakeup
+#include <cstdint>             // Fixed-width integers
+#include <mutex>               // Unflushed files
+#include <string>              // Paths
+#include <system_error>        // Flusher start failure
+#include <thread>              // Flusher
+#include <vector>              // Unflushed files, overlapped slots
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+// POSIX headers
+#if !defined(_WIN32)
+#include <cstdio>   // rename
+#include <fcntl.h>  // open, posix_fallocate
+#include <unistd.h> // pwrite, fsync, link
+#include <cerrno>   // EINTR
+#endif
+
+
+
+// When written files reach the disk
+enum class WriteDurability : unsigned
+{
+	None,     // Left to the system cache: a power loss can truncate the files written just before it
+	PerFile,  // Flushed before the rename: a file under its final name is complete, power loss included
+	Group     // Renamed right away and flushed together every groupFlushMs: a power loss can only
+	          // truncate the files of the last interval
+};
+
+// Tuning knobs of AtomicFileWriter
+struct AtomicFileWriterOptions
+{
+	WriteDurability durability{ WriteDurability::PerFile };
+	DWORD groupFlushMs{ 1000 };
+	DWORD cbChunk{ 1 << 20 };  // Size of each write, and alignment of every write offset
+	UINT cInFlight{ 4 };       // Chunks queued at once (overlapped I/O, Windows)
+};
+
+struct AtomicFileWriterStats
+{
+	UINT64 cFiles{};
+	UINT64 cbWritten{};
+	UINT64 cFailed{};        // Nothing was left under the final name
+	UINT64 cGroupFlushes{};  // Flush passes over the files of one interval
+};
+
+
+
+// Whole-file writes that never leave a partial file under the final name. The data goes to
+// "<name>.partial", sized up front, in large chunks at chunk-aligned offsets, with every write
+// checked; the temporary file then replaces the final name in one rename, and is deleted if
+// anything failed. On Windows the chunks are queued as overlapped writes, cInFlight at a time;
+// elsewhere they are written with pwrite. The durability policy decides when the data is
+// flushed. Write is safe to call from several threads; Start and Stop are not.
+class AtomicFileWriter
+{
+private:
+	using PathString = std::basic_string<TCHAR>;
+
+	static constexpr LPCTSTR kTemporarySuffix = _T(".partial");
+
+	AtomicFileWriterOptions options_{};
+	std::atomic<uint64_t> cFiles_{};
+	std::atomic<uint64_t> cbWritten_{};
+	std::atomic<uint64_t> cFailed_{};
+	std::atomic<uint64_t> cGroupFlushes_{};
+
+	std::mutex groupMutex_;
+	std::condition_variable groupWakeup_;
+	std::vector<PathString> unflushed_;
+	std::thread flusher_;
+	bool isStopping_{};
+
+private:
+#if defined(_WIN32)
+	// Keeps up to cInFlight chunks queued; waits for all of them before returning, so the
+	// buffer outlives every write
+	static bool WriteChunks(HANDLE hFile, const uint8_t* pData, size_t cbData, size_t cbChunk, UINT cInFlight)
+	{
+		std::vector<OVERLAPPED> slots(cInFlight);
+		std::vector<DWORD> cbExpected(cInFlight);
+		std::vector<bool> isPending(cInFlight);
+		bool isWritten = true;
+		for (OVERLAPPED& slot : slots) {
+			slot.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+			if (!slot.hEvent) { isWritten = false; }
+		}
+
+		const auto Complete = [&](size_t i) {
+			isPending[i] = false;
+			DWORD cbDone{};
+			return GetOverlappedResult(hFile, &slots[i], &cbDone, TRUE) and cbDone == cbExpected[i];
+		};
+
+		size_t nChunk{};
+		for (size_t offset{}; isWritten and offset < cbData; offset += cbChunk, ++nChunk) {
+			const size_t i = nChunk % cInFlight;
+			if (isPending[i] and !Complete(i)) {
+				isWritten = false;
+				break;
+			}
+
+			OVERLAPPED& slot = slots[i];
+			const HANDLE hEvent = slot.hEvent;
+			slot = {};
+			slot.hEvent = hEvent;
+			slot.Offset = (DWORD)offset;
+			slot.OffsetHigh = (DWORD)((uint64_t)offset >> 32);
+			cbExpected[i] = (DWORD)(cbData - offset < cbChunk ? cbData - offset : cbChunk);
+			if (!WriteFile(hFile, pData + offset, cbExpected[i], NULL, &slot) and GetLastError() != ERROR_IO_PENDING) {
+				isWritten = false;
+				break;
+			}
+			isPending[i] = true;
+		}
+
+		if (!isWritten) { CancelIo(hFile); }
+		for (size_t i{}; i < cInFlight; ++i) {
+			if (isPending[i] and !Complete(i)) { isWritten = false; }
+		}
+
+		for (OVERLAPPED& slot : slots) {
+			if (slot.hEvent) { CloseHandle(slot.hEvent); }
+		}
+		return isWritten;
+	}
+
+	bool WriteTemporary(const PathString& temporaryPath, const uint8_t* pData, size_t cbData) const
+	{
+		HANDLE hFile = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return false; }
+
+		// Final size up front: allocated in one piece, and no write has to extend the file
+		FILE_END_OF_FILE_INFO endOfFile{};
+		endOfFile.EndOfFile.QuadPart = (LONGLONG)cbData;
+		SetFileInformationByHandle(hFile, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+
+		bool isWritten = WriteChunks(hFile, pData, cbData, options_.cbChunk, options_.cInFlight);
+		if (isWritten and options_.durability == WriteDurability::PerFile) {
+			isWritten = FlushFileBuffers(hFile) != FALSE;
+		}
+		return CloseHandle(hFile) and isWritten;
+	}
+
+	bool Publish(const PathString& temporaryPath, const PathString& path, bool isReplacing) const
+	{
+		const DWORD dwFlags = (isReplacing ? MOVEFILE_REPLACE_EXISTING : 0)
+			| (options_.durability == WriteDurability::PerFile ? MOVEFILE_WRITE_THROUGH : 0);
+		return MoveFileEx(temporaryPath.c_str(), path.c_str(), dwFlags) != FALSE;
+	}
+
+	static void Discard(const PathString& temporaryPath)
+	{
+		DeleteFile(temporaryPath.c_str());
+	}
+
+	// The cache of a file is flushed through any handle opened for writing
+	static void Flush(const PathString& path)
+	{
+		HANDLE hFile = CreateFile(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return; }  // Moved or deleted since
+		FlushFileBuffers(hFile);
+		CloseHandle(hFile);
+	}
+#else
+	bool WriteTemporary(const PathString& temporaryPath, const uint8_t* pData, size_t cbData) const
+	{
+		const int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0) { return false; }
+
+#if defined(__linux__)
+		if (cbData) { posix_fallocate(fd, 0, (off_t)cbData); }
+#endif
+
+		bool isWritten = true;
+		for (size_t offset{}; isWritten and offset < cbData; ) {
+			const size_t cbWrite = cbData - offset < options_.cbChunk ? cbData - offset : options_.cbChunk;
+			const ssize_t cbDone = pwrite(fd, pData + offset, cbWrite, (off_t)offset);
+			if (cbDone > 0) { offset += (size_t)cbDone; }
+			else if (cbDone < 0 and errno == EINTR) { continue; }
+			else { isWritten = false; }
+		}
+		if (isWritten and options_.durability == WriteDurability::PerFile) {
+			isWritten = fsync(fd) == 0;
+		}
+		return close(fd) == 0 and isWritten;
+	}
+
+	bool Publish(const PathString& temporaryPath, const PathString& path, bool isReplacing) const
+	{
+		// link fails on an existing name where rename would replace it
+		if (isReplacing ? ::rename(temporaryPath.c_str(), path.c_str()) != 0 : ::link(temporaryPath.c_str(), path.c_str()) != 0) {
+			return false;
+		}
+		if (!isReplacing) { unlink(temporaryPath.c_str()); }
+		if (options_.durability != WriteDurability::PerFile) { return true; }
+
+		// The rename itself is durable once the directory is
+		const size_t slash = path.find_last_of('/');
+		const PathString directory = slash == PathString::npos ? PathString(".") : path.substr(0, slash ? slash : 1);
+		const int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) { return true; }
+		fsync(fd);
+		close(fd);
+		return true;
+	}
+
+	static void Discard(const PathString& temporaryPath)
+	{
+		unlink(temporaryPath.c_str());
+	}
+
+	static void Flush(const PathString& path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) { return; }
+		fsync(fd);
+		close(fd);
+	}
+#endif
+
+	void FlusherLoop()
+	{
+		std::unique_lock<std::mutex> lock(groupMutex_);
+		for (;;) {
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.groupFlushMs);
+			const bool isStopping = groupWakeup_.wait_until(lock, deadline, [this]() { return isStopping_; });
+
+			std::vector<PathString> paths;
+			paths.swap(unflushed_);
+			lock.unlock();
+			for (const PathString& path : paths) { Flush(path); }
+			if (!paths.empty()) { cGroupFlushes_.fetch_add(1, std::memory_order_relaxed); }
+			lock.lock();
+
+			if (isStopping) { break; }
+		}
+	}
+
+public:
+	AtomicFileWriter() = default;
+	AtomicFileWriter(const AtomicFileWriter&) = delete;
+	AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+	~AtomicFileWriter()
+	{
+		Stop();
+	}
+
+	// Sets the options; Group also starts the flusher thread. Without Start, files are written
+	// with the default options and Group behaves as None.
+	bool Start(const AtomicFileWriterOptions& options)
+	{
+		if (flusher_.joinable()) { return false; }
+
+		options_ = options;
+		options_.cbChunk = options_.cbChunk < 4096 ? 4096 : (options_.cbChunk + 4095) / 4096 * 4096;
+		if (!options_.cInFlight) { options_.cInFlight = 1; }
+		if (options_.durability != WriteDurability::Group) { return true; }
+
+		isStopping_ = false;
+		try { flusher_ = std::thread([this]() { FlusherLoop(); }); }
+		catch (const std::system_error&) {
+			options_.durability = WriteDurability::PerFile;
+			return false;
+		}
+		return true;
+	}
+
+	// Flushes the files of the current interval and stops the flusher
+	void Stop()
+	{
+		if (!flusher_.joinable()) { return; }
+		{
+			std::lock_guard<std::mutex> lock(groupMutex_);
+			isStopping_ = true;
+		}
+		groupWakeup_.notify_one();
+		flusher_.join();
+	}
+
+	// Replaces cszPath with the data, or leaves it as it was. Without isReplacing an existing
+	// cszPath is kept and the write fails with ERROR_ALREADY_EXISTS (EEXIST).
+	bool Write(LPCTSTR cszPath, const void* pData, size_t cbData, bool isReplacing = true)
+	{
+		if (!cszPath or !*cszPath or (!pData and cbData)) { return false; }
+
+		const PathString path = cszPath;
+		const PathString temporaryPath = path + kTemporarySuffix;
+		if (!WriteTemporary(temporaryPath, static_cast<const uint8_t*>(pData), cbData) or !Publish(temporaryPath, path, isReplacing)) {
+			const DWORD dwError = GetLastError();  // The caller's, not the cleanup's
+			Discard(temporaryPath);
+			SetLastError(dwError);
+			cFailed_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		cFiles_.fetch_add(1, std::memory_order_relaxed);
+		cbWritten_.fetch_add(cbData, std::memory_order_relaxed);
+		if (options_.durability == WriteDurability::Group and flusher_.joinable()) {
+			std::lock_guard<std::mutex> lock(groupMutex_);
+			unflushed_.push_back(path);
+		}
+		return true;
+	}
+
+	AtomicFileWriterStats GetStats() const
+	{
+		return { cFiles_.load(std::memory_order_relaxed), cbWritten_.load(std::memory_order_relaxed),
+			cFailed_.load(std::memory_order_relaxed), cGroupFlushes_.load(std::memory_order_relaxed) };
+	}
+
+	// "None", "File" or "Group" (case-insensitive); PerFile for anything else
+	static WriteDurability ParseDurability(LPCTSTR cszName)
+	{
+		if (cszName and _tcsicmp(cszName, _T("None")) == 0) { return WriteDurability::None; }
+		if (cszName and _tcsicmp(cszName, _T("Group")) == 0) { return WriteDurability::Group; }
+		return WriteDurability::PerFile;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static AtomicFileWriter writer;
+	writer.Start(AtomicFileWriterOptions{ WriteDurability::Group, 1000 });
+
+	// Any thread
+	if (!writer.Write(_T("C:\\Captures\\screenshot_1.png"), png.data(), png.size())) {
+		// The previous file, if any, is untouched; no .partial file is left behind
+	}
+
+	writer.Stop();  // Flushes the last interval
+
+*/
+
+
+
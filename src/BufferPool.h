@@ -0,0 +1,191 @@
+#pragma once
+
+// Standard library headers
+#include <vector>  // Free lists
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Buffer handed out by BufferPool
+struct PooledBuffer
+{
+	LPBYTE pData{};      // Page-aligned storage
+	SIZE_T cbSize{};     // Bytes in use
+	SIZE_T cbCapacity{}; // Bytes committed
+};
+
+
+
+// Memory usage counters of a BufferPool
+struct BufferPoolStats
+{
+	SIZE_T cbInUse{};          // Held by callers right now
+	SIZE_T cbPeakInUse{};      // Maximum of cbInUse
+	SIZE_T cbCached{};         // Parked in free lists, ready for reuse
+	SIZE_T cbCommitted{};      // cbInUse + cbCached (steady-state footprint)
+	SIZE_T cbPeakCommitted{};  // Maximum of cbCommitted
+	UINT64 cAcquired{};        // Total Acquire calls
+	UINT64 cReused{};          // Acquire calls served from a free list
+};
+
+
+
+// Size-classed pool of large, page-aligned buffers for captured clipboard payloads.
+// Classes go from 64 KB to 512 MB in four steps per power of two, so a buffer commits at most
+// 25% more than its payload; anything larger is allocated exactly and released immediately.
+// Thread-safe.
+class BufferPool
+{
+private:
+	static constexpr unsigned kMinClassShift = 16;  // 64 KB
+	static constexpr unsigned kClassCount = 53;     // 64 KB, 80 KB, 96 KB, 112 KB, 128 KB .. 512 MB
+
+	// 32bpp DIB of an 8K screen, the largest capture the cache has to keep
+	static constexpr SIZE_T kMaxResolutionSize = (SIZE_T)7680 * 4320 * 4 + sizeof(BITMAPV5HEADER);
+
+	SRWLOCK lock_ = SRWLOCK_INIT;
+	std::vector<LPBYTE> freeLists_[kClassCount];
+	SIZE_T cbMaxCached_;
+	BufferPoolStats stats_{};
+
+private:
+	// Returns the size class for a request, or kClassCount if it is too large to pool
+	static constexpr unsigned ClassOf(SIZE_T cbSize)
+	{
+		unsigned nClass{};
+		while (nClass < kClassCount and ClassSize(nClass) < cbSize) { ++nClass; }
+		return nClass;
+	}
+
+	// Class n is (4 + n % 4) quarters of 2^(kMinClassShift + n / 4)
+	static constexpr SIZE_T ClassSize(unsigned nClass)
+	{
+		return (SIZE_T)(4 + nClass % 4) << (kMinClassShift - 2 + nClass / 4);
+	}
+
+	void UpdatePeaks()
+	{
+		stats_.cbCommitted = stats_.cbInUse + stats_.cbCached;
+		if (stats_.cbInUse > stats_.cbPeakInUse) { stats_.cbPeakInUse = stats_.cbInUse; }
+		if (stats_.cbCommitted > stats_.cbPeakCommitted) { stats_.cbPeakCommitted = stats_.cbCommitted; }
+	}
+
+public:
+	// cbMaxCached bounds how much idle memory the free lists may keep; it is never less than one
+	// maximum-resolution buffer, which would otherwise be freed and committed again per capture.
+	// The default keeps one 8K capture (the 128 MB class) plus 64 MB of smaller ones.
+	explicit BufferPool(SIZE_T cbMaxCached = ClassSize(ClassOf(kMaxResolutionSize)) + 64 * 1024 * 1024) :
+		cbMaxCached_{ cbMaxCached > ClassSize(ClassOf(kMaxResolutionSize)) ? cbMaxCached : ClassSize(ClassOf(kMaxResolutionSize)) }
+	{}
+
+	~BufferPool()
+	{
+		Trim();
+	}
+
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	bool Acquire(SIZE_T cbSize, PooledBuffer* pBuffer)
+	{
+		if (!pBuffer or !cbSize) { return false; }
+
+		const unsigned nClass = ClassOf(cbSize);
+		const SIZE_T cbCapacity = nClass < kClassCount ? ClassSize(nClass) : cbSize;
+		LPBYTE pData{};
+
+		AcquireSRWLockExclusive(&lock_);
+		++stats_.cAcquired;
+		if (nClass < kClassCount and !freeLists_[nClass].empty()) {
+			pData = freeLists_[nClass].back();
+			freeLists_[nClass].pop_back();
+			stats_.cbCached -= cbCapacity;
+			++stats_.cReused;
+		}
+		ReleaseSRWLockExclusive(&lock_);
+
+		if (!pData) {
+			pData = static_cast<LPBYTE>(VirtualAlloc(NULL, cbCapacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+			if (!pData) { return false; }
+		}
+
+		AcquireSRWLockExclusive(&lock_);
+		stats_.cbInUse += cbCapacity;
+		UpdatePeaks();
+		ReleaseSRWLockExclusive(&lock_);
+
+		pBuffer->pData = pData;
+		pBuffer->cbSize = cbSize;
+		pBuffer->cbCapacity = cbCapacity;
+		return true;
+	}
+
+	void Release(PooledBuffer* pBuffer)
+	{
+		if (!pBuffer or !pBuffer->pData) { return; }
+
+		const unsigned nClass = ClassOf(pBuffer->cbCapacity);
+		bool isCached{};
+
+		AcquireSRWLockExclusive(&lock_);
+		stats_.cbInUse -= pBuffer->cbCapacity;
+		if (nClass < kClassCount and ClassSize(nClass) == pBuffer->cbCapacity and
+			stats_.cbCached + pBuffer->cbCapacity <= cbMaxCached_)
+		{
+			freeLists_[nClass].push_back(pBuffer->pData);
+			stats_.cbCached += pBuffer->cbCapacity;
+			isCached = true;
+		}
+		UpdatePeaks();
+		ReleaseSRWLockExclusive(&lock_);
+
+		if (!isCached) {
+			VirtualFree(pBuffer->pData, 0, MEM_RELEASE);
+		}
+		*pBuffer = {};
+	}
+
+	// Returns every cached buffer to the system
+	void Trim()
+	{
+		AcquireSRWLockExclusive(&lock_);
+		for (auto& freeList : freeLists_) {
+			for (LPBYTE pData : freeList) { VirtualFree(pData, 0, MEM_RELEASE); }
+			freeList.clear();
+		}
+		stats_.cbCached = 0;
+		UpdatePeaks();
+		ReleaseSRWLockExclusive(&lock_);
+	}
+
+	BufferPoolStats GetStats()
+	{
+		AcquireSRWLockShared(&lock_);
+		BufferPoolStats stats = stats_;
+		ReleaseSRWLockShared(&lock_);
+		return stats;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static BufferPool pool;
+
+	PooledBuffer buffer;
+	if (pool.Acquire(cbDataSize, &buffer)) {
+		memcpy(buffer.pData, pSrc, cbDataSize);
+		// ...
+		pool.Release(&buffer);
+	}
+
+*/
+
+
+
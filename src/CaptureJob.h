@@ -0,0 +1,115 @@
+#pragma once
+
+// Implementation-specific headers
+#include "ClipboardImageSaver.h"  // ClipboardResult
+#include "BufferPool.h"           // Payload storage
+#include "ContentHash.h"          // Hash128
+#include "FilenameTemplate.h"     // Name fields
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Stages of a capture, in processing order
+enum class CaptureStage : unsigned
+{
+	Open,    // OpenClipboard, including retries
+	Owner,   // Owner process lookup
+	Filter,  // Owner rules
+	Copy,    // Copy out of the clipboard handle
+	Queue,   // Waiting for a worker
+	Hash,    // Content hash and duplicate checks
+	Encode,  // PNG or QOI encode
+	Write,   // File write
+	Count
+};
+
+
+
+// Per-capture stage latencies in QueryPerformanceCounter ticks
+struct CaptureTimings
+{
+	LONGLONG ticks[(size_t)CaptureStage::Count]{};
+	unsigned recorded{};  // Bit per stage that ran, so a skipped stage is not read as 0 ms
+
+	static LONGLONG Now()
+	{
+		LARGE_INTEGER li;
+		QueryPerformanceCounter(&li);
+		return li.QuadPart;
+	}
+
+	static double ToMilliseconds(LONGLONG llTicks)
+	{
+		static const LONGLONG llFrequency = []() {
+			LARGE_INTEGER li;
+			QueryPerformanceFrequency(&li);
+			return li.QuadPart;
+		}();
+		return (double)llTicks * 1000.0 / (double)llFrequency;
+	}
+
+	// Records the time elapsed since llStart and returns the current timestamp
+	LONGLONG Record(CaptureStage stage, LONGLONG llStart)
+	{
+		return Record(stage, llStart, Now());
+	}
+
+	// Records a stage that ended at llEnd, for stages timed inside a callee; returns llEnd
+	LONGLONG Record(CaptureStage stage, LONGLONG llStart, LONGLONG llEnd)
+	{
+		ticks[(size_t)stage] += llEnd - llStart;
+		recorded |= 1u << (unsigned)stage;
+		return llEnd;
+	}
+
+	double Milliseconds(CaptureStage stage) const
+	{
+		return ToMilliseconds(ticks[(size_t)stage]);
+	}
+
+	bool IsRecorded(CaptureStage stage) const
+	{
+		return (recorded >> (unsigned)stage) & 1;
+	}
+};
+
+
+
+// Work item handed from the message loop to the workers
+struct CaptureJob
+{
+	PooledBuffer buffer{};          // Private copy of the clipboard payload, released by the worker
+	INT nFormat{};                  // Clipboard format of the payload
+	Hash128 dataHash{};             // Content hash of the payload, computed during the copy
+	BOOL isDataHashed{};            // dataHash is set (the pre-hash path leaves it to the worker)
+	TCHAR szFormat[16]{};           // Printable format name
+	TCHAR szOwner[MAX_PATH]{};      // Clipboard owner executable name
+	TCHAR szFilename[MAX_PATH]{};   // Output path
+	FilenameFields nameFields{};    // Values szFilename was formatted from
+	LONGLONG llQueuedAt{};          // Timestamp of Submit
+	SIZE_T cbWritten{};             // Bytes of the file written, spool file included
+	CaptureTimings timings{};
+	ClipboardResult result{ ClipboardResult::NoData };
+	DWORD dwError{};                // GetLastError of the failing stage
+};
+
+
+
+
+/*
+Usage example:
+
+	CaptureJob* pJob = new CaptureJob{};
+	LONGLONG llStageStart = CaptureTimings::Now();
+	// ...open the clipboard...
+	llStageStart = pJob->timings.Record(CaptureStage::Open, llStageStart);
+
+	printf("%.1f ms\n", pJob->timings.Milliseconds(CaptureStage::Open));
+
+*/
+
+
+
@@ -0,0 +1,264 @@
+#pragma once
+
+// Implementation-specific headers
+#include "CaptureJob.h"        // Stages, timings and results
+#include "ClipboardMonitor.h"  // Update outcomes
+
+// Standard library headers
+#include <atomic>   // Lock-free counters
+#include <cstdint>  // Fixed-width integers
+#include <cstdio>   // snprintf
+#include <string>   // JSON text
+
+
+
+// Log-linear latency histogram in microseconds, HDR style.
+// Values below 64 us get a bucket each; above that every power of two is split into 32
+// buckets, so a percentile is reported within 3% of the recorded value from 1 us to over an
+// hour, in a fixed 7 KB. Recording is a few relaxed atomic operations: any thread may record
+// while another one reads.
+class LatencyHistogram
+{
+private:
+	static constexpr unsigned kSubBits = 6;
+	static constexpr unsigned kHalf = 1u << (kSubBits - 1);
+	static constexpr unsigned kMaxShift = 26;  // Values are capped at 2^32 us, about 71 minutes
+	static constexpr size_t kBuckets = (1u << kSubBits) + kMaxShift * kHalf;
+
+	std::atomic<uint64_t> counts_[kBuckets]{};
+	std::atomic<uint64_t> cValues_{};
+	std::atomic<uint64_t> sumUs_{};
+	std::atomic<uint64_t> maxUs_{};
+
+private:
+	static size_t ToBucket(uint64_t us)
+	{
+		if (us < (1u << kSubBits)) { return (size_t)us; }
+		unsigned shift = 1;
+		while ((us >> shift) >= (1u << kSubBits)) { ++shift; }
+		return (1u << kSubBits) + (shift - 1) * kHalf + (size_t)((us >> shift) - kHalf);
+	}
+
+	// Highest value that lands in the bucket
+	static uint64_t ToValue(size_t bucket)
+	{
+		if (bucket < (1u << kSubBits)) { return bucket; }
+		const unsigned shift = (unsigned)((bucket - (1u << kSubBits)) / kHalf) + 1;
+		const uint64_t sub = (bucket - (1u << kSubBits)) % kHalf + kHalf;
+		return ((sub + 1) << shift) - 1;
+	}
+
+public:
+	void Record(uint64_t us)
+	{
+		if (us > 0xFFFFFFFFull) { us = 0xFFFFFFFFull; }
+		counts_[ToBucket(us)].fetch_add(1, std::memory_order_relaxed);
+		cValues_.fetch_add(1, std::memory_order_relaxed);
+		sumUs_.fetch_add(us, std::memory_order_relaxed);
+		uint64_t maxUs = maxUs_.load(std::memory_order_relaxed);
+		while (us > maxUs and !maxUs_.compare_exchange_weak(maxUs, us, std::memory_order_relaxed)) {}
+	}
+
+	void RecordTicks(LONGLONG llTicks)
+	{
+		Record(llTicks > 0 ? (uint64_t)(CaptureTimings::ToMilliseconds(llTicks) * 1000) : 0);
+	}
+
+	// Value at or below which `percent` of the recorded values fall; 0 if there are none
+	uint64_t GetPercentile(double percent) const
+	{
+		uint64_t cTotal{};
+		for (const auto& count : counts_) { cTotal += count.load(std::memory_order_relaxed); }
+		if (!cTotal) { return 0; }
+
+		const uint64_t cTarget = (uint64_t)(percent / 100 * (double)cTotal + 0.5);
+		uint64_t cSeen{};
+		for (size_t i{}; i < kBuckets; ++i) {
+			cSeen += counts_[i].load(std::memory_order_relaxed);
+			if (cSeen >= cTarget and cSeen) {
+				const uint64_t value = ToValue(i);
+				const uint64_t maxUs = GetMax();
+				return value < maxUs ? value : maxUs;
+			}
+		}
+		return GetMax();
+	}
+
+	uint64_t GetCount() const { return cValues_.load(std::memory_order_relaxed); }
+	uint64_t GetMax() const { return maxUs_.load(std::memory_order_relaxed); }
+
+	double GetMean() const
+	{
+		const uint64_t cValues = GetCount();
+		return cValues ? (double)sumUs_.load(std::memory_order_relaxed) / (double)cValues : 0;
+	}
+
+};
+
+
+
+// Counters and per-stage latencies of the capture path, for the tray tooltip and the metrics
+// publisher. The front stages (open to copy) are recorded by the thread that handles updates,
+// the rest when a finished job comes back, so every stage is counted once per update that
+// reached it. Readable from any thread while being recorded.
+class CaptureMetrics
+{
+private:
+	static constexpr size_t kResultCount = (size_t)ClipboardResult::InvalidParameter + 1;
+
+	LatencyHistogram stages_[(size_t)CaptureStage::Count];
+	LatencyHistogram endToEnd_;  // Open to write, saved captures only
+	std::atomic<uint64_t> updates_[(size_t)ClipboardUpdate::Count]{};
+	std::atomic<uint64_t> results_[kResultCount]{};
+	std::atomic<uint64_t> cbWritten_{};
+	const LONGLONG llStart_{ CaptureTimings::Now() };
+
+private:
+	static void AppendHistogram(std::string* pJson, const char* pszName, const LatencyHistogram& histogram, bool isLast)
+	{
+		char szLine[256];
+		snprintf(szLine, sizeof(szLine),
+			"    \"%s\": { \"count\": %llu, \"mean\": %.0f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu }%s\n",
+			pszName, (unsigned long long)histogram.GetCount(), histogram.GetMean(),
+			(unsigned long long)histogram.GetPercentile(50), (unsigned long long)histogram.GetPercentile(90),
+			(unsigned long long)histogram.GetPercentile(99), (unsigned long long)histogram.GetPercentile(99.9),
+			(unsigned long long)histogram.GetMax(), isLast ? "" : ",");
+		*pJson += szLine;
+	}
+
+	static void AppendCounters(std::string* pJson, const char* pszName, const char* const* ppszNames,
+		const std::atomic<uint64_t>* pCounts, size_t cCounts, bool isLast)
+	{
+		char szField[64];
+		*pJson += "  \"";
+		*pJson += pszName;
+		*pJson += "\": {";
+		for (size_t i{}; i < cCounts; ++i) {
+			snprintf(szField, sizeof(szField), "%s \"%s\": %llu", i ? "," : "", ppszNames[i],
+				(unsigned long long)pCounts[i].load(std::memory_order_relaxed));
+			*pJson += szField;
+		}
+		*pJson += isLast ? " }\n" : " },\n";
+	}
+
+public:
+	// One call per update handed to ClipboardMonitor, with its GetLastTimings
+	void RecordUpdate(ClipboardUpdate update, const CaptureTimings& timings)
+	{
+		updates_[(size_t)update].fetch_add(1, std::memory_order_relaxed);
+		for (size_t i{}; i <= (size_t)CaptureStage::Copy; ++i) {
+			if (timings.IsRecorded((CaptureStage)i)) { stages_[i].RecordTicks(timings.ticks[i]); }
+		}
+	}
+
+	// One call per job that comes back, submitted or not
+	void RecordJob(const CaptureJob& job)
+	{
+		results_[(size_t)job.result].fetch_add(1, std::memory_order_relaxed);
+		cbWritten_.fetch_add(job.cbWritten, std::memory_order_relaxed);
+
+		LONGLONG llTotal{};
+		for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+			llTotal += job.timings.ticks[i];
+			if (i > (size_t)CaptureStage::Copy and job.timings.IsRecorded((CaptureStage)i)) {
+				stages_[i].RecordTicks(job.timings.ticks[i]);
+			}
+		}
+		if (job.result == ClipboardResult::Success) { endToEnd_.RecordTicks(llTotal); }
+	}
+
+	uint64_t GetCount(ClipboardResult result) const
+	{
+		return results_[(size_t)result].load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetCount(ClipboardUpdate update) const
+	{
+		return updates_[(size_t)update].load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetDuplicateCount() const
+	{
+		return GetCount(ClipboardResult::UnchangedContent) + GetCount(ClipboardResult::SimilarContent);
+	}
+
+	// Jobs that ended in an error, duplicates excluded
+	uint64_t GetFailureCount() const
+	{
+		uint64_t cFailures{};
+		for (size_t i{}; i < kResultCount; ++i) { cFailures += results_[i].load(std::memory_order_relaxed); }
+		return cFailures - GetCount(ClipboardResult::Success) - GetDuplicateCount();
+	}
+
+	uint64_t GetBytesWritten() const
+	{
+		return cbWritten_.load(std::memory_order_relaxed);
+	}
+
+	const LatencyHistogram& GetStage(CaptureStage stage) const
+	{
+		return stages_[(size_t)stage];
+	}
+
+	const LatencyHistogram& GetEndToEnd() const
+	{
+		return endToEnd_;
+	}
+
+	// Snapshot as a UTF-8 JSON object; latencies in microseconds
+	std::string ToJson() const
+	{
+		static const char* const stageNames[] = { "open", "owner", "filter", "copy", "queue", "hash", "encode", "write" };
+		static const char* const updateNames[] = { "submitted", "openFailed", "noOwner", "notWhitelisted", "noImage", "noFilename", "dropped" };
+		static const char* const resultNames[] = { "success", "noData", "conversionFailed", "lockFailed",
+			"unchangedContent", "similarContent", "saveFailed", "nameUnavailable", "invalidParameter" };
+		static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == (size_t)CaptureStage::Count, "Stage names");
+		static_assert(sizeof(updateNames) / sizeof(updateNames[0]) == (size_t)ClipboardUpdate::Count, "Update names");
+		static_assert(sizeof(resultNames) / sizeof(resultNames[0]) == kResultCount, "Result names");
+
+		std::string json;
+		json.reserve(2048);
+		char szHeader[256];
+		snprintf(szHeader, sizeof(szHeader),
+			"{\n  \"uptimeSeconds\": %.0f,\n  \"captures\": %llu,\n  \"duplicates\": %llu,\n  \"failures\": %llu,\n  \"bytesWritten\": %llu,\n",
+			CaptureTimings::ToMilliseconds(CaptureTimings::Now() - llStart_) / 1000,
+			(unsigned long long)GetCount(ClipboardResult::Success), (unsigned long long)GetDuplicateCount(),
+			(unsigned long long)GetFailureCount(), (unsigned long long)GetBytesWritten());
+		json += szHeader;
+		AppendCounters(&json, "updates", updateNames, updates_, (size_t)ClipboardUpdate::Count, false);
+		AppendCounters(&json, "results", resultNames, results_, kResultCount, false);
+		json += "  \"latencyUs\": {\n";
+		for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+			AppendHistogram(&json, stageNames[i], stages_[i], false);
+		}
+		AppendHistogram(&json, "endToEnd", endToEnd_, true);
+		json += "  }\n}\n";
+		return json;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static CaptureMetrics metrics;
+
+	// Thread handling clipboard updates
+	const ClipboardUpdate update = monitor.OnUpdate(&clipboardSource, &pFailedJob);
+	metrics.RecordUpdate(update, monitor.GetLastTimings());
+
+	// Finished job back on the same thread
+	metrics.RecordJob(*pJob);
+
+	// Anywhere
+	const LatencyHistogram& encode = metrics.GetStage(CaptureStage::Encode);
+	printf("encode p99 %llu us over %llu captures\n", encode.GetPercentile(99), encode.GetCount());
+	std::string json = metrics.ToJson();
+
+*/
+
+
+
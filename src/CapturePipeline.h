@@ -0,0 +1,165 @@
+#pragma once
+
+// Implementation-specific headers
+#include "CaptureJob.h"     // Work item and timings
+#include "LockFreeQueue.h"  // Job queue
+#include "TraceZones.h"     // Worker timeline
+
+// Standard library headers
+#include <atomic>   // Stop flag and counters
+#include <vector>   // Worker handles
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Worker pool fed by a lock-free queue. The message loop only copies the clipboard
+// data and submits; hashing, encoding and writing happen on the workers, and the
+// finished job is posted back to the owner window as (uNotifyMsg, 0, CaptureJob*).
+class CapturePipeline
+{
+public:
+	using ProcessProc = void (*)(CaptureJob*);
+
+private:
+	LockFreeQueue<CaptureJob*> queue_{ 64 };
+	std::vector<HANDLE> workers_;
+	HANDLE hWakeup_{};
+	std::atomic<bool> isStopping_{};
+	std::atomic<unsigned> cDropped_{};
+
+	HWND hNotifyWnd_{};
+	UINT uNotifyMsg_{};
+	ProcessProc pfnProcess_{};
+
+private:
+	static DWORD WINAPI WorkerThunk(LPVOID lpParam)
+	{
+		static_cast<CapturePipeline*>(lpParam)->WorkerLoop();
+		return 0;
+	}
+
+	void WorkerLoop()
+	{
+		TRACE_THREAD("capture worker");
+		for (;;) {
+			WaitForSingleObject(hWakeup_, INFINITE);
+
+			CaptureJob* pJob{};
+			while (queue_.Pop(&pJob)) {
+				pJob->timings.Record(CaptureStage::Queue, pJob->llQueuedAt);
+				pfnProcess_(pJob);
+
+				if (!PostMessage(hNotifyWnd_, uNotifyMsg_, 0, (LPARAM)pJob)) {
+					delete pJob;  // Owner window is gone
+				}
+			}
+
+			// Queue is drained, leave only when asked to
+			if (isStopping_.load(std::memory_order_acquire)) { break; }
+		}
+	}
+
+public:
+	~CapturePipeline()
+	{
+		Stop();
+	}
+
+	// Spawns the workers; pfnProcess runs on a worker thread for every submitted job
+	bool Start(HWND hNotifyWnd, UINT uNotifyMsg, unsigned cWorkers, ProcessProc pfnProcess)
+	{
+		if (!hNotifyWnd or !pfnProcess or !workers_.empty()) { return false; }
+
+		hNotifyWnd_ = hNotifyWnd;
+		uNotifyMsg_ = uNotifyMsg;
+		pfnProcess_ = pfnProcess;
+		isStopping_ = false;
+
+		hWakeup_ = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+		if (!hWakeup_) { return false; }
+
+		// Stop waits on every worker handle at once
+		if (!cWorkers) { cWorkers = 1; }
+		if (cWorkers > MAXIMUM_WAIT_OBJECTS) { cWorkers = MAXIMUM_WAIT_OBJECTS; }
+		for (unsigned i{}; i < cWorkers; ++i) {
+			HANDLE hThread = CreateThread(NULL, 0, WorkerThunk, this, 0, NULL);
+			if (!hThread) { break; }
+			SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);  // Keep the UI responsive
+			workers_.push_back(hThread);
+		}
+
+		if (workers_.empty()) {
+			CloseHandle(hWakeup_);
+			hWakeup_ = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	// Never blocks; returns false if the pipeline is not running or the queue is full
+	bool Submit(CaptureJob* pJob)
+	{
+		if (!pJob or workers_.empty() or isStopping_.load(std::memory_order_relaxed)) { return false; }
+
+		pJob->llQueuedAt = CaptureTimings::Now();
+		if (!queue_.Push(pJob)) {
+			++cDropped_;
+			return false;
+		}
+		ReleaseSemaphore(hWakeup_, 1, NULL);
+		return true;
+	}
+
+	// Lets the workers finish every queued job, then joins them
+	void Stop()
+	{
+		if (workers_.empty()) { return; }
+
+		isStopping_.store(true, std::memory_order_release);
+		ReleaseSemaphore(hWakeup_, (LONG)workers_.size(), NULL);
+
+		WaitForMultipleObjects((DWORD)workers_.size(), workers_.data(), TRUE, INFINITE);
+		for (HANDLE hThread : workers_) { CloseHandle(hThread); }
+		workers_.clear();
+
+		CloseHandle(hWakeup_);
+		hWakeup_ = NULL;
+	}
+
+	size_t GetQueueDepth() const
+	{
+		return queue_.Size();
+	}
+
+	unsigned GetDroppedCount() const
+	{
+		return cDropped_.load(std::memory_order_relaxed);
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static CapturePipeline pipeline;
+	pipeline.Start(hWnd, WM_APP_CAPTURE_RESULT, 2, HandleClipboardData);
+
+	CaptureJob* pJob = new CaptureJob{};
+	// ...copy clipboard data into pJob->buffer, CloseClipboard...
+	if (!pipeline.Submit(pJob)) { pool.Release(&pJob->buffer); delete pJob; }
+
+	// WndProc
+	case WM_APP_CAPTURE_RESULT:
+		CaptureJob* pJob = reinterpret_cast<CaptureJob*>(lParam);
+		// ...notify...
+		delete pJob;
+
+*/
+
+
+
@@ -4,15 +4,43 @@
 #include "resource.h"                                    // Resource identifiers
 #include "AppDefine.h"                                   // Application-wide definitions and constants
 #include "EditDialog.h"                                  // Edit dialog window
-#include "TStringHash.h"                                 // tchar string hash functor
+#include "DedupIndex.h"                                  // Persistent duplicate index
+#include "PerceptualHash.h"                              // Near-duplicate fingerprints
+#include "CapturePipeline.h"                             // Worker threads for hashing, encoding and writing
+#include "ClipboardMonitor.h"                            // Clipboard update handling behind ClipboardSource
+#include "BufferPool.h"                                  // Recycled payload buffers
+#include "ContentHash.h"                                 // Hash computed during the copy
+#include "PixelKey.h"                                    // Format-independent dedup key
+#include "PngEncoder.h"                                  // Native multithreaded PNG encoder
+#include "PixelConvert.h"                                // SIMD DIB row conversion
+#include "DIBDecoder.h"                                  // Row decoders for every DIB variant
+#include "PngReader.h"                                   // CF_PNG rows for fingerprints
+#include "Qoi.h"                                         // Fast spool format
+#include "SpoolTranscoder.h"                             // Background QOI to PNG conversion
+#include "IdleOptimizer.h"                               // Idle-time PNG recompression
+#include "UpdateCoalescer.h"                             // Trailing-edge update scheduling
+#include "ClipboardOpenRetry.h"                          // Timer-driven clipboard open retries
+#include "OwnerCache.h"                                  // Clipboard owner names by PID
+#include "WhitelistMatcher.h"                            // Compiled whitelist rules
+#include "OwnerRuleList.h"                               // Allow/deny list file, reloaded on change
+#include "CaptureMetrics.h"                              // Per-stage latency histograms and counters
+#include "MetricsPublisher.h"                            // Metrics pipe and snapshot file
+#include "AtomicFileWriter.h"                            // Crash-safe file writes with a durability policy
+#include "FilenameTemplate.h"                            // Compiled capture name template
+#include "OutputLayout.h"                                // Output root and shard directories
+#include "PackStore.h"                                   // Append-only pack segments
+#include "TraceZones.h"                                  // Chrome trace timeline (CIS_TRACE_ZONES builds)
 #include "CustomIncludes\WinApi\ThemeManager.h"          // Dark mode support
 #include "CustomIncludes\WinApi\MessageBoxNotifier.h"    // MessageBox notification handler
 #include "CustomIncludes\WinApi\BalloonNotifier.h"       // BalloonNotification handler
-#include "CustomIncludes\WinApi\Debouncer.h"             // Debounce helper
 #include "CustomIncludes\WinApi\IniFileManager.h"        // .ini file settings management
 
 // Standard library headers
 #include <unordered_set>         // Container
+#include <deque>                 // Container
+#include <algorithm>             // std::find
+#include <vector>                // Container
+#include <atomic>                // Capture sequence
 
 // Windows system headers
 #include <windows.h>             // Core Windows API definitions (e.g., HWND, WPARAM, SendMessage)
@@ -43,8 +71,61 @@ namespace Settings
 	TCHAR procWhiteList[WhiteListMaxChars];
 	BOOL isNotificationsEnabled{};
 	BOOL isWhitelistEnabled{};
-	std::unordered_set<tstring, TStringHash> whitelistHashes{};
+	WhitelistMatcher whitelist{};
+	TCHAR szRulesPath[MAX_PATH]{};
+	OwnerRules* pOwnerRules{};  // Swapped on WM_APP_RULES_RELOADED
+	OwnerRuleList ownerRuleList{};
 	IniFileManager ini{};
+	DedupIndex dedupIndex{};
+	HashAlgorithm hashAlgorithm{ HashAlgorithm::Xxh3_64 };
+	BOOL isPixelKeyEnabled{};
+	BOOL isPreHashEnabled{};
+	DedupIndex sampleIndex{};
+	BOOL isNearDuplicateEnabled{};
+	UINT nearDuplicateDistance{};
+	PerceptualAlgorithm perceptualAlgorithm{};
+	BKTree nearDuplicateHistory{};
+	std::deque<UINT64> nearDuplicateRecent{};  // Fingerprints in the tree, oldest first
+	size_t cNearDuplicateMax{};                // Kept after a trim: [Dedup] LastN or MaxFingerprints
+	size_t cNearDuplicateSlack{};              // Inserted past the cap before the tree is rebuilt
+	const size_t MaxFingerprints = 65536;      // Session and AllTime history, 512 KB on disk
+	TCHAR szFingerprintPath[MAX_PATH]{};       // AllTime only
+	UINT pipelineWorkers{};
+	CapturePipeline capturePipeline{};
+	ClipboardMonitor clipboardMonitor{};
+	UpdateCoalescer clipboardCoalescer{};
+	ClipboardOpenRetry clipboardOpenRetry{};
+	OwnerCache ownerCache{};
+	CaptureMetrics captureMetrics{};
+	MetricsPublisher metricsPublisher{};
+#if CIS_TRACE_ZONES
+	UINT traceThresholdMs{};
+	ULONGLONG ullLastTraceMs{};
+#endif
+	BufferPool bufferPool{};
+	PngEncodeOptions pngOptions{};
+	const PixelConvert::Kernels* pPixelKernels{};
+	BOOL isSpoolEnabled{};
+	SpoolTranscoder spoolTranscoder{};
+	BOOL isOptimizerEnabled{};
+	IdleOptimizerOptions optimizerOptions{};
+	UINT64 cbOptimizerSavedBefore{};
+	IdleOptimizer idleOptimizer{};
+	AtomicFileWriter fileWriter{};  // Captures, spool files and transcoded PNGs
+	FilenameTemplate filenameTemplate{};
+	std::atomic<UINT64> captureSequence{};      // Last sequence number handed out this session
+	const UINT MaxNameAttempts = 4096;          // Sequence numbers a capture tries past taken names
+	OutputLayout outputLayout{};
+	BOOL isPackEnabled{};
+	PackWriter packWriter{};  // Captures, instead of one file each, with [Pack] Enabled
+
+	// Guards the duplicate indexes, which are shared by the pipeline workers
+	SRWLOCK dedupLock = SRWLOCK_INIT;
+	std::unordered_set<UINT64> dedupKeysInFlight{};
+	std::vector<UINT64> fingerprintsInFlight{};
+	std::vector<UINT64> samplesInFlight{};          // Sample keys of every reserved capture
+	std::vector<UINT64> deferredSamplesInFlight{};  // Those still without their full key
+	CONDITION_VARIABLE deferredDone = CONDITION_VARIABLE_INIT;
 
 	// Application-wide constants for naming and identification
 	LPCTSTR MainName            = _T("Clipboard Image Saver");
@@ -59,6 +140,18 @@ namespace IniConfig
 	// Sections
 	constexpr LPCTSTR NOTIFICATIONS = _T("Notifications");
 	constexpr LPCTSTR WHITELIST     = _T("Whitelist");
+	constexpr LPCTSTR DEDUP         = _T("Dedup");
+	constexpr LPCTSTR NEAR_DUPLICATE = _T("NearDuplicate");
+	constexpr LPCTSTR PIPELINE      = _T("Pipeline");
+	constexpr LPCTSTR ENCODER       = _T("Encoder");
+	constexpr LPCTSTR SPOOL         = _T("Spool");
+	constexpr LPCTSTR OPTIMIZER     = _T("Optimizer");
+	constexpr LPCTSTR COALESCE      = _T("Coalesce");
+	constexpr LPCTSTR METRICS       = _T("Metrics");
+	constexpr LPCTSTR TRACE         = _T("Trace");
+	constexpr LPCTSTR WRITER        = _T("Writer");
+	constexpr LPCTSTR OUTPUT        = _T("Output");
+	constexpr LPCTSTR PACK          = _T("Pack");
 
 	// Keys
 	namespace Notifications
@@ -69,6 +162,73 @@ namespace IniConfig
 	{
 		constexpr LPCTSTR ENABLED = _T("Enabled");
 		constexpr LPCTSTR LIST    = _T("List");
+		constexpr LPCTSTR FILE    = _T("File");     // Allow/deny list file; default is the INI path with .rules
+	}
+	namespace Dedup
+	{
+		constexpr LPCTSTR SCOPE    = _T("Scope");    // LastN | Session | AllTime
+		constexpr LPCTSTR LAST_N   = _T("LastN");    // History length for the LastN scope
+		constexpr LPCTSTR HASH     = _T("Hash");     // XXH3 | XXH128 | Murmur3 (keys of older indexes)
+		constexpr LPCTSTR KEY      = _T("Key");      // Pixels | Bytes
+		constexpr LPCTSTR PRE_HASH = _T("PreHash");  // Sampled key first, full hash only when it is known
+	}
+	namespace NearDuplicate
+	{
+		constexpr LPCTSTR ENABLED   = _T("Enabled");
+		constexpr LPCTSTR DISTANCE  = _T("MaxDistance");  // Hamming distance in bits (0-64)
+		constexpr LPCTSTR ALGORITHM = _T("Algorithm");    // dHash | aHash | pHash
+	}
+	namespace Pipeline
+	{
+		constexpr LPCTSTR WORKERS = _T("Workers");  // Encoder/writer threads
+	}
+	namespace Encoder
+	{
+		constexpr LPCTSTR LEVEL   = _T("Level");    // Fastest | Fast | Default | Smallest
+		constexpr LPCTSTR THREADS = _T("Threads");  // Deflate threads per image, 0 = one per logical processor
+		constexpr LPCTSTR SIMD    = _T("Simd");     // Auto | Scalar | SSE2 | AVX2 | NEON
+	}
+	namespace Spool
+	{
+		constexpr LPCTSTR ENABLED = _T("Enabled");  // Write QOI first, convert to PNG in the background
+	}
+	namespace Optimizer
+	{
+		constexpr LPCTSTR ENABLED      = _T("Enabled");      // Recompress saved PNGs while the user is idle
+		constexpr LPCTSTR CPU_BUDGET   = _T("CpuBudget");    // Percent of one core (1-100)
+		constexpr LPCTSTR IDLE_SECONDS = _T("IdleSeconds");  // Input-idle time before work starts
+		constexpr LPCTSTR SAVED_KB     = _T("SavedKB");      // Running total, written on exit
+	}
+	namespace Coalesce
+	{
+		constexpr LPCTSTR MIN_WINDOW_MS = _T("MinWindowMs");  // Quiet time before a burst is processed
+		constexpr LPCTSTR MAX_WINDOW_MS = _T("MaxWindowMs");  // Cap of the cost-adaptive window
+		constexpr LPCTSTR MAX_DELAY_MS  = _T("MaxDelayMs");   // Longest wait during a continuous stream
+	}
+	namespace Metrics
+	{
+		constexpr LPCTSTR PIPE             = _T("Pipe");             // Serve snapshots on \\.\pipe\ClipboardImageSaver.metrics
+		constexpr LPCTSTR SNAPSHOT_SECONDS = _T("SnapshotSeconds");  // Snapshot file interval, 0 = on exit only, -1 = never
+	}
+	namespace Trace
+	{
+		constexpr LPCTSTR THRESHOLD_MS = _T("ThresholdMs");  // Saves the trace after a slower capture, 0 = off (CIS_TRACE_ZONES builds)
+	}
+	namespace Writer
+	{
+		constexpr LPCTSTR DURABILITY     = _T("Durability");    // File | Group | None
+		constexpr LPCTSTR GROUP_FLUSH_MS = _T("GroupFlushMs");  // Flush interval of the Group policy
+	}
+	namespace Output
+	{
+		constexpr LPCTSTR NAME  = _T("Name");   // File name template, see FilenameTemplate.h
+		constexpr LPCTSTR ROOT  = _T("Root");   // Output directory; default is the working directory
+		constexpr LPCTSTR SHARD = _T("Shard");  // None | Date (YYYY\MM\DD) | Owner | Hash (first two hex digits)
+	}
+	namespace Pack
+	{
+		constexpr LPCTSTR ENABLED    = _T("Enabled");    // Append captures to pack segments in the output root
+		constexpr LPCTSTR SEGMENT_MB = _T("SegmentMB");  // Size at which a new segment starts
 	}
 }
 
@@ -76,29 +236,16 @@ namespace IniConfig
 using EMC_ = ErrorMessageConverter;
 
 
-// Enum declarations
-enum class ClipboardResult : unsigned
-{
-	Success,
-	NoData,
-	ConversionFailed,
-	LockFailed,
-	UnchangedContent,
-	SaveFailed,
-	InvalidParameter
-};
-
-
 // Forward declarations
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 
 
 
-// Opens the specified folder in Windows Explorer.
+// Opens the output root in Windows Explorer.
 BOOL OpenFolderInExplorer()
 {
-	TCHAR szDirectoryPath[MAX_PATH]{};
-	if (!GetCurrentDirectory(MAX_PATH, szDirectoryPath)) { return FALSE; }
+	LPCTSTR szDirectoryPath = Settings::outputLayout.GetRoot();
+	if (!*szDirectoryPath) { return FALSE; }
 
 	// Open the folder in Explorer
 	HINSTANCE hResult = ShellExecute(
@@ -144,7 +291,7 @@ BOOL RestoreTextFromStorage(LPCTSTR cszSrc, LPTSTR szDest, DWORD cchMax)
 	// Handle in-place replacement by processing backward
 	DWORD cchOriginalLen{};
 	DWORD nPipeCount{};
-	LPCTSTR INVALID_CHARS = _T("\\/:*?\"<>");
+	LPCTSTR INVALID_CHARS = _T("\"<>");  // Glob and path rules need \ / : * ?
 
 	// Count '|' characters to determine new length
 	for (LPCTSTR it{ cszSrc }; *it != _T('\0'); ++it, ++cchOriginalLen) {
@@ -172,21 +319,10 @@ BOOL RestoreTextFromStorage(LPCTSTR cszSrc, LPTSTR szDest, DWORD cchMax)
 	return TRUE;
 }
 
-// Updates the whitelist hash cache
+// Recompiles the whitelist matcher from the list text
 void UpdateWhitelistCache()
 {
-	LPCTSTR cszDelim = _T("\r\n");
-	LPTSTR szContext = NULL;
-	LPTSTR szCopy = _tcsdup(Settings::procWhiteList);
-
-	Settings::whitelistHashes.clear();
-	LPTSTR szToken = _tcstok_s(szCopy, cszDelim, &szContext);
-	while (szToken) {
-		Settings::whitelistHashes.insert(szToken);
-		szToken = _tcstok_s(NULL, cszDelim, &szContext);
-	}
-
-	free(szCopy);
+	Settings::whitelist.Compile(Settings::procWhiteList);
 }
 
 // Updates a specific int setting in a configuration file
@@ -228,68 +364,475 @@ void UpdateSetting(LPCTSTR cszSection, LPCTSTR cszKey, LPTSTR szText, DWORD cchT
 	Settings::ini.WriteString(cszSection, cszKey, szText);
 }
 
-// Function to check existence in the whitelist
+// Checks an owner (full executable path or name) against the whitelist rules
 BOOL IsStringWhitelisted(LPCTSTR cszText)
 {
 	if (!cszText) { return FALSE; }
 
-	auto it = Settings::whitelistHashes.find(cszText);
-
-	return it != Settings::whitelistHashes.end();
+	return Settings::whitelist.IsMatch(cszText) ? TRUE : FALSE;
 }
 
-// Generates a filename string
-LPCTSTR GenerateFilename()
+// Formats the name template and extension into pJob->szFilename after its first cchDirectory
+// characters, from the job's name fields
+BOOL FormatCaptureName(CaptureJob* pJob, size_t cchDirectory)
 {
-	static TCHAR szBuffer[MAX_PATH]{};
-	static DWORD dwBaseLength{};              // Directory + prefix length
-	static LPCTSTR cszPrefix = _T("\\screenshot_");
 	static LPCTSTR cszExtension = _T(".png");
-	static const BYTE byPrefixLength = 12;    // Length of prefix without null terminator
-	static const BYTE byTimestampLength = 18; // Exact length of "%04d%02d%02d_%02d%02d%02d%03d"
-	static const BYTE byExtensionLength = 4;  // Length of ".png"
-
-	if (!dwBaseLength) {
-		DWORD dwDirectoryLength = GetCurrentDirectory(MAX_PATH, szBuffer);
-		if (dwDirectoryLength == 0 or
-			dwDirectoryLength + byPrefixLength + byTimestampLength + byExtensionLength >= MAX_PATH)
-		{
-			szBuffer[0] = _T('\0');
-			return NULL;
-		}
+	static const size_t cchExtension = 4;     // Length of ".png"
 
-		// Add prefix
-		_tcscpy_s(szBuffer + dwDirectoryLength, MAX_PATH - dwDirectoryLength, cszPrefix);
-		// Add prefix length
-		dwBaseLength = dwDirectoryLength + byPrefixLength;
-	}
+	if (cchDirectory + cchExtension >= MAX_PATH) { return FALSE; }
+
+	LPTSTR szName = pJob->szFilename + cchDirectory;
+	const size_t cchName = Settings::filenameTemplate.Format(pJob->nameFields, pJob->szOwner,
+		szName, MAX_PATH - cchDirectory - cchExtension);
+	if (!cchName) { return FALSE; }
+
+	memcpy(szName + cchName, cszExtension, (cchExtension + 1) * sizeof(TCHAR));
+	return TRUE;
+}
+
+// Formats pJob->szFilename ("<root>\<shard>\<name>.png") from the job's name fields
+BOOL FormatCapturePath(CaptureJob* pJob)
+{
+	const size_t cchDirectory = Settings::outputLayout.FormatDirectory(pJob->nameFields, pJob->szOwner,
+		pJob->szFilename, MAX_PATH);
+	return cchDirectory and FormatCaptureName(pJob, cchDirectory);
+}
+
+// Names a capture from the template: local time and the next sequence number. A {hash} in the
+// template or a Hash shard is formatted as zeros here and filled in by the worker once the key
+// is known.
+BOOL GenerateFilename(CaptureJob* pJob)
+{
+	if (!pJob) { return FALSE; }
 
-	// Generate timestamp
 	SYSTEMTIME st;
 	GetLocalTime(&st); // Get time with milliseconds
+	pJob->nameFields = { st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds,
+		++Settings::captureSequence };  // Taken again by the worker when the name exists
+
+	return FormatCapturePath(pJob);
+}
+
+// Sets up the output root, shard layout and name template of the INI file; FALSE if one of
+// them is invalid and its default is used
+BOOL InitializeCaptureNaming()
+{
+	static LPCTSTR cszDefaultTemplate = _T("screenshot_{date}_{time}_{seq}");
+
+	TCHAR szTemplate[MAX_PATH]{};
+	Settings::ini.ReadString(
+		IniConfig::OUTPUT, IniConfig::Output::NAME,
+		cszDefaultTemplate,
+		szTemplate, _countof(szTemplate)
+	);
 
-	// Format directly into buffer at baseLength (YYYYMMDD_HHMMSSmmm)
-	_stprintf_s(
-		szBuffer + dwBaseLength,   // Target position
-		byTimestampLength + 1,     // Max allowed chars: 18 + null terminator
-		_T("%04d%02d%02d_%02d%02d%02d%03d"),  // Format: YYYYMMDD_HHMMSSmmm
-		st.wYear,                  // 4-digit year
-		st.wMonth,                 // 2-digit month
-		st.wDay,                   // 2-digit day
-		st.wHour,                  // 2-digit hour
-		st.wMinute,                // 2-digit minute
-		st.wSecond,                // 2-digit second
-		st.wMilliseconds           // 3-digit milliseconds
+	TCHAR szRoot[MAX_PATH]{};
+	Settings::ini.ReadString(
+		IniConfig::OUTPUT, IniConfig::Output::ROOT,
+		_T(""),
+		szRoot, _countof(szRoot)
 	);
 
-	// Add extension
-	_tcscpy_s(
-		szBuffer + dwBaseLength + byTimestampLength,
-		MAX_PATH - dwBaseLength - byTimestampLength,
-		cszExtension
+	TCHAR szShard[16]{};
+	Settings::ini.ReadString(
+		IniConfig::OUTPUT, IniConfig::Output::SHARD,
+		_T("None"),
+		szShard, _countof(szShard)
 	);
 
-	return szBuffer;
+	BOOL isValid = TRUE;
+	const ShardPolicy shardPolicy = OutputLayout::ParseShardPolicy(szShard);
+	if (!*szRoot or !Settings::outputLayout.Configure(szRoot, shardPolicy)) {
+		isValid = !*szRoot;
+		Settings::outputLayout.Configure(_T("."), shardPolicy);
+	}
+
+	// {seq} keeps the names of a session apart; captures never replace a file of an earlier one
+	if (!Settings::filenameTemplate.Compile(szTemplate) or !Settings::filenameTemplate.IsSequenceUsed()) {
+		isValid = FALSE;
+		Settings::filenameTemplate.Compile(cszDefaultTemplate);
+	}
+	return isValid;
+}
+
+// Opens the duplicate index with the scope configured in the INI file
+BOOL InitializeDedupIndex()
+{
+	TCHAR szScope[16]{};
+	Settings::ini.ReadString(
+		IniConfig::DEDUP, IniConfig::Dedup::SCOPE,
+		_T("AllTime"),
+		szScope, _countof(szScope)
+	);
+	const DWORD cLastN = Settings::ini.ReadInt(
+		IniConfig::DEDUP, IniConfig::Dedup::LAST_N,
+		1
+	);
+
+	TCHAR szHash[16]{};
+	Settings::ini.ReadString(
+		IniConfig::DEDUP, IniConfig::Dedup::HASH,
+		_T("XXH3"),
+		szHash, _countof(szHash)
+	);
+
+	TCHAR szKey[16]{};
+	Settings::ini.ReadString(
+		IniConfig::DEDUP, IniConfig::Dedup::KEY,
+		_T("Pixels"),
+		szKey, _countof(szKey)
+	);
+	const BOOL isPreHashRequested = Settings::ini.ReadInt(
+		IniConfig::DEDUP, IniConfig::Dedup::PRE_HASH,
+		1
+	);
+
+	DedupScope scope = DedupScope::AllTime;
+	if (_tcsicmp(szScope, _T("LastN")) == 0) { scope = DedupScope::LastN; }
+	else if (_tcsicmp(szScope, _T("Session")) == 0) { scope = DedupScope::Session; }
+
+	Settings::hashAlgorithm = HashAlgorithm::Xxh3_64;
+	if (_tcsicmp(szHash, _T("XXH128")) == 0) { Settings::hashAlgorithm = HashAlgorithm::Xxh3_128; }
+	else if (_tcsicmp(szHash, _T("Murmur3")) == 0) { Settings::hashAlgorithm = HashAlgorithm::Murmur3_32; }
+	Settings::isPixelKeyEnabled = _tcsicmp(szKey, _T("Bytes")) != 0;
+
+	// Pixel and byte keys of the same image differ, so switching either setting starts a new index.
+	// So does PreHash: keys saved while it was off have no sample in the sample index.
+	const UINT64 qwKeyKind = (UINT64)Settings::hashAlgorithm |
+		(Settings::isPixelKeyEnabled ? PixelKey::kKeyKindFlag : 0) |
+		(isPreHashRequested ? ContentHash::kSampledKeyKindFlag : 0);
+
+	// Index file lives next to the INI file
+	TCHAR szIndexPath[MAX_PATH]{};
+	_tcscpy_s(szIndexPath, Settings::ini.GetPath());
+	if (!PathRenameExtension(szIndexPath, _T(".idx"))) { szIndexPath[0] = _T('\0'); }
+
+	const BOOL bResult = Settings::dedupIndex.Open(scope, cLastN, szIndexPath, qwKeyKind) ? TRUE : FALSE;
+
+	// Sample keys of the same captures, evicted in the same order
+	Settings::isPreHashEnabled = FALSE;
+	if (isPreHashRequested) {
+		TCHAR szSamplePath[MAX_PATH]{};
+		_tcscpy_s(szSamplePath, Settings::ini.GetPath());
+		if (!PathRenameExtension(szSamplePath, _T(".sidx"))) { szSamplePath[0] = _T('\0'); }
+		Settings::sampleIndex.Open(Settings::dedupIndex.GetScope(), cLastN, szSamplePath, qwKeyKind);
+
+		// An empty sample index next to saved keys (deleted or unreadable file) would let their
+		// duplicates through, so the full hash stays in charge until the index is reset
+		Settings::isPreHashEnabled =
+			Settings::sampleIndex.GetScope() == Settings::dedupIndex.GetScope() and
+			(Settings::sampleIndex.GetCount() or !Settings::dedupIndex.GetCount());
+	}
+	return bResult;
+}
+
+// Loads perceptual fingerprints of previously saved images
+BOOL InitializeNearDuplicateHistory()
+{
+	Settings::isNearDuplicateEnabled =
+		Settings::ini.ReadInt(
+			IniConfig::NEAR_DUPLICATE, IniConfig::NearDuplicate::ENABLED,
+			FALSE
+		);
+	Settings::nearDuplicateDistance =
+		Settings::ini.ReadInt(
+			IniConfig::NEAR_DUPLICATE, IniConfig::NearDuplicate::DISTANCE,
+			3
+		);
+
+	TCHAR szAlgorithm[16]{};
+	Settings::ini.ReadString(
+		IniConfig::NEAR_DUPLICATE, IniConfig::NearDuplicate::ALGORITHM,
+		_T("dHash"),
+		szAlgorithm, _countof(szAlgorithm)
+	);
+
+	// Fingerprints of different algorithms are not comparable, so each one keeps its own history file
+	LPCTSTR cszExtension = _T(".dhash");
+	Settings::perceptualAlgorithm = PerceptualAlgorithm::DifferenceHash;
+	if (_tcsicmp(szAlgorithm, _T("aHash")) == 0) {
+		Settings::perceptualAlgorithm = PerceptualAlgorithm::AverageHash;
+		cszExtension = _T(".ahash");
+	}
+	else if (_tcsicmp(szAlgorithm, _T("pHash")) == 0) {
+		Settings::perceptualAlgorithm = PerceptualAlgorithm::DctHash;
+		cszExtension = _T(".phash");
+	}
+
+	// The history follows [Dedup] Scope: the last N fingerprints, or those of this session, or
+	// the most recent MaxFingerprints of a file that survives restarts
+	const DedupScope scope = Settings::dedupIndex.GetScope();
+	Settings::nearDuplicateHistory.Clear();
+	Settings::nearDuplicateRecent.clear();
+	Settings::cNearDuplicateMax = scope == DedupScope::LastN ? Settings::dedupIndex.GetLastN() : Settings::MaxFingerprints;
+	Settings::cNearDuplicateSlack = scope == DedupScope::LastN ? 0 : Settings::cNearDuplicateMax / 4;
+	Settings::szFingerprintPath[0] = _T('\0');
+	if (scope != DedupScope::AllTime) { return TRUE; }
+
+	// History lives next to the INI file, one 64-bit record per saved image
+	_tcscpy_s(Settings::szFingerprintPath, Settings::ini.GetPath());
+	if (!PathRenameExtension(Settings::szFingerprintPath, cszExtension)) {
+		Settings::szFingerprintPath[0] = _T('\0');
+		return FALSE;
+	}
+
+	HANDLE hFile = CreateFile(Settings::szFingerprintPath, GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) { return TRUE; }  // No history yet
+
+	// Only the newest records are loaded
+	LARGE_INTEGER liSize{};
+	GetFileSizeEx(hFile, &liSize);
+	const UINT64 cRecords = (UINT64)liSize.QuadPart / sizeof(UINT64);
+	const UINT64 cSkipped = cRecords > Settings::cNearDuplicateMax ? cRecords - Settings::cNearDuplicateMax : 0;
+	LARGE_INTEGER liStart{};
+	liStart.QuadPart = (LONGLONG)(cSkipped * sizeof(UINT64));
+	SetFilePointerEx(hFile, liStart, NULL, FILE_BEGIN);
+
+	UINT64 records[512];
+	DWORD cbRead{};
+	while (ReadFile(hFile, records, sizeof(records), &cbRead, NULL) and cbRead) {
+		for (DWORD i{}; i < cbRead / sizeof(UINT64); ++i) {
+			Settings::nearDuplicateRecent.push_back(records[i]);
+			Settings::nearDuplicateHistory.Insert(records[i]);
+		}
+	}
+	CloseHandle(hFile);
+
+	// Past the cap, the file is rewritten with what was loaded
+	if (cSkipped) {
+		const std::vector<UINT64> kept(Settings::nearDuplicateRecent.begin(), Settings::nearDuplicateRecent.end());
+		Settings::fileWriter.Write(Settings::szFingerprintPath, kept.data(), kept.size() * sizeof(UINT64));
+	}
+
+	return TRUE;
+}
+
+// Adds the fingerprint of a saved image to the in-memory history (under dedupLock). Past the cap
+// and its slack, the oldest fingerprints are dropped and the tree is rebuilt from the rest.
+void InsertNearDuplicateHistory(UINT64 qwFingerprint)
+{
+	auto& recent = Settings::nearDuplicateRecent;
+	recent.push_back(qwFingerprint);
+	if (recent.size() <= Settings::cNearDuplicateMax + Settings::cNearDuplicateSlack) {
+		Settings::nearDuplicateHistory.Insert(qwFingerprint);
+		return;
+	}
+
+	while (recent.size() > Settings::cNearDuplicateMax) { recent.pop_front(); }
+	Settings::nearDuplicateHistory.Clear();
+	for (UINT64 qwRecent : recent) { Settings::nearDuplicateHistory.Insert(qwRecent); }
+}
+
+// Appends the fingerprint of a saved image to the AllTime history file. Called outside
+// dedupLock; appends of 8 bytes from several workers do not interleave.
+void AppendNearDuplicateHistory(UINT64 qwFingerprint)
+{
+	if (!*Settings::szFingerprintPath) { return; }
+
+	HANDLE hFile = CreateFile(Settings::szFingerprintPath, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) { return; }
+
+	DWORD cbWritten{};
+	WriteFile(hFile, &qwFingerprint, sizeof(qwFingerprint), &cbWritten, NULL);
+	CloseHandle(hFile);
+}
+
+// Reads the PNG encoder speed/size level and thread count
+void InitializeEncoderOptions()
+{
+	TCHAR szLevel[16]{};
+	Settings::ini.ReadString(
+		IniConfig::ENCODER, IniConfig::Encoder::LEVEL,
+		_T("Default"),
+		szLevel, _countof(szLevel)
+	);
+
+	Settings::pngOptions.level = PngLevel::Default;
+	if (_tcsicmp(szLevel, _T("Fastest")) == 0) { Settings::pngOptions.level = PngLevel::Fastest; }
+	else if (_tcsicmp(szLevel, _T("Fast")) == 0) { Settings::pngOptions.level = PngLevel::Fast; }
+	else if (_tcsicmp(szLevel, _T("Smallest")) == 0) { Settings::pngOptions.level = PngLevel::Smallest; }
+
+	Settings::pngOptions.cThreads =
+		Settings::ini.ReadInt(
+			IniConfig::ENCODER, IniConfig::Encoder::THREADS,
+			0
+		);
+
+	// Pixel conversion kernels; forcing Scalar is useful to compare output against the reference
+	TCHAR szSimd[16]{};
+	Settings::ini.ReadString(
+		IniConfig::ENCODER, IniConfig::Encoder::SIMD,
+		_T("Auto"),
+		szSimd, _countof(szSimd)
+	);
+
+	Settings::pPixelKernels = NULL;
+	if (_tcsicmp(szSimd, _T("Scalar")) == 0) { Settings::pPixelKernels = PixelConvert::GetKernels(PixelIsa::Scalar); }
+	else if (_tcsicmp(szSimd, _T("SSE2")) == 0) { Settings::pPixelKernels = PixelConvert::GetKernels(PixelIsa::SSE2); }
+	else if (_tcsicmp(szSimd, _T("AVX2")) == 0) { Settings::pPixelKernels = PixelConvert::GetKernels(PixelIsa::AVX2); }
+	else if (_tcsicmp(szSimd, _T("NEON")) == 0) { Settings::pPixelKernels = PixelConvert::GetKernels(PixelIsa::NEON); }
+	if (!Settings::pPixelKernels) { Settings::pPixelKernels = &PixelConvert::GetBestKernels(); }
+}
+
+// Reads the idle optimizer switches, CPU budget and saved-bytes total
+void InitializeOptimizerOptions()
+{
+	Settings::isOptimizerEnabled =
+		Settings::ini.ReadInt(
+			IniConfig::OPTIMIZER, IniConfig::Optimizer::ENABLED,
+			FALSE
+		);
+
+	const INT nBudget =
+		Settings::ini.ReadInt(
+			IniConfig::OPTIMIZER, IniConfig::Optimizer::CPU_BUDGET,
+			25
+		);
+	Settings::optimizerOptions.cpuBudgetPercent = nBudget < 1 ? 1 : nBudget > 100 ? 100 : (UINT)nBudget;
+
+	const INT nIdleSeconds =
+		Settings::ini.ReadInt(
+			IniConfig::OPTIMIZER, IniConfig::Optimizer::IDLE_SECONDS,
+			30
+		);
+	Settings::optimizerOptions.idleSeconds = nIdleSeconds < 0 ? 0 : (UINT)nIdleSeconds;
+
+	const INT nSavedKB =
+		Settings::ini.ReadInt(
+			IniConfig::OPTIMIZER, IniConfig::Optimizer::SAVED_KB,
+			0
+		);
+	Settings::cbOptimizerSavedBefore = nSavedKB < 0 ? 0 : (UINT64)nSavedKB * 1024;
+}
+
+// Reads the clipboard update coalescing window
+void InitializeCoalesceOptions()
+{
+	UpdateCoalescerOptions options{};
+	const INT nMinWindowMs =
+		Settings::ini.ReadInt(
+			IniConfig::COALESCE, IniConfig::Coalesce::MIN_WINDOW_MS,
+			(INT)options.minWindowMs
+		);
+	const INT nMaxWindowMs =
+		Settings::ini.ReadInt(
+			IniConfig::COALESCE, IniConfig::Coalesce::MAX_WINDOW_MS,
+			(INT)options.maxWindowMs
+		);
+	const INT nMaxDelayMs =
+		Settings::ini.ReadInt(
+			IniConfig::COALESCE, IniConfig::Coalesce::MAX_DELAY_MS,
+			(INT)options.maxDelayMs
+		);
+	options.minWindowMs = nMinWindowMs < 0 ? 0 : (DWORD)nMinWindowMs;
+	options.maxWindowMs = nMaxWindowMs < 0 ? 0 : (DWORD)nMaxWindowMs;
+	options.maxDelayMs = nMaxDelayMs < 0 ? 0 : (DWORD)nMaxDelayMs;
+	Settings::clipboardCoalescer.SetOptions(options);
+}
+
+// Loads the allow/deny list file, which is watched for changes once the window exists
+void InitializeOwnerRules()
+{
+	Settings::ini.ReadString(
+		IniConfig::WHITELIST, IniConfig::Whitelist::FILE,
+		_T(""),
+		Settings::szRulesPath, _countof(Settings::szRulesPath)
+	);
+	if (!*Settings::szRulesPath) {
+		_tcscpy_s(Settings::szRulesPath, Settings::ini.GetPath());
+		if (!PathRenameExtension(Settings::szRulesPath, _T(".rules"))) { Settings::szRulesPath[0] = _T('\0'); }
+	}
+
+	// A missing file is an empty list
+	delete Settings::pOwnerRules;
+	Settings::pOwnerRules = new OwnerRules;
+	OwnerRuleList::Load(Settings::szRulesPath, Settings::pOwnerRules);
+}
+
+// Starts the metrics pipe and snapshot file; the snapshot lives next to the INI file
+void InitializeMetricsPublisher()
+{
+	const BOOL isPipeEnabled =
+		Settings::ini.ReadInt(
+			IniConfig::METRICS, IniConfig::Metrics::PIPE,
+			TRUE
+		);
+	const INT nSnapshotSeconds =
+		Settings::ini.ReadInt(
+			IniConfig::METRICS, IniConfig::Metrics::SNAPSHOT_SECONDS,
+			60
+		);
+
+	TCHAR szSnapshotPath[MAX_PATH]{};
+	if (nSnapshotSeconds >= 0) {
+		_tcscpy_s(szSnapshotPath, Settings::ini.GetPath());
+		if (!PathRenameExtension(szSnapshotPath, _T(".metrics.json"))) { szSnapshotPath[0] = _T('\0'); }
+	}
+
+	Settings::metricsPublisher.Start(&Settings::captureMetrics,
+		isPipeEnabled ? _T("\\\\.\\pipe\\ClipboardImageSaver.metrics") : NULL,
+		szSnapshotPath, nSnapshotSeconds > 0 ? (DWORD)nSnapshotSeconds : 0);
+}
+
+// Durability policy of the INI file, shared by the file and pack writers
+AtomicFileWriterOptions ReadWriterOptions()
+{
+	TCHAR szDurability[16]{};
+	Settings::ini.ReadString(
+		IniConfig::WRITER, IniConfig::Writer::DURABILITY,
+		_T("File"),
+		szDurability, _countof(szDurability)
+	);
+	const INT nGroupFlushMs =
+		Settings::ini.ReadInt(
+			IniConfig::WRITER, IniConfig::Writer::GROUP_FLUSH_MS,
+			1000
+		);
+
+	AtomicFileWriterOptions options{};
+	options.durability = AtomicFileWriter::ParseDurability(szDurability);
+	options.groupFlushMs = nGroupFlushMs < 10 ? 10 : (DWORD)nGroupFlushMs;
+	return options;
+}
+
+// Starts the file writer with the durability policy of the INI file
+void InitializeFileWriter()
+{
+	Settings::fileWriter.Start(ReadWriterOptions());
+}
+
+// Opens the pack segments of the output root with [Pack] Enabled; FALSE if they cannot be
+// opened, and captures are saved as files
+BOOL InitializePackStore()
+{
+	Settings::isPackEnabled =
+		Settings::ini.ReadInt(
+			IniConfig::PACK, IniConfig::Pack::ENABLED,
+			FALSE
+		);
+	if (!Settings::isPackEnabled) { return TRUE; }
+
+	const INT nSegmentMB =
+		Settings::ini.ReadInt(
+			IniConfig::PACK, IniConfig::Pack::SEGMENT_MB,
+			256
+		);
+
+	const AtomicFileWriterOptions writerOptions = ReadWriterOptions();
+	PackWriterOptions options{};
+	options.durability = writerOptions.durability;
+	options.groupFlushMs = writerOptions.groupFlushMs;
+	options.cbMaxSegment = (uint64_t)(nSegmentMB < 1 ? 1 : nSegmentMB) << 20;
+
+	LPCTSTR cszRoot = Settings::outputLayout.GetRoot();
+	Settings::isPackEnabled = Settings::outputLayout.EnsureDirectoryOf(cszRoot)
+		and Settings::packWriter.Open(cszRoot, options);
+
+	// Packed captures are encoded right away: there is no file to spool or to optimize in place
+	if (Settings::isPackEnabled) { Settings::isSpoolEnabled = FALSE; }
+	return Settings::isPackEnabled;
 }
 
 // Initialize global settings with defaults or values read from the INI file
@@ -315,6 +858,37 @@ BOOL InitializeDefaultSettings()
 	);
 	RestoreTextFromStorage(szBuffer, Settings::procWhiteList, Settings::WhiteListMaxChars);
 	UpdateWhitelistCache();
+	InitializeOwnerRules();
+
+	InitializeDedupIndex();
+	InitializeNearDuplicateHistory();
+
+	// Stop joins the workers with one WaitForMultipleObjects, which takes up to 64 handles
+	const INT nWorkers =
+		Settings::ini.ReadInt(
+			IniConfig::PIPELINE, IniConfig::Pipeline::WORKERS,
+			2
+		);
+	Settings::pipelineWorkers = nWorkers < 1 ? 1 : nWorkers > MAXIMUM_WAIT_OBJECTS ? MAXIMUM_WAIT_OBJECTS : (UINT)nWorkers;
+	InitializeEncoderOptions();
+
+	Settings::isSpoolEnabled =
+		Settings::ini.ReadInt(
+			IniConfig::SPOOL, IniConfig::Spool::ENABLED,
+			FALSE
+		);
+
+	InitializeOptimizerOptions();
+	InitializeCoalesceOptions();
+
+#if CIS_TRACE_ZONES
+	const INT nTraceThresholdMs =
+		Settings::ini.ReadInt(
+			IniConfig::TRACE, IniConfig::Trace::THRESHOLD_MS,
+			500
+		);
+	Settings::traceThresholdMs = nTraceThresholdMs < 0 ? 0 : (UINT)nTraceThresholdMs;
+#endif
 
 	return TRUE;
 }
@@ -354,219 +928,633 @@ INT GetEncoderClsid(LPCTSTR cszFormat, CLSID* pClsid)
 	return -1;
 }
 
-// Function to save PNG to file
-BOOL SavePNGToFile(HGLOBAL hData, LPCTSTR cszFilename)
+// Writes an encoded capture (PNG, or QOI for the spool) to its file
+BOOL WriteCaptureFile(LPCVOID pData, SIZE_T cbDataSize, LPCTSTR cszFilename)
 {
-	if (!hData or !cszFilename) { return FALSE; }
+	if (!pData or !cszFilename) { return FALSE; }
+	TRACE_ZONE("WriteCaptureFile");
 
-	// Handle PNG data directly
-	LPVOID pngData = GlobalLock(hData);
-	BOOL bSuccess{};
+	// Never leaves a truncated file under the final name, even after a crash, and never replaces
+	// an existing capture: fails with ERROR_ALREADY_EXISTS instead
+	return Settings::fileWriter.Write(cszFilename, pData, cbDataSize, false) ? TRUE : FALSE;
+}
 
-	if (pngData) {
-		SIZE_T cbDataSize = GlobalSize(hData);
-		HANDLE hFile = CreateFile(cszFilename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-		if (hFile != INVALID_HANDLE_VALUE) {
-			DWORD bytesWritten;
-			WriteFile(hFile, pngData, (DWORD)cbDataSize, &bytesWritten, NULL);
-			CloseHandle(hFile);
-			bSuccess = (bytesWritten == cbDataSize);
-		}
-		GlobalUnlock(hData);
+#if CIS_TRACE_ZONES
+// Saves the trace zones that ended since llSince next to the INI file (<ini>.trace.json)
+BOOL SaveTrace(LONGLONG llSince)
+{
+	TCHAR szTracePath[MAX_PATH]{};
+	_tcscpy_s(szTracePath, Settings::ini.GetPath());
+	if (!PathRenameExtension(szTracePath, _T(".trace.json"))) { return FALSE; }
+
+	const std::string json = Trace::ToChromeJson(llSince);
+	return Settings::fileWriter.Write(szTracePath, json.data(), json.size()) ? TRUE : FALSE;
+}
+#endif
+
+// Returns a pointer to the pixel array that follows the DIB header, masks and color table
+LPBYTE GetDIBPixels(const BITMAPINFO* pbmi)
+{
+	if (!pbmi) { return NULL; }
+
+	return (LPBYTE)pbmi + DIBDecoder::GetPixelOffset(pbmi);
+}
+
+// Computes the perceptual fingerprint of a capture from its decoded rows, so that a re-encode
+// of the same picture as CF_PNG or as another DIB variant fingerprints alike. The decoders
+// check the headers against the payload size; malformed payloads get no fingerprint.
+BOOL ComputeFingerprint(const CaptureJob* pJob, UINT64* pqwFingerprint)
+{
+	if (!pJob or !pqwFingerprint) { return FALSE; }
+	TRACE_ZONE("ComputeFingerprint");
+
+	const LPBYTE lpcbData = pJob->buffer.pData;
+	const SIZE_T cbDataSize = pJob->buffer.cbSize;
+
+	if (pJob->nFormat == CF_PNG) {
+		PngReader reader;
+		if (!reader.Open(lpcbData, cbDataSize)) { return FALSE; }
+		return PerceptualHash::Compute(Settings::perceptualAlgorithm, PngReader::ReadRowProc, &reader,
+			reader.GetWidth(), reader.GetHeight(), 4, pqwFingerprint);
+	}
+
+	// Alpha does not take part in the luma: its scan is skipped
+	DIBDecoder decoder;
+	if (!decoder.Open(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize, Settings::pPixelKernels, false)) {
+		return FALSE;
 	}
-	return bSuccess;
+	return PerceptualHash::Compute(Settings::perceptualAlgorithm, DIBDecoder::ReadRowProc, &decoder,
+		decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), pqwFingerprint);
 }
 
-// Function to save DIB to PNG file
-BOOL SaveDIBToFile(HGLOBAL hData, LPCTSTR cszFilename)
+// Dedup keys of one capture
+struct CaptureKeys
 {
-	if (!hData or !cszFilename) { return FALSE; }
+	UINT64 qwData{};       // Full key (ComputeDataKey)
+	UINT64 qwSample{};     // Sample key of the full key
+	UINT64 pending[2]{};   // Sample keys claimed while in flight (ComputeSampleKey before the full key)
+	BOOL hasData{};
+	BOOL hasSample{};
+	BOOL isDeferred{};     // Claimed on its samples; the full key is computed after the save
+};
 
-	// Lock the DIB to access its data
-	BITMAPINFO* pbmi = (BITMAPINFO*)GlobalLock(hData);
-	if (!pbmi) { return FALSE; }
+// Dedup key of the copied payload: the hash of its decoded pixels, so the same picture copied
+// as CF_PNG or as any DIB variant is one duplicate; the byte hash if the payload cannot be decoded.
+// pqwSampleKey, when set, receives the matching sample key.
+UINT64 ComputeDataKey(CaptureJob* pJob, UINT64* pqwSampleKey)
+{
+	TRACE_ZONE("ComputeDataKey");
+	const LPBYTE lpcbData = pJob->buffer.pData;
+	const SIZE_T cbDataSize = pJob->buffer.cbSize;
+
+	if (Settings::isPixelKeyEnabled) {
+		UINT64 qwPixelKey{};
+		const bool isDecoded = pJob->nFormat == CF_PNG
+			? PixelKey::FromPNG(lpcbData, cbDataSize, Settings::hashAlgorithm, &qwPixelKey, pqwSampleKey)
+			: PixelKey::FromDIB(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize,
+				Settings::hashAlgorithm, Settings::pPixelKernels, &qwPixelKey, pqwSampleKey);
+		if (isDecoded) { return qwPixelKey; }
+	}
 
-	// Calculate the offset to the pixel data
-	DWORD dwColorTableSize{};
-	if (pbmi->bmiHeader.biBitCount <= 8) {
-		dwColorTableSize = (pbmi->bmiHeader.biClrUsed ? pbmi->bmiHeader.biClrUsed : (1 << pbmi->bmiHeader.biBitCount)) * sizeof(RGBQUAD);
+	if (!pJob->isDataHashed) {
+		pJob->dataHash = ContentHash::Compute(Settings::hashAlgorithm, lpcbData, cbDataSize, 0);
+		pJob->isDataHashed = TRUE;
 	}
-	LPVOID pPixels = (BYTE*)pbmi + pbmi->bmiHeader.biSize + dwColorTableSize;
+	if (pqwSampleKey) { *pqwSampleKey = ContentHash::Sample(lpcbData, cbDataSize); }
+	return ContentHash::ToDedupKey(Settings::hashAlgorithm, pJob->dataHash, cbDataSize);
+}
+
+// Sample keys of the copied payload, consistent with ComputeDataKey: equal keys imply equal
+// samples. The second one is the other reading of an undecided DIB alpha channel (equal to the
+// first otherwise). FALSE when the sample needs the full decode (CF_PNG pixel keys).
+BOOL ComputeSampleKey(const CaptureJob* pJob, UINT64 sampleKeys[2])
+{
+	TRACE_ZONE("ComputeSampleKey");
+	const LPBYTE lpcbData = pJob->buffer.pData;
+	const SIZE_T cbDataSize = pJob->buffer.cbSize;
+
+	if (Settings::isPixelKeyEnabled) {
+		if (pJob->nFormat == CF_PNG) { return FALSE; }
+		if (PixelKey::SampleDIB(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize,
+			Settings::pPixelKernels, &sampleKeys[0], &sampleKeys[1]))
+		{
+			return TRUE;
+		}
+	}
+
+	// Payloads without pixel keys fall back to byte keys, and so do their samples
+	sampleKeys[0] = sampleKeys[1] = ContentHash::Sample(lpcbData, cbDataSize);
+	return TRUE;
+}
+
+// Where the time and bytes of a save went, for the metrics
+struct SaveOutcome
+{
+	LONGLONG llEncodedAt{};  // End of the encode, start of the write
+	SIZE_T cbWritten{};
+};
 
-	// Create a GDI+ Bitmap from the DIB
-	Gdiplus::Bitmap bitmap(pbmi, pPixels);
+// Encodes a DIB through GDI+ into memory, for the formats DIBDecoder does not read
+BOOL EncodeDIBGdiplus(const BITMAPINFO* pbmi, std::vector<uint8_t>* pPng)
+{
+	if (!pbmi or !pPng) { return FALSE; }
+	TRACE_ZONE("EncodeDIBGdiplus");
 
-	// Get the PNG encoder CLSID
 	CLSID pngClsid;
 	if (GetEncoderClsid(_T("image/png"), &pngClsid) < 0) {
-		GlobalUnlock(hData);
 		return FALSE;
 	}
 
-	// Save the bitmap as PNG
-	Gdiplus::Status gdiStatus = bitmap.Save(cszFilename, &pngClsid, NULL);
+	IStream* pStream{};
+	if (FAILED(CreateStreamOnHGlobal(NULL, TRUE, &pStream))) {
+		return FALSE;
+	}
+
+	Gdiplus::Bitmap bitmap(pbmi, GetDIBPixels(pbmi));
+	HGLOBAL hGlobal{};
+	STATSTG stat{};
+	BOOL bResult = bitmap.Save(pStream, &pngClsid, NULL) == Gdiplus::Ok
+		and SUCCEEDED(GetHGlobalFromStream(pStream, &hGlobal))
+		and SUCCEEDED(pStream->Stat(&stat, STATFLAG_NONAME));
+	if (bResult) {
+		const BYTE* pData = static_cast<const BYTE*>(GlobalLock(hGlobal));
+		bResult = pData != NULL;
+		if (bResult) {
+			pPng->assign(pData, pData + stat.cbSize.QuadPart);
+			GlobalUnlock(hGlobal);
+		}
+	}
+
+	pStream->Release();
+	return bResult;
+}
+
+// Saves a DIB through GDI+, for the formats DIBDecoder does not read (e.g. BI_JPEG)
+// Encoded in memory and written by the file writer, like every other capture
+BOOL SaveDIBToFileGdiplus(const BITMAPINFO* pbmi, LPCTSTR cszFilename, SaveOutcome* pOutcome)
+{
+	if (!pbmi or !cszFilename or !pOutcome) { return FALSE; }
+	TRACE_ZONE("SaveDIBToFileGdiplus");
+
+	std::vector<uint8_t> png;
+	const BOOL isEncoded = EncodeDIBGdiplus(pbmi, &png);
+	pOutcome->llEncodedAt = CaptureTimings::Now();
+	if (!isEncoded or !WriteCaptureFile(png.data(), png.size(), cszFilename)) { return FALSE; }
+
+	pOutcome->cbWritten = png.size();
+	return TRUE;
+}
+
+// Function to save DIB to PNG file
+BOOL SaveDIBToFile(const BITMAPINFO* pbmi, SIZE_T cbDataSize, LPCTSTR cszFilename, SaveOutcome* pOutcome)
+{
+	if (!pbmi or !cszFilename or !pOutcome) { return FALSE; }
+
+	DIBDecoder decoder;
+	if (!decoder.Open(pbmi, cbDataSize, Settings::pPixelKernels)) {
+		return SaveDIBToFileGdiplus(pbmi, cszFilename, pOutcome);
+	}
+
+	const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+	std::vector<uint8_t> png;
+	const bool isEncoded = EncodePng(image, Settings::pngOptions, &png);
+	pOutcome->llEncodedAt = CaptureTimings::Now();
+	if (!isEncoded or !WriteCaptureFile(png.data(), png.size(), cszFilename)) { return FALSE; }
+
+	pOutcome->cbWritten = png.size();
+	return TRUE;
+}
+
+// Saves a DIB as a QOI spool file next to cszFilename and queues its conversion to PNG
+BOOL SaveDIBToSpool(const BITMAPINFO* pbmi, SIZE_T cbDataSize, LPCTSTR cszFilename, SaveOutcome* pOutcome)
+{
+	if (!pbmi or !cszFilename or !pOutcome) { return FALSE; }
+
+	DIBDecoder decoder;
+	if (!decoder.Open(pbmi, cbDataSize, Settings::pPixelKernels)) {
+		return SaveDIBToFileGdiplus(pbmi, cszFilename, pOutcome);
+	}
+
+	TCHAR szSpoolPath[MAX_PATH]{};
+	if (!SpoolTranscoder::GetSpoolPath(cszFilename, szSpoolPath, MAX_PATH)) { return FALSE; }
+
+	const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+	std::vector<uint8_t> qoi;
+	const bool isEncoded = Qoi::Encode(image, &qoi);
+	pOutcome->llEncodedAt = CaptureTimings::Now();
+	if (!isEncoded) { return FALSE; }
+
+	// Renamed into place by the writer, so the transcoder never picks up a partial file on restart
+	if (!WriteCaptureFile(qoi.data(), qoi.size(), szSpoolPath)) { return FALSE; }
+
+	pOutcome->cbWritten = qoi.size();
+	Settings::spoolTranscoder.Enqueue(szSpoolPath);
+	return TRUE;
+}
+
+// Appends encoded data to the pack with the job's owner and dedup key
+BOOL SaveToPack(LPCVOID pData, SIZE_T cbDataSize, const CaptureJob* pJob, UINT64 qwKey, SaveOutcome* pOutcome)
+{
+	if (!pData or !pJob or !pOutcome) { return FALSE; }
+	TRACE_ZONE("SaveToPack");
+
+	if (!Settings::packWriter.Append(pData, cbDataSize, qwKey, PackWriter::Now(), pJob->szOwner)) { return FALSE; }
+
+	pOutcome->cbWritten = cbDataSize;
+	return TRUE;
+}
+
+// Encodes a DIB to PNG in memory and appends it to the pack
+BOOL SaveDIBToPack(const BITMAPINFO* pbmi, SIZE_T cbDataSize, const CaptureJob* pJob, UINT64 qwKey, SaveOutcome* pOutcome)
+{
+	if (!pbmi or !pJob or !pOutcome) { return FALSE; }
+
+	std::vector<uint8_t> png;
+	DIBDecoder decoder;
+	BOOL isEncoded{};
+	if (decoder.Open(pbmi, cbDataSize, Settings::pPixelKernels)) {
+		const PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+		isEncoded = EncodePng(image, Settings::pngOptions, &png);
+	}
+	else {
+		isEncoded = EncodeDIBGdiplus(pbmi, &png);
+	}
+	pOutcome->llEncodedAt = CaptureTimings::Now();
+	if (!isEncoded) { return FALSE; }
 
-	// Clean up
-	GlobalUnlock(hData);
-	return gdiStatus == Gdiplus::Ok;
+	return SaveToPack(png.data(), png.size(), pJob, qwKey, pOutcome);
 }
 
 // Retrieves the executable path of the clipboard owner process
 LPCTSTR RetrieveClipboardOwner()
 {
-	static TCHAR szExePath[MAX_PATH]; // Buffer for the executable path
-
+	TRACE_ZONE("RetrieveClipboardOwner");
 	HWND hClipboardOwner = GetClipboardOwner();
 	if (!hClipboardOwner) { return NULL; }
 
 	DWORD dwProcessId{};
 	GetWindowThreadProcessId(hClipboardOwner, &dwProcessId);
-	if (!dwProcessId) { return NULL; }
 
-	HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, dwProcessId);
-	if (!hProcess) { return NULL; }
+	// Only the first capture from a process opens it
+	return Settings::ownerCache.Lookup(dwProcessId);
+}
 
-	DWORD dwPathSize = MAX_PATH;
-	BOOL bSuccess = QueryFullProcessImageName(hProcess, 0, szExePath, &dwPathSize);
-	CloseHandle(hProcess);
-	if (!bSuccess) { return NULL; }
+// Converts a CF_BITMAP handle into a 32bpp bottom-up DIB held in a pooled buffer
+BOOL CopyBitmapToBuffer(HBITMAP hBitmap, PooledBuffer* pBuffer)
+{
+	if (!hBitmap or !pBuffer) { return FALSE; }
+
+	BITMAP bm{};
+	if (!GetObject(hBitmap, sizeof(bm), &bm) or bm.bmWidth <= 0 or bm.bmHeight <= 0) { return FALSE; }
+
+	BITMAPINFOHEADER bih{};
+	bih.biSize = sizeof(BITMAPINFOHEADER);
+	bih.biWidth = bm.bmWidth;
+	bih.biHeight = bm.bmHeight;
+	bih.biPlanes = 1;
+	bih.biBitCount = 32;
+	bih.biCompression = BI_RGB;
+	bih.biSizeImage = (DWORD)bm.bmWidth * bm.bmHeight * 4;
+
+	if (!Settings::bufferPool.Acquire(sizeof(bih) + bih.biSizeImage, pBuffer)) { return FALSE; }
+	memcpy(pBuffer->pData, &bih, sizeof(bih));
+
+	HDC hdc = GetDC(NULL);
+	const INT nLines = GetDIBits(hdc, hBitmap, 0, bm.bmHeight,
+		pBuffer->pData + sizeof(bih), reinterpret_cast<BITMAPINFO*>(pBuffer->pData), DIB_RGB_COLORS);
+	ReleaseDC(NULL, hdc);
+
+	if (nLines != bm.bmHeight) {
+		Settings::bufferPool.Release(pBuffer);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	// Extract the executable name
-	LPCTSTR cszExeName = _tcsrchr(szExePath, _T('\\'));
-	if (!cszExeName) { return NULL; }
-	++cszExeName; // Move past the backslash
+// Copies clipboard data into a pooled buffer, hashing each chunk while it is still in cache
+// (large payloads are copied and hashed on all cores). Without pHash it is a plain copy.
+BOOL CopyAndHash(LPCVOID pSrc, SIZE_T cbDataSize, PooledBuffer* pBuffer, Hash128* pHash)
+{
+	if (!Settings::bufferPool.Acquire(cbDataSize, pBuffer)) { return FALSE; }
 
-	return cszExeName;
+	if (!pHash) {
+		memcpy(pBuffer->pData, pSrc, cbDataSize);
+		return TRUE;
+	}
+	*pHash = ContentHash::Compute(Settings::hashAlgorithm, pSrc, cbDataSize, 0, pBuffer->pData);
+	return TRUE;
 }
 
-// Convert bitmap to DIB
-BOOL BitmapToDIB(HGLOBAL hClipboardData)
+// Retrieves image data and its format from the clipboard into the job (single copy)
+BOOL GetClipboardImageData(CaptureJob* pJob)
 {
+	if (!pJob) { return FALSE; }
+	TRACE_ZONE("GetClipboardImageData");
+
+	static UINT uFormatPriorityList[]{ CF_PNG, CF_DIBV5, CF_DIB, CF_BITMAP };
+
+	pJob->nFormat = 0;
+
+	INT nFormat = GetPriorityClipboardFormat(uFormatPriorityList, _countof(uFormatPriorityList));
+	if (nFormat <= 0) { return FALSE; }
+
+	HANDLE hClipboardData = GetClipboardData(nFormat);
 	if (!hClipboardData) { return FALSE; }
 
-	HBITMAP hBitmap = (HBITMAP)hClipboardData;
-	if (hBitmap) {
-		hClipboardData = GlobalAlloc(GMEM_MOVEABLE, sizeof(BITMAPINFOHEADER) + GetBitmapBits(hBitmap, 0, NULL));
-		if (hClipboardData) {
-			BITMAPINFOHEADER* pbi = (BITMAPINFOHEADER*)GlobalLock(hClipboardData);
-			if (pbi) { // Check if lock succeeded
-				GetDIBits(GetDC(NULL), hBitmap, 0, 0, NULL, (BITMAPINFO*)pbi, DIB_RGB_COLORS);
-				GlobalUnlock(hClipboardData);
-				return TRUE;
-			}
+	// CF_BITMAP is a GDI handle, not global memory
+	if (nFormat == CF_BITMAP) {
+		if (!CopyBitmapToBuffer((HBITMAP)hClipboardData, &pJob->buffer)) { return FALSE; }
+		if (!Settings::isPreHashEnabled) {
+			pJob->dataHash = ContentHash::Compute(Settings::hashAlgorithm, pJob->buffer.pData, pJob->buffer.cbSize, 0);
+			pJob->isDataHashed = TRUE;
 		}
+		pJob->nFormat = CF_DIB;
+		return TRUE;
 	}
-	return FALSE;
+
+	const SIZE_T cbDataSize = GlobalSize(hClipboardData);
+	LPCVOID pSrc = GlobalLock(hClipboardData);
+	if (!pSrc or !cbDataSize) {
+		if (pSrc) { GlobalUnlock(hClipboardData); }
+		return FALSE;
+	}
+
+	// With the pre-hash the worker hashes only what the sample key cannot settle
+	BOOL bResult = CopyAndHash(pSrc, cbDataSize, &pJob->buffer, Settings::isPreHashEnabled ? NULL : &pJob->dataHash);
+	GlobalUnlock(hClipboardData);
+
+	if (bResult) {
+		pJob->nFormat = nFormat;
+		pJob->isDataHashed = !Settings::isPreHashEnabled;
+	}
+	return bResult;
 }
 
-// Retrieves image data and its format from the clipboard
-HGLOBAL GetClipboardImageData(INT* pFormat)
+// Returns a printable name for a clipboard format
+LPCTSTR GetClipboardFormatLabel(INT nFormat)
 {
-	if (!pFormat) { return 0; }
+	if (nFormat == CF_PNG)    return _T("PNG");
+	if (nFormat == CF_DIBV5)  return _T("DIBV5");
+	if (nFormat == CF_DIB)    return _T("DIB");
+	if (nFormat == CF_BITMAP) return _T("BITMAP");
+	else                      return _T("unknown");
+}
 
-	static UINT uFormatPriorityList[]{ CF_PNG, CF_DIBV5, CF_DIB, CF_BITMAP };
+// Claims a capture for saving; fails if it is already saved or being saved by another worker.
+// A capture without its full key is claimed on its sample keys alone, which only succeeds when
+// no saved or pending capture has them; otherwise it fails with ClipboardResult::Success and
+// the full key has to decide.
+BOOL ReserveCapture(const CaptureKeys& keys, const UINT64* pqwFingerprint, ClipboardResult* pResult)
+{
+	TRACE_ZONE("ReserveCapture");
+	AcquireSRWLockExclusive(&Settings::dedupLock);
+
+	// A capture with the same sample that is still without its full key could be this very
+	// image, so its key has to be in the index before this one is checked
+	const auto IsPending = [](const std::vector<UINT64>& pending, UINT64 qwKey) {
+		return std::find(pending.begin(), pending.end(), qwKey) != pending.end();
+	};
+	if (keys.hasSample) {
+		while (IsPending(Settings::deferredSamplesInFlight, keys.pending[0]) or
+			IsPending(Settings::deferredSamplesInFlight, keys.pending[1]))
+		{
+			SleepConditionVariableSRW(&Settings::deferredDone, &Settings::dedupLock, INFINITE, 0);
+		}
+	}
 
-	HGLOBAL hClipboardData{};
-	HGLOBAL hCopy{};
-	*pFormat = 0;
+	*pResult = ClipboardResult::Success;
+	BOOL isSampleNew = TRUE;
+	if (!keys.hasData) {
+		for (UINT64 qwSample : keys.pending) {
+			if (Settings::sampleIndex.Contains(qwSample) or IsPending(Settings::samplesInFlight, qwSample)) {
+				isSampleNew = FALSE;
+			}
+		}
+	}
+	else if (Settings::dedupIndex.Contains(keys.qwData) or
+		Settings::dedupKeysInFlight.count(keys.qwData))
+	{
+		*pResult = ClipboardResult::UnchangedContent;
+	}
 
-	INT nFormat = GetPriorityClipboardFormat(uFormatPriorityList, _countof(uFormatPriorityList));
-	if (nFormat) {
-		hClipboardData = GetClipboardData(nFormat);
-		if (hClipboardData) {
-			SIZE_T cbDataSize = GlobalSize(hClipboardData);
-			hCopy = GlobalAlloc(GMEM_MOVEABLE, cbDataSize);
-			if (hCopy) {
-				LPVOID pSrc = GlobalLock(hClipboardData);
-				LPVOID pDest = GlobalLock(hCopy);
-				if (pSrc && pDest) {
-					memcpy(pDest, pSrc, cbDataSize);
-					*pFormat = nFormat;
-				}
-				GlobalUnlock(hClipboardData);
-				GlobalUnlock(hCopy);
+	if (isSampleNew and *pResult == ClipboardResult::Success and pqwFingerprint) {
+		BOOL isSimilar = Settings::nearDuplicateHistory.FindWithin(*pqwFingerprint, Settings::nearDuplicateDistance);
+		for (UINT64 qwPending : Settings::fingerprintsInFlight) {
+			if (isSimilar) { break; }
+			isSimilar = PerceptualHash::HammingDistance(qwPending, *pqwFingerprint) <= Settings::nearDuplicateDistance;
+		}
+		if (isSimilar) { *pResult = ClipboardResult::SimilarContent; }
+	}
+
+	const BOOL isReserved = isSampleNew and *pResult == ClipboardResult::Success;
+	if (isReserved) {
+		if (keys.hasData) { Settings::dedupKeysInFlight.insert(keys.qwData); }
+		if (keys.hasSample) {
+			for (UINT64 qwSample : keys.pending) {
+				Settings::samplesInFlight.push_back(qwSample);
+				if (!keys.hasData) { Settings::deferredSamplesInFlight.push_back(qwSample); }
 			}
 		}
+		if (pqwFingerprint) { Settings::fingerprintsInFlight.push_back(*pqwFingerprint); }
 	}
-	return hCopy; // Caller MUST free this handle
+
+	ReleaseSRWLockExclusive(&Settings::dedupLock);
+	return isReserved;
 }
 
-// Processes clipboard data and handles related operations
-ClipboardResult HandleClipboardData(LPTSTR szFormat, UINT cchFormat)
+// Removes one occurrence of a key from an in-flight list
+void EraseInFlight(std::vector<UINT64>* pPending, UINT64 qwKey)
 {
-	static DWORD dwLastDataHash{};
-	static SIZE_T cbLastDataSize{};
-
-	if (!szFormat) { return ClipboardResult::InvalidParameter; }
+	auto it = std::find(pPending->begin(), pPending->end(), qwKey);
+	if (it != pPending->end()) { pPending->erase(it); }
+}
 
-	INT nFormat{};
-	HGLOBAL hClipboardData = GetClipboardImageData(&nFormat);
+// Releases a reservation and records the content as saved on success
+void CompleteCapture(const CaptureKeys& keys, const UINT64* pqwFingerprint, BOOL bSaved)
+{
+	AcquireSRWLockExclusive(&Settings::dedupLock);
 
-	_tcscpy_s(szFormat, cchFormat, [&]() {
-		if (nFormat == CF_PNG)    return _T("PNG");
-		if (nFormat == CF_DIBV5)  return _T("DIBV5");
-		if (nFormat == CF_DIB)    return _T("DIB");
-		if (nFormat == CF_BITMAP) return _T("BITMAP");
-		else                      return _T("unknown");
-		}()
-	);
+	if (keys.hasData and !keys.isDeferred) { Settings::dedupKeysInFlight.erase(keys.qwData); }
+	if (keys.hasSample) {
+		for (UINT64 qwSample : keys.pending) {
+			EraseInFlight(&Settings::samplesInFlight, qwSample);
+			if (keys.isDeferred) { EraseInFlight(&Settings::deferredSamplesInFlight, qwSample); }
+		}
+		if (keys.isDeferred) { WakeAllConditionVariable(&Settings::deferredDone); }
+	}
+	if (pqwFingerprint) {
+		auto& pending = Settings::fingerprintsInFlight;
+		for (auto it = pending.begin(); it != pending.end(); ++it) {
+			if (*it == *pqwFingerprint) { pending.erase(it); break; }
+		}
+	}
 
-	if (!hClipboardData or nFormat <= 0) {
-		return ClipboardResult::NoData;
+	// Update state only after successful save; the sample goes first so that a key is never
+	// indexed without it
+	if (bSaved and keys.hasData) {
+		if (keys.hasSample) { Settings::sampleIndex.Insert(keys.qwSample); }
+		Settings::dedupIndex.Insert(keys.qwData);
+		if (pqwFingerprint) { InsertNearDuplicateHistory(*pqwFingerprint); }
 	}
 
-	// Convert CF_BITMAP to CF_DIB if needed
-	if (nFormat == CF_BITMAP) {
-		if (!BitmapToDIB(hClipboardData)) {
-			GlobalFree(hClipboardData);
-			return ClipboardResult::ConversionFailed;
-		}
-		nFormat = CF_DIB;
+	ReleaseSRWLockExclusive(&Settings::dedupLock);
+
+	// Disk I/O outside the lock, so that the workers do not queue behind it
+	if (bSaved and keys.hasData and pqwFingerprint) { AppendNearDuplicateHistory(*pqwFingerprint); }
+}
+
+// Saves a capture as a file in its shard directory, as a spool file with [Spool] Enabled
+BOOL SaveCaptureToFile(CaptureJob* pJob, SaveOutcome* pOutcome, BOOL* pisSpooled)
+{
+	const LPBYTE lpcbData = pJob->buffer.pData;
+	const SIZE_T cbDataSize = pJob->buffer.cbSize;
+
+	if (!Settings::outputLayout.EnsureDirectoryOf(pJob->szFilename)) { return FALSE; }
+
+	// A name of an earlier session is left before encoding; WriteCaptureFile also refuses it
+	if (GetFileAttributes(pJob->szFilename) != INVALID_FILE_ATTRIBUTES) {
+		SetLastError(ERROR_ALREADY_EXISTS);
+		return FALSE;
 	}
 
-	LPBYTE lpcbData = static_cast<LPBYTE>(GlobalLock(hClipboardData));
-	if (!lpcbData) {
-		GlobalFree(hClipboardData);
-		return ClipboardResult::LockFailed;
+	if (pJob->nFormat == CF_PNG) {
+		if (!WriteCaptureFile(lpcbData, cbDataSize, pJob->szFilename)) { return FALSE; }
+		pOutcome->cbWritten = cbDataSize;
+		return TRUE;
+	}
+	if (Settings::isSpoolEnabled) {
+		*pisSpooled = SaveDIBToSpool(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize, pJob->szFilename, pOutcome);
+		return *pisSpooled;
 	}
+	return SaveDIBToFile(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize, pJob->szFilename, pOutcome);
+}
 
-	// Calculate content hash
-	const SIZE_T cbDataSize = GlobalSize(hClipboardData);
-	const DWORD dwDataHash = (DWORD)MurmurHash3_32{}.computeHash(lpcbData, cbDataSize);
-	GlobalUnlock(hClipboardData);
+// Processes copied clipboard data: hash, duplicate checks, encode and write (pipeline worker)
+ClipboardResult HandleClipboardData(CaptureJob* pJob)
+{
+	if (!pJob or !pJob->buffer.pData) { return ClipboardResult::InvalidParameter; }
+	TRACE_ZONE("HandleClipboardData");
+
+	const LPBYTE lpcbData = pJob->buffer.pData;
+	const SIZE_T cbDataSize = pJob->buffer.cbSize;
+	const INT nFormat = pJob->nFormat;
+	LONGLONG llStageStart = CaptureTimings::Now();
+
+	// Pre-hash: a sample key no saved or pending capture has means the content is new, and the
+	// full key is left until after the save
+	CaptureKeys keys{};
+	keys.hasSample = Settings::isPreHashEnabled and ComputeSampleKey(pJob, keys.pending);
+
+	// Fingerprint for near-duplicates (re-encodes, blinking cursors, clocks)
+	UINT64 qwFingerprint{};
+	BOOL hasFingerprint{};
+	if (Settings::isNearDuplicateEnabled) {
+		hasFingerprint = ComputeFingerprint(pJob, &qwFingerprint);
+	}
 
-	// Check for duplicate content
-	if (cbDataSize == cbLastDataSize and dwDataHash == dwLastDataHash) {
-		GlobalFree(hClipboardData);
-		return ClipboardResult::UnchangedContent;
+	const UINT64* pqwFingerprint = hasFingerprint ? &qwFingerprint : NULL;
+
+	// Check for duplicate content, on the sample keys first
+	ClipboardResult result{};
+	keys.isDeferred = keys.hasSample and ReserveCapture(keys, pqwFingerprint, &result);
+	if (!keys.isDeferred and result == ClipboardResult::Success) {
+		// Seen sample, or none without the full decode: the full key decides and settles the sample
+		keys.qwData = ComputeDataKey(pJob, Settings::isPreHashEnabled ? &keys.qwSample : NULL);
+		keys.hasData = TRUE;
+		keys.hasSample = Settings::isPreHashEnabled;
+		keys.pending[0] = keys.pending[1] = keys.qwSample;
+		if (!ReserveCapture(keys, pqwFingerprint, &result)) {
+			pJob->timings.Record(CaptureStage::Hash, llStageStart);
+			return result;
+		}
 	}
+	else if (!keys.isDeferred) {
+		pJob->timings.Record(CaptureStage::Hash, llStageStart);
+		return result;
+	}
+
+	// A {hash} name, Hash shard or pack entry is finished now; a deferred capture computes its
+	// full key before the save
+	BOOL isNameUnavailable{};
+	if (Settings::filenameTemplate.IsHashUsed() or Settings::outputLayout.IsHashUsed() or Settings::isPackEnabled) {
+		if (!keys.hasData) {
+			keys.qwData = ComputeDataKey(pJob, &keys.qwSample);
+			keys.hasData = TRUE;
+		}
+		pJob->nameFields.contentHash = keys.qwData;
 
-	// Generate filename and save
-	LPCTSTR cszFilename = GenerateFilename();
-	if (!cszFilename) {
-		GlobalFree(hClipboardData);
-		return ClipboardResult::SaveFailed;
+		// A hash that makes the path too long skips the capture like a taken name (packs need no name)
+		isNameUnavailable = !FormatCapturePath(pJob) and !Settings::isPackEnabled;
 	}
+	llStageStart = pJob->timings.Record(CaptureStage::Hash, llStageStart);
 
 	BOOL bResult{};
-	if (nFormat == CF_PNG) {
-		bResult = SavePNGToFile(hClipboardData, cszFilename);
+	BOOL isSpooled{};
+	SaveOutcome outcome{ llStageStart };  // CF_PNG is written as is
+	if (Settings::isPackEnabled) {
+		bResult = nFormat == CF_PNG
+			? SaveToPack(lpcbData, cbDataSize, pJob, keys.qwData, &outcome)
+			: SaveDIBToPack(reinterpret_cast<const BITMAPINFO*>(lpcbData), cbDataSize, pJob, keys.qwData, &outcome);
 	}
-	else {
-		bResult = SaveDIBToFile(hClipboardData, cszFilename);
+	else if (!isNameUnavailable) {
+		bResult = SaveCaptureToFile(pJob, &outcome, &isSpooled);
+
+		// Shard directory deleted while running: created again and the capture saved once more,
+		// before the failure reaches the message loop
+		if (!bResult and GetLastError() == ERROR_PATH_NOT_FOUND) {
+			Settings::outputLayout.ForgetDirectoryOf(pJob->szFilename);
+			bResult = SaveCaptureToFile(pJob, &outcome, &isSpooled);
+		}
+
+		// Name taken, by a file of an earlier session as the sequence restarts at 1: the next
+		// sequence numbers are tried, and a capture that finds none is skipped
+		for (UINT cAttempts{}; !bResult and GetLastError() == ERROR_ALREADY_EXISTS; ++cAttempts) {
+			pJob->nameFields.sequence = ++Settings::captureSequence;
+			if (cAttempts == Settings::MaxNameAttempts or !FormatCapturePath(pJob)) {
+				isNameUnavailable = TRUE;
+				break;
+			}
+			bResult = SaveCaptureToFile(pJob, &outcome, &isSpooled);
+		}
+	}
+	if (nFormat != CF_PNG) { pJob->timings.Record(CaptureStage::Encode, llStageStart, outcome.llEncodedAt); }
+	pJob->timings.Record(CaptureStage::Write, outcome.llEncodedAt);
+	pJob->cbWritten = outcome.cbWritten;
+
+	// Spooled captures are queued by the transcoder once their PNG exists; packed ones are never
+	// rewritten
+	if (bResult and !isSpooled and !Settings::isPackEnabled and Settings::isOptimizerEnabled) {
+		Settings::idleOptimizer.Enqueue(pJob->szFilename);
 	}
 
-	GlobalFree(hClipboardData);
+	// Full key of a capture claimed on its samples, so that its copies are found later
+	if (keys.isDeferred and bResult and !keys.hasData) {
+		keys.qwData = ComputeDataKey(pJob, &keys.qwSample);
+		keys.hasData = TRUE;
+	}
 
-	if (!bResult) {
-		return ClipboardResult::SaveFailed;
+	CompleteCapture(keys, pqwFingerprint, bResult);
+
+	if (bResult) { return ClipboardResult::Success; }
+	return isNameUnavailable ? ClipboardResult::NameUnavailable : ClipboardResult::SaveFailed;
+}
+
+// Spool transcoder callback: hands the finished PNG to the idle optimizer
+void OnSpoolCompleted(LPCTSTR cszPngPath)
+{
+	if (Settings::isOptimizerEnabled) {
+		Settings::idleOptimizer.Enqueue(cszPngPath);
 	}
+}
 
-	// Update state only after successful save
-	dwLastDataHash = dwDataHash;
-	cbLastDataSize = cbDataSize;
+// Pipeline entry point: runs the capture and releases its payload
+void ProcessCaptureJob(CaptureJob* pJob)
+{
+	SetLastError(ERROR_SUCCESS);
+	pJob->result = HandleClipboardData(pJob);
+	pJob->dwError = GetLastError();
 
-	return ClipboardResult::Success;
+	Settings::bufferPool.Release(&pJob->buffer);
 }
 
 // Tray Icon initialization
@@ -613,6 +1601,66 @@ Gdiplus::Status InitializeGDIPlus(ULONG_PTR* pGdiPlusToken)
 	return Gdiplus::GdiplusStartup(pGdiPlusToken, &startupInput, NULL);
 }
 
+// Refreshes the tray tooltip with the current buffer memory footprint and spool backlog
+BOOL UpdateTrayTooltip(NOTIFYICONDATA* pNotifyIconData)
+{
+	if (!pNotifyIconData) { return FALSE; }
+
+	const double cbMegabyte = 1024.0 * 1024.0;
+	const BufferPoolStats stats = Settings::bufferPool.GetStats();
+
+	INT cchTip = _stprintf_s(pNotifyIconData->szTip,
+		_T("%s" EOL_ "Buffers: %.1f MB steady, %.1f MB peak"),
+		Settings::MainName,
+		stats.cbCommitted / cbMegabyte,
+		stats.cbPeakCommitted / cbMegabyte
+	);
+
+	const size_t cSpoolPending = Settings::spoolTranscoder.GetQueueDepth();
+	if (cchTip > 0 and cSpoolPending) {
+		const INT cchLine = _stprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip,
+			_T("\r\nSpool: %zu pending"), cSpoolPending);
+		if (cchLine > 0) { cchTip += cchLine; }
+	}
+
+	if (cchTip > 0 and Settings::idleOptimizer.IsRunning()) {
+		const INT cchLine = _stprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip,
+			_T("\r\nOptimizer: %.1f MB saved"), Settings::idleOptimizer.GetBytesSaved() / cbMegabyte);
+		if (cchLine > 0) { cchTip += cchLine; }
+	}
+
+	// Last lines, truncated rather than failing if the tip is already long
+	const UpdateCoalescerStats coalescerStats = Settings::clipboardCoalescer.GetStats();
+	if (cchTip > 0 and coalescerStats.cCoalesced) {
+		const INT cchLine = _sntprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip, _TRUNCATE,
+			_T("\r\nUpdates: %llu processed, %llu coalesced"), coalescerStats.cProcessed, coalescerStats.cCoalesced);
+		cchTip = cchLine > 0 ? cchTip + cchLine : 0;
+	}
+
+	const ClipboardContentionStats contentionStats = Settings::clipboardOpenRetry.GetStats();
+	if (cchTip > 0 and contentionStats.cContended) {
+		const INT cchLine = _sntprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip, _TRUNCATE,
+			_T("\r\nClipboard busy: %llu, %llu recovered"), contentionStats.cContended, contentionStats.cRecovered);
+		cchTip = cchLine > 0 ? cchTip + cchLine : 0;
+	}
+
+	if (cchTip > 0 and Settings::ownerCache.GetStats().cLookups) {
+		const INT cchLine = _sntprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip, _TRUNCATE,
+			_T("\r\nOwners: %u%% cached"), Settings::ownerCache.GetHitRate());
+		cchTip = cchLine > 0 ? cchTip + cchLine : 0;
+	}
+
+	const LatencyHistogram& endToEnd = Settings::captureMetrics.GetEndToEnd();
+	if (cchTip > 0 and endToEnd.GetCount()) {
+		_sntprintf_s(pNotifyIconData->szTip + cchTip, _countof(pNotifyIconData->szTip) - cchTip, _TRUNCATE,
+			_T("\r\nSave: p50 %.0f ms, p99 %.0f ms, %llu failed"), endToEnd.GetPercentile(50) / 1000.0,
+			endToEnd.GetPercentile(99) / 1000.0, Settings::captureMetrics.GetFailureCount());
+	}
+
+	pNotifyIconData->uFlags = NIF_TIP | NIF_SHOWTIP;
+	return Shell_NotifyIcon(NIM_MODIFY, pNotifyIconData);
+}
+
 // Creates a popup menu for the system tray
 BOOL CreateTrayContextMenu(HMENU* pMenu)
 {
@@ -637,6 +1685,11 @@ BOOL CreateTrayContextMenu(HMENU* pMenu)
 		MF_STRING | (Settings::isNotificationsEnabled ? MF_CHECKED : MF_UNCHECKED),
 		IDM_TRAY_TOGGLE_NOTIFICATIONS, _T("Show notifications")
 	);
+#if CIS_TRACE_ZONES
+	AppendMenu(*pMenu, MF_STRING, IDM_TRAY_SAVE_TRACE,
+		_T("Save trace")
+	);
+#endif
 	AppendMenu(*pMenu, MF_SEPARATOR, IDM_TRAY_SEPARATOR, NULL);
 	AppendMenu(*pMenu, MF_STRING, IDM_TRAY_EXIT,
 		_T("Exit")
@@ -669,33 +1722,63 @@ BOOL ShowTrayContextMenu(HWND hWnd)
 	return FALSE;
 }
 
-// Attempts to open the clipboard with retry logic on access denial
-BOOL TryOpenClipboard()
+// The Win32 clipboard as a ClipboardSource. Open makes a single attempt; while another process
+// holds the clipboard (ERROR_ACCESS_DENIED) the window procedure retries on a timer.
+class Win32ClipboardSource : public ClipboardSource
 {
-	BOOL bResult = OpenClipboard(NULL);
-	if (bResult) { return TRUE; }
+public:
+	BOOL Open() override
+	{
+		TRACE_ZONE("OpenClipboard");
+		return OpenClipboard(NULL);
+	}
 
-	DWORD dwError = GetLastError();
-	if (dwError == ERROR_ACCESS_DENIED) { // Clipboard is being held by another process
-		INT nRetries = 4;
-		UINT uDelay = 50;  // ms
+	void Close() override { CloseClipboard(); }
 
-		// Retry logic with progressive backoff
-		do {
-			Sleep(uDelay);
-			uDelay *= 2;  // Exponential backoff
-		} while (nRetries-- > 0 and !(bResult = OpenClipboard(NULL)));
+	LPCTSTR GetOwner() override { return RetrieveClipboardOwner(); }
+
+	BOOL CopyImage(CaptureJob* pJob) override
+	{
+		const BOOL hasData = GetClipboardImageData(pJob);
+		_tcscpy_s(pJob->szFormat, GetClipboardFormatLabel(pJob->nFormat));
+		return hasData;
 	}
-	return bResult;
+};
+
+// ClipboardMonitor hooks
+BOOL IsOwnerAllowed(void*, LPCTSTR cszOwner)
+{
+	// Deny rules of the list file apply even with the whitelist off
+	const OwnerRules* pRules = Settings::pOwnerRules;
+	if (pRules and cszOwner and pRules->deny.IsMatch(cszOwner)) { return FALSE; }
+	if (Settings::isWhitelistEnabled != TRUE) { return TRUE; }
+
+	return IsStringWhitelisted(cszOwner) or (pRules and cszOwner and pRules->allow.IsMatch(cszOwner));
 }
 
-// Validates a string for Windows application names by checking for invalid characters
+BOOL GenerateCaptureFilename(void*, CaptureJob* pJob)
+{
+	return GenerateFilename(pJob);
+}
+
+bool SubmitCaptureJob(void*, CaptureJob* pJob)
+{
+	return Settings::capturePipeline.Submit(pJob);
+}
+
+void ReleaseCaptureBuffer(void*, PooledBuffer* pBuffer)
+{
+	Settings::bufferPool.Release(pBuffer);
+}
+
+// Validates whitelist rules: names, paths and globs are allowed ("keepass*.exe", "C:\Tools\*"),
+// the storage separator and characters no path can hold are not
 BOOL CheckTextCorrectness(LPCTSTR lpcszText)
 {
 	if (!lpcszText) { return FALSE; }
 
-	// These are typically invalid filename characters in Windows
-	for (LPCTSTR INVALID_CHARS{ _T("\\/:*?\"<>|") }; *lpcszText; ++lpcszText) {
+	// '|' stands for line breaks in the INI file
+	for (LPCTSTR INVALID_CHARS{ _T("\"<>|") }; *lpcszText; ++lpcszText) {
 		if (_tcschr(INVALID_CHARS, *lpcszText)) {
 			return FALSE;
 		}
@@ -744,45 +1827,88 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 	case WM_CLIPBOARDUPDATE:
 	{
-		static Debouncer debouncer{ 50 };
-		static const UINT uMaxFormatStringLength = 64;
-		static TCHAR szClipboardFormatBuffer[uMaxFormatStringLength];
+		// A retry still waiting for older content is dropped; this update is processed instead
+		if (Settings::clipboardOpenRetry.Supersede()) { KillTimer(hWnd, IDT_CLIPBOARD_RETRY); }
 
-		// Debounce
-		if (!debouncer.ShouldProcess()) { break; }
+		// Processed once the burst it belongs to is over (WM_TIMER); re-arming replaces the timer
+		SetTimer(hWnd, IDT_CLIPBOARD_COALESCE, Settings::clipboardCoalescer.OnUpdate(GetTickCount64()), NULL);
+		break;
+	}
 
-		if (!TryOpenClipboard()) {
+	case WM_TIMER:
+	{
+		if (wParam == IDT_CLIPBOARD_RETRY) {
+			KillTimer(hWnd, IDT_CLIPBOARD_RETRY);
+			if (!Settings::clipboardOpenRetry.IsRetryDue(GetClipboardSequenceNumber())) { break; }
+		}
+		else if (wParam == IDT_CLIPBOARD_COALESCE) {
+			KillTimer(hWnd, IDT_CLIPBOARD_COALESCE);
+
+			DWORD dwDelayMs{};
+			if (!Settings::clipboardCoalescer.IsDue(GetTickCount64(), &dwDelayMs)) {
+				if (dwDelayMs) { SetTimer(hWnd, IDT_CLIPBOARD_COALESCE, dwDelayMs, NULL); }
+				break;
+			}
+		}
+		else { break; }
+
+		// The clipboard now holds the latest state of the burst
+		static Win32ClipboardSource clipboardSource{};
+		CaptureJob* pFailedJob{};
+		const LONGLONG llStart = CaptureTimings::Now();
+		const ClipboardUpdate update = Settings::clipboardMonitor.OnUpdate(&clipboardSource, &pFailedJob);
+		const DWORD dwError = update == ClipboardUpdate::OpenFailed ? GetLastError() : ERROR_SUCCESS;
+		Settings::captureMetrics.RecordUpdate(update, Settings::clipboardMonitor.GetLastTimings());
+		Settings::clipboardCoalescer.OnProcessed(CaptureTimings::ToMilliseconds(CaptureTimings::Now() - llStart));
+
+		// Held by another process: try again later instead of waiting here
+		const DWORD dwRetryMs = Settings::clipboardOpenRetry.OnAttempt(dwError == ERROR_ACCESS_DENIED,
+			GetClipboardSequenceNumber(), GetTickCount64());
+		if (dwRetryMs) {
+			SetTimer(hWnd, IDT_CLIPBOARD_RETRY, dwRetryMs, NULL);
+		}
+		else if (update == ClipboardUpdate::OpenFailed) {
 			BalloonNotifier{
 				{ _T("System Error") },
-				{ _T("Failed to access clipboard." EOL_ "%s"), EMC_(GetLastError()) }
+				{ _T("Failed to access clipboard." EOL_ "%s"), EMC_(dwError) }
 			}.ShowError(&notifyIconData);
-			break;
 		}
-
-		// Retrieves the name of the clipboard data owner
-		LPCTSTR cszClipboardOwner = RetrieveClipboardOwner();
-		if (!cszClipboardOwner) {
-			CloseClipboard();
-			break;
+		else if (update == ClipboardUpdate::NoFilename) {
+			PostMessage(hWnd, WM_APP_CAPTURE_RESULT, 0, (LPARAM)pFailedJob);
 		}
+		break;
+	}
 
-		// Checks if the whitelist option is enabled
-		if (Settings::isWhitelistEnabled == TRUE) {
-			if (!IsStringWhitelisted(cszClipboardOwner)) {
-				CloseClipboard();
-				break;
-			}
+	case WM_APP_CAPTURE_RESULT:
+	{
+		CaptureJob* pJob = reinterpret_cast<CaptureJob*>(lParam);
+		if (!pJob) { break; }
+		Settings::captureMetrics.RecordJob(*pJob);
+
+#if CIS_TRACE_ZONES
+		// A slow capture saves the timeline from its clipboard update on, at most every 10 s
+		LONGLONG llCaptureTicks{};
+		LONGLONG llFrontTicks{};
+		for (size_t i{}; i < (size_t)CaptureStage::Count; ++i) {
+			llCaptureTicks += pJob->timings.ticks[i];
+			if (i <= (size_t)CaptureStage::Copy) { llFrontTicks += pJob->timings.ticks[i]; }
 		}
+		if (Settings::traceThresholdMs and CaptureTimings::ToMilliseconds(llCaptureTicks) > Settings::traceThresholdMs
+			and GetTickCount64() - Settings::ullLastTraceMs >= 10000)
+		{
+			Settings::ullLastTraceMs = GetTickCount64();
+			SaveTrace(pJob->llQueuedAt - llFrontTicks);
+		}
+#endif
 
 		// Helper function for error cases
 		const auto HandleClipboardError = [&](LPCTSTR szTitle, LPCTSTR szMessage) {
 			if (Settings::isNotificationsEnabled) {
 				BalloonNotifier{
 					{ szTitle },
-					{ _T("%s." EOL_ "%s"), EMC_(GetLastError()) }
+					{ _T("%s." EOL_ "%s"), szMessage, EMC_(pJob->dwError) }
 				}.ShowError(&notifyIconData);
 			}
-			CloseClipboard();
 			nExitCode = -1;
 			DestroyWindow(hWnd);
 		};
@@ -792,14 +1918,19 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			if (Settings::isNotificationsEnabled) {
 				BalloonNotifier{
 					{ szTitle },
-					{ _T("Owner:  %s" EOL_ "Type:  %s"), cszClipboardOwner, szClipboardFormatBuffer }
+					{ _T("Owner:  %s" EOL_ "Type:  %s" EOL_ "Time:  %.1f / %.1f / %.1f / %.1f / %.1f / %.1f ms"),
+						pJob->szOwner, pJob->szFormat,
+						pJob->timings.Milliseconds(CaptureStage::Open),
+						pJob->timings.Milliseconds(CaptureStage::Copy),
+						pJob->timings.Milliseconds(CaptureStage::Queue),
+						pJob->timings.Milliseconds(CaptureStage::Hash),
+						pJob->timings.Milliseconds(CaptureStage::Encode),
+						pJob->timings.Milliseconds(CaptureStage::Write) }
 				}.ShowInfo(&notifyIconData);
 			}
 		};
 
-		ClipboardResult clipboardResult = 
-			HandleClipboardData(szClipboardFormatBuffer, uMaxFormatStringLength);
-
+		const ClipboardResult clipboardResult = pJob->result;
 		switch (clipboardResult) {
 		case ClipboardResult::Success:
 			ShowStatusNotification(_T("Clipboard Data Captured"));
@@ -807,18 +1938,48 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		case ClipboardResult::UnchangedContent:
 			//ShowStatusNotification(_T("Clipboard Data Ignored"));
 			break;
+		case ClipboardResult::SimilarContent:
+			// Unlike exact duplicates, the skipped image may hold content that was not saved
+			ShowStatusNotification(_T("Similar Clipboard Data Ignored"));
+			break;
 		case ClipboardResult::ConversionFailed:
 			HandleClipboardError(_T("Image Conversion Error"), _T("Failed to convert bitmap to DIB format"));
-			return -1;
+			break;
 		case ClipboardResult::LockFailed:
 			HandleClipboardError(_T("Memory Error"), _T("Failed to lock clipboard memory"));
-			return -1;
+			break;
 		case ClipboardResult::SaveFailed:
 			HandleClipboardError(_T("Save Error"), _T("Failed to save image to file"));
-			return -1;
+			break;
+		case ClipboardResult::NameUnavailable:
+			// The next capture can still be named: reported, not fatal
+			if (Settings::isNotificationsEnabled) {
+				BalloonNotifier{
+					{ _T("Clipboard Data Skipped") },
+					{ _T("No free file name for the capture." EOL_ "Check the [Output] Name template.") }
+				}.ShowWarning(&notifyIconData);
+			}
+			break;
 		default: break; }
 
-		CloseClipboard();
+		UpdateTrayTooltip(&notifyIconData);
+
+		delete pJob;
+		break;
+	}
+
+	case WM_APP_SPOOL_PROGRESS:
+	case WM_APP_OPTIMIZER_PROGRESS:
+	{
+		UpdateTrayTooltip(&notifyIconData);
+		break;
+	}
+
+	case WM_APP_RULES_RELOADED:
+	{
+		// Clipboard updates are handled on this thread too, so none is matching right now
+		delete Settings::pOwnerRules;
+		Settings::pOwnerRules = (OwnerRules*)lParam;
 		break;
 	}
 
@@ -843,6 +2004,18 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				break;
 			}
 
+#if CIS_TRACE_ZONES
+			if (wCommandId == IDM_TRAY_SAVE_TRACE) {
+				if (!SaveTrace(0)) {
+					BalloonNotifier{
+						{ _T("System Error") },
+						{ _T("Failed to save the trace." EOL_ "%s"), EMC_(GetLastError()) }
+					}.ShowWarning(&notifyIconData);
+				}
+				break;
+			}
+#endif
+
 			if (wCommandId == IDM_TRAY_TOGGLE_WHITELIST) {
 				UpdateSetting(IniConfig::WHITELIST, IniConfig::Whitelist::ENABLED,
 					(INT)!Settings::isWhitelistEnabled);
@@ -883,6 +2056,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 	case WM_CREATE:
 	{
+		TRACE_THREAD("message loop");
+
 		Gdiplus::Status gdiStatus = InitializeGDIPlus(&pGdiPlusToken);
 		if (gdiStatus != Gdiplus::Status::Ok) {
 			MessageBoxNotifier{
@@ -900,6 +2075,56 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			return -1;
 		}
 
+		// Before anything that saves files
+		InitializeFileWriter();
+		if (!InitializeCaptureNaming()) {
+			BalloonNotifier{
+				{ _T("Settings Error") },
+				{ _T("Invalid [Output] Root or Name, the default is used.") }
+			}.ShowWarning(&notifyIconData);
+		}
+		if (!InitializePackStore()) {
+			BalloonNotifier{
+				{ _T("Settings Error") },
+				{ _T("Cannot open the pack in [Output] Root, captures are saved as files." EOL_ "%s"), EMC_(GetLastError()) }
+			}.ShowWarning(&notifyIconData);
+		}
+
+		Settings::clipboardMonitor.SetHooks({ NULL, IsOwnerAllowed, GenerateCaptureFilename, SubmitCaptureJob, ReleaseCaptureBuffer });
+		if (!Settings::capturePipeline.Start(hWnd, WM_APP_CAPTURE_RESULT,
+			Settings::pipelineWorkers, ProcessCaptureJob))
+		{
+			MessageBoxNotifier{
+				{ _T("System Error") },
+				{ _T("Failed to start capture workers." EOL_ "%s"), EMC_(GetLastError()) }
+			}.ShowError(hWnd);
+			return -1;
+		}
+
+		// Started before the transcoder, which hands it the spool files it resumes
+		if (Settings::isOptimizerEnabled) {
+			Settings::isOptimizerEnabled = Settings::idleOptimizer.Start(Settings::optimizerOptions,
+				Settings::cbOptimizerSavedBefore, hWnd, WM_APP_OPTIMIZER_PROGRESS);
+		}
+
+		// Spool files sit next to their final PNG; leftovers from the last run are resumed from
+		// the output root and its shard directories
+		PngEncodeOptions spoolOptions = Settings::pngOptions;
+		spoolOptions.cThreads = 1;
+		if (!Settings::spoolTranscoder.Start(Settings::outputLayout.GetRoot(), spoolOptions, &Settings::fileWriter,
+			hWnd, WM_APP_SPOOL_PROGRESS, OnSpoolCompleted))
+		{
+			Settings::isSpoolEnabled = FALSE;
+		}
+
+		// Metrics for "it is slow" reports, read without touching the capture path
+		InitializeMetricsPublisher();
+
+		// Edits to the list file take effect without a restart
+		if (*Settings::szRulesPath) {
+			Settings::ownerRuleList.Start(Settings::szRulesPath, hWnd, WM_APP_RULES_RELOADED);
+		}
+
 		if (!AddClipboardFormatListener(hWnd)) {
 			BalloonNotifier{
 				{ _T("System Error") },
@@ -928,6 +2153,40 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 	case WM_DESTROY:
 	{
 		if (!RemoveClipboardFormatListener(hWnd)) {}
+		KillTimer(hWnd, IDT_CLIPBOARD_COALESCE);
+		KillTimer(hWnd, IDT_CLIPBOARD_RETRY);
+
+		// Let the workers save what is already queued
+		Settings::capturePipeline.Stop();
+
+		// Last snapshot, with every capture counted
+		Settings::metricsPublisher.Stop();
+
+		// Finish the file being converted; the remaining spool files are resumed on the next start
+		Settings::spoolTranscoder.Stop();
+
+		// Flush the files and pack entries written since the last group flush
+		Settings::fileWriter.Stop();
+		Settings::packWriter.Close();
+
+		// Abandon the file being optimized and keep the saved-bytes total
+		if (Settings::idleOptimizer.IsRunning()) {
+			Settings::idleOptimizer.Stop();
+			UpdateSetting(IniConfig::OPTIMIZER, IniConfig::Optimizer::SAVED_KB,
+				(INT)(Settings::idleOptimizer.GetBytesSaved() / 1024));
+		}
+
+		// Release the owner process handles
+		Settings::ownerCache.Clear();
+
+		// A version posted after this point is dropped with the message queue
+		Settings::ownerRuleList.Stop();
+		delete Settings::pOwnerRules;
+		Settings::pOwnerRules = NULL;
+
+		// Flush and release the duplicate index
+		Settings::dedupIndex.Close();
+		Settings::sampleIndex.Close();
 
 		// Remove system tray icon
 		Shell_NotifyIcon(NIM_DELETE, &notifyIconData);
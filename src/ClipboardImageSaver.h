@@ -9,3 +9,19 @@
 
 
 
+// Outcome of processing one clipboard update
+enum class ClipboardResult : unsigned
+{
+	Success,
+	NoData,
+	ConversionFailed,
+	LockFailed,
+	UnchangedContent,
+	SimilarContent,
+	SaveFailed,
+	NameUnavailable,  // No free file name for the capture: skipped, unlike SaveFailed
+	InvalidParameter
+};
+
+
+
@@ -0,0 +1,167 @@
+#pragma once
+
+// Implementation-specific headers
+#include "ClipboardSource.h"  // Update source
+#include "CaptureJob.h"       // Work item
+#include "TraceZones.h"       // Update timeline
+
+// Standard library headers
+#include <cstdint>  // Counters
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Outcome of one clipboard update at the front of the capture path
+enum class ClipboardUpdate : unsigned
+{
+	Submitted,       // Handed to the workers
+	OpenFailed,      // Clipboard not opened, the last error says why (ERROR_ACCESS_DENIED: held)
+	NoOwner,         // Owner process unknown
+	NotWhitelisted,  // Owner rejected by pfnIsOwnerAllowed
+	NoImage,         // No image format, or the copy failed
+	NoFilename,      // Output path could not be built; the job comes back as NameUnavailable
+	Dropped,         // Workers saturated
+	Count
+};
+
+
+
+// Connects the monitor to the application (or to the replay driver); pContext is passed to
+// every hook
+struct ClipboardMonitorHooks
+{
+	void* pContext{};
+	BOOL (*pfnIsOwnerAllowed)(void* pContext, LPCTSTR cszOwner){};  // Owner path; NULL accepts every owner
+	BOOL (*pfnGenerateFilename)(void* pContext, CaptureJob* pJob){};  // Sets pJob->szFilename; FALSE if it cannot
+	bool (*pfnSubmit)(void* pContext, CaptureJob* pJob){};          // false when saturated
+	void (*pfnReleaseBuffer)(void* pContext, PooledBuffer* pBuffer){};
+};
+
+
+
+// WM_CLIPBOARDUPDATE without Win32: takes the clipboard, checks its owner, copies the image
+// out, releases the clipboard, names the file and submits the job, counting every outcome.
+// Runs on the thread that receives the updates.
+class ClipboardMonitor
+{
+private:
+	ClipboardMonitorHooks hooks_{};
+	uint64_t counts_[(size_t)ClipboardUpdate::Count]{};
+	CaptureTimings timings_{};  // Front stages of the last update
+
+private:
+	ClipboardUpdate Tally(ClipboardUpdate update)
+	{
+		++counts_[(size_t)update];
+		return update;
+	}
+
+public:
+	void SetHooks(const ClipboardMonitorHooks& hooks)
+	{
+		hooks_ = hooks;
+	}
+
+	// Processes one update. On NoFilename *ppFailedJob receives the job, payload released and
+	// result set, for the caller to report; it is NULL otherwise.
+	ClipboardUpdate OnUpdate(ClipboardSource* pSource, CaptureJob** ppFailedJob)
+	{
+		TRACE_ZONE("ClipboardUpdate");
+		if (ppFailedJob) { *ppFailedJob = NULL; }
+		if (!pSource or !hooks_.pfnGenerateFilename or !hooks_.pfnSubmit or !hooks_.pfnReleaseBuffer) {
+			return Tally(ClipboardUpdate::NoImage);
+		}
+
+		timings_ = {};
+		LONGLONG llStageStart = CaptureTimings::Now();
+
+		const bool isOpened = pSource->Open();
+		llStageStart = timings_.Record(CaptureStage::Open, llStageStart);
+		if (!isOpened) { return Tally(ClipboardUpdate::OpenFailed); }
+
+		LPCTSTR cszOwner = pSource->GetOwner();
+		llStageStart = timings_.Record(CaptureStage::Owner, llStageStart);
+		if (!cszOwner) {
+			pSource->Close();
+			return Tally(ClipboardUpdate::NoOwner);
+		}
+
+		const bool isAllowed = !hooks_.pfnIsOwnerAllowed or hooks_.pfnIsOwnerAllowed(hooks_.pContext, cszOwner);
+		llStageStart = timings_.Record(CaptureStage::Filter, llStageStart);
+		if (!isAllowed) {
+			pSource->Close();
+			return Tally(ClipboardUpdate::NotWhitelisted);
+		}
+
+		// Copy the data, then release the clipboard before any heavy work
+		CaptureJob* pJob = new CaptureJob{};
+		LPCTSTR cszOwnerName = cszOwner;
+		for (LPCTSTR p = cszOwner; *p; ++p) {
+			if (*p == _T('\\') or *p == _T('/')) { cszOwnerName = p + 1; }
+		}
+		_tcscpy_s(pJob->szOwner, cszOwnerName);
+		const BOOL hasData = pSource->CopyImage(pJob);
+		pSource->Close();
+		timings_.Record(CaptureStage::Copy, llStageStart);
+		pJob->timings = timings_;
+
+		if (!hasData) {
+			delete pJob;
+			return Tally(ClipboardUpdate::NoImage);
+		}
+
+		// Name the file at capture time
+		if (!hooks_.pfnGenerateFilename(hooks_.pContext, pJob)) {
+			pJob->dwError = GetLastError();
+			hooks_.pfnReleaseBuffer(hooks_.pContext, &pJob->buffer);
+			pJob->result = ClipboardResult::NameUnavailable;
+			if (ppFailedJob) { *ppFailedJob = pJob; }
+			else { delete pJob; }
+			return Tally(ClipboardUpdate::NoFilename);
+		}
+
+		// Hand off to the workers, dropping the capture if they are saturated
+		if (!hooks_.pfnSubmit(hooks_.pContext, pJob)) {
+			hooks_.pfnReleaseBuffer(hooks_.pContext, &pJob->buffer);
+			delete pJob;
+			return Tally(ClipboardUpdate::Dropped);
+		}
+		return Tally(ClipboardUpdate::Submitted);
+	}
+
+	uint64_t GetCount(ClipboardUpdate update) const
+	{
+		return counts_[(size_t)update];
+	}
+
+	// Stages the last update went through, up to the copy; a submitted job carries the same
+	const CaptureTimings& GetLastTimings() const
+	{
+		return timings_;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static ClipboardMonitor monitor;
+	monitor.SetHooks({ NULL, IsOwnerAllowed, GenerateFilename, SubmitJob, ReleaseBuffer });
+
+	// WndProc
+	case WM_CLIPBOARDUPDATE:
+		CaptureJob* pFailedJob{};
+		if (monitor.OnUpdate(&clipboardSource, &pFailedJob) == ClipboardUpdate::NoFilename) {
+			PostMessage(hWnd, WM_APP_CAPTURE_RESULT, 0, (LPARAM)pFailedJob);
+		}
+
+*/
+
+
+
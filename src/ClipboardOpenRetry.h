@@ -0,0 +1,144 @@
+#pragma once
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Tuning knobs of ClipboardOpenRetry
+struct ClipboardOpenRetryOptions
+{
+	UINT cRetries{ 4 };        // Attempts after the first one
+	DWORD firstDelayMs{ 50 };  // Doubles after every failed attempt (50, 100, 200, 400)
+};
+
+struct ClipboardContentionStats
+{
+	UINT64 cAttempts{};       // Opens tried, first attempts included
+	UINT64 cContended{};      // Updates that found the clipboard held by another process
+	UINT64 cRecovered{};      // ... and got it on a retry
+	UINT64 cSuperseded{};     // ... whose retries were dropped for a newer update
+	UINT64 cGaveUp{};         // ... that ran out of retries
+	ULONGLONG totalWaitMs{};  // First failure to recovery, summed over cRecovered
+	ULONGLONG maxWaitMs{};
+};
+
+
+
+// Retries of a clipboard open that found the clipboard held, without blocking the caller.
+// Instead of sleeping between attempts, the caller arms a timer for the delay returned by
+// OnAttempt and tries again when IsRetryDue says so. A retry is only made for the clipboard
+// content it was started for (its sequence number); a newer update supersedes it and is
+// processed on its own. Single-threaded, like the message loop it serves.
+class ClipboardOpenRetry
+{
+private:
+	ClipboardOpenRetryOptions options_{};
+	ClipboardContentionStats stats_{};
+	bool isWaiting_{};
+	DWORD dwSequence_{};
+	UINT nRetry_{};
+	ULONGLONG ullFirstFailureMs_{};
+
+public:
+	void SetOptions(const ClipboardOpenRetryOptions& options)
+	{
+		options_ = options;
+	}
+
+	// Records the outcome of an attempt, first or retry. Returns the delay before the next
+	// retry, or 0 when there is none (opened, failed for another reason, or out of retries).
+	DWORD OnAttempt(bool isContended, DWORD dwSequence, ULONGLONG ullNowMs)
+	{
+		++stats_.cAttempts;
+
+		if (!isWaiting_) {
+			if (!isContended or !options_.cRetries) {
+				if (isContended) {
+					++stats_.cContended;
+					++stats_.cGaveUp;
+				}
+				return 0;
+			}
+			++stats_.cContended;
+			isWaiting_ = true;
+			dwSequence_ = dwSequence;
+			ullFirstFailureMs_ = ullNowMs;
+			nRetry_ = 0;
+		}
+		else if (!isContended) {
+			isWaiting_ = false;
+			const ULONGLONG waitMs = ullNowMs - ullFirstFailureMs_;
+			++stats_.cRecovered;
+			stats_.totalWaitMs += waitMs;
+			if (waitMs > stats_.maxWaitMs) { stats_.maxWaitMs = waitMs; }
+			return 0;
+		}
+		else if (nRetry_ >= options_.cRetries) {
+			isWaiting_ = false;
+			++stats_.cGaveUp;
+			return 0;
+		}
+
+		return options_.firstDelayMs << nRetry_++;
+	}
+
+	// Retry timer fired: true if the retry should be made now. False if nothing is pending or
+	// the clipboard changed since (superseded).
+	bool IsRetryDue(DWORD dwCurrentSequence)
+	{
+		if (!isWaiting_) { return false; }
+		if (dwCurrentSequence != dwSequence_) {
+			isWaiting_ = false;
+			++stats_.cSuperseded;
+			return false;
+		}
+		return true;
+	}
+
+	// A newer update arrived; true if a pending retry was dropped for it
+	bool Supersede()
+	{
+		if (!isWaiting_) { return false; }
+		isWaiting_ = false;
+		++stats_.cSuperseded;
+		return true;
+	}
+
+	bool IsWaiting() const
+	{
+		return isWaiting_;
+	}
+
+	ClipboardContentionStats GetStats() const
+	{
+		return stats_;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static ClipboardOpenRetry openRetry;
+
+	// WndProc, processing an update or a due retry
+	const BOOL isOpened = OpenClipboard(NULL);
+	const bool isContended = !isOpened and GetLastError() == ERROR_ACCESS_DENIED;
+	const DWORD dwDelayMs = openRetry.OnAttempt(isContended, GetClipboardSequenceNumber(), GetTickCount64());
+	if (dwDelayMs) { SetTimer(hWnd, IDT_CLIPBOARD_RETRY, dwDelayMs, NULL); }
+
+	case WM_CLIPBOARDUPDATE:
+		if (openRetry.Supersede()) { KillTimer(hWnd, IDT_CLIPBOARD_RETRY); }
+
+	case WM_TIMER:  // IDT_CLIPBOARD_RETRY
+		KillTimer(hWnd, IDT_CLIPBOARD_RETRY);
+		if (openRetry.IsRetryDue(GetClipboardSequenceNumber())) { ProcessClipboard(); }
+
+*/
+
+
+
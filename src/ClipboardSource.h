@@ -0,0 +1,54 @@
+#pragma once
+
+// Implementation-specific headers
+#include "CaptureJob.h"  // Copy target
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Where clipboard updates are read from: the Win32 clipboard in the application, recorded or
+// synthetic events in the replay driver. ClipboardMonitor calls it from one thread, in the
+// order Open, GetOwner, CopyImage, Close; GetOwner and CopyImage only while it is open.
+class ClipboardSource
+{
+public:
+	virtual ~ClipboardSource() = default;
+
+	// Takes the clipboard in a single attempt, without waiting; FALSE with the last error set,
+	// ERROR_ACCESS_DENIED while another process holds it (the caller decides when to retry)
+	virtual BOOL Open() = 0;
+
+	virtual void Close() = 0;
+
+	// Full executable path of the clipboard owner (only its name if the source has no path),
+	// valid until Close; NULL if the owner cannot be identified
+	virtual LPCTSTR GetOwner() = 0;
+
+	// Copies the preferred image format into pJob->buffer and sets nFormat and szFormat (and
+	// dataHash/isDataHashed when the copy hashes); FALSE if there is no image
+	virtual BOOL CopyImage(CaptureJob* pJob) = 0;
+
+};
+
+
+
+
+/*
+Usage example:
+
+	class Win32ClipboardSource : public ClipboardSource
+	{
+	public:
+		BOOL Open() override { return OpenClipboard(NULL); }
+		void Close() override { CloseClipboard(); }
+		LPCTSTR GetOwner() override { return RetrieveClipboardOwner(); }
+		BOOL CopyImage(CaptureJob* pJob) override { return GetClipboardImageData(pJob); }
+	};
+
+*/
+
+
+
@@ -0,0 +1,724 @@
+// Implementation-specific headers
+#include "ContentHash.h"
+
+// Standard library headers
+#include <cstring>    // memcpy
+#include <algorithm>  // min
+#include <atomic>     // Leaf counter, selected kernels
+#include <thread>     // Leaf workers
+
+// SIMD intrinsics
+#if defined(_M_X64) or defined(_M_IX86) or defined(__x86_64__) or defined(__i386__)
+#define CONTENT_HASH_X86 1
+#include <immintrin.h>
+#endif
+#if defined(_M_X64) or defined(__SSE2__) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define CONTENT_HASH_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// AVX2 functions are compiled for AVX2 individually and only called after the runtime check
+#if CONTENT_HASH_X86 and (defined(__GNUC__) or defined(__clang__))
+#define CONTENT_HASH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CONTENT_HASH_TARGET_AVX2
+#endif
+
+
+
+// Anonymous namespace for the XXH3 primitives and per-ISA stripe loops
+namespace
+{
+	constexpr uint32_t kPrime32_1 = 0x9E3779B1U;
+	constexpr uint32_t kPrime32_2 = 0x85EBCA77U;
+	constexpr uint32_t kPrime32_3 = 0xC2B2AE3DU;
+	constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+	constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+	constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+	constexpr uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+	constexpr uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+	constexpr size_t kStripeSize = 64;
+	constexpr size_t kSecretSize = 192;
+	constexpr size_t kStripesPerBlock = (kSecretSize - kStripeSize) / 8;
+	constexpr size_t kMidSizeMax = 240;
+	constexpr size_t kMaxThreads = 16;
+	constexpr size_t kCopyChunk = 64 * 1024;  // Fits in L2 between the copy and the hash
+
+	alignas(64) constexpr uint8_t kSecret[kSecretSize] = {
+		0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+		0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+		0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+		0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+		0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+		0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+		0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+		0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+		0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+		0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+		0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+		0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+	};
+
+	inline uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Read64(const uint8_t* p)
+	{
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline void Write64(uint8_t* p, uint64_t value)
+	{
+		memcpy(p, &value, sizeof(value));
+	}
+
+	inline uint32_t Swap32(uint32_t x)
+	{
+		return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+	}
+
+	inline uint64_t Swap64(uint64_t x)
+	{
+		return ((uint64_t)Swap32((uint32_t)x) << 32) | Swap32((uint32_t)(x >> 32));
+	}
+
+	inline uint32_t Rotl32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+	inline uint64_t Rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	inline uint64_t XorShift(uint64_t x, int shift) { return x ^ (x >> shift); }
+
+	inline Hash128 Multiply128(uint64_t a, uint64_t b)
+	{
+#if defined(_MSC_VER) and defined(_M_X64)
+		Hash128 product;
+		product.low = _umul128(a, b, &product.high);
+		return product;
+#elif defined(__SIZEOF_INT128__)
+		const unsigned __int128 product = (unsigned __int128)a * b;
+		return { (uint64_t)product, (uint64_t)(product >> 64) };
+#else
+		const uint64_t loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+		const uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+		const uint64_t loHi = (a & 0xFFFFFFFF) * (b >> 32);
+		const uint64_t hiHi = (a >> 32) * (b >> 32);
+		const uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+		return { (cross << 32) | (loLo & 0xFFFFFFFF), (hiLo >> 32) + (cross >> 32) + hiHi };
+#endif
+	}
+
+	inline uint64_t MultiplyFold64(uint64_t a, uint64_t b)
+	{
+		const Hash128 product = Multiply128(a, b);
+		return product.low ^ product.high;
+	}
+
+	inline uint64_t Xxh64Avalanche(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= kPrime64_2;
+		h ^= h >> 29;
+		h *= kPrime64_3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	inline uint64_t Avalanche(uint64_t h)
+	{
+		h = XorShift(h, 37);
+		h *= kPrimeMx1;
+		return XorShift(h, 32);
+	}
+
+	inline uint64_t RrmxmxAvalanche(uint64_t h, uint64_t cbSize)
+	{
+		h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+		h *= kPrimeMx2;
+		h ^= (h >> 35) + cbSize;
+		h *= kPrimeMx2;
+		return XorShift(h, 28);
+	}
+
+	inline uint64_t Mix16(const uint8_t* p, const uint8_t* pSecret)
+	{
+		return MultiplyFold64(Read64(p) ^ Read64(pSecret), Read64(p + 8) ^ Read64(pSecret + 8));
+	}
+
+	inline Hash128 Mix32(Hash128 acc, const uint8_t* p1, const uint8_t* p2, const uint8_t* pSecret)
+	{
+		acc.low += Mix16(p1, pSecret);
+		acc.low ^= Read64(p2) + Read64(p2 + 8);
+		acc.high += Mix16(p2, pSecret + 16);
+		acc.high ^= Read64(p1) + Read64(p1 + 8);
+		return acc;
+	}
+
+	uint64_t MergeAccumulators(const uint64_t* pAcc, const uint8_t* pSecret, uint64_t start)
+	{
+		uint64_t result = start;
+		for (size_t i{}; i < 4; ++i) {
+			result += MultiplyFold64(pAcc[2 * i] ^ Read64(pSecret + 16 * i), pAcc[2 * i + 1] ^ Read64(pSecret + 16 * i + 8));
+		}
+		return Avalanche(result);
+	}
+
+	// Short inputs (0 to 240 bytes) are hashed directly
+
+	uint64_t Short64(const uint8_t* p, size_t cbSize)
+	{
+		if (cbSize > 128) {
+			uint64_t acc = cbSize * kPrime64_1;
+			const size_t cRounds = cbSize / 16;
+			for (size_t i{}; i < 8; ++i) { acc += Mix16(p + 16 * i, kSecret + 16 * i); }
+			acc = Avalanche(acc);
+			for (size_t i = 8; i < cRounds; ++i) { acc += Mix16(p + 16 * i, kSecret + 16 * (i - 8) + 3); }
+			acc += Mix16(p + cbSize - 16, kSecret + 136 - 17);
+			return Avalanche(acc);
+		}
+		if (cbSize > 16) {
+			uint64_t acc = cbSize * kPrime64_1;
+			if (cbSize > 32) {
+				if (cbSize > 64) {
+					if (cbSize > 96) {
+						acc += Mix16(p + 48, kSecret + 96);
+						acc += Mix16(p + cbSize - 64, kSecret + 112);
+					}
+					acc += Mix16(p + 32, kSecret + 64);
+					acc += Mix16(p + cbSize - 48, kSecret + 80);
+				}
+				acc += Mix16(p + 16, kSecret + 32);
+				acc += Mix16(p + cbSize - 32, kSecret + 48);
+			}
+			acc += Mix16(p, kSecret);
+			acc += Mix16(p + cbSize - 16, kSecret + 16);
+			return Avalanche(acc);
+		}
+		if (cbSize > 8) {
+			const uint64_t inputLow = Read64(p) ^ (Read64(kSecret + 24) ^ Read64(kSecret + 32));
+			const uint64_t inputHigh = Read64(p + cbSize - 8) ^ (Read64(kSecret + 40) ^ Read64(kSecret + 48));
+			const uint64_t acc = cbSize + Swap64(inputLow) + inputHigh + MultiplyFold64(inputLow, inputHigh);
+			return Avalanche(acc);
+		}
+		if (cbSize >= 4) {
+			const uint64_t input = Read32(p + cbSize - 4) + ((uint64_t)Read32(p) << 32);
+			const uint64_t keyed = input ^ (Read64(kSecret + 8) ^ Read64(kSecret + 16));
+			return RrmxmxAvalanche(keyed, cbSize);
+		}
+		if (cbSize) {
+			const uint32_t combined = ((uint32_t)p[0] << 16) | ((uint32_t)p[cbSize >> 1] << 24) |
+				(uint32_t)p[cbSize - 1] | ((uint32_t)cbSize << 8);
+			return Xxh64Avalanche(combined ^ (uint64_t)(Read32(kSecret) ^ Read32(kSecret + 4)));
+		}
+		return Xxh64Avalanche(Read64(kSecret + 56) ^ Read64(kSecret + 64));
+	}
+
+	Hash128 Finish128Mixed(Hash128 acc, uint64_t cbSize)
+	{
+		Hash128 h;
+		h.low = Avalanche(acc.low + acc.high);
+		h.high = 0 - Avalanche(acc.low * kPrime64_1 + acc.high * kPrime64_4 + cbSize * kPrime64_2);
+		return h;
+	}
+
+	Hash128 Short128(const uint8_t* p, size_t cbSize)
+	{
+		if (cbSize > 128) {
+			Hash128 acc{ cbSize * kPrime64_1, 0 };
+			const size_t cRounds = cbSize / 32;
+			for (size_t i{}; i < 4; ++i) { acc = Mix32(acc, p + 32 * i, p + 32 * i + 16, kSecret + 32 * i); }
+			acc.low = Avalanche(acc.low);
+			acc.high = Avalanche(acc.high);
+			for (size_t i = 4; i < cRounds; ++i) {
+				acc = Mix32(acc, p + 32 * i, p + 32 * i + 16, kSecret + 3 + 32 * (i - 4));
+			}
+			acc = Mix32(acc, p + cbSize - 16, p + cbSize - 32, kSecret + 136 - 17 - 16);
+			return Finish128Mixed(acc, cbSize);
+		}
+		if (cbSize > 16) {
+			Hash128 acc{ cbSize * kPrime64_1, 0 };
+			if (cbSize > 32) {
+				if (cbSize > 64) {
+					if (cbSize > 96) { acc = Mix32(acc, p + 48, p + cbSize - 64, kSecret + 96); }
+					acc = Mix32(acc, p + 32, p + cbSize - 48, kSecret + 64);
+				}
+				acc = Mix32(acc, p + 16, p + cbSize - 32, kSecret + 32);
+			}
+			acc = Mix32(acc, p, p + cbSize - 16, kSecret);
+			return Finish128Mixed(acc, cbSize);
+		}
+		if (cbSize > 8) {
+			const uint64_t bitflipLow = Read64(kSecret + 32) ^ Read64(kSecret + 40);
+			const uint64_t bitflipHigh = Read64(kSecret + 48) ^ Read64(kSecret + 56);
+			const uint64_t inputLow = Read64(p);
+			uint64_t inputHigh = Read64(p + cbSize - 8);
+			Hash128 m = Multiply128(inputLow ^ inputHigh ^ bitflipLow, kPrime64_1);
+			m.low += (uint64_t)(cbSize - 1) << 54;
+			inputHigh ^= bitflipHigh;
+			m.high += inputHigh + (uint64_t)(uint32_t)inputHigh * (kPrime32_2 - 1);
+			m.low ^= Swap64(m.high);
+			Hash128 h = Multiply128(m.low, kPrime64_2);
+			h.high += m.high * kPrime64_2;
+			return { Avalanche(h.low), Avalanche(h.high) };
+		}
+		if (cbSize >= 4) {
+			const uint64_t input = Read32(p) + ((uint64_t)Read32(p + cbSize - 4) << 32);
+			const uint64_t keyed = input ^ (Read64(kSecret + 16) ^ Read64(kSecret + 24));
+			Hash128 m = Multiply128(keyed, kPrime64_1 + (cbSize << 2));
+			m.high += m.low << 1;
+			m.low ^= m.high >> 3;
+			m.low = XorShift(m.low, 35);
+			m.low *= kPrimeMx2;
+			m.low = XorShift(m.low, 28);
+			m.high = Avalanche(m.high);
+			return m;
+		}
+		if (cbSize) {
+			const uint32_t combinedLow = ((uint32_t)p[0] << 16) | ((uint32_t)p[cbSize >> 1] << 24) |
+				(uint32_t)p[cbSize - 1] | ((uint32_t)cbSize << 8);
+			const uint32_t combinedHigh = Rotl32(Swap32(combinedLow), 13);
+			const uint64_t bitflipLow = Read32(kSecret) ^ Read32(kSecret + 4);
+			const uint64_t bitflipHigh = Read32(kSecret + 8) ^ Read32(kSecret + 12);
+			return { Xxh64Avalanche(combinedLow ^ bitflipLow), Xxh64Avalanche(combinedHigh ^ bitflipHigh) };
+		}
+		return { Xxh64Avalanche(Read64(kSecret + 64) ^ Read64(kSecret + 72)),
+			Xxh64Avalanche(Read64(kSecret + 80) ^ Read64(kSecret + 88)) };
+	}
+
+	// Stripe loop kernels: accumulate cStripes consecutive stripes with the secret advancing
+	// 8 bytes per stripe, and scramble the accumulators at a block boundary
+
+	struct Xxh3Kernels
+	{
+		PixelIsa isa;
+		void (*pfnAccumulate)(uint64_t* pAcc, const uint8_t* pStripes, const uint8_t* pSecret, size_t cStripes);
+		void (*pfnScramble)(uint64_t* pAcc, const uint8_t* pSecret);
+	};
+
+	void AccumulateScalar(uint64_t* pAcc, const uint8_t* pStripes, const uint8_t* pSecret, size_t cStripes)
+	{
+		for (size_t n{}; n < cStripes; ++n, pStripes += kStripeSize, pSecret += 8) {
+			for (size_t i{}; i < 8; ++i) {
+				const uint64_t data = Read64(pStripes + 8 * i);
+				const uint64_t key = data ^ Read64(pSecret + 8 * i);
+				pAcc[i ^ 1] += data;
+				pAcc[i] += (uint64_t)(uint32_t)key * (key >> 32);
+			}
+		}
+	}
+
+	void ScrambleScalar(uint64_t* pAcc, const uint8_t* pSecret)
+	{
+		for (size_t i{}; i < 8; ++i) {
+			uint64_t acc = XorShift(pAcc[i], 47);
+			acc ^= Read64(pSecret + 8 * i);
+			pAcc[i] = acc * kPrime32_1;
+		}
+	}
+
+	constexpr Xxh3Kernels kScalarKernels{ PixelIsa::Scalar, AccumulateScalar, ScrambleScalar };
+
+
+#if CONTENT_HASH_SSE2
+	void AccumulateSSE2(uint64_t* pAcc, const uint8_t* pStripes, const uint8_t* pSecret, size_t cStripes)
+	{
+		__m128i acc[4];
+		for (size_t i{}; i < 4; ++i) { acc[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAcc) + i); }
+
+		for (size_t n{}; n < cStripes; ++n, pStripes += kStripeSize, pSecret += 8) {
+			for (size_t i{}; i < 4; ++i) {
+				const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pStripes) + i);
+				const __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSecret) + i));
+				const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+				const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+				acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+			}
+		}
+
+		for (size_t i{}; i < 4; ++i) { _mm_storeu_si128(reinterpret_cast<__m128i*>(pAcc) + i, acc[i]); }
+	}
+
+	void ScrambleSSE2(uint64_t* pAcc, const uint8_t* pSecret)
+	{
+		const __m128i prime = _mm_set1_epi32((int)kPrime32_1);
+		for (size_t i{}; i < 4; ++i) {
+			__m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAcc) + i);
+			acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+			acc = _mm_xor_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSecret) + i));
+			const __m128i productLow = _mm_mul_epu32(acc, prime);
+			const __m128i productHigh = _mm_mul_epu32(_mm_shuffle_epi32(acc, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pAcc) + i, _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32)));
+		}
+	}
+
+	constexpr Xxh3Kernels kSSE2Kernels{ PixelIsa::SSE2, AccumulateSSE2, ScrambleSSE2 };
+#endif
+
+
+#if CONTENT_HASH_X86
+	CONTENT_HASH_TARGET_AVX2
+	void AccumulateAVX2(uint64_t* pAcc, const uint8_t* pStripes, const uint8_t* pSecret, size_t cStripes)
+	{
+		__m256i acc[2];
+		for (size_t i{}; i < 2; ++i) { acc[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pAcc) + i); }
+
+		for (size_t n{}; n < cStripes; ++n, pStripes += kStripeSize, pSecret += 8) {
+			for (size_t i{}; i < 2; ++i) {
+				const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pStripes) + i);
+				const __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSecret) + i));
+				const __m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+				const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+				acc[i] = _mm256_add_epi64(acc[i], _mm256_add_epi64(product, swapped));
+			}
+		}
+
+		for (size_t i{}; i < 2; ++i) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(pAcc) + i, acc[i]); }
+	}
+
+	CONTENT_HASH_TARGET_AVX2
+	void ScrambleAVX2(uint64_t* pAcc, const uint8_t* pSecret)
+	{
+		const __m256i prime = _mm256_set1_epi32((int)kPrime32_1);
+		for (size_t i{}; i < 2; ++i) {
+			__m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pAcc) + i);
+			acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47));
+			acc = _mm256_xor_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSecret) + i));
+			const __m256i productLow = _mm256_mul_epu32(acc, prime);
+			const __m256i productHigh = _mm256_mul_epu32(_mm256_shuffle_epi32(acc, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pAcc) + i, _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32)));
+		}
+	}
+
+	constexpr Xxh3Kernels kAVX2Kernels{ PixelIsa::AVX2, AccumulateAVX2, ScrambleAVX2 };
+#endif
+
+
+	const Xxh3Kernels* GetKernels(PixelIsa isa)
+	{
+		if (!PixelConvert::IsSupported(isa)) { return nullptr; }
+
+		switch (isa) {
+		case PixelIsa::Scalar: return &kScalarKernels;
+#if CONTENT_HASH_SSE2
+		case PixelIsa::SSE2: return &kSSE2Kernels;
+#endif
+#if CONTENT_HASH_X86
+		case PixelIsa::AVX2: return &kAVX2Kernels;
+#endif
+		default: return nullptr;
+		}
+	}
+
+	const Xxh3Kernels* SelectBestKernels()
+	{
+		const PixelIsa preferred[] = { PixelIsa::AVX2, PixelIsa::SSE2 };
+		for (PixelIsa isa : preferred) {
+			if (const Xxh3Kernels* pKernels = GetKernels(isa)) { return pKernels; }
+		}
+		return &kScalarKernels;
+	}
+
+	std::atomic<const Xxh3Kernels*> g_pKernels{ SelectBestKernels() };
+
+	void StoreDigest(uint8_t* p, const Hash128& hash)
+	{
+		Write64(p, hash.low);
+		Write64(p + 8, hash.high);
+	}
+
+	// XXH3-128 of one tree leaf, copying it first when pCopyTo is set
+	Hash128 HashLeaf(const uint8_t* pData, size_t cbSize, uint8_t* pCopyTo)
+	{
+		Xxh3Stream stream;
+		if (!pCopyTo) {
+			stream.Update(pData, cbSize);
+			return stream.Finish128();
+		}
+		for (size_t cbOffset{}; cbOffset < cbSize; cbOffset += kCopyChunk) {
+			const size_t cbPart = std::min(kCopyChunk, cbSize - cbOffset);
+			memcpy(pCopyTo + cbOffset, pData + cbOffset, cbPart);
+			stream.Update(pCopyTo + cbOffset, cbPart);
+		}
+		return stream.Finish128();
+	}
+
+	// Root of the tree: XXH3 over the leaf digests and the total size
+	Hash128 HashRoot(HashAlgorithm algorithm, std::vector<uint8_t>* pLeaves, uint64_t cbTotal)
+	{
+		uint8_t size[8];
+		Write64(size, cbTotal);
+		pLeaves->insert(pLeaves->end(), size, size + sizeof(size));
+
+		Xxh3Stream stream;
+		stream.Update(pLeaves->data(), pLeaves->size());
+		if (algorithm == HashAlgorithm::Xxh3_128) { return stream.Finish128(); }
+		return { stream.Finish64(), 0 };
+	}
+}
+
+
+
+// Xxh3Stream
+
+void Xxh3Stream::Reset()
+{
+	const uint64_t initial[8] = { kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1 };
+	memcpy(acc_, initial, sizeof(acc_));
+	cbBuffered_ = 0;
+	cStripesInBlock_ = 0;
+	cbTotal_ = 0;
+}
+
+void Xxh3Stream::ConsumeStripes(uint64_t* pAcc, size_t* pcStripesInBlock, const uint8_t* pStripes, size_t cStripes)
+{
+	const Xxh3Kernels* pKernels = g_pKernels.load(std::memory_order_relaxed);
+	while (cStripes) {
+		const size_t cBatch = std::min(cStripes, kStripesPerBlock - *pcStripesInBlock);
+		pKernels->pfnAccumulate(pAcc, pStripes, kSecret + *pcStripesInBlock * 8, cBatch);
+		pStripes += cBatch * kStripeSize;
+		cStripes -= cBatch;
+		*pcStripesInBlock += cBatch;
+		if (*pcStripesInBlock == kStripesPerBlock) {
+			pKernels->pfnScramble(pAcc, kSecret + kSecretSize - kStripeSize);
+			*pcStripesInBlock = 0;
+		}
+	}
+}
+
+void Xxh3Stream::Update(const void* pData, size_t cbSize)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pData);
+	cbTotal_ += cbSize;
+
+	if (cbBuffered_ + cbSize <= kBufferSize) {
+		memcpy(buffer_ + cbBuffered_, p, cbSize);
+		cbBuffered_ += cbSize;
+		return;
+	}
+
+	// More input follows, so a full buffer can be consumed (the last byte is always kept back)
+	if (cbBuffered_) {
+		const size_t cbFill = kBufferSize - cbBuffered_;
+		memcpy(buffer_ + cbBuffered_, p, cbFill);
+		p += cbFill;
+		cbSize -= cbFill;
+		ConsumeStripes(acc_, &cStripesInBlock_, buffer_, kBufferSize / kStripeSize);
+		cbBuffered_ = 0;
+	}
+
+	if (cbSize > kBufferSize) {
+		const size_t cStripes = (cbSize - 1) / kStripeSize;
+		ConsumeStripes(acc_, &cStripesInBlock_, p, cStripes);
+		p += cStripes * kStripeSize;
+		cbSize -= cStripes * kStripeSize;
+		// The final stripe may reach back into data that was already consumed
+		memcpy(buffer_ + kBufferSize - kStripeSize, p - kStripeSize, kStripeSize);
+	}
+
+	memcpy(buffer_, p, cbSize);
+	cbBuffered_ = cbSize;
+}
+
+void Xxh3Stream::FinishLong(uint64_t* pAcc) const
+{
+	memcpy(pAcc, acc_, sizeof(acc_));
+	size_t cStripesInBlock = cStripesInBlock_;
+
+	uint8_t lastStripe[kStripeSize];
+	const uint8_t* pLastStripe = lastStripe;
+	if (cbBuffered_ >= kStripeSize) {
+		const size_t cStripes = (cbBuffered_ - 1) / kStripeSize;
+		ConsumeStripes(pAcc, &cStripesInBlock, buffer_, cStripes);
+		pLastStripe = buffer_ + cbBuffered_ - kStripeSize;
+	}
+	else {
+		const size_t cbCatchUp = kStripeSize - cbBuffered_;
+		memcpy(lastStripe, buffer_ + kBufferSize - cbCatchUp, cbCatchUp);
+		memcpy(lastStripe + cbCatchUp, buffer_, cbBuffered_);
+	}
+	g_pKernels.load(std::memory_order_relaxed)->pfnAccumulate(pAcc, pLastStripe, kSecret + kSecretSize - kStripeSize - 7, 1);
+}
+
+uint64_t Xxh3Stream::Finish64() const
+{
+	if (cbTotal_ <= kMidSizeMax) { return Short64(buffer_, (size_t)cbTotal_); }
+
+	alignas(64) uint64_t acc[8];
+	FinishLong(acc);
+	return MergeAccumulators(acc, kSecret + 11, cbTotal_ * kPrime64_1);
+}
+
+Hash128 Xxh3Stream::Finish128() const
+{
+	if (cbTotal_ <= kMidSizeMax) { return Short128(buffer_, (size_t)cbTotal_); }
+
+	alignas(64) uint64_t acc[8];
+	FinishLong(acc);
+	return { MergeAccumulators(acc, kSecret + 11, cbTotal_ * kPrime64_1),
+		MergeAccumulators(acc, kSecret + kSecretSize - kStripeSize - 11, ~(cbTotal_ * kPrime64_2)) };
+}
+
+
+
+// ContentHasher
+
+void ContentHasher::Reset(HashAlgorithm algorithm, uint64_t cbTotal)
+{
+	algorithm_ = algorithm;
+	isTree_ = algorithm != HashAlgorithm::Murmur3_32 and cbTotal >= ContentHash::kTreeMinSize;
+	murmur_ = MurmurHash3Stream{};
+	xxh3_.Reset();
+	cbLeaf_ = 0;
+	leaves_.clear();
+}
+
+void ContentHasher::Update(const void* pData, size_t cbSize)
+{
+	if (algorithm_ == HashAlgorithm::Murmur3_32) {
+		murmur_.Update(pData, cbSize);
+		return;
+	}
+	if (!isTree_) {
+		xxh3_.Update(pData, cbSize);
+		return;
+	}
+
+	const uint8_t* p = static_cast<const uint8_t*>(pData);
+	while (cbSize) {
+		const size_t cbPart = std::min(cbSize, ContentHash::kTreeLeafSize - cbLeaf_);
+		xxh3_.Update(p, cbPart);
+		p += cbPart;
+		cbSize -= cbPart;
+		cbLeaf_ += cbPart;
+		if (cbLeaf_ == ContentHash::kTreeLeafSize) {
+			leaves_.resize(leaves_.size() + sizeof(Hash128));
+			StoreDigest(leaves_.data() + leaves_.size() - sizeof(Hash128), xxh3_.Finish128());
+			xxh3_.Reset();
+			cbLeaf_ = 0;
+		}
+	}
+}
+
+Hash128 ContentHasher::Finish()
+{
+	switch (algorithm_) {
+	case HashAlgorithm::Murmur3_32:
+		return { murmur_.Finish(), 0 };
+	case HashAlgorithm::Xxh3_128:
+		if (!isTree_) { return xxh3_.Finish128(); }
+		break;
+	default:
+		if (!isTree_) { return { xxh3_.Finish64(), 0 }; }
+		break;
+	}
+
+	const uint64_t cbTotal = (uint64_t)(leaves_.size() / sizeof(Hash128)) * ContentHash::kTreeLeafSize + cbLeaf_;
+	if (cbLeaf_) {
+		leaves_.resize(leaves_.size() + sizeof(Hash128));
+		StoreDigest(leaves_.data() + leaves_.size() - sizeof(Hash128), xxh3_.Finish128());
+		xxh3_.Reset();
+		cbLeaf_ = 0;
+	}
+	return HashRoot(algorithm_, &leaves_, cbTotal);
+}
+
+
+
+// ContentHash
+
+Hash128 ContentHash::Compute(HashAlgorithm algorithm, const void* pData, size_t cbSize, unsigned cThreads, void* pCopyTo)
+{
+	const uint8_t* pFrom = static_cast<const uint8_t*>(pData);
+	uint8_t* pTo = static_cast<uint8_t*>(pCopyTo);
+
+	// Sequential layouts: hash each chunk right after copying it
+	if (algorithm == HashAlgorithm::Murmur3_32 or cbSize < kTreeMinSize) {
+		ContentHasher hasher(algorithm, cbSize);
+		if (!pTo) {
+			hasher.Update(pFrom, cbSize);
+			return hasher.Finish();
+		}
+		for (size_t cbOffset{}; cbOffset < cbSize; cbOffset += kCopyChunk) {
+			const size_t cbPart = std::min(kCopyChunk, cbSize - cbOffset);
+			memcpy(pTo + cbOffset, pFrom + cbOffset, cbPart);
+			hasher.Update(pTo + cbOffset, cbPart);
+		}
+		return hasher.Finish();
+	}
+
+	// Tree layout: threads take leaves in order from a shared counter
+	const size_t cLeaves = (cbSize + kTreeLeafSize - 1) / kTreeLeafSize;
+	std::vector<uint8_t> leaves(cLeaves * sizeof(Hash128));
+
+	if (!cThreads) { cThreads = std::thread::hardware_concurrency(); }
+	const size_t cWorkers = std::max<size_t>(1, std::min<size_t>({ (size_t)cThreads, cLeaves, kMaxThreads }));
+
+	std::atomic<size_t> nextLeaf{};
+	auto worker = [&]() {
+		for (size_t i = nextLeaf++; i < cLeaves; i = nextLeaf++) {
+			const size_t cbOffset = i * kTreeLeafSize;
+			const size_t cbLeaf = std::min(kTreeLeafSize, cbSize - cbOffset);
+			StoreDigest(leaves.data() + i * sizeof(Hash128), HashLeaf(pFrom + cbOffset, cbLeaf, pTo ? pTo + cbOffset : nullptr));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(cWorkers - 1);
+	for (size_t i = 1; i < cWorkers; ++i) { threads.emplace_back(worker); }
+	worker();
+	for (std::thread& thread : threads) { thread.join(); }
+
+	return HashRoot(algorithm, &leaves, cbSize);
+}
+
+uint64_t ContentHash::ToDedupKey(HashAlgorithm algorithm, const Hash128& hash, size_t cbSize)
+{
+	if (algorithm == HashAlgorithm::Murmur3_32) { return (hash.low << 32) | (uint32_t)cbSize; }
+	return hash.low;
+}
+
+uint64_t ContentHash::Sample(const void* pData, size_t cbSize)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pData);
+	uint8_t size[8]{};
+	for (int i{}; i < 8; ++i) { size[i] = (uint8_t)((uint64_t)cbSize >> (i * 8)); }
+
+	Xxh3Stream stream;
+	stream.Update(size, sizeof(size));
+	if (cbSize <= kSampleBlocks * kSampleBlockSize) {
+		stream.Update(p, cbSize);
+		return stream.Finish64();
+	}
+
+	// First and last blocks included, the rest spread evenly in between
+	const size_t cbSpan = cbSize - kSampleBlockSize;
+	for (size_t i{}; i < kSampleBlocks; ++i) {
+		stream.Update(p + (size_t)((uint64_t)cbSpan * i / (kSampleBlocks - 1)), kSampleBlockSize);
+	}
+	return stream.Finish64();
+}
+
+PixelIsa ContentHash::GetIsa()
+{
+	return g_pKernels.load(std::memory_order_relaxed)->isa;
+}
+
+bool ContentHash::SelectIsa(PixelIsa isa)
+{
+	const Xxh3Kernels* pKernels = GetKernels(isa);
+	if (!pKernels) { return false; }
+	g_pKernels.store(pKernels, std::memory_order_relaxed);
+	return true;
+}
+
+
+
+
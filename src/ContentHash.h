@@ -0,0 +1,148 @@
+#pragma once
+
+// Implementation-specific headers
+#include "PixelConvert.h"       // PixelIsa (instruction set selection)
+#include "MurmurHash3Stream.h"  // Legacy 32-bit hash
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Tree leaf digests
+
+
+
+// Content hash used for the duplicate key. The values are persisted in the dedup index,
+// so the numbering must stay stable.
+enum class HashAlgorithm : unsigned
+{
+	Murmur3_32 = 0,  // Legacy key, kept for existing indexes
+	Xxh3_64 = 1,
+	Xxh3_128 = 2
+};
+
+
+
+// 128-bit digest; 32- and 64-bit algorithms only fill low
+struct Hash128
+{
+	uint64_t low;
+	uint64_t high;
+
+	bool operator==(const Hash128& other) const { return low == other.low and high == other.high; }
+	bool operator!=(const Hash128& other) const { return !(*this == other); }
+};
+
+
+
+// Streaming XXH3 (64- and 128-bit, default secret, seed 0). Feeding the data in any number
+// of pieces yields the reference XXH3_64bits / XXH3_128bits value of the whole buffer.
+class Xxh3Stream
+{
+private:
+	static constexpr size_t kBufferSize = 256;  // Four stripes
+
+	alignas(64) uint64_t acc_[8];
+	alignas(64) uint8_t buffer_[kBufferSize];
+	size_t cbBuffered_{};
+	size_t cStripesInBlock_{};
+	uint64_t cbTotal_{};
+
+private:
+	// Accumulates whole stripes, scrambling at every block boundary
+	static void ConsumeStripes(uint64_t* pAcc, size_t* pcStripesInBlock, const uint8_t* pStripes, size_t cStripes);
+
+	// Accumulator state after the buffered tail, for inputs longer than 240 bytes
+	void FinishLong(uint64_t* pAcc) const;
+
+public:
+	Xxh3Stream() { Reset(); }
+
+	void Reset();
+	void Update(const void* pData, size_t cbSize);
+	uint64_t Finish64() const;
+	Hash128 Finish128() const;
+
+};
+
+
+
+// Streaming hasher for any HashAlgorithm. Payloads of ContentHash::kTreeMinSize bytes or more
+// are hashed as a tree for the XXH3 algorithms, so the total size has to be known up front;
+// ContentHash::Compute produces the same value on several threads.
+class ContentHasher
+{
+private:
+	HashAlgorithm algorithm_{ HashAlgorithm::Xxh3_64 };
+	bool isTree_{};
+	MurmurHash3Stream murmur_;
+	Xxh3Stream xxh3_;
+	size_t cbLeaf_{};                 // Bytes in the current tree leaf
+	std::vector<uint8_t> leaves_;     // Finished leaf digests, 16 bytes each
+
+public:
+	explicit ContentHasher(HashAlgorithm algorithm = HashAlgorithm::Xxh3_64, uint64_t cbTotal = 0)
+	{
+		Reset(algorithm, cbTotal);
+	}
+
+	void Reset(HashAlgorithm algorithm, uint64_t cbTotal);
+	void Update(const void* pData, size_t cbSize);
+	Hash128 Finish();
+
+};
+
+
+
+// Content hashing front end.
+// XXH3 runs its stripe loop with SSE2 or AVX2 when available (bit-identical to the scalar
+// loop). Payloads of kTreeMinSize bytes or more are split into kTreeLeafSize leaves that are
+// hashed with XXH3-128 independently; the result is the XXH3 of the leaf digests followed by
+// the 64-bit little-endian size. That value differs from flat XXH3 of the same bytes, but it
+// is the same whether the leaves were hashed on one thread or many.
+namespace ContentHash
+{
+	constexpr size_t kTreeLeafSize = 1 << 20;
+	constexpr size_t kTreeMinSize = 8 << 20;
+
+	// Hashes a buffer, spreading tree leaves over up to cThreads threads (0 = one per logical
+	// processor). When pCopyTo is set the data is copied there chunk by chunk as it is hashed.
+	Hash128 Compute(HashAlgorithm algorithm, const void* pData, size_t cbSize, unsigned cThreads = 1, void* pCopyTo = nullptr);
+
+	// 64-bit dedup index key. Murmur3 keeps the legacy (hash << 32 | size) layout.
+	uint64_t ToDedupKey(HashAlgorithm algorithm, const Hash128& hash, size_t cbSize);
+
+	// Set in the dedup index key kind when the index has a sample-key companion
+	constexpr uint64_t kSampledKeyKindFlag = 0x200;
+	constexpr size_t kSampleBlocks = 64;
+	constexpr size_t kSampleBlockSize = 64;
+
+	// XXH3-64 of the size and kSampleBlocks evenly spaced blocks (the whole payload when it is
+	// smaller). Equal payloads always have equal samples, so a sample never seen before proves
+	// the payload is new without reading all of it.
+	uint64_t Sample(const void* pData, size_t cbSize);
+
+	// Instruction set of the XXH3 stripe loop; Select is meant for benchmarks and tests
+	PixelIsa GetIsa();
+	bool SelectIsa(PixelIsa isa);
+}
+
+
+
+
+/*
+Usage example:
+
+	// Copy a clipboard payload and hash it on all cores
+	Hash128 hash = ContentHash::Compute(HashAlgorithm::Xxh3_64, pGlobal, cbSize, 0, pPrivateCopy);
+	UINT64 qwKey = ContentHash::ToDedupKey(HashAlgorithm::Xxh3_64, hash, cbSize);
+
+	// Incremental, same value
+	ContentHasher hasher(HashAlgorithm::Xxh3_64, cbSize);
+	hasher.Update(pFirst, cbFirst);
+	hasher.Update(pSecond, cbSecond);
+	Hash128 sameHash = hasher.Finish();
+
+*/
+
+
+
@@ -0,0 +1,374 @@
+// Implementation-specific headers
+#include "DIBDecoder.h"
+
+// Standard library headers
+#include <cstring>      // memcpy, memset
+#include <climits>      // LONG_MIN
+#include <new>          // bad_alloc
+#include <type_traits>  // conditional_t
+
+
+
+// Anonymous namespace for internal constants
+namespace
+{
+	constexpr uint64_t kMaxPixels = (uint64_t)1 << 28;  // 1 GB as RGBA
+
+	// 5/6-bit channel widened by bit replication
+	inline uint8_t Expand5(unsigned v) { return (uint8_t)((v << 3) | (v >> 2)); }
+	inline uint8_t Expand6(unsigned v) { return (uint8_t)((v << 2) | (v >> 4)); }
+
+	inline unsigned CountTrailingZeros(DWORD dwValue)
+	{
+		unsigned n{};
+		while (!(dwValue & 1)) { dwValue >>= 1; ++n; }
+		return n;
+	}
+}
+
+
+
+template<DIBFormat Format, bool IsTopDown>
+void DIBDecoder::DecodeRow(const DIBDecoder& decoder, uint32_t y, uint8_t* pRow)
+{
+	const BYTE* pSrc = decoder.pPixels_ + (size_t)(IsTopDown ? y : decoder.nHeight_ - 1 - y) * decoder.cbStride_;
+	const UINT nWidth = decoder.nWidth_;
+
+	if constexpr (Format == DIBFormat::Palette1) {
+		for (UINT x{}; x < nWidth; ++x, pRow += 3) {
+			memcpy(pRow, decoder.palette_[(pSrc[x >> 3] >> (7 - (x & 7))) & 1], 3);
+		}
+	}
+	else if constexpr (Format == DIBFormat::Palette4) {
+		for (UINT x{}; x < nWidth; ++x, pRow += 3) {
+			memcpy(pRow, decoder.palette_[(pSrc[x >> 1] >> (x & 1 ? 0 : 4)) & 0x0F], 3);
+		}
+	}
+	else if constexpr (Format == DIBFormat::Palette8) {
+		for (UINT x{}; x < nWidth; ++x, pRow += 3) {
+			memcpy(pRow, decoder.palette_[pSrc[x]], 3);
+		}
+	}
+	else if constexpr (Format == DIBFormat::Rgb555 or Format == DIBFormat::Rgb565) {
+		for (UINT x{}; x < nWidth; ++x, pRow += 3) {
+			WORD wPixel;
+			memcpy(&wPixel, pSrc + x * 2, sizeof(wPixel));
+			if constexpr (Format == DIBFormat::Rgb555) {
+				pRow[0] = Expand5((wPixel >> 10) & 0x1F);
+				pRow[1] = Expand5((wPixel >> 5) & 0x1F);
+			}
+			else {
+				pRow[0] = Expand5(wPixel >> 11);
+				pRow[1] = Expand6((wPixel >> 5) & 0x3F);
+			}
+			pRow[2] = Expand5(wPixel & 0x1F);
+		}
+	}
+	else if constexpr (Format == DIBFormat::Masked16 or Format == DIBFormat::Masked32) {
+		using Pixel = std::conditional_t<Format == DIBFormat::Masked16, WORD, DWORD>;
+		const Channel* pChannels = decoder.channels_;
+		const UINT nChannels = decoder.nChannels_;
+		for (UINT x{}; x < nWidth; ++x, pRow += nChannels) {
+			Pixel pixel;
+			memcpy(&pixel, pSrc + x * sizeof(Pixel), sizeof(Pixel));
+			for (UINT c{}; c < nChannels; ++c) {
+				const Channel& channel = pChannels[c];
+				pRow[c] = channel.scale[(pixel >> channel.shift) & channel.dwValueMask];
+			}
+		}
+	}
+	else if constexpr (Format == DIBFormat::Bgr24) {
+		decoder.pKernels_->pfnBgr24ToRgb24(pSrc, pRow, nWidth);
+	}
+	else if constexpr (Format == DIBFormat::Shuffle32) {
+		if (decoder.nChannels_ == 4) { decoder.pKernels_->pfnShuffle32To32(pSrc, pRow, nWidth, decoder.order_); }
+		else { decoder.pKernels_->pfnShuffle32To24(pSrc, pRow, nWidth, decoder.order_); }
+	}
+}
+
+// Expands a BI_RLE4/BI_RLE8 stream into one index byte per pixel; skipped pixels stay 0
+template<bool IsRle4>
+bool DIBDecoder::ExpandRle(const BYTE* pData, size_t cbData)
+{
+	try {
+		rleIndices_.assign((size_t)nWidth_ * nHeight_, 0);
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+
+	size_t pos{};
+	UINT x{}, y{};
+	while (pos + 2 <= cbData) {
+		const BYTE count = pData[pos];
+		const BYTE value = pData[pos + 1];
+		pos += 2;
+
+		if (count) {
+			// Encoded run: one index (RLE8) or two alternating nibbles (RLE4)
+			if (y >= nHeight_) { return false; }
+			uint8_t* pLine = rleIndices_.data() + (size_t)y * nWidth_;
+			for (UINT i{}; i < count and x < nWidth_; ++i, ++x) {
+				pLine[x] = IsRle4 ? (i & 1 ? value & 0x0F : value >> 4) : value;
+			}
+			continue;
+		}
+
+		switch (value) {
+		case 0:  // End of line
+			x = 0;
+			++y;
+			break;
+		case 1:  // End of bitmap
+			return true;
+		case 2:  // Delta
+			if (pos + 2 > cbData) { return false; }
+			x += pData[pos];
+			y += pData[pos + 1];
+			pos += 2;
+			break;
+		default: {
+			// Absolute run of value pixels, padded to a 16-bit boundary
+			const size_t cbRun = IsRle4 ? ((size_t)value + 1) / 2 : value;
+			if (pos + cbRun > cbData or y >= nHeight_) { return false; }
+			uint8_t* pLine = rleIndices_.data() + (size_t)y * nWidth_;
+			for (UINT i{}; i < value and x < nWidth_; ++i, ++x) {
+				pLine[x] = IsRle4 ? (i & 1 ? pData[pos + i / 2] & 0x0F : pData[pos + i / 2] >> 4) : pData[pos + i];
+			}
+			pos += (cbRun + 1) & ~(size_t)1;
+			break;
+		}
+		}
+	}
+	return true;  // Tolerate streams without the end-of-bitmap marker
+}
+
+// Derives shift and bit width of each mask; masks must be contiguous runs of bits
+bool DIBDecoder::InitializeChannels(const DWORD* pMasks, unsigned cMasks)
+{
+	for (unsigned c{}; c < 4; ++c) {
+		Channel& channel = channels_[c];
+		channel = {};
+		channel.dwMask = c < cMasks ? pMasks[c] : 0;
+		if (!channel.dwMask) { continue; }
+
+		channel.shift = CountTrailingZeros(channel.dwMask);
+		const DWORD dwValueMask = channel.dwMask >> channel.shift;
+		if (dwValueMask & (dwValueMask + 1)) { return false; }  // Not contiguous
+
+		unsigned bits{};
+		while (bits < 32 and (dwValueMask >> bits)) { ++bits; }
+		if (bits > 8) {
+			// Keep the top 8 bits
+			channel.shift += bits - 8;
+			bits = 8;
+		}
+
+		const unsigned maxValue = (1u << bits) - 1;
+		channel.dwValueMask = maxValue;
+		for (unsigned v{}; v <= maxValue; ++v) {
+			channel.scale[v] = (uint8_t)((v * 255 + maxValue / 2) / maxValue);
+		}
+	}
+	return true;
+}
+
+// True if the alpha channel holds anything but zeros (all-zero alpha means opaque)
+bool DIBDecoder::IsAlphaPresent() const
+{
+	if (format_ == DIBFormat::Shuffle32) {
+		return !pKernels_->pfnIsAlphaZero(pPixels_, (size_t)nWidth_ * nHeight_, order_[3]);
+	}
+
+	const Channel& alpha = channels_[3];
+	if (!alpha.dwMask) { return false; }
+
+	const UINT cbPixel = format_ == DIBFormat::Masked16 ? 2 : 4;
+	for (UINT y{}; y < nHeight_; ++y) {
+		const BYTE* pSrc = pPixels_ + (size_t)y * cbStride_;
+		for (UINT x{}; x < nWidth_; ++x) {
+			DWORD dwPixel{};
+			memcpy(&dwPixel, pSrc + x * cbPixel, cbPixel);
+			if (dwPixel & alpha.dwMask) { return true; }
+		}
+	}
+	return false;
+}
+
+size_t DIBDecoder::GetPixelOffset(const BITMAPINFO* pbmi)
+{
+	if (!pbmi) { return 0; }
+
+	const BITMAPINFOHEADER& bih = pbmi->bmiHeader;
+	size_t cbOffset = bih.biSize;
+
+	// Channel masks follow a plain BITMAPINFOHEADER; V4/V5 headers carry them inside
+	if (bih.biCompression == BI_BITFIELDS and bih.biSize == sizeof(BITMAPINFOHEADER)) {
+		cbOffset += 3 * sizeof(DWORD);
+	}
+
+	// Palettes for <= 8bpp, optional optimization palettes for deeper formats
+	size_t cColors = bih.biClrUsed;
+	if (!cColors and bih.biBitCount <= 8) { cColors = (size_t)1 << bih.biBitCount; }
+	return cbOffset + cColors * sizeof(RGBQUAD);
+}
+
+bool DIBDecoder::Open(const BITMAPINFO* pbmi, size_t cbSize, const PixelConvert::Kernels* pKernels, bool isAlphaScanned)
+{
+	pfnRow_ = NULL;
+	pPixels_ = NULL;
+	rleIndices_.clear();
+	if (!pbmi or cbSize < sizeof(BITMAPINFOHEADER)) { return false; }
+
+	const BITMAPINFOHEADER& bih = pbmi->bmiHeader;
+	if (bih.biSize < sizeof(BITMAPINFOHEADER) or bih.biSize > cbSize) { return false; }
+	if (bih.biWidth <= 0 or bih.biHeight == 0 or bih.biHeight == LONG_MIN) { return false; }
+
+	nWidth_ = bih.biWidth;
+	nHeight_ = bih.biHeight < 0 ? -bih.biHeight : bih.biHeight;
+	isTopDown_ = bih.biHeight < 0;
+	nChannels_ = 3;
+	isAlphaPossible_ = false;
+	pKernels_ = pKernels ? pKernels : &PixelConvert::GetBestKernels();
+	if ((uint64_t)nWidth_ * nHeight_ > kMaxPixels) { return false; }
+
+	const size_t cbOffset = GetPixelOffset(pbmi);
+	if (bih.biClrUsed > cbSize / sizeof(RGBQUAD) or cbOffset > cbSize) { return false; }
+	const BYTE* pData = reinterpret_cast<const BYTE*>(pbmi) + cbOffset;
+	const size_t cbData = cbSize - cbOffset;
+
+	// Masks sit right after the 40-byte header, both for BITMAPINFOHEADER and V4/V5 headers
+	DWORD masks[4]{};
+	const bool hasAlphaMask = bih.biSize >= sizeof(BITMAPV4HEADER);
+	if (bih.biCompression == BI_BITFIELDS) {
+		const size_t cbMasks = (hasAlphaMask ? 4 : 3) * sizeof(DWORD);
+		if (sizeof(BITMAPINFOHEADER) + cbMasks > cbSize) { return false; }
+		memcpy(masks, reinterpret_cast<const BYTE*>(pbmi) + sizeof(BITMAPINFOHEADER), cbMasks);
+	}
+
+	switch (bih.biBitCount) {
+	case 1:
+	case 4:
+	case 8: {
+		// Palette entries are BGRX
+		const size_t cColors = bih.biClrUsed ? bih.biClrUsed : (size_t)1 << bih.biBitCount;
+		const RGBQUAD* pColors = reinterpret_cast<const RGBQUAD*>(reinterpret_cast<const BYTE*>(pbmi) + bih.biSize);
+		memset(palette_, 0, sizeof(palette_));
+		for (size_t i{}; i < cColors and i < 256; ++i) {
+			palette_[i][0] = pColors[i].rgbRed;
+			palette_[i][1] = pColors[i].rgbGreen;
+			palette_[i][2] = pColors[i].rgbBlue;
+		}
+
+		if (bih.biCompression == BI_RGB) {
+			format_ = bih.biBitCount == 1 ? DIBFormat::Palette1 : bih.biBitCount == 4 ? DIBFormat::Palette4 : DIBFormat::Palette8;
+			break;
+		}
+
+		// RLE bitmaps are bottom-up only
+		if (isTopDown_) { return false; }
+		const size_t cbStream = bih.biSizeImage and bih.biSizeImage < cbData ? bih.biSizeImage : cbData;
+		if (bih.biCompression == BI_RLE8 and bih.biBitCount == 8) {
+			if (!ExpandRle<false>(pData, cbStream)) { return false; }
+		}
+		else if (bih.biCompression == BI_RLE4 and bih.biBitCount == 4) {
+			if (!ExpandRle<true>(pData, cbStream)) { return false; }
+		}
+		else {
+			return false;
+		}
+		format_ = DIBFormat::Palette8;
+		pPixels_ = rleIndices_.data();
+		cbStride_ = nWidth_;
+		break;
+	}
+	case 16:
+		if (bih.biCompression == BI_RGB) {
+			format_ = DIBFormat::Rgb555;
+		}
+		else if (bih.biCompression != BI_BITFIELDS) {
+			return false;
+		}
+		else if (masks[0] == 0x7C00 and masks[1] == 0x03E0 and masks[2] == 0x001F and !masks[3]) {
+			format_ = DIBFormat::Rgb555;
+		}
+		else if (masks[0] == 0xF800 and masks[1] == 0x07E0 and masks[2] == 0x001F and !masks[3]) {
+			format_ = DIBFormat::Rgb565;
+		}
+		else {
+			format_ = DIBFormat::Masked16;
+		}
+		break;
+	case 24:
+		if (bih.biCompression != BI_RGB) { return false; }
+		format_ = DIBFormat::Bgr24;
+		break;
+	case 32: {
+		// BI_RGB is BGRX, where X may carry alpha
+		if (bih.biCompression == BI_RGB) {
+			masks[0] = 0x00FF0000;
+			masks[1] = 0x0000FF00;
+			masks[2] = 0x000000FF;
+			masks[3] = 0xFF000000;
+		}
+		else if (bih.biCompression != BI_BITFIELDS) {
+			return false;
+		}
+
+		// Byte-aligned masks go through the SIMD shuffle kernels
+		format_ = DIBFormat::Shuffle32;
+		for (unsigned c{}; c < 4; ++c) {
+			INT nByte = -1;
+			for (INT b{}; b < 4; ++b) {
+				if (masks[c] == (0xFFu << (8 * b))) { nByte = b; }
+			}
+			if (nByte < 0 and (c < 3 or masks[c])) { format_ = DIBFormat::Masked32; }
+			order_[c] = (BYTE)(nByte < 0 ? 0 : nByte);
+		}
+		break;
+	}
+	default:
+		return false;
+	}
+
+	// Locate and bounds-check the uncompressed pixel array (RLE formats already point at their indices)
+	if (!pPixels_) {
+		const uint64_t cbStride = (((uint64_t)nWidth_ * bih.biBitCount + 31) / 32) * 4;
+		if (cbStride * nHeight_ > cbData) { return false; }
+		pPixels_ = pData;
+		cbStride_ = (size_t)cbStride;
+	}
+
+	if (format_ == DIBFormat::Masked16 or format_ == DIBFormat::Masked32) {
+		if (!InitializeChannels(masks, 4)) { return false; }
+	}
+
+	// An alpha channel that is zero everywhere means "no alpha", not "fully transparent"
+	const bool canHaveAlpha = format_ == DIBFormat::Masked16 or format_ == DIBFormat::Masked32 or
+		(format_ == DIBFormat::Shuffle32 and masks[3]);
+	if (isAlphaScanned) {
+		nChannels_ = canHaveAlpha and IsAlphaPresent() ? 4 : 3;
+	}
+	else {
+		isAlphaPossible_ = canHaveAlpha and (format_ == DIBFormat::Shuffle32 or channels_[3].dwMask);
+		nChannels_ = isAlphaPossible_ ? 4 : 3;
+	}
+
+	// One decoder per (format, orientation)
+	static const RowProc kDecoders[(size_t)DIBFormat::Count][2] = {
+		{ DecodeRow<DIBFormat::Palette1, false>,  DecodeRow<DIBFormat::Palette1, true> },
+		{ DecodeRow<DIBFormat::Palette4, false>,  DecodeRow<DIBFormat::Palette4, true> },
+		{ DecodeRow<DIBFormat::Palette8, false>,  DecodeRow<DIBFormat::Palette8, true> },
+		{ DecodeRow<DIBFormat::Rgb555, false>,    DecodeRow<DIBFormat::Rgb555, true> },
+		{ DecodeRow<DIBFormat::Rgb565, false>,    DecodeRow<DIBFormat::Rgb565, true> },
+		{ DecodeRow<DIBFormat::Masked16, false>,  DecodeRow<DIBFormat::Masked16, true> },
+		{ DecodeRow<DIBFormat::Bgr24, false>,     DecodeRow<DIBFormat::Bgr24, true> },
+		{ DecodeRow<DIBFormat::Shuffle32, false>, DecodeRow<DIBFormat::Shuffle32, true> },
+		{ DecodeRow<DIBFormat::Masked32, false>,  DecodeRow<DIBFormat::Masked32, true> },
+	};
+	pfnRow_ = kDecoders[(size_t)format_][isTopDown_ ? 1 : 0];
+	return true;
+}
+
+
+
@@ -0,0 +1,130 @@
+#pragma once
+
+// Implementation-specific headers
+#include "PixelConvert.h"  // 24/32bpp row kernels
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <vector>   // Decoded RLE indices
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Pixel layouts DIBDecoder tells apart; each one has its own row decoder per orientation
+enum class DIBFormat : unsigned
+{
+	Palette1,
+	Palette4,
+	Palette8,      // Also the decoded form of BI_RLE4/BI_RLE8
+	Rgb555,        // 16bpp BI_RGB or the equivalent BI_BITFIELDS masks
+	Rgb565,
+	Masked16,      // Any other contiguous 16bpp masks, optionally with alpha
+	Bgr24,
+	Shuffle32,     // 32bpp with byte-aligned masks
+	Masked32,      // 32bpp with other masks (e.g. 10-10-10)
+	Count
+};
+
+
+
+// Reads any uncompressed or RLE-compressed DIB row by row as 8-bit RGB or RGBA, top row first.
+// The row decoder is a template instance per (format, orientation) picked once in Open,
+// so the per-pixel loops carry no format branches. RLE bitmaps are expanded to palette
+// indices up front, since their rows cannot be located without decoding the stream.
+class DIBDecoder
+{
+private:
+	using RowProc = void (*)(const DIBDecoder& decoder, uint32_t y, uint8_t* pRow);
+
+	// One bitfield channel: value = (pixel & mask) >> shift, widened to 8 bits
+	struct Channel
+	{
+		DWORD dwMask{};
+		unsigned shift{};        // Adjusted so at most the top 8 bits remain
+		DWORD dwValueMask{};     // Applied after the shift
+		uint8_t scale[256]{};    // Value -> 0..255
+	};
+
+	const BYTE* pPixels_{};
+	size_t cbStride_{};
+	UINT nWidth_{};
+	UINT nHeight_{};
+	UINT nChannels_{};
+	DIBFormat format_{ DIBFormat::Count };
+	bool isTopDown_{};
+	bool isAlphaPossible_{};            // Alpha channel left undecided by Open
+	RowProc pfnRow_{};
+
+	uint8_t palette_[256][3]{};         // RGB, palette formats
+	Channel channels_[4]{};             // R, G, B, A for the masked formats
+	BYTE order_[4]{};                   // Source byte per output channel, Shuffle32
+	const PixelConvert::Kernels* pKernels_{};
+	std::vector<uint8_t> rleIndices_;   // Expanded RLE image, bottom-up rows of nWidth_ bytes
+
+private:
+	template<DIBFormat Format, bool IsTopDown>
+	static void DecodeRow(const DIBDecoder& decoder, uint32_t y, uint8_t* pRow);
+
+	template<bool IsRle4>
+	bool ExpandRle(const BYTE* pData, size_t cbData);
+
+	bool InitializeChannels(const DWORD* pMasks, unsigned cMasks);
+	bool IsAlphaPresent() const;
+
+public:
+	DIBDecoder() = default;
+	DIBDecoder(const DIBDecoder&) = delete;             // pPixels_ may point into rleIndices_
+	DIBDecoder& operator=(const DIBDecoder&) = delete;
+
+	// Byte offset of the pixel array from the start of the BITMAPINFO
+	static size_t GetPixelOffset(const BITMAPINFO* pbmi);
+
+	// Parses pbmi (cbSize bytes including the pixels); false for malformed or unsupported DIBs.
+	// An alpha channel that is zero everywhere means "no alpha", which takes a pass over the
+	// whole image; without isAlphaScanned that pass is skipped, every format that can carry
+	// alpha is read as RGBA and IsAlphaPossible leaves the decision to the caller.
+	bool Open(const BITMAPINFO* pbmi, size_t cbSize, const PixelConvert::Kernels* pKernels = NULL, bool isAlphaScanned = true);
+
+	UINT GetWidth() const { return nWidth_; }
+	UINT GetHeight() const { return nHeight_; }
+	UINT GetChannels() const { return nChannels_; }  // 3 (RGB) or 4 (RGBA)
+	DIBFormat GetFormat() const { return format_; }
+	bool IsAlphaPossible() const { return isAlphaPossible_; }
+
+	// Writes row y (0 = top) as nWidth_ * nChannels_ bytes
+	void ReadRow(uint32_t y, uint8_t* pRow) const
+	{
+		pfnRow_(*this, y, pRow);
+	}
+
+	// PngRowProc adapter, pContext is the DIBDecoder
+	static bool ReadRowProc(const void* pContext, uint32_t y, uint8_t* pRow)
+	{
+		static_cast<const DIBDecoder*>(pContext)->ReadRow(y, pRow);
+		return true;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	DIBDecoder decoder;
+	if (decoder.Open(pbmi, cbDataSize)) {
+		std::vector<uint8_t> row(decoder.GetWidth() * decoder.GetChannels());
+		for (UINT y{}; y < decoder.GetHeight(); ++y) {
+			decoder.ReadRow(y, row.data());
+		}
+	}
+
+	PngImage image{ decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), DIBDecoder::ReadRowProc, &decoder };
+
+*/
+
+
+
@@ -0,0 +1,434 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>        // Fixed-width integers
+#include <string>         // Index path
+#include <vector>         // Bloom filter storage, grown table
+#include <deque>          // Last-N ring
+#include <unordered_set>  // Session set
+#include <unordered_map>  // Last-N reference counts
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Scope of the "seen before?" check
+enum class DedupScope : unsigned
+{
+	LastN,    // Only the N most recent captures
+	Session,  // Everything captured since startup
+	AllTime   // Persistent index that survives restarts
+};
+
+
+
+// In-memory Bloom filter that answers "definitely new" without touching the mapped index
+class BloomFilter
+{
+private:
+	static constexpr unsigned kHashCount = 7;    // ~1% false positives at 10 bits per entry
+	static constexpr unsigned kBitsPerEntry = 10;
+
+	std::vector<uint64_t> bits_;
+	uint64_t mask_{};
+
+private:
+	// SplitMix64 finalizer, spreads already-hashed keys over the bit range
+	static uint64_t Mix(uint64_t x)
+	{
+		x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return x;
+	}
+
+public:
+	// Sizes the filter for the expected number of entries and clears it
+	void Reset(size_t cEntries)
+	{
+		uint64_t cBits = 1024;
+		while (cBits < cEntries * kBitsPerEntry) { cBits <<= 1; }
+
+		bits_.assign((size_t)(cBits / 64), 0);
+		mask_ = cBits - 1;
+	}
+
+	void Add(uint64_t key)
+	{
+		if (bits_.empty()) { return; }
+
+		const uint64_t h1 = Mix(key);
+		const uint64_t h2 = Mix(key ^ 0x9e3779b97f4a7c15ULL) | 1;
+		for (unsigned i{}; i < kHashCount; ++i) {
+			const uint64_t bit = (h1 + i * h2) & mask_;
+			bits_[bit >> 6] |= 1ULL << (bit & 63);
+		}
+	}
+
+	bool MayContain(uint64_t key) const
+	{
+		if (bits_.empty()) { return false; }
+
+		const uint64_t h1 = Mix(key);
+		const uint64_t h2 = Mix(key ^ 0x9e3779b97f4a7c15ULL) | 1;
+		for (unsigned i{}; i < kHashCount; ++i) {
+			const uint64_t bit = (h1 + i * h2) & mask_;
+			if (!(bits_[bit >> 6] & (1ULL << (bit & 63)))) { return false; }
+		}
+		return true;
+	}
+
+};
+
+
+
+// Content-key index used to skip images that were already saved
+class DedupIndex
+{
+private:
+	// On-disk layout: header followed by an open-addressing table of 64-bit keys (0 = empty slot)
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t capacity;  // Slot count, power of two
+		uint64_t count;     // Occupied slots
+		uint64_t keyKind;   // Caller-defined key scheme (zero in files written before it existed)
+	};
+
+	static constexpr uint32_t kMagic = 0x58534943;        // "CISX"
+	static constexpr uint32_t kVersion = 1;
+	static constexpr uint64_t kInitialCapacity = 1 << 16;  // 512 KB of slots
+	static constexpr unsigned kMaxLoadPercent = 70;
+
+	DedupScope scope_{ DedupScope::AllTime };
+	DWORD cLastN_{ 1 };
+	uint64_t keyKind_{};
+
+	// Last-N scope
+	std::deque<uint64_t> recent_;
+	std::unordered_map<uint64_t, DWORD> recentCounts_;
+
+	// Session scope
+	std::unordered_set<uint64_t> session_;
+
+	// All-time scope
+	std::basic_string<TCHAR> path_;
+	HANDLE hFile_{ INVALID_HANDLE_VALUE };
+	HANDLE hMapping_{};
+	FileHeader* pHeader_{};
+	uint64_t* pSlots_{};
+	BloomFilter bloom_;
+
+private:
+	// Key 0 marks an empty slot in the mapped table
+	static uint64_t NormalizeKey(uint64_t key)
+	{
+		return key ? key : 1;
+	}
+
+	void Unmap()
+	{
+		if (pHeader_) {
+			FlushViewOfFile(pHeader_, 0);
+			UnmapViewOfFile(pHeader_);
+			pHeader_ = NULL;
+			pSlots_ = NULL;
+		}
+		if (hMapping_) {
+			CloseHandle(hMapping_);
+			hMapping_ = NULL;
+		}
+	}
+
+	// Maps the file large enough to hold the given slot count (the file grows zero-filled)
+	bool Map(uint64_t capacity)
+	{
+		Unmap();
+
+		const uint64_t cbTotal = sizeof(FileHeader) + capacity * sizeof(uint64_t);
+		hMapping_ = CreateFileMapping(hFile_, NULL, PAGE_READWRITE,
+			(DWORD)(cbTotal >> 32), (DWORD)cbTotal, NULL);
+		if (!hMapping_) { return false; }
+
+		pHeader_ = static_cast<FileHeader*>(MapViewOfFile(hMapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		if (!pHeader_) {
+			CloseHandle(hMapping_);
+			hMapping_ = NULL;
+			return false;
+		}
+		pSlots_ = reinterpret_cast<uint64_t*>(pHeader_ + 1);
+		return true;
+	}
+
+	// Probes are bounded by the capacity, so even a full table cannot spin
+	bool TableContains(uint64_t key) const
+	{
+		const uint64_t mask = pHeader_->capacity - 1;
+		uint64_t i = key & mask;
+		for (uint64_t cProbes{}; cProbes < pHeader_->capacity; ++cProbes, i = (i + 1) & mask) {
+			if (pSlots_[i] == key) { return true; }
+			if (pSlots_[i] == 0) { return false; }
+		}
+		return false;
+	}
+
+	// Inserts into the mapped table, returns false if the key was already present (or the table is full)
+	bool TableInsert(uint64_t key)
+	{
+		const uint64_t mask = pHeader_->capacity - 1;
+		uint64_t i = key & mask;
+		for (uint64_t cProbes{}; cProbes < pHeader_->capacity; ++cProbes, i = (i + 1) & mask) {
+			if (pSlots_[i] == key) { return false; }
+			if (pSlots_[i] == 0) {
+				pSlots_[i] = key;
+				++pHeader_->count;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IsOverloaded(uint64_t cEntries) const
+	{
+		return cEntries * 100 > pHeader_->capacity * kMaxLoadPercent;
+	}
+
+	// Also recounts the occupied slots: the stored count of a damaged file cannot be trusted
+	void RebuildBloom()
+	{
+		bloom_.Reset((size_t)(pHeader_->capacity * kMaxLoadPercent / 100));
+		uint64_t count{};
+		for (uint64_t i{}; i < pHeader_->capacity; ++i) {
+			if (pSlots_[i]) {
+				bloom_.Add(pSlots_[i]);
+				++count;
+			}
+		}
+		pHeader_->count = count;
+	}
+
+	// Doubles the table: the bigger one is built in memory, written beside the index and renamed
+	// over it, so a crash leaves either the old table or the new one, never a partial one.
+	// On failure the index may be left closed; the caller falls back to the session history.
+	bool Grow()
+	{
+		const uint64_t newCapacity = pHeader_->capacity * 2;
+		const uint64_t cbTotal = sizeof(FileHeader) + newCapacity * sizeof(uint64_t);
+		if (cbTotal > MAXDWORD) { return false; }
+
+		std::vector<uint64_t> file((size_t)(cbTotal / sizeof(uint64_t)));
+		FileHeader* pHeader = reinterpret_cast<FileHeader*>(file.data());
+		*pHeader = *pHeader_;
+		pHeader->capacity = newCapacity;
+		uint64_t* pSlots = file.data() + sizeof(FileHeader) / sizeof(uint64_t);
+		for (uint64_t i{}; i < pHeader_->capacity; ++i) {
+			if (!pSlots_[i]) { continue; }
+			uint64_t j = pSlots_[i] & (newCapacity - 1);
+			while (pSlots[j]) { j = (j + 1) & (newCapacity - 1); }
+			pSlots[j] = pSlots_[i];
+		}
+
+		const std::basic_string<TCHAR> temporaryPath = path_ + _T(".tmp");
+		HANDLE hTemporary = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hTemporary == INVALID_HANDLE_VALUE) { return false; }
+		DWORD cbWritten{};
+		const bool isWritten = WriteFile(hTemporary, file.data(), (DWORD)cbTotal, &cbWritten, NULL)
+			and cbWritten == cbTotal and FlushFileBuffers(hTemporary);
+		CloseHandle(hTemporary);
+		file = {};
+
+		// The mapping and handle keep the index from being replaced
+		Unmap();
+		CloseHandle(hFile_);
+		hFile_ = INVALID_HANDLE_VALUE;
+		if (!isWritten or
+			!MoveFileEx(temporaryPath.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			DeleteFile(temporaryPath.c_str());
+			return false;
+		}
+		return OpenFile(path_.c_str());
+	}
+
+	bool OpenFile(LPCTSTR cszPath)
+	{
+		hFile_ = CreateFile(cszPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+			NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile_ == INVALID_HANDLE_VALUE) { return false; }
+
+		LARGE_INTEGER liSize{};
+		GetFileSizeEx(hFile_, &liSize);
+
+		// Reuse an existing index only if its header is consistent
+		FileHeader header{};
+		DWORD cbRead{};
+		bool isValid = liSize.QuadPart >= (LONGLONG)sizeof(FileHeader) and
+			ReadFile(hFile_, &header, sizeof(header), &cbRead, NULL) and
+			cbRead == sizeof(header) and
+			header.magic == kMagic and header.version == kVersion and
+			header.keyKind == keyKind_ and
+			header.capacity >= kInitialCapacity and
+			(header.capacity & (header.capacity - 1)) == 0 and
+			liSize.QuadPart >= (LONGLONG)(sizeof(FileHeader) + header.capacity * sizeof(uint64_t));
+
+		if (!isValid) {
+			// Start over with an empty table (keys of another scheme can never match)
+			SetFilePointer(hFile_, 0, NULL, FILE_BEGIN);
+			SetEndOfFile(hFile_);
+			if (!Map(kInitialCapacity)) { return false; }
+			pHeader_->magic = kMagic;
+			pHeader_->version = kVersion;
+			pHeader_->capacity = kInitialCapacity;
+			pHeader_->count = 0;
+			pHeader_->keyKind = keyKind_;
+		}
+		else if (!Map(header.capacity)) {
+			return false;
+		}
+
+		// A table filled past the load limit (an understated count) is rebuilt at twice the size
+		RebuildBloom();
+		return !IsOverloaded(pHeader_->count) or Grow();
+	}
+
+public:
+	~DedupIndex()
+	{
+		Close();
+	}
+
+	// Selects the scope; the persistent file is only opened for DedupScope::AllTime.
+	// An existing file is reused only if it was written with the same key scheme.
+	bool Open(DedupScope scope, DWORD cLastN, LPCTSTR cszIndexPath, uint64_t keyKind = 0)
+	{
+		Close();
+
+		scope_ = scope;
+		cLastN_ = cLastN ? cLastN : 1;
+		keyKind_ = keyKind;
+
+		if (scope_ == DedupScope::AllTime) {
+			path_ = cszIndexPath ? cszIndexPath : _T("");
+			if (!cszIndexPath or !OpenFile(cszIndexPath)) {
+				Close();
+				scope_ = DedupScope::Session;  // Degrade gracefully instead of disabling dedup
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		Unmap();
+		if (hFile_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(hFile_);
+			hFile_ = INVALID_HANDLE_VALUE;
+		}
+		recent_.clear();
+		recentCounts_.clear();
+		session_.clear();
+	}
+
+	DedupScope GetScope() const
+	{
+		return scope_;
+	}
+
+	DWORD GetLastN() const
+	{
+		return cLastN_;
+	}
+
+	// Distinct keys in the configured history
+	uint64_t GetCount() const
+	{
+		switch (scope_) {
+		case DedupScope::LastN: return recentCounts_.size();
+		case DedupScope::Session: return session_.size();
+		case DedupScope::AllTime: return pHeader_ ? pHeader_->count : 0;
+		default: return 0;
+		}
+	}
+
+	// Returns true if the key is part of the configured history
+	bool Contains(uint64_t key) const
+	{
+		key = NormalizeKey(key);
+
+		switch (scope_) {
+		case DedupScope::LastN:
+			return recentCounts_.find(key) != recentCounts_.end();
+		case DedupScope::Session:
+			return session_.find(key) != session_.end();
+		case DedupScope::AllTime:
+			if (!pHeader_) { return false; }
+			if (!bloom_.MayContain(key)) { return false; }  // Fast path for new images
+			return TableContains(key);
+		default:
+			return false;
+		}
+	}
+
+	// Records a saved key
+	void Insert(uint64_t key)
+	{
+		key = NormalizeKey(key);
+
+		switch (scope_) {
+		case DedupScope::LastN:
+		{
+			recent_.push_back(key);
+			++recentCounts_[key];
+			while (recent_.size() > cLastN_) {
+				auto it = recentCounts_.find(recent_.front());
+				if (it != recentCounts_.end() and --it->second == 0) {
+					recentCounts_.erase(it);
+				}
+				recent_.pop_front();
+			}
+			break;
+		}
+		case DedupScope::Session:
+			session_.insert(key);
+			break;
+		case DedupScope::AllTime:
+			if (!pHeader_) { break; }
+			if (IsOverloaded(pHeader_->count + 1) and !Grow()) {
+				// Degrade like a failed Open rather than repeating the Grow on every insert
+				Close();
+				scope_ = DedupScope::Session;
+				session_.insert(key);
+				break;
+			}
+			if (TableInsert(key)) {
+				bloom_.Add(key);
+			}
+			break;
+		default: break;
+		}
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static DedupIndex index;
+	index.Open(DedupScope::AllTime, 0, _T("C:\\Captures\\ClipboardImageSaver.idx"), (uint64_t)HashAlgorithm::Xxh3_64);
+
+	if (!index.Contains(qwKey)) {
+		// ...save...
+		index.Insert(qwKey);
+	}
+
+*/
+
+
+
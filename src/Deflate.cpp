@@ -0,0 +1,975 @@
+// Implementation-specific headers
+#include "Deflate.h"
+
+// Standard library headers
+#include <cstring>    // memcpy, memset
+#include <algorithm>  // sort, min
+#include <queue>      // Huffman tree construction
+#include <cmath>      // log2
+#include <limits>     // Path cost sentinel
+
+// SIMD intrinsics
+#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define DEFLATE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+
+// Anonymous namespace for internal tables and helpers
+namespace
+{
+	constexpr size_t kWindowMask = Deflate::kWindowSize - 1;
+	constexpr unsigned kMinMatch = 3;
+	constexpr unsigned kMaxMatch = 258;
+	constexpr unsigned kTooFar = 4096;          // Minimum-length matches farther than this cost more than literals
+	constexpr unsigned kHashBits = 15;
+	constexpr size_t kHashSize = (size_t)1 << kHashBits;
+	constexpr size_t kMaxBlockSymbols = 32768;  // Symbols buffered before a block is emitted
+	constexpr unsigned kMaxStoredLength = 65535;
+	constexpr size_t kOptimalChunk = (size_t)1 << 20;  // Input parsed per shortest-path run
+
+	constexpr unsigned kLitLenCodes = 286;
+	constexpr unsigned kDistCodes = 30;
+	constexpr unsigned kCodeLengthCodes = 19;
+	constexpr unsigned kEndOfBlock = 256;
+
+	// zlib-style tuning per level: lazy matching stops at lazyLength, chains shrink past goodLength
+	struct LevelParams
+	{
+		unsigned goodLength;
+		unsigned lazyLength;   // Greedy levels: longest match whose positions are all hashed
+		unsigned niceLength;
+		unsigned maxChain;
+		bool isLazy;
+		unsigned optimalPasses;  // Shortest-path parsing rounds, 0 = greedy or lazy matching
+	};
+
+	constexpr LevelParams kLevels[Deflate::kOptimalLevel + 1] = {
+		{   0,   0,   0,    0, false, 0 },  // 0: stored
+		{   4,   4,   8,    4, false, 0 },  // 1
+		{   4,   5,  16,    8, false, 0 },  // 2
+		{   4,   6,  32,   32, false, 0 },  // 3
+		{   4,   4,  16,   16, true,  0 },  // 4
+		{   8,  16,  32,   32, true,  0 },  // 5
+		{   8,  16, 128,  128, true,  0 },  // 6
+		{   8,  32, 128,  256, true,  0 },  // 7
+		{  32, 128, 258, 1024, true,  0 },  // 8
+		{  32, 258, 258, 4096, true,  0 },  // 9
+		{ 128, 258, 258, 1024, true,  3 },  // 10: optimal
+	};
+
+	constexpr uint16_t kLengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr uint8_t kLengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr uint16_t kDistBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	constexpr uint8_t kDistExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	constexpr uint8_t kCodeLengthOrder[kCodeLengthCodes] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Length (3..258) and distance (1..32768) to code lookup tables
+	struct CodeTables
+	{
+		uint8_t lengthCode[kMaxMatch + 1];
+		uint8_t distCodeLow[512];    // Distances 1..512
+		uint8_t distCodeHigh[256];   // (distance - 1) >> 7 for larger distances
+
+		CodeTables()
+		{
+			for (unsigned code{}; code < 29; ++code) {
+				const unsigned last = code == 28 ? 258 : kLengthBase[code] + (1u << kLengthExtra[code]) - 1;
+				for (unsigned len = kLengthBase[code]; len <= last and len <= kMaxMatch; ++len) {
+					lengthCode[len] = (uint8_t)code;
+				}
+			}
+			lengthCode[258] = 28;  // 258 has its own code, not 284 + 31
+
+			for (unsigned code{}; code < kDistCodes; ++code) {
+				const unsigned first = kDistBase[code];
+				const unsigned last = first + (1u << kDistExtra[code]) - 1;
+				for (unsigned dist = first; dist <= last; ++dist) {
+					if (dist <= 512) { distCodeLow[dist - 1] = (uint8_t)code; }
+					else { distCodeHigh[(dist - 1) >> 7] = (uint8_t)code; }
+				}
+			}
+		}
+
+		unsigned DistCode(unsigned dist) const
+		{
+			return dist <= 512 ? distCodeLow[dist - 1] : distCodeHigh[(dist - 1) >> 7];
+		}
+	};
+
+	const CodeTables& Tables()
+	{
+		static const CodeTables tables;
+		return tables;
+	}
+
+	// LSB-first bit packer
+	class BitWriter
+	{
+	private:
+		std::vector<uint8_t>* pOut_;
+		uint64_t bits_{};
+		unsigned cBits_{};
+
+	public:
+		explicit BitWriter(std::vector<uint8_t>* pOut) :
+			pOut_{ pOut }
+		{}
+
+		void Put(uint32_t value, unsigned cBits)
+		{
+			bits_ |= (uint64_t)value << cBits_;
+			cBits_ += cBits;
+			while (cBits_ >= 8) {
+				pOut_->push_back((uint8_t)bits_);
+				bits_ >>= 8;
+				cBits_ -= 8;
+			}
+		}
+
+		void AlignToByte()
+		{
+			if (cBits_) { Put(0, 8 - cBits_); }
+		}
+
+		void PutBytes(const uint8_t* pData, size_t cbSize)
+		{
+			pOut_->insert(pOut_->end(), pData, pData + cbSize);
+		}
+	};
+
+	uint32_t ReverseBits(uint32_t code, unsigned cBits)
+	{
+		uint32_t result{};
+		for (unsigned i{}; i < cBits; ++i) {
+			result = (result << 1) | (code & 1);
+			code >>= 1;
+		}
+		return result;
+	}
+
+	// Builds length-limited Huffman code lengths from symbol frequencies
+	void BuildCodeLengths(const uint32_t* pFreq, unsigned cSymbols, unsigned maxBits, uint8_t* pLengths)
+	{
+		memset(pLengths, 0, cSymbols);
+
+		std::vector<unsigned> used;
+		for (unsigned i{}; i < cSymbols; ++i) {
+			if (pFreq[i]) { used.push_back(i); }
+		}
+		if (used.empty()) { return; }
+		if (used.size() == 1) {
+			pLengths[used[0]] = 1;
+			return;
+		}
+
+		// Plain Huffman tree over (frequency, node) pairs
+		struct Node { uint64_t freq; int parent; };
+		std::vector<Node> nodes;
+		nodes.reserve(used.size() * 2);
+		using Entry = std::pair<uint64_t, int>;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+		for (unsigned symbol : used) {
+			heap.push({ pFreq[symbol], (int)nodes.size() });
+			nodes.push_back({ pFreq[symbol], -1 });
+		}
+		while (heap.size() > 1) {
+			const Entry a = heap.top(); heap.pop();
+			const Entry b = heap.top(); heap.pop();
+			const int parent = (int)nodes.size();
+			nodes.push_back({ a.first + b.first, -1 });
+			nodes[a.second].parent = parent;
+			nodes[b.second].parent = parent;
+			heap.push({ a.first + b.first, parent });
+		}
+
+		// Count leaves per depth, folding overlong codes into maxBits
+		unsigned counts[64]{};
+		for (size_t i{}; i < used.size(); ++i) {
+			unsigned depth{};
+			for (int n = (int)i; nodes[n].parent >= 0; n = nodes[n].parent) { ++depth; }
+			++counts[depth > maxBits ? maxBits : depth];
+		}
+
+		// Restore the Kraft equality after folding (same fix-up as zlib/miniz)
+		uint32_t total{};
+		for (unsigned len = 1; len <= maxBits; ++len) {
+			total += counts[len] << (maxBits - len);
+		}
+		while (total > (1u << maxBits)) {
+			--counts[maxBits];
+			for (unsigned len = maxBits - 1; len > 0; --len) {
+				if (counts[len]) {
+					--counts[len];
+					counts[len + 1] += 2;
+					break;
+				}
+			}
+			--total;
+		}
+
+		// Longest codes go to the least frequent symbols
+		std::stable_sort(used.begin(), used.end(), [&](unsigned a, unsigned b) { return pFreq[a] < pFreq[b]; });
+		size_t next{};
+		for (unsigned len = maxBits; len > 0; --len) {
+			for (unsigned n{}; n < counts[len]; ++n) {
+				pLengths[used[next++]] = (uint8_t)len;
+			}
+		}
+	}
+
+	// Canonical codes (bit-reversed for LSB-first output)
+	void BuildCodes(const uint8_t* pLengths, unsigned cSymbols, uint16_t* pCodes)
+	{
+		unsigned counts[16]{};
+		for (unsigned i{}; i < cSymbols; ++i) { ++counts[pLengths[i]]; }
+		counts[0] = 0;
+
+		uint32_t nextCode[16]{};
+		uint32_t code{};
+		for (unsigned len = 1; len < 16; ++len) {
+			code = (code + counts[len - 1]) << 1;
+			nextCode[len] = code;
+		}
+		for (unsigned i{}; i < cSymbols; ++i) {
+			pCodes[i] = pLengths[i] ? (uint16_t)ReverseBits(nextCode[pLengths[i]]++, pLengths[i]) : 0;
+		}
+	}
+
+	// One LZ77 symbol: literal (dist == 0) or match
+	struct Symbol
+	{
+		uint16_t litLen;  // Literal byte or match length
+		uint16_t dist;
+	};
+
+	// Estimated bits per literal/length and distance code, from the symbol statistics of a parse
+	struct CostModel
+	{
+		float litLen[kLitLenCodes];
+		float dist[kDistCodes];
+
+		// Entropy of the previous parse; unused codes cost as much as a single occurrence
+		void SetFromCounts(const uint32_t* pLitFreq, const uint32_t* pDistFreq)
+		{
+			const auto Fill = [](const uint32_t* pFreq, unsigned cSymbols, float* pCost) {
+				uint64_t total{};
+				for (unsigned i{}; i < cSymbols; ++i) { total += pFreq[i]; }
+				const double log2Total = total ? std::log2((double)total) : 0.0;
+				for (unsigned i{}; i < cSymbols; ++i) {
+					pCost[i] = (float)(pFreq[i] ? log2Total - std::log2((double)pFreq[i]) : log2Total);
+				}
+			};
+			Fill(pLitFreq, kLitLenCodes, litLen);
+			Fill(pDistFreq, kDistCodes, dist);
+		}
+	};
+
+	// Match candidates at one position: each entry is the shortest distance reaching its length
+	struct MatchCandidate
+	{
+		uint16_t length;
+		uint16_t dist;
+	};
+
+	class Compressor
+	{
+	private:
+		const uint8_t* pData_;
+		size_t dictBegin_;
+		size_t end_;
+		const LevelParams& params_;
+		BitWriter writer_;
+
+		std::vector<uint32_t> head_;  // Hash -> position + 1 (relative to dictBegin)
+		std::vector<uint32_t> prev_;  // Position & mask -> previous position + 1
+
+		std::vector<Symbol> symbols_;
+		size_t blockRawBegin_{};
+		size_t cbBlockRaw_{};
+
+		// Shortest-path parsing state, reused per chunk
+		std::vector<MatchCandidate> candidates_;
+		std::vector<uint32_t> candidateBegin_;  // Position -> first candidate, n + 1 entries
+		std::vector<float> pathCost_;
+		std::vector<Symbol> pathStep_;           // Position -> step that reached it at pathCost_
+
+	private:
+		uint32_t Hash(size_t pos) const
+		{
+			const uint32_t v = pData_[pos] | (pData_[pos + 1] << 8) | (pData_[pos + 2] << 16);
+			return (v * 2654435761u) >> (32 - kHashBits);
+		}
+
+		// Inserts pos into the hash chains and returns the previous head
+		size_t Insert(size_t pos)
+		{
+			if (pos + kMinMatch > end_) { return 0; }
+
+			const uint32_t h = Hash(pos);
+			const uint32_t previous = head_[h];
+			prev_[pos & kWindowMask] = previous;
+			head_[h] = (uint32_t)(pos - dictBegin_ + 1);
+			return previous;
+		}
+
+		unsigned LongestMatch(size_t pos, uint32_t candidate, unsigned prevLength, unsigned* pDist) const
+		{
+			const size_t limit = pos - dictBegin_ > Deflate::kWindowSize ? pos - Deflate::kWindowSize : dictBegin_;
+			const unsigned maxLength = (unsigned)std::min<size_t>(kMaxMatch, end_ - pos);
+			unsigned chain = params_.maxChain;
+			if (prevLength >= params_.goodLength) { chain >>= 2; }
+
+			unsigned bestLength = prevLength;
+			const uint8_t* pCur = pData_ + pos;
+
+			while (candidate and chain--) {
+				const size_t match = dictBegin_ + candidate - 1;
+				if (match < limit or match >= pos) { break; }
+
+				const uint8_t* pMatch = pData_ + match;
+				if (pMatch[bestLength] == pCur[bestLength] and pMatch[0] == pCur[0] and pMatch[1] == pCur[1]) {
+					unsigned length = 2;
+					while (length < maxLength and pMatch[length] == pCur[length]) { ++length; }
+					if (length > bestLength) {
+						bestLength = length;
+						*pDist = (unsigned)(pos - match);
+						if (length >= params_.niceLength or length >= maxLength) { break; }
+					}
+				}
+				candidate = prev_[match & kWindowMask];
+			}
+			return bestLength;
+		}
+
+		void EmitLiteral(size_t pos)
+		{
+			if (symbols_.empty()) { blockRawBegin_ = pos; }
+			symbols_.push_back({ pData_[pos], 0 });
+			++cbBlockRaw_;
+			if (symbols_.size() >= kMaxBlockSymbols) { FlushBlock(false); }
+		}
+
+		void EmitMatch(size_t pos, unsigned length, unsigned dist)
+		{
+			if (symbols_.empty()) { blockRawBegin_ = pos; }
+			symbols_.push_back({ (uint16_t)length, (uint16_t)dist });
+			cbBlockRaw_ += length;
+			if (symbols_.size() >= kMaxBlockSymbols) { FlushBlock(false); }
+		}
+
+		void WriteStored(const uint8_t* pRaw, size_t cbRaw, bool isFinal)
+		{
+			do {
+				const unsigned cbChunk = (unsigned)std::min<size_t>(cbRaw, kMaxStoredLength);
+				const bool isLast = cbChunk == cbRaw;
+				writer_.Put(isLast and isFinal ? 1 : 0, 1);
+				writer_.Put(0, 2);
+				writer_.AlignToByte();
+				writer_.Put(cbChunk, 16);
+				writer_.Put(~cbChunk & 0xFFFF, 16);
+				writer_.PutBytes(pRaw, cbChunk);
+				pRaw += cbChunk;
+				cbRaw -= cbChunk;
+			} while (cbRaw);
+		}
+
+		void WriteSymbols(const uint16_t* pLitCodes, const uint8_t* pLitLengths,
+			const uint16_t* pDistCodes, const uint8_t* pDistLengths)
+		{
+			const CodeTables& tables = Tables();
+			for (const Symbol& symbol : symbols_) {
+				if (!symbol.dist) {
+					writer_.Put(pLitCodes[symbol.litLen], pLitLengths[symbol.litLen]);
+					continue;
+				}
+				const unsigned lengthCode = tables.lengthCode[symbol.litLen];
+				writer_.Put(pLitCodes[257 + lengthCode], pLitLengths[257 + lengthCode]);
+				writer_.Put(symbol.litLen - kLengthBase[lengthCode], kLengthExtra[lengthCode]);
+
+				const unsigned distCode = tables.DistCode(symbol.dist);
+				writer_.Put(pDistCodes[distCode], pDistLengths[distCode]);
+				writer_.Put(symbol.dist - kDistBase[distCode], kDistExtra[distCode]);
+			}
+			writer_.Put(pLitCodes[kEndOfBlock], pLitLengths[kEndOfBlock]);
+		}
+
+	public:
+		Compressor(const uint8_t* pData, size_t dictBegin, size_t end, int level, std::vector<uint8_t>* pOutput) :
+			pData_{ pData },
+			dictBegin_{ dictBegin },
+			end_{ end },
+			params_{ kLevels[level] },
+			writer_{ pOutput },
+			head_(kHashSize),
+			prev_(Deflate::kWindowSize)
+		{
+			symbols_.reserve(kMaxBlockSymbols);
+		}
+
+		// Emits the buffered symbols as the cheapest of stored, fixed or dynamic Huffman
+		void FlushBlock(bool isFinal)
+		{
+			const CodeTables& tables = Tables();
+
+			uint32_t litFreq[kLitLenCodes]{};
+			uint32_t distFreq[kDistCodes]{};
+			uint64_t extraBits{};
+			for (const Symbol& symbol : symbols_) {
+				if (!symbol.dist) {
+					++litFreq[symbol.litLen];
+					continue;
+				}
+				const unsigned lengthCode = tables.lengthCode[symbol.litLen];
+				const unsigned distCode = tables.DistCode(symbol.dist);
+				++litFreq[257 + lengthCode];
+				++distFreq[distCode];
+				extraBits += kLengthExtra[lengthCode] + kDistExtra[distCode];
+			}
+			litFreq[kEndOfBlock] = 1;
+
+			// Dynamic code lengths; decoders need at least one distance code
+			uint8_t litLengths[kLitLenCodes];
+			uint8_t distLengths[kDistCodes];
+			BuildCodeLengths(litFreq, kLitLenCodes, 15, litLengths);
+			BuildCodeLengths(distFreq, kDistCodes, 15, distLengths);
+			if (std::count(distLengths, distLengths + kDistCodes, 0) == kDistCodes) { distLengths[0] = 1; }
+
+			unsigned cLit = kLitLenCodes;
+			while (cLit > 257 and !litLengths[cLit - 1]) { --cLit; }
+			unsigned cDist = kDistCodes;
+			while (cDist > 1 and !distLengths[cDist - 1]) { --cDist; }
+
+			// Run-length encode the concatenated code lengths (codes 16, 17, 18)
+			uint8_t allLengths[kLitLenCodes + kDistCodes];
+			memcpy(allLengths, litLengths, cLit);
+			memcpy(allLengths + cLit, distLengths, cDist);
+			const unsigned cAll = cLit + cDist;
+
+			struct RleItem { uint8_t code; uint8_t extra; };
+			std::vector<RleItem> rle;
+			uint32_t clFreq[kCodeLengthCodes]{};
+			for (unsigned i{}; i < cAll;) {
+				const uint8_t len = allLengths[i];
+				unsigned run = 1;
+				while (i + run < cAll and allLengths[i + run] == len) { ++run; }
+				i += run;
+
+				if (len == 0) {
+					while (run >= 11) { const unsigned n = std::min(run, 138u); rle.push_back({ 18, (uint8_t)(n - 11) }); ++clFreq[18]; run -= n; }
+					if (run >= 3) { rle.push_back({ 17, (uint8_t)(run - 3) }); ++clFreq[17]; run = 0; }
+				}
+				else {
+					rle.push_back({ len, 0 }); ++clFreq[len]; --run;
+					while (run >= 3) { const unsigned n = std::min(run, 6u); rle.push_back({ 16, (uint8_t)(n - 3) }); ++clFreq[16]; run -= n; }
+				}
+				for (; run; --run) { rle.push_back({ len, 0 }); ++clFreq[len]; }
+			}
+
+			uint8_t clLengths[kCodeLengthCodes];
+			BuildCodeLengths(clFreq, kCodeLengthCodes, 7, clLengths);
+			unsigned cCodeLength = kCodeLengthCodes;
+			while (cCodeLength > 4 and !clLengths[kCodeLengthOrder[cCodeLength - 1]]) { --cCodeLength; }
+
+			// Compare encoded sizes in bits
+			uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * cCodeLength + extraBits;
+			for (const RleItem& item : rle) {
+				dynamicBits += clLengths[item.code] + (item.code == 16 ? 2 : item.code == 17 ? 3 : item.code == 18 ? 7 : 0);
+			}
+			uint64_t fixedBits = 3 + extraBits;
+			for (unsigned i{}; i < kLitLenCodes; ++i) {
+				dynamicBits += (uint64_t)litFreq[i] * litLengths[i];
+				fixedBits += (uint64_t)litFreq[i] * (i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+			}
+			for (unsigned i{}; i < kDistCodes; ++i) {
+				dynamicBits += (uint64_t)distFreq[i] * distLengths[i];
+				fixedBits += (uint64_t)distFreq[i] * 5;
+			}
+			const uint64_t storedBits = (cbBlockRaw_ + 5 * (cbBlockRaw_ / kMaxStoredLength + 1)) * 8 + 7;
+
+			if (storedBits <= dynamicBits and storedBits <= fixedBits) {
+				WriteStored(pData_ + blockRawBegin_, cbBlockRaw_, isFinal);
+			}
+			else if (fixedBits <= dynamicBits) {
+				uint8_t fixedLit[288];
+				uint8_t fixedDist[kDistCodes];
+				for (unsigned i{}; i < 288; ++i) { fixedLit[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8; }
+				memset(fixedDist, 5, sizeof(fixedDist));
+				uint16_t litCodes[288];
+				uint16_t distCodes[kDistCodes];
+				BuildCodes(fixedLit, 288, litCodes);
+				BuildCodes(fixedDist, kDistCodes, distCodes);
+
+				writer_.Put(isFinal ? 1 : 0, 1);
+				writer_.Put(1, 2);
+				WriteSymbols(litCodes, fixedLit, distCodes, fixedDist);
+			}
+			else {
+				uint16_t litCodes[kLitLenCodes];
+				uint16_t distCodes[kDistCodes];
+				uint16_t clCodes[kCodeLengthCodes];
+				BuildCodes(litLengths, kLitLenCodes, litCodes);
+				BuildCodes(distLengths, kDistCodes, distCodes);
+				BuildCodes(clLengths, kCodeLengthCodes, clCodes);
+
+				writer_.Put(isFinal ? 1 : 0, 1);
+				writer_.Put(2, 2);
+				writer_.Put(cLit - 257, 5);
+				writer_.Put(cDist - 1, 5);
+				writer_.Put(cCodeLength - 4, 4);
+				for (unsigned i{}; i < cCodeLength; ++i) {
+					writer_.Put(clLengths[kCodeLengthOrder[i]], 3);
+				}
+				for (const RleItem& item : rle) {
+					writer_.Put(clCodes[item.code], clLengths[item.code]);
+					if (item.code == 16) { writer_.Put(item.extra, 2); }
+					else if (item.code == 17) { writer_.Put(item.extra, 3); }
+					else if (item.code == 18) { writer_.Put(item.extra, 7); }
+				}
+				WriteSymbols(litCodes, litLengths, distCodes, distLengths);
+			}
+
+			symbols_.clear();
+			cbBlockRaw_ = 0;
+		}
+
+		// Seeds the hash chains with the history preceding the range
+		void Prime(size_t begin)
+		{
+			for (size_t pos = std::max(dictBegin_, begin > Deflate::kWindowSize ? begin - Deflate::kWindowSize : 0); pos < begin; ++pos) {
+				Insert(pos);
+			}
+		}
+
+		void CompressGreedy(size_t begin)
+		{
+			for (size_t pos = begin; pos < end_;) {
+				const uint32_t candidate = (uint32_t)Insert(pos);
+				unsigned dist{};
+				unsigned length = candidate ? LongestMatch(pos, candidate, kMinMatch - 1, &dist) : 0;
+				if (length == kMinMatch and dist > kTooFar) { length = 0; }
+
+				if (length >= kMinMatch) {
+					EmitMatch(pos, length, dist);
+					if (length <= params_.lazyLength) {
+						for (size_t i = pos + 1; i < pos + length; ++i) { Insert(i); }
+					}
+					pos += length;
+				}
+				else {
+					EmitLiteral(pos);
+					++pos;
+				}
+			}
+		}
+
+		void CompressLazy(size_t begin)
+		{
+			unsigned prevLength = kMinMatch - 1;
+			unsigned prevDist{};
+			bool isMatchAvailable{};
+
+			for (size_t pos = begin; pos < end_;) {
+				const uint32_t candidate = (uint32_t)Insert(pos);
+				unsigned dist{};
+				unsigned length = kMinMatch - 1;
+				if (candidate and prevLength < params_.lazyLength) {
+					length = LongestMatch(pos, candidate, kMinMatch - 1, &dist);
+					if (length == kMinMatch and dist > kTooFar) { length = kMinMatch - 1; }
+				}
+
+				if (prevLength >= kMinMatch and length <= prevLength) {
+					// The match found at the previous position wins
+					EmitMatch(pos - 1, prevLength, prevDist);
+					const size_t next = pos - 1 + prevLength;
+					for (size_t i = pos + 1; i < next; ++i) { Insert(i); }
+					pos = next;
+					isMatchAvailable = false;
+					prevLength = kMinMatch - 1;
+				}
+				else if (isMatchAvailable) {
+					EmitLiteral(pos - 1);
+					prevLength = length;
+					prevDist = dist;
+					++pos;
+				}
+				else {
+					isMatchAvailable = true;
+					prevLength = length;
+					prevDist = dist;
+					++pos;
+				}
+			}
+			if (isMatchAvailable) { EmitLiteral(end_ - 1); }
+		}
+
+		// Records, for every position of [begin, end), each match length that beats all nearer matches.
+		// Positions covered by a match of at least goodLength only get the tail of that match, which
+		// keeps long repeats from searching the full chain at every byte.
+		void CollectCandidates(size_t begin, size_t end)
+		{
+			candidates_.clear();
+			candidateBegin_.assign(end - begin + 1, 0);
+
+			size_t skipEnd{};
+			unsigned skipDist{};
+			for (size_t pos = begin; pos < end; ++pos) {
+				candidateBegin_[pos - begin] = (uint32_t)candidates_.size();
+				uint32_t candidate = (uint32_t)Insert(pos);
+
+				if (pos < skipEnd) {
+					if (skipEnd - pos >= kMinMatch) { candidates_.push_back({ (uint16_t)(skipEnd - pos), (uint16_t)skipDist }); }
+					continue;
+				}
+				if (!candidate) { continue; }
+
+				const size_t limit = pos - dictBegin_ > Deflate::kWindowSize ? pos - Deflate::kWindowSize : dictBegin_;
+				const unsigned maxLength = (unsigned)std::min<size_t>(kMaxMatch, end_ - pos);
+				const uint8_t* pCur = pData_ + pos;
+				unsigned bestLength = kMinMatch - 1;
+				unsigned chain = params_.maxChain;
+
+				while (candidate and chain--) {
+					const size_t match = dictBegin_ + candidate - 1;
+					if (match < limit or match >= pos) { break; }
+
+					const uint8_t* pMatch = pData_ + match;
+					if (pMatch[bestLength] == pCur[bestLength] and pMatch[0] == pCur[0] and pMatch[1] == pCur[1]) {
+						unsigned length = 2;
+						while (length < maxLength and pMatch[length] == pCur[length]) { ++length; }
+						if (length > bestLength) {
+							bestLength = length;
+							candidates_.push_back({ (uint16_t)length, (uint16_t)(pos - match) });
+							if (length >= maxLength) { break; }
+						}
+					}
+					candidate = prev_[match & kWindowMask];
+				}
+
+				if (bestLength >= params_.goodLength) {
+					skipEnd = pos + bestLength;
+					skipDist = candidates_.back().dist;
+				}
+			}
+			candidateBegin_[end - begin] = (uint32_t)candidates_.size();
+		}
+
+		// Cheapest symbol sequence for [begin, end) under the cost model, returned as path lengths
+		void FindShortestPath(size_t begin, size_t end, const CostModel& model, std::vector<Symbol>* pPath)
+		{
+			const CodeTables& tables = Tables();
+			const size_t n = end - begin;
+
+			float lengthCost[kMaxMatch + 1]{};
+			for (unsigned len = kMinMatch; len <= kMaxMatch; ++len) {
+				const unsigned code = tables.lengthCode[len];
+				lengthCost[len] = model.litLen[257 + code] + kLengthExtra[code];
+			}
+
+			pathCost_.assign(n + 1, std::numeric_limits<float>::infinity());
+			pathStep_.resize(n + 1);
+			pathCost_[0] = 0.0f;
+
+			for (size_t i{}; i < n; ++i) {
+				const float base = pathCost_[i];
+
+				const float literal = base + model.litLen[pData_[begin + i]];
+				if (literal < pathCost_[i + 1]) {
+					pathCost_[i + 1] = literal;
+					pathStep_[i + 1] = { 1, 0 };
+				}
+
+				// Inside long repeats only the maximal match is worth pricing
+				uint32_t c = candidateBegin_[i];
+				if (c < candidateBegin_[i + 1] and candidates_[candidateBegin_[i + 1] - 1].length == kMaxMatch and n - i >= kMaxMatch) {
+					c = candidateBegin_[i + 1] - 1;
+				}
+
+				unsigned shorter = c > candidateBegin_[i] ? kMaxMatch - 1 : kMinMatch - 1;
+				for (; c < candidateBegin_[i + 1]; ++c) {
+					const MatchCandidate& match = candidates_[c];
+					const unsigned distCode = tables.DistCode(match.dist);
+					const float matchBase = base + model.dist[distCode] + kDistExtra[distCode];
+					const unsigned longest = (unsigned)std::min<size_t>(match.length, n - i);
+
+					for (unsigned len = shorter + 1; len <= longest; ++len) {
+						const float cost = matchBase + lengthCost[len];
+						if (cost < pathCost_[i + len]) {
+							pathCost_[i + len] = cost;
+							pathStep_[i + len] = { (uint16_t)len, match.dist };
+						}
+					}
+					shorter = match.length;
+				}
+			}
+
+			// Walk back from the end, then reverse into stream order
+			pPath->clear();
+			for (size_t i = n; i > 0; i -= pathStep_[i].litLen) {
+				pPath->push_back(pathStep_[i]);
+			}
+			std::reverse(pPath->begin(), pPath->end());
+		}
+
+		// Symbol statistics of a path and its entropy-coded size in bits
+		double CountPath(size_t begin, const std::vector<Symbol>& path, uint32_t* pLitFreq, uint32_t* pDistFreq) const
+		{
+			const CodeTables& tables = Tables();
+			memset(pLitFreq, 0, sizeof(uint32_t) * kLitLenCodes);
+			memset(pDistFreq, 0, sizeof(uint32_t) * kDistCodes);
+
+			double bits{};
+			size_t pos = begin;
+			for (const Symbol& step : path) {
+				if (!step.dist) { ++pLitFreq[pData_[pos]]; }
+				else {
+					const unsigned lengthCode = tables.lengthCode[step.litLen];
+					const unsigned distCode = tables.DistCode(step.dist);
+					++pLitFreq[257 + lengthCode];
+					++pDistFreq[distCode];
+					bits += kLengthExtra[lengthCode] + kDistExtra[distCode];
+				}
+				pos += step.litLen;
+			}
+			pLitFreq[kEndOfBlock] = 1;
+
+			CostModel model;
+			model.SetFromCounts(pLitFreq, pDistFreq);
+			for (unsigned i{}; i < kLitLenCodes; ++i) { bits += (double)pLitFreq[i] * model.litLen[i]; }
+			for (unsigned i{}; i < kDistCodes; ++i) { bits += (double)pDistFreq[i] * model.dist[i]; }
+			return bits;
+		}
+
+		// Longest candidate at every step; the statistics of this parse seed the first cost model
+		void FindGreedyPath(size_t begin, size_t end, std::vector<Symbol>* pPath) const
+		{
+			const size_t n = end - begin;
+			pPath->clear();
+			for (size_t i{}; i < n;) {
+				Symbol step{ 1, 0 };
+				if (candidateBegin_[i] < candidateBegin_[i + 1]) {
+					const MatchCandidate& longest = candidates_[candidateBegin_[i + 1] - 1];
+					const unsigned length = (unsigned)std::min<size_t>(longest.length, n - i);
+					if (length >= kMinMatch) { step = { (uint16_t)length, longest.dist }; }
+				}
+				pPath->push_back(step);
+				i += step.litLen;
+			}
+		}
+
+		void CompressOptimal(size_t begin)
+		{
+			std::vector<Symbol> path;
+			std::vector<Symbol> bestPath;
+			uint32_t litFreq[kLitLenCodes];
+			uint32_t distFreq[kDistCodes];
+
+			for (size_t chunkBegin = begin; chunkBegin < end_; chunkBegin += kOptimalChunk) {
+				const size_t chunkEnd = std::min(end_, chunkBegin + kOptimalChunk);
+				CollectCandidates(chunkBegin, chunkEnd);
+
+				// Each pass prices symbols by the previous parse; keep whichever parse codes smallest
+				FindGreedyPath(chunkBegin, chunkEnd, &bestPath);
+				double bestBits = CountPath(chunkBegin, bestPath, litFreq, distFreq);
+				CostModel model;
+				for (unsigned pass{}; pass < params_.optimalPasses; ++pass) {
+					model.SetFromCounts(litFreq, distFreq);
+					FindShortestPath(chunkBegin, chunkEnd, model, &path);
+					const double bits = CountPath(chunkBegin, path, litFreq, distFreq);
+					if (bits < bestBits) {
+						bestBits = bits;
+						bestPath.swap(path);
+					}
+				}
+
+				size_t pos = chunkBegin;
+				for (const Symbol& step : bestPath) {
+					if (!step.dist) { EmitLiteral(pos); }
+					else { EmitMatch(pos, step.litLen, step.dist); }
+					pos += step.litLen;
+				}
+			}
+		}
+
+		void Run(size_t begin, bool isFinal)
+		{
+			if (params_.maxChain == 0) {
+				if (begin < end_) { WriteStored(pData_ + begin, end_ - begin, isFinal); }
+				else if (isFinal) { WriteStored(pData_ + begin, 0, true); }
+			}
+			else {
+				Prime(begin);
+				if (params_.optimalPasses) { CompressOptimal(begin); }
+				else if (params_.isLazy) { CompressLazy(begin); }
+				else { CompressGreedy(begin); }
+
+				if (!symbols_.empty() or isFinal) {
+					if (symbols_.empty()) { blockRawBegin_ = end_; }
+					FlushBlock(isFinal);
+				}
+			}
+
+			if (!isFinal) {
+				// Sync flush: empty stored block leaves the range byte-aligned
+				writer_.Put(0, 3);
+				writer_.AlignToByte();
+				writer_.Put(0x0000, 16);
+				writer_.Put(0xFFFF, 16);
+			}
+			writer_.AlignToByte();
+		}
+	};
+
+	// Slicing-by-8 CRC-32 tables
+	struct CrcTables
+	{
+		uint32_t table[8][256];
+
+		CrcTables()
+		{
+			for (uint32_t i{}; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k{}; k < 8; ++k) { c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+				table[0][i] = c;
+			}
+			for (uint32_t i{}; i < 256; ++i) {
+				for (int t = 1; t < 8; ++t) {
+					table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+				}
+			}
+		}
+	};
+}
+
+
+
+uint32_t Deflate::Adler32(uint32_t adler, const uint8_t* pData, size_t cbSize)
+{
+	constexpr uint32_t kBase = 65521;
+	constexpr size_t kMaxRun = 5552;  // Largest run before the 32-bit sums can overflow
+
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while (cbSize) {
+		size_t run = std::min(cbSize, kMaxRun);
+		cbSize -= run;
+#if DEFLATE_SSE2
+		// 16 bytes per step: psadbw sums the bytes for a, weights 16..1 give their share of b
+		if (run >= 16) {
+			const size_t cBlocks = run / 16;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i weightsLow = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+			const __m128i weightsHigh = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+			__m128i sumA = zero;         // Bytes so far in this run
+			__m128i sumPrefixA = zero;   // sumA before each block, added up
+			__m128i sumB = zero;         // Weighted bytes
+			for (size_t i{}; i < cBlocks; ++i, pData += 16) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData));
+				sumPrefixA = _mm_add_epi32(sumPrefixA, sumA);
+				sumA = _mm_add_epi32(sumA, _mm_sad_epu8(v, zero));
+				sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weightsLow));
+				sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weightsHigh));
+			}
+			uint32_t lanesA[4], lanesPrefixA[4], lanesB[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanesA), sumA);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanesPrefixA), sumPrefixA);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanesB), sumB);
+			const uint64_t bytes = (uint64_t)lanesA[0] + lanesA[2];
+			const uint64_t prefix = (uint64_t)lanesPrefixA[0] + lanesPrefixA[2];
+			const uint64_t weighted = (uint64_t)lanesB[0] + lanesB[1] + lanesB[2] + lanesB[3];
+			b = (uint32_t)((b + (uint64_t)a * cBlocks * 16 + prefix * 16 + weighted) % kBase);
+			a = (uint32_t)((a + bytes) % kBase);
+			run -= cBlocks * 16;
+		}
+#endif
+		for (; run >= 8; run -= 8, pData += 8) {
+			a += pData[0]; b += a; a += pData[1]; b += a;
+			a += pData[2]; b += a; a += pData[3]; b += a;
+			a += pData[4]; b += a; a += pData[5]; b += a;
+			a += pData[6]; b += a; a += pData[7]; b += a;
+		}
+		for (; run; --run) { a += *pData++; b += a; }
+		a %= kBase;
+		b %= kBase;
+	}
+	return (b << 16) | a;
+}
+
+uint32_t Deflate::Adler32Combine(uint32_t adler1, uint32_t adler2, size_t cbSize2)
+{
+	constexpr uint32_t kBase = 65521;
+
+	const uint32_t rem = (uint32_t)(cbSize2 % kBase);
+	uint32_t sum1 = adler1 & 0xFFFF;
+	uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % kBase);
+	sum1 += (adler2 & 0xFFFF) + kBase - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + kBase - rem;
+	if (sum1 >= kBase) { sum1 -= kBase; }
+	if (sum1 >= kBase) { sum1 -= kBase; }
+	if (sum2 >= (kBase << 1)) { sum2 -= (kBase << 1); }
+	if (sum2 >= kBase) { sum2 -= kBase; }
+	return sum1 | (sum2 << 16);
+}
+
+uint32_t Deflate::Crc32(uint32_t crc, const uint8_t* pData, size_t cbSize)
+{
+	static const CrcTables tables;
+	const auto& t = tables.table;
+
+	crc = ~crc;
+	for (; cbSize >= 8; cbSize -= 8, pData += 8) {
+		const uint32_t lo = (pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((uint32_t)pData[3] << 24)) ^ crc;
+		const uint32_t hi = pData[4] | (pData[5] << 8) | (pData[6] << 16) | ((uint32_t)pData[7] << 24);
+		crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+			t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+	}
+	for (; cbSize; --cbSize) {
+		crc = t[0][(crc ^ *pData++) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void Deflate::CompressRange(const uint8_t* pData, size_t dictBegin, size_t begin, size_t end,
+	int level, bool isFinal, std::vector<uint8_t>* pOutput)
+{
+	if (!pOutput) { return; }
+	if (level < kMinLevel) { level = kMinLevel; }
+	if (level > kOptimalLevel) { level = kOptimalLevel; }
+	if (dictBegin > begin) { dictBegin = begin; }
+
+	Compressor compressor{ pData, dictBegin, end, level, pOutput };
+	compressor.Run(begin, isFinal);
+}
+
+void Deflate::WriteZlibHeader(int level, std::vector<uint8_t>* pOutput)
+{
+	// CMF = deflate with 32K window; FLG carries the level hint and the check bits
+	const uint8_t flg = level <= 1 ? 0x01 : level <= 5 ? 0x5E : level <= 6 ? 0x9C : 0xDA;
+	pOutput->push_back(0x78);
+	pOutput->push_back(flg);
+}
+
+void Deflate::ZlibCompress(const uint8_t* pData, size_t cbSize, int level, std::vector<uint8_t>* pOutput)
+{
+	if (!pOutput) { return; }
+
+	WriteZlibHeader(level, pOutput);
+	CompressRange(pData, 0, 0, cbSize, level, true, pOutput);
+
+	const uint32_t adler = Adler32(1, pData, cbSize);
+	const uint8_t trailer[4] = { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler };
+	pOutput->insert(pOutput->end(), trailer, trailer + 4);
+}
+
+
+
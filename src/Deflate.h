@@ -0,0 +1,52 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Output buffers
+
+
+
+// Portable DEFLATE (RFC 1951) compressor with zlib (RFC 1950) framing helpers.
+// Ranges of one buffer can be compressed independently on different threads and
+// concatenated into a single valid stream: every range but the last ends with a
+// sync flush (empty stored block), and may use the bytes before it as history.
+namespace Deflate
+{
+	constexpr int kMinLevel = 0;       // Stored blocks only
+	constexpr int kDefaultLevel = 6;
+	constexpr int kMaxLevel = 9;
+	constexpr int kOptimalLevel = 10;  // Iterated shortest-path parsing, for offline recompression only
+	constexpr size_t kWindowSize = 32768;
+
+	// Running checksums, start with Adler32(1, ...) and Crc32(0, ...)
+	uint32_t Adler32(uint32_t adler, const uint8_t* pData, size_t cbSize);
+	uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t cbSize2);
+	uint32_t Crc32(uint32_t crc, const uint8_t* pData, size_t cbSize);
+
+	// Compresses pData[begin, end) as raw deflate blocks appended to pOutput (level 0..kOptimalLevel).
+	// Bytes in [dictBegin, begin) are history that matches may refer to.
+	// isFinal marks the last range of the stream; other ranges end byte-aligned with a sync flush.
+	void CompressRange(const uint8_t* pData, size_t dictBegin, size_t begin, size_t end,
+		int level, bool isFinal, std::vector<uint8_t>* pOutput);
+
+	// Two-byte zlib header for the given level
+	void WriteZlibHeader(int level, std::vector<uint8_t>* pOutput);
+
+	// Single-threaded zlib stream: header, deflate data, Adler-32 trailer
+	void ZlibCompress(const uint8_t* pData, size_t cbSize, int level, std::vector<uint8_t>* pOutput);
+}
+
+
+
+
+/*
+Usage example:
+
+	std::vector<uint8_t> compressed;
+	Deflate::ZlibCompress(data.data(), data.size(), Deflate::kDefaultLevel, &compressed);
+
+*/
+
+
+
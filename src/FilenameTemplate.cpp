@@ -0,0 +1,191 @@
+// Implementation-specific headers
+#include "FilenameTemplate.h"
+
+// Standard library headers
+#include <cstring>  // memcpy
+#include <utility>  // move
+
+
+
+// Anonymous namespace for token names and digit formatting
+namespace
+{
+	// Longest owner name written into a file name
+	constexpr size_t kMaxOwner = 64;
+
+	bool IsForbidden(TCHAR c)
+	{
+		return (unsigned)c < 0x20 or c == _T('\\') or c == _T('/') or c == _T(':') or c == _T('*')
+			or c == _T('?') or c == _T('"') or c == _T('<') or c == _T('>') or c == _T('|');
+	}
+
+	bool IsName(const TCHAR* pName, size_t cchName, const char* pszToken)
+	{
+		size_t i{};
+		for (; i < cchName and pszToken[i]; ++i) {
+			if (pName[i] != (TCHAR)pszToken[i]) { return false; }
+		}
+		return i == cchName and !pszToken[i];
+	}
+
+	// At least cDigits decimal digits, zero-padded; returns the end, or NULL past pEnd
+	TCHAR* PutDecimal(TCHAR* p, const TCHAR* pEnd, uint64_t value, unsigned cDigits)
+	{
+		TCHAR digits[20];
+		unsigned cWritten{};
+		do {
+			digits[cWritten++] = (TCHAR)(_T('0') + value % 10);
+			value /= 10;
+		} while (value);
+		while (cWritten < cDigits and cWritten < 20) { digits[cWritten++] = _T('0'); }
+
+		if ((size_t)(pEnd - p) < cWritten) { return NULL; }
+		while (cWritten) { *p++ = digits[--cWritten]; }
+		return p;
+	}
+
+	// The cDigits most significant hex digits
+	TCHAR* PutHex(TCHAR* p, const TCHAR* pEnd, uint64_t value, unsigned cDigits)
+	{
+		if ((size_t)(pEnd - p) < cDigits) { return NULL; }
+		for (unsigned i{}; i < cDigits; ++i) {
+			*p++ = (TCHAR)_T("0123456789abcdef")[(value >> (60 - 4 * i)) & 0xF];
+		}
+		return p;
+	}
+
+	// Executable name without directory and extension, made safe for a file name
+	TCHAR* PutOwner(TCHAR* p, const TCHAR* pEnd, LPCTSTR cszOwner)
+	{
+		if (!cszOwner or !*cszOwner) { cszOwner = _T("unknown"); }
+
+		const TCHAR* pName = cszOwner;
+		const TCHAR* pStop{};
+		for (const TCHAR* pIt = cszOwner; *pIt; ++pIt) {
+			if (*pIt == _T('\\') or *pIt == _T('/')) { pName = pIt + 1; pStop = NULL; }
+			else if (*pIt == _T('.')) { pStop = pIt; }
+		}
+		if (!pStop or pStop == pName) { pStop = pName; while (*pStop) { ++pStop; } }
+
+		for (size_t i{}; pName < pStop and i < kMaxOwner; ++pName, ++i) {
+			if (p == pEnd) { return NULL; }
+			*p++ = IsForbidden(*pName) ? _T('_') : *pName;
+		}
+		return p;
+	}
+}
+
+
+
+void FilenameTemplate::AddLiteral(const TCHAR* pText, size_t cchText)
+{
+	if (!cchText) { return; }
+
+	// Runs of literal text share one segment
+	if (!segments_.empty() and segments_.back().token == Token::Literal
+		and segments_.back().offset + segments_.back().length == text_.size())
+	{
+		segments_.back().length += (uint32_t)cchText;
+	}
+	else {
+		segments_.push_back({ Token::Literal, 0, (uint32_t)text_.size(), (uint32_t)cchText });
+	}
+	text_.insert(text_.end(), pText, pText + cchText);
+}
+
+void FilenameTemplate::AddToken(Token token, unsigned cDigits)
+{
+	segments_.push_back({ token, (uint8_t)cDigits, 0, 0 });
+	if (token == Token::Hash) { isHashUsed_ = true; }
+	if (token == Token::Sequence) { isSequenceUsed_ = true; }
+}
+
+bool FilenameTemplate::Compile(LPCTSTR cszTemplate)
+{
+	if (!cszTemplate or !*cszTemplate) { return false; }
+
+	FilenameTemplate compiled;
+	for (const TCHAR* p = cszTemplate; *p; ) {
+		if ((p[0] == _T('{') and p[1] == _T('{')) or (p[0] == _T('}') and p[1] == _T('}'))) {
+			compiled.AddLiteral(p, 1);
+			p += 2;
+			continue;
+		}
+		if (*p == _T('}') or IsForbidden(*p)) { return false; }
+		if (*p != _T('{')) {
+			compiled.AddLiteral(p++, 1);
+			continue;
+		}
+
+		// {name} or {name:N}
+		const TCHAR* pName = ++p;
+		while (*p and *p != _T('}') and *p != _T(':')) { ++p; }
+		const size_t cchName = (size_t)(p - pName);
+		unsigned cDigits{};
+		if (*p == _T(':')) {
+			for (++p; *p >= _T('0') and *p <= _T('9') and cDigits < 100; ++p) { cDigits = cDigits * 10 + (unsigned)(*p - _T('0')); }
+			if (!cDigits) { return false; }
+		}
+		if (*p++ != _T('}')) { return false; }
+
+		if (IsName(pName, cchName, "date")) {
+			compiled.AddToken(Token::Year, 4);
+			compiled.AddToken(Token::Month, 2);
+			compiled.AddToken(Token::Day, 2);
+		}
+		else if (IsName(pName, cchName, "time")) {
+			compiled.AddToken(Token::Hour, 2);
+			compiled.AddToken(Token::Minute, 2);
+			compiled.AddToken(Token::Second, 2);
+			compiled.AddToken(Token::Millisecond, 3);
+		}
+		else if (IsName(pName, cchName, "year")) { compiled.AddToken(Token::Year, 4); }
+		else if (IsName(pName, cchName, "month")) { compiled.AddToken(Token::Month, 2); }
+		else if (IsName(pName, cchName, "day")) { compiled.AddToken(Token::Day, 2); }
+		else if (IsName(pName, cchName, "hour")) { compiled.AddToken(Token::Hour, 2); }
+		else if (IsName(pName, cchName, "minute")) { compiled.AddToken(Token::Minute, 2); }
+		else if (IsName(pName, cchName, "second")) { compiled.AddToken(Token::Second, 2); }
+		else if (IsName(pName, cchName, "ms")) { compiled.AddToken(Token::Millisecond, 3); }
+		else if (IsName(pName, cchName, "seq")) { compiled.AddToken(Token::Sequence, cDigits ? (cDigits < 20 ? cDigits : 20) : 4); }
+		else if (IsName(pName, cchName, "hash")) { compiled.AddToken(Token::Hash, cDigits ? (cDigits < 16 ? cDigits : 16) : 16); }
+		else if (IsName(pName, cchName, "owner")) { compiled.AddToken(Token::Owner, 0); }
+		else { return false; }
+	}
+
+	*this = std::move(compiled);
+	return true;
+}
+
+size_t FilenameTemplate::Format(const FilenameFields& fields, LPCTSTR cszOwner, LPTSTR szOut, size_t cchOut) const
+{
+	if (!szOut or !cchOut or segments_.empty()) { return 0; }
+
+	TCHAR* p = szOut;
+	const TCHAR* pEnd = szOut + cchOut - 1;  // Room for the terminator
+	for (const Segment& segment : segments_) {
+		switch (segment.token) {
+		case Token::Literal:
+			if ((size_t)(pEnd - p) < segment.length) { p = NULL; break; }
+			memcpy(p, text_.data() + segment.offset, segment.length * sizeof(TCHAR));
+			p += segment.length;
+			break;
+		case Token::Year:        p = PutDecimal(p, pEnd, fields.wYear, segment.cDigits); break;
+		case Token::Month:       p = PutDecimal(p, pEnd, fields.wMonth, segment.cDigits); break;
+		case Token::Day:         p = PutDecimal(p, pEnd, fields.wDay, segment.cDigits); break;
+		case Token::Hour:        p = PutDecimal(p, pEnd, fields.wHour, segment.cDigits); break;
+		case Token::Minute:      p = PutDecimal(p, pEnd, fields.wMinute, segment.cDigits); break;
+		case Token::Second:      p = PutDecimal(p, pEnd, fields.wSecond, segment.cDigits); break;
+		case Token::Millisecond: p = PutDecimal(p, pEnd, fields.wMilliseconds, segment.cDigits); break;
+		case Token::Sequence:    p = PutDecimal(p, pEnd, fields.sequence, segment.cDigits); break;
+		case Token::Hash:        p = PutHex(p, pEnd, fields.contentHash, segment.cDigits); break;
+		case Token::Owner:       p = PutOwner(p, pEnd, cszOwner); break;
+		}
+		if (!p) {
+			szOut[0] = _T('\0');
+			return 0;
+		}
+	}
+
+	*p = _T('\0');
+	return (size_t)(p - szOut);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <vector>   // Compiled segments
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Capture-time values a name is built from
+struct FilenameFields
+{
+	WORD wYear{};
+	WORD wMonth{};
+	WORD wDay{};
+	WORD wHour{};
+	WORD wMinute{};
+	WORD wSecond{};
+	WORD wMilliseconds{};
+	uint64_t sequence{};     // Per-session capture number, never repeated
+	uint64_t contentHash{};  // Dedup key of the content, 0 until it is known
+};
+
+
+
+// Capture file name template, compiled once and formatted without printf.
+// Literal text is copied as is; tokens in braces are replaced:
+//   {date} YYYYMMDD  {time} HHMMSSmmm  {year} {month} {day} {hour} {minute} {second} {ms}
+//   {seq}  the session sequence, at least 4 digits ({seq:N} for N digits)
+//   {hash} the content hash in hex, 16 digits ({hash:N} for its first N)
+//   {owner} the owner executable name without its extension
+// "{{" and "}}" stand for braces. The result is a file name stem: characters that are not
+// allowed in file names are rejected by Compile, and replaced by '_' in the owner name.
+class FilenameTemplate
+{
+private:
+	enum class Token : uint8_t
+	{
+		Literal, Year, Month, Day, Hour, Minute, Second, Millisecond, Sequence, Hash, Owner
+	};
+
+	struct Segment
+	{
+		Token token{};
+		uint8_t cDigits{};     // Width of numbers
+		uint32_t offset{};     // Literal text in text_
+		uint32_t length{};
+	};
+
+	std::vector<TCHAR> text_;
+	std::vector<Segment> segments_;
+	bool isHashUsed_{};
+	bool isSequenceUsed_{};
+
+private:
+	void AddLiteral(const TCHAR* pText, size_t cchText);
+	void AddToken(Token token, unsigned cDigits);
+
+public:
+	// Replaces the template; false (and the previous template kept) if it has an unknown token,
+	// an unmatched brace or a character not allowed in file names
+	bool Compile(LPCTSTR cszTemplate);
+
+	// Writes the stem and its terminator to szOut; returns its length, or 0 if it does not fit
+	// in cchOut characters. cszOwner is the owner path or name, NULL if unknown.
+	size_t Format(const FilenameFields& fields, LPCTSTR cszOwner, LPTSTR szOut, size_t cchOut) const;
+
+	// The name depends on the content hash: the same template formats to the same length
+	// before and after the hash is known
+	bool IsHashUsed() const { return isHashUsed_; }
+
+	// The name has a {seq}: two captures of one session never share it
+	bool IsSequenceUsed() const { return isSequenceUsed_; }
+
+	bool IsEmpty() const { return segments_.empty(); }
+
+};
+
+
+
+
+/*
+Usage example:
+
+	FilenameTemplate name;
+	name.Compile(_T("screenshot_{date}_{time}_{seq}"));
+
+	FilenameFields fields{ 2024, 5, 17, 9, 41, 7, 12, 3 };
+	TCHAR szStem[MAX_PATH];
+	name.Format(fields, NULL, szStem, MAX_PATH);  // "screenshot_20240517_094107012_0003"
+
+	name.Compile(_T("{owner}-{year}-{month}-{day}-{hash:8}"));
+	fields.contentHash = 0x5B0E43F2A1C97D10;
+	name.Format(fields, _T("C:\\Windows\\mspaint.exe"), szStem, MAX_PATH);  // "mspaint-2024-05-17-5b0e43f2"
+
+*/
+
+
+
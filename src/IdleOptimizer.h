@@ -0,0 +1,274 @@
+#pragma once
+
+// Implementation-specific headers
+#include "TStringHash.h"   // tstring
+#include "PngOptimizer.h"  // Lossless re-encode
+#include "TraceZones.h"    // Worker timeline
+
+// Standard library headers
+#include <atomic>     // Stop flag and counters
+#include <deque>      // Pending files
+#include <vector>     // File buffers
+#include <algorithm>  // min
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Tuning knobs of IdleOptimizer
+struct IdleOptimizerOptions
+{
+	UINT cpuBudgetPercent{ 25 };  // Average share of one core, enforced by resting between files
+	UINT idleSeconds{ 30 };       // Time without keyboard or mouse input before a file is started
+	PngOptimizeOptions png{};
+};
+
+
+
+// Background PNG shrinker for finished captures.
+// Files are optimized on one background-priority thread, only while the user is idle, and
+// replaced atomically when the result is smaller; the original timestamps are kept. After
+// each file the worker rests long enough to keep its CPU time within the configured budget.
+class IdleOptimizer
+{
+private:
+	static constexpr DWORD kIdlePollMs = 1000;
+
+	std::deque<tstring> pending_;
+	SRWLOCK lock_ = SRWLOCK_INIT;
+	HANDLE hThread_{};
+	HANDLE hWakeup_{};  // Semaphore, one count per queued file
+	HANDLE hStop_{};    // Manual-reset event, also cuts idle waits and rests short
+	std::atomic<bool> isStopping_{};
+	std::atomic<uint64_t> cbSaved_{};
+	std::atomic<unsigned> cOptimized_{};
+
+	IdleOptimizerOptions options_{};
+	HWND hNotifyWnd_{};
+	UINT uNotifyMsg_{};
+
+private:
+	static DWORD WINAPI WorkerThunk(LPVOID lpParam)
+	{
+		static_cast<IdleOptimizer*>(lpParam)->WorkerLoop();
+		return 0;
+	}
+
+	bool IsUserIdle() const
+	{
+		LASTINPUTINFO lastInput{ sizeof(LASTINPUTINFO) };
+		if (!GetLastInputInfo(&lastInput)) { return true; }
+		return GetTickCount() - lastInput.dwTime >= options_.idleSeconds * 1000;
+	}
+
+	// Sleeps on the stop event; false when stopping
+	bool Rest(DWORD dwMilliseconds) const
+	{
+		return WaitForSingleObject(hStop_, dwMilliseconds) == WAIT_TIMEOUT;
+	}
+
+	static ULONGLONG GetThreadCpuTime()
+	{
+		FILETIME ftCreation{}, ftExit{}, ftKernel{}, ftUser{};
+		if (!GetThreadTimes(GetCurrentThread(), &ftCreation, &ftExit, &ftKernel, &ftUser)) { return 0; }
+
+		const ULONGLONG kernel = ((ULONGLONG)ftKernel.dwHighDateTime << 32) | ftKernel.dwLowDateTime;
+		const ULONGLONG user = ((ULONGLONG)ftUser.dwHighDateTime << 32) | ftUser.dwLowDateTime;
+		return kernel + user;  // 100 ns units
+	}
+
+	// Returns the bytes saved, 0 when the file was left alone
+	uint64_t OptimizeFile(const tstring& path)
+	{
+		HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return 0; }
+
+		BY_HANDLE_FILE_INFORMATION info{};
+		std::vector<uint8_t> original;
+		bool isRead{};
+		if (GetFileInformationByHandle(hFile, &info) and !info.nFileSizeHigh and info.nFileSizeLow) {
+			original.resize(info.nFileSizeLow);
+			DWORD cbRead{};
+			isRead = ReadFile(hFile, original.data(), info.nFileSizeLow, &cbRead, NULL) and cbRead == info.nFileSizeLow;
+		}
+		CloseHandle(hFile);
+		if (!isRead) { return 0; }
+
+		std::vector<uint8_t> optimized;
+		PngOptimizeOptions pngOptions = options_.png;
+		pngOptions.pCancel = &isStopping_;
+		if (!PngOptimizer::Optimize(original.data(), original.size(), pngOptions, &optimized)) { return 0; }
+		if (optimized.size() >= original.size()) { return 0; }
+
+		// Write beside the file, then swap it in with one rename
+		const tstring temporaryPath = path + _T(".optimizing");
+		hFile = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return 0; }
+
+		DWORD cbWritten{};
+		bool isWritten = WriteFile(hFile, optimized.data(), (DWORD)optimized.size(), &cbWritten, NULL) and cbWritten == optimized.size();
+		isWritten = isWritten and SetFileTime(hFile, &info.ftCreationTime, NULL, &info.ftLastWriteTime);
+		isWritten = isWritten and FlushFileBuffers(hFile);
+		CloseHandle(hFile);
+
+		// Leave the file alone if it changed while it was being optimized
+		WIN32_FILE_ATTRIBUTE_DATA current{};
+		const bool isUnchanged = GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &current) and
+			current.nFileSizeLow == info.nFileSizeLow and current.nFileSizeHigh == info.nFileSizeHigh and
+			CompareFileTime(&current.ftLastWriteTime, &info.ftLastWriteTime) == 0;
+
+		if (!isWritten or !isUnchanged or
+			!MoveFileEx(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			DeleteFile(temporaryPath.c_str());
+			return 0;
+		}
+		return original.size() - optimized.size();
+	}
+
+	void WorkerLoop()
+	{
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+		TRACE_THREAD("idle optimizer");
+
+		const HANDLE handles[2] = { hStop_, hWakeup_ };
+		while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+			while (!IsUserIdle()) {
+				if (!Rest(kIdlePollMs)) { break; }
+			}
+			if (isStopping_.load(std::memory_order_acquire)) { break; }
+
+			tstring path;
+			AcquireSRWLockExclusive(&lock_);
+			if (!pending_.empty()) {
+				path = std::move(pending_.front());
+				pending_.pop_front();
+			}
+			ReleaseSRWLockExclusive(&lock_);
+			if (path.empty()) { continue; }
+
+			const ULONGLONG cpuStart = GetThreadCpuTime();
+			const uint64_t cbSaved = OptimizeFile(path);
+			const ULONGLONG cpuUsed = GetThreadCpuTime() - cpuStart;
+
+			if (cbSaved) {
+				cbSaved_ += cbSaved;
+				++cOptimized_;
+				if (hNotifyWnd_) { PostMessage(hNotifyWnd_, uNotifyMsg_, 0, 0); }
+			}
+
+			// Rest so that busy time / (busy + rest) stays at the budget
+			const UINT budget = options_.cpuBudgetPercent;
+			if (budget < 100) {
+				const ULONGLONG restMs = cpuUsed / 10000 * (100 - budget) / budget;
+				if (!Rest((DWORD)std::min<ULONGLONG>(restMs, MAXDWORD - 1))) { break; }
+			}
+		}
+
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+	}
+
+public:
+	~IdleOptimizer()
+	{
+		Stop();
+	}
+
+	// Starts the worker; cbSavedBefore carries the running total over from earlier sessions.
+	// Every file that shrinks posts (uNotifyMsg, 0, 0) to hNotifyWnd.
+	bool Start(const IdleOptimizerOptions& options, uint64_t cbSavedBefore, HWND hNotifyWnd, UINT uNotifyMsg)
+	{
+		if (hThread_) { return false; }
+
+		options_ = options;
+		if (!options_.cpuBudgetPercent) { options_.cpuBudgetPercent = 1; }
+		cbSaved_ = cbSavedBefore;
+		hNotifyWnd_ = hNotifyWnd;
+		uNotifyMsg_ = uNotifyMsg;
+		isStopping_ = false;
+
+		hWakeup_ = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+		hStop_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (hWakeup_ and hStop_) {
+			hThread_ = CreateThread(NULL, 0, WorkerThunk, this, 0, NULL);
+		}
+		if (!hThread_) {
+			if (hWakeup_) { CloseHandle(hWakeup_); }
+			if (hStop_) { CloseHandle(hStop_); }
+			hWakeup_ = hStop_ = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	// Queues a finished PNG; thread-safe
+	bool Enqueue(LPCTSTR cszPath)
+	{
+		if (!cszPath or !hThread_) { return false; }
+
+		AcquireSRWLockExclusive(&lock_);
+		pending_.push_back(cszPath);
+		ReleaseSRWLockExclusive(&lock_);
+
+		ReleaseSemaphore(hWakeup_, 1, NULL);
+		return true;
+	}
+
+	// Abandons the file in progress (it is left untouched) and drops the queue
+	void Stop()
+	{
+		if (!hThread_) { return; }
+
+		isStopping_.store(true, std::memory_order_release);
+		SetEvent(hStop_);
+		WaitForSingleObject(hThread_, INFINITE);
+		CloseHandle(hThread_);
+		CloseHandle(hWakeup_);
+		CloseHandle(hStop_);
+		hThread_ = hWakeup_ = hStop_ = NULL;
+
+		AcquireSRWLockExclusive(&lock_);
+		pending_.clear();
+		ReleaseSRWLockExclusive(&lock_);
+	}
+
+	bool IsRunning() const
+	{
+		return hThread_ != NULL;
+	}
+
+	uint64_t GetBytesSaved() const
+	{
+		return cbSaved_.load(std::memory_order_relaxed);
+	}
+
+	unsigned GetOptimizedCount() const
+	{
+		return cOptimized_.load(std::memory_order_relaxed);
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static IdleOptimizer optimizer;
+	IdleOptimizerOptions options{};
+	options.cpuBudgetPercent = 10;
+	optimizer.Start(options, cbSavedLastSession, hWnd, WM_APP_OPTIMIZER_PROGRESS);
+
+	optimizer.Enqueue(szSavedPngPath);
+
+	// On exit
+	optimizer.Stop();
+	SaveTotal(optimizer.GetBytesSaved());
+
+*/
+
+
+
@@ -0,0 +1,437 @@
+// Implementation-specific headers
+#include "Inflate.h"
+#include "Deflate.h"  // Adler32
+
+// Standard library headers
+#include <cstring>    // memcpy, memset
+#include <algorithm>  // min
+
+
+
+// Anonymous namespace for the format tables
+namespace
+{
+	constexpr size_t kWindowSize = 32768;
+	constexpr size_t kWindowMask = kWindowSize - 1;
+	constexpr unsigned kEndOfBlock = 256;
+
+	constexpr uint16_t kLengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr uint8_t kLengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr uint16_t kDistBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	constexpr uint8_t kDistExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	constexpr uint8_t kCodeLengthOrder[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	unsigned ReverseBits(unsigned code, unsigned cBits)
+	{
+		unsigned reversed{};
+		for (unsigned i{}; i < cBits; ++i) {
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		return reversed;
+	}
+}
+
+
+
+bool Inflater::Huffman::Build(const uint8_t* pLengths, unsigned cSymbols)
+{
+	memset(fast, 0, sizeof(fast));
+	memset(counts, 0, sizeof(counts));
+	for (unsigned i{}; i < cSymbols; ++i) { ++counts[pLengths[i]]; }
+	counts[0] = 0;
+
+	// Over-subscribed sets are invalid; incomplete ones fail only if an unused code shows up
+	int left = 1;
+	for (unsigned len = 1; len < 16; ++len) {
+		left = (left << 1) - counts[len];
+		if (left < 0) { return false; }
+	}
+
+	// First symbol slot and first canonical code per length
+	uint16_t offsets[16]{};
+	uint16_t nextCode[16]{};
+	unsigned code{};
+	for (unsigned len = 1; len < 16; ++len) {
+		offsets[len] = (uint16_t)(offsets[len - 1] + counts[len - 1]);
+		code = (code + counts[len - 1]) << 1;
+		nextCode[len] = (uint16_t)code;
+	}
+
+	for (unsigned symbol{}; symbol < cSymbols; ++symbol) {
+		const unsigned len = pLengths[symbol];
+		if (!len) { continue; }
+
+		symbols[offsets[len]++] = (uint16_t)symbol;
+		const unsigned assigned = nextCode[len]++;
+		if (len <= kFastBits) {
+			const uint16_t entry = (uint16_t)((symbol << 4) | len);
+			for (unsigned i = ReverseBits(assigned, len); i < (1u << kFastBits); i += 1u << len) {
+				fast[i] = entry;
+			}
+		}
+	}
+	return true;
+}
+
+Inflater::Inflater() :
+	window_(kWindowSize)
+{
+}
+
+void Inflater::Reset(bool isZlib)
+{
+	input_.clear();
+	spanIndex_ = 0;
+	spanOffset_ = 0;
+	bitBuffer_ = 0;
+	cBits_ = 0;
+
+	isZlib_ = isZlib;
+	state_ = isZlib ? State::ZlibHeader : State::BlockHeader;
+	status_ = InflateStatus::Ok;
+	isFinalBlock_ = false;
+	cbStoredLeft_ = 0;
+	copyLength_ = 0;
+	copyDist_ = 0;
+	pendingLiteral_ = -1;
+	windowPos_ = 0;
+	cbTotalOut_ = 0;
+	adler_ = 1;
+}
+
+void Inflater::AppendInput(const uint8_t* pData, size_t cbSize)
+{
+	if (pData and cbSize) { input_.push_back({ pData, cbSize }); }
+}
+
+void Inflater::Refill()
+{
+	while (cBits_ <= 56 and spanIndex_ < input_.size()) {
+		const Span& span = input_[spanIndex_];
+		bitBuffer_ |= (uint64_t)span.pData[spanOffset_] << cBits_;
+		cBits_ += 8;
+		if (++spanOffset_ == span.cbSize) {
+			++spanIndex_;
+			spanOffset_ = 0;
+		}
+	}
+}
+
+bool Inflater::Need(unsigned cBits)
+{
+	if (cBits_ < cBits) { Refill(); }
+	return cBits_ >= cBits;
+}
+
+uint32_t Inflater::Bits(unsigned cBits)
+{
+	const uint32_t value = (uint32_t)(bitBuffer_ & ((1ull << cBits) - 1));
+	bitBuffer_ >>= cBits;
+	cBits_ -= cBits;
+	return value;
+}
+
+bool Inflater::Decode(const Huffman& huffman, unsigned* pSymbol)
+{
+	if (cBits_ < 15) { Refill(); }
+
+	const uint16_t entry = huffman.fast[bitBuffer_ & ((1u << Huffman::kFastBits) - 1)];
+	if (entry) {
+		const unsigned len = entry & 15;
+		if (len > cBits_) { Fail(InflateStatus::Truncated); return false; }
+		Bits(len);
+		*pSymbol = entry >> 4;
+		return true;
+	}
+
+	// Longer codes, one bit at a time (deflate sends Huffman codes MSB first)
+	int code{};
+	int first{};
+	int index{};
+	for (unsigned len = 1; len < 16; ++len) {
+		if (len > cBits_) { Fail(InflateStatus::Truncated); return false; }
+		code |= (int)((bitBuffer_ >> (len - 1)) & 1);
+		const int count = huffman.counts[len];
+		if (code - first < count) {
+			Bits(len);
+			*pSymbol = huffman.symbols[index + code - first];
+			return true;
+		}
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	Fail(InflateStatus::Corrupt);
+	return false;
+}
+
+bool Inflater::ReadBlockHeader()
+{
+	if (!Need(3)) { Fail(InflateStatus::Truncated); return false; }
+	isFinalBlock_ = Bits(1) != 0;
+	const unsigned type = Bits(2);
+
+	if (type == 0) {
+		Bits(cBits_ & 7);
+		if (!Need(32)) { Fail(InflateStatus::Truncated); return false; }
+		const unsigned length = Bits(16);
+		const unsigned lengthComplement = Bits(16);
+		if (length != (~lengthComplement & 0xFFFF)) { Fail(InflateStatus::Corrupt); return false; }
+		cbStoredLeft_ = length;
+		state_ = State::Stored;
+		return true;
+	}
+
+	if (type == 1) {
+		uint8_t lengths[288 + 30];
+		for (unsigned i{}; i < 288; ++i) { lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8; }
+		memset(lengths + 288, 5, 30);
+		litLen_.Build(lengths, 288);
+		dist_.Build(lengths + 288, 30);
+		state_ = State::Codes;
+		return true;
+	}
+
+	if (type == 2 and ReadDynamicTables()) {
+		state_ = State::Codes;
+		return true;
+	}
+
+	if (state_ != State::End) { Fail(InflateStatus::Corrupt); }
+	return false;
+}
+
+bool Inflater::ReadDynamicTables()
+{
+	if (!Need(14)) { Fail(InflateStatus::Truncated); return false; }
+	const unsigned cLit = Bits(5) + 257;
+	const unsigned cDist = Bits(5) + 1;
+	const unsigned cCodeLength = Bits(4) + 4;
+	if (cLit > 286 or cDist > 30) { Fail(InflateStatus::Corrupt); return false; }
+
+	uint8_t clLengths[19]{};
+	for (unsigned i{}; i < cCodeLength; ++i) {
+		if (!Need(3)) { Fail(InflateStatus::Truncated); return false; }
+		clLengths[kCodeLengthOrder[i]] = (uint8_t)Bits(3);
+	}
+	Huffman codeLengths;
+	if (!codeLengths.Build(clLengths, 19)) { Fail(InflateStatus::Corrupt); return false; }
+
+	uint8_t lengths[286 + 30]{};
+	for (unsigned i{}; i < cLit + cDist;) {
+		unsigned symbol{};
+		if (!Decode(codeLengths, &symbol)) { return false; }
+
+		if (symbol < 16) {
+			lengths[i++] = (uint8_t)symbol;
+			continue;
+		}
+
+		uint8_t value{};
+		unsigned repeat{};
+		if (symbol == 16) {
+			if (!i) { Fail(InflateStatus::Corrupt); return false; }
+			if (!Need(2)) { Fail(InflateStatus::Truncated); return false; }
+			value = lengths[i - 1];
+			repeat = 3 + Bits(2);
+		}
+		else if (symbol == 17) {
+			if (!Need(3)) { Fail(InflateStatus::Truncated); return false; }
+			repeat = 3 + Bits(3);
+		}
+		else {
+			if (!Need(7)) { Fail(InflateStatus::Truncated); return false; }
+			repeat = 11 + Bits(7);
+		}
+		if (i + repeat > cLit + cDist) { Fail(InflateStatus::Corrupt); return false; }
+		memset(lengths + i, value, repeat);
+		i += repeat;
+	}
+
+	if (!lengths[kEndOfBlock] or !litLen_.Build(lengths, cLit) or !dist_.Build(lengths + cLit, cDist)) {
+		Fail(InflateStatus::Corrupt);
+		return false;
+	}
+	return true;
+}
+
+void Inflater::CopyMatch(uint8_t* pOut, size_t* pcbProduced, size_t cbOut)
+{
+	const size_t cbSpace = cbOut - *pcbProduced;
+	size_t cbLeft = copyLength_ < cbSpace ? copyLength_ : cbSpace;
+	copyLength_ -= (unsigned)cbLeft;
+	uint8_t* pDest = pOut + *pcbProduced;
+	*pcbProduced += cbLeft;
+
+	// Short distances overlap themselves, byte by byte
+	if (copyDist_ < 16) {
+		for (; cbLeft; --cbLeft) {
+			const uint8_t value = window_[(windowPos_ - copyDist_) & kWindowMask];
+			*pDest++ = value;
+			window_[windowPos_] = value;
+			windowPos_ = (windowPos_ + 1) & kWindowMask;
+		}
+		return;
+	}
+
+	// Otherwise in segments that neither overlap nor cross the end of the window
+	while (cbLeft) {
+		const size_t from = (windowPos_ - copyDist_) & kWindowMask;
+		size_t cb = cbLeft < copyDist_ ? cbLeft : copyDist_;
+		if (cb > kWindowSize - from) { cb = kWindowSize - from; }
+		if (cb > kWindowSize - windowPos_) { cb = kWindowSize - windowPos_; }
+		memmove(window_.data() + windowPos_, window_.data() + from, cb);
+		memcpy(pDest, window_.data() + windowPos_, cb);
+		pDest += cb;
+		cbLeft -= cb;
+		windowPos_ = (windowPos_ + cb) & kWindowMask;
+	}
+}
+
+size_t Inflater::Read(uint8_t* pOut, size_t cbOut)
+{
+	size_t cbProduced{};
+	const auto Put = [&](uint8_t value) {
+		pOut[cbProduced++] = value;
+		window_[windowPos_] = value;
+		windowPos_ = (windowPos_ + 1) & kWindowMask;
+	};
+
+	size_t cbChecked{};  // Output already added to the Adler-32
+	bool isOutputFull{};
+	while (state_ != State::End and !isOutputFull) {
+		switch (state_) {
+		case State::ZlibHeader:
+		{
+			if (!Need(16)) { Fail(InflateStatus::Truncated); break; }
+			const unsigned cmf = Bits(8);
+			const unsigned flg = Bits(8);
+			// Deflate with at most a 32K window, valid check bits, no preset dictionary
+			if ((cmf & 15) != 8 or (cmf >> 4) > 7 or (cmf * 256 + flg) % 31 or (flg & 0x20)) {
+				Fail(InflateStatus::Corrupt);
+				break;
+			}
+			state_ = State::BlockHeader;
+			break;
+		}
+
+		case State::BlockHeader:
+			if (isFinalBlock_) {
+				state_ = isZlib_ ? State::Trailer : State::End;
+				if (!isZlib_) { status_ = InflateStatus::Done; }
+				break;
+			}
+			ReadBlockHeader();
+			break;
+
+		case State::Stored:
+			while (cbStoredLeft_ and cbProduced < cbOut) {
+				if (!Need(8)) { Fail(InflateStatus::Truncated); break; }
+				Put((uint8_t)Bits(8));
+				--cbStoredLeft_;
+			}
+			if (state_ == State::End) { break; }
+			if (cbStoredLeft_) { isOutputFull = true; }
+			else { state_ = State::BlockHeader; }
+			break;
+
+		case State::Codes:
+		{
+			if (pendingLiteral_ >= 0) {
+				if (cbProduced == cbOut) { isOutputFull = true; break; }
+				Put((uint8_t)pendingLiteral_);
+				pendingLiteral_ = -1;
+			}
+			if (copyLength_) { CopyMatch(pOut, &cbProduced, cbOut); }
+			if (copyLength_) { isOutputFull = true; break; }
+
+			// Stay here symbol after symbol; one more is decoded once the output is full so that
+			// the end of the last block is seen together with its last byte
+			while (state_ == State::Codes) {
+				unsigned symbol{};
+				if (!Decode(litLen_, &symbol)) { break; }
+
+				if (symbol < kEndOfBlock) {
+					if (cbProduced == cbOut) {
+						pendingLiteral_ = (int)symbol;
+						isOutputFull = true;
+						break;
+					}
+					Put((uint8_t)symbol);
+					continue;
+				}
+				if (symbol == kEndOfBlock) {
+					state_ = State::BlockHeader;
+					break;
+				}
+
+				symbol -= 257;
+				if (symbol >= 29) { Fail(InflateStatus::Corrupt); break; }
+				if (!Need(kLengthExtra[symbol])) { Fail(InflateStatus::Truncated); break; }
+				const unsigned length = kLengthBase[symbol] + Bits(kLengthExtra[symbol]);
+
+				unsigned distCode{};
+				if (!Decode(dist_, &distCode)) { break; }
+				if (distCode >= 30) { Fail(InflateStatus::Corrupt); break; }
+				if (!Need(kDistExtra[distCode])) { Fail(InflateStatus::Truncated); break; }
+				const unsigned dist = kDistBase[distCode] + Bits(kDistExtra[distCode]);
+				if (dist > cbTotalOut_ + cbProduced) { Fail(InflateStatus::Corrupt); break; }
+
+				copyLength_ = length;
+				copyDist_ = dist;
+				CopyMatch(pOut, &cbProduced, cbOut);
+				if (copyLength_) { isOutputFull = true; break; }
+			}
+			break;
+		}
+
+		case State::Trailer:
+		{
+			adler_ = Deflate::Adler32(adler_, pOut + cbChecked, cbProduced - cbChecked);
+			cbChecked = cbProduced;
+
+			Bits(cBits_ & 7);
+			if (!Need(32)) { Fail(InflateStatus::Truncated); break; }
+			uint32_t expected{};
+			for (int i{}; i < 4; ++i) { expected = (expected << 8) | Bits(8); }
+			if (expected != adler_) { Fail(InflateStatus::Corrupt); break; }
+
+			state_ = State::End;
+			status_ = InflateStatus::Done;
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	if (isZlib_ and cbProduced > cbChecked) { adler_ = Deflate::Adler32(adler_, pOut + cbChecked, cbProduced - cbChecked); }
+	cbTotalOut_ += cbProduced;
+	return cbProduced;
+}
+
+bool Inflater::Decompress(const uint8_t* pData, size_t cbSize, size_t cbExpected, std::vector<uint8_t>* pOutput)
+{
+	if (!pData or !pOutput) { return false; }
+
+	Inflater inflater;
+	inflater.AppendInput(pData, cbSize);
+	pOutput->resize(cbExpected);
+	const size_t cbRead = inflater.Read(pOutput->data(), cbExpected);
+	return cbRead == cbExpected and inflater.GetStatus() == InflateStatus::Done;
+}
+
+
+
+
@@ -0,0 +1,120 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Input spans, window
+
+
+
+enum class InflateStatus
+{
+	Ok,         // More output may follow
+	Done,       // Final block decoded (and the zlib trailer verified)
+	Truncated,  // Input ended inside the stream
+	Corrupt     // Invalid code, distance or checksum
+};
+
+
+
+// Pull-based DEFLATE (RFC 1951) decoder with optional zlib (RFC 1950) framing.
+// The compressed stream may be split over several input spans (e.g. PNG IDAT chunks) that
+// must stay valid until decoding ends. Output is produced in caller-sized pieces, so a whole
+// image never has to be inflated at once; only the 32K history window is kept.
+class Inflater
+{
+private:
+	struct Span
+	{
+		const uint8_t* pData;
+		size_t cbSize;
+	};
+
+	// Canonical Huffman code: fast table for short codes, counts/symbols for the rest
+	struct Huffman
+	{
+		static constexpr unsigned kFastBits = 10;
+
+		uint16_t fast[1 << kFastBits]{};  // (symbol << 4) | length, 0 = longer code
+		uint16_t counts[16]{};
+		uint16_t symbols[288]{};
+
+		bool Build(const uint8_t* pLengths, unsigned cSymbols);
+	};
+
+	enum class State { ZlibHeader, BlockHeader, Stored, Codes, Trailer, End };
+
+	std::vector<Span> input_;
+	size_t spanIndex_{};
+	size_t spanOffset_{};
+	uint64_t bitBuffer_{};
+	unsigned cBits_{};
+
+	State state_{ State::ZlibHeader };
+	InflateStatus status_{ InflateStatus::Ok };
+	bool isZlib_{ true };
+	bool isFinalBlock_{};
+	size_t cbStoredLeft_{};
+	unsigned copyLength_{};  // Match bytes still to copy
+	unsigned copyDist_{};
+	int pendingLiteral_{ -1 };  // Literal decoded while the output was full
+
+	Huffman litLen_;
+	Huffman dist_;
+	std::vector<uint8_t> window_;
+	size_t windowPos_{};
+	size_t cbTotalOut_{};
+	uint32_t adler_{ 1 };
+
+private:
+	void Refill();
+	bool Need(unsigned cBits);
+	uint32_t Bits(unsigned cBits);
+	bool Decode(const Huffman& huffman, unsigned* pSymbol);
+	bool ReadBlockHeader();
+	bool ReadDynamicTables();
+	void CopyMatch(uint8_t* pOut, size_t* pcbProduced, size_t cbOut);
+	void Fail(InflateStatus status) { status_ = status; state_ = State::End; }
+
+public:
+	Inflater();
+
+	// Restarts decoding; input spans are dropped
+	void Reset(bool isZlib = true);
+
+	// Appends the next piece of the compressed stream
+	void AppendInput(const uint8_t* pData, size_t cbSize);
+
+	// Writes up to cbOut bytes and returns the count; fewer than cbOut only at the end or on error.
+	// Decoding runs ahead until the next output byte, so the status turns Done with the last byte.
+	size_t Read(uint8_t* pOut, size_t cbOut);
+
+	InflateStatus GetStatus() const { return status_; }
+	size_t GetTotalOut() const { return cbTotalOut_; }
+
+	// Inflates a whole zlib stream of exactly cbExpected bytes
+	static bool Decompress(const uint8_t* pData, size_t cbSize, size_t cbExpected, std::vector<uint8_t>* pOutput);
+
+};
+
+
+
+
+/*
+Usage example:
+
+	Inflater inflater;
+	for (const Chunk& idat : idatChunks) {
+		inflater.AppendInput(idat.pData, idat.cbSize);
+	}
+	while (inflater.Read(row.data(), row.size()) == row.size()) {
+		// ...one filtered scanline...
+	}
+	if (inflater.GetStatus() != InflateStatus::Done) {
+		// Truncated or corrupt
+	}
+
+*/
+
+
+
@@ -0,0 +1,129 @@
+#pragma once
+
+// Standard library headers
+#include <atomic>   // Sequence counters
+#include <cstddef>  // size_t
+#include <cstdint>  // intptr_t
+#include <memory>   // unique_ptr
+
+
+
+// Bounded multi-producer/multi-consumer queue (Dmitry Vyukov's sequence-cell design).
+// Push and Pop never block and never allocate after construction.
+template <typename T>
+class LockFreeQueue
+{
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// Keep producer and consumer counters on separate cache lines
+	static constexpr size_t kCacheLine = 64;
+
+	std::unique_ptr<Cell[]> cells_;
+	size_t mask_{};
+	alignas(kCacheLine) std::atomic<size_t> enqueuePos_{};
+	alignas(kCacheLine) std::atomic<size_t> dequeuePos_{};
+
+public:
+	// Capacity is rounded up to a power of two
+	explicit LockFreeQueue(size_t capacity = 64)
+	{
+		size_t size = 2;
+		while (size < capacity) { size <<= 1; }
+
+		cells_.reset(new Cell[size]);
+		mask_ = size - 1;
+		for (size_t i{}; i < size; ++i) {
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	size_t Capacity() const
+	{
+		return mask_ + 1;
+	}
+
+	// Returns false if the queue is full
+	bool Push(const T& value)
+	{
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells_[pos & mask_];
+			const size_t seq = cell.sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;  // Full
+			}
+			else {
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false if the queue is empty
+	bool Pop(T* pValue)
+	{
+		size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells_[pos & mask_];
+			const size_t seq = cell.sequence.load(std::memory_order_acquire);
+			const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					*pValue = cell.value;
+					cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;  // Empty
+			}
+			else {
+				pos = dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Approximate number of queued items
+	size_t Size() const
+	{
+		const size_t head = dequeuePos_.load(std::memory_order_relaxed);
+		const size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+		return tail >= head ? tail - head : 0;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	LockFreeQueue<CaptureJob*> queue{ 64 };
+
+	// Producer
+	if (!queue.Push(pJob)) { delete pJob; }
+
+	// Consumer
+	CaptureJob* pJob{};
+	while (queue.Pop(&pJob)) { Process(pJob); }
+
+*/
+
+
+
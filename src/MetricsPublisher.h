@@ -0,0 +1,210 @@
+#pragma once
+
+// Implementation-specific headers
+#include "CaptureMetrics.h"  // JSON snapshot
+#include "TStringHash.h"     // tstring
+
+// Standard library headers
+#include <string>  // JSON text
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Serves CaptureMetrics outside the process from one background thread: every client that
+// connects to the named pipe reads one JSON snapshot, then the pipe is closed; and the same
+// snapshot is written to a file at a fixed interval and once more on Stop. Both are optional.
+// The capture path never waits for the publisher: it only reads the metrics' atomic counters.
+class MetricsPublisher
+{
+private:
+	static constexpr DWORD kPipeBufferSize = 64 * 1024;
+	static constexpr DWORD kWriteTimeoutMs = 1000;  // Clients that do not read in time are dropped
+
+	const CaptureMetrics* pMetrics_{};
+	tstring pipeName_;
+	tstring snapshotPath_;
+	DWORD snapshotMs_{};
+	HANDLE hThread_{};
+	HANDLE hStop_{};
+
+private:
+	static DWORD WINAPI PublisherThunk(LPVOID lpParam)
+	{
+		static_cast<MetricsPublisher*>(lpParam)->PublisherLoop();
+		return 0;
+	}
+
+	// New pipe instance waiting for a client; the event is signaled when one connects
+	HANDLE Listen(OVERLAPPED* pOverlapped) const
+	{
+		HANDLE hPipe = CreateNamedPipe(pipeName_.c_str(), PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+			PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, kPipeBufferSize, 0, 0, NULL);
+		if (hPipe == INVALID_HANDLE_VALUE) { return hPipe; }
+
+		ResetEvent(pOverlapped->hEvent);
+		if (!ConnectNamedPipe(hPipe, pOverlapped)) {
+			const DWORD dwError = GetLastError();
+			if (dwError == ERROR_PIPE_CONNECTED) { SetEvent(pOverlapped->hEvent); }
+			else if (dwError != ERROR_IO_PENDING) {
+				CloseHandle(hPipe);
+				return INVALID_HANDLE_VALUE;
+			}
+		}
+		return hPipe;
+	}
+
+	// Writes the snapshot and closes the instance; the client reads what is buffered to the end
+	void Serve(HANDLE hPipe, OVERLAPPED* pOverlapped) const
+	{
+		const std::string json = pMetrics_->ToJson();
+		ResetEvent(pOverlapped->hEvent);
+		DWORD cbWritten{};
+		if (!WriteFile(hPipe, json.data(), (DWORD)json.size(), &cbWritten, pOverlapped)
+			and GetLastError() == ERROR_IO_PENDING
+			and WaitForSingleObject(pOverlapped->hEvent, kWriteTimeoutMs) != WAIT_OBJECT_0)
+		{
+			CancelIo(hPipe);
+			GetOverlappedResult(hPipe, pOverlapped, &cbWritten, TRUE);
+		}
+		CloseHandle(hPipe);
+	}
+
+	void WriteSnapshot() const
+	{
+		if (snapshotPath_.empty()) { return; }
+
+		// Renamed over the previous snapshot, so readers never see half a file
+		const std::string json = pMetrics_->ToJson();
+		const tstring temporaryPath = snapshotPath_ + _T(".partial");
+		HANDLE hFile = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return; }
+
+		DWORD cbWritten{};
+		const bool isWritten = WriteFile(hFile, json.data(), (DWORD)json.size(), &cbWritten, NULL) and cbWritten == json.size();
+		CloseHandle(hFile);
+
+		if (!isWritten or !MoveFileEx(temporaryPath.c_str(), snapshotPath_.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+			DeleteFile(temporaryPath.c_str());
+		}
+	}
+
+	void PublisherLoop()
+	{
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+		OVERLAPPED overlapped{};
+		overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		HANDLE hPipe = INVALID_HANDLE_VALUE;
+		bool isPipeEnabled = !pipeName_.empty() and overlapped.hEvent;
+		ULONGLONG ullNextSnapshotMs = GetTickCount64() + snapshotMs_;
+
+		for (;;) {
+			if (isPipeEnabled and hPipe == INVALID_HANDLE_VALUE) {
+				hPipe = Listen(&overlapped);
+				isPipeEnabled = hPipe != INVALID_HANDLE_VALUE;  // Name taken or pipes unavailable
+			}
+
+			DWORD dwTimeoutMs = INFINITE;
+			if (snapshotMs_ and !snapshotPath_.empty()) {
+				const ULONGLONG ullNowMs = GetTickCount64();
+				dwTimeoutMs = ullNextSnapshotMs > ullNowMs ? (DWORD)(ullNextSnapshotMs - ullNowMs) : 0;
+			}
+
+			const HANDLE handles[2]{ hStop_, overlapped.hEvent };
+			const DWORD dwWait = WaitForMultipleObjects(hPipe != INVALID_HANDLE_VALUE ? 2 : 1, handles, FALSE, dwTimeoutMs);
+			if (dwWait == WAIT_OBJECT_0 or dwWait == WAIT_FAILED) { break; }
+			if (dwWait == WAIT_OBJECT_0 + 1) {
+				Serve(hPipe, &overlapped);
+				hPipe = INVALID_HANDLE_VALUE;
+			}
+
+			if (dwTimeoutMs != INFINITE and GetTickCount64() >= ullNextSnapshotMs) {
+				WriteSnapshot();
+				ullNextSnapshotMs = GetTickCount64() + snapshotMs_;
+			}
+		}
+
+		if (hPipe != INVALID_HANDLE_VALUE) {
+			CancelIo(hPipe);
+			CloseHandle(hPipe);
+		}
+		if (overlapped.hEvent) { CloseHandle(overlapped.hEvent); }
+
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+	}
+
+public:
+	MetricsPublisher() = default;
+	MetricsPublisher(const MetricsPublisher&) = delete;
+	MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+
+	~MetricsPublisher()
+	{
+		Stop();
+	}
+
+	// cszPipeName ("\\.\pipe\<name>") or cszSnapshotPath may be NULL to leave that output off;
+	// dwSnapshotSeconds 0 writes the file on Stop only
+	bool Start(const CaptureMetrics* pMetrics, LPCTSTR cszPipeName, LPCTSTR cszSnapshotPath, DWORD dwSnapshotSeconds)
+	{
+		if (hThread_ or !pMetrics) { return false; }
+		if ((!cszPipeName or !*cszPipeName) and (!cszSnapshotPath or !*cszSnapshotPath)) { return false; }
+
+		pMetrics_ = pMetrics;
+		pipeName_ = cszPipeName ? cszPipeName : _T("");
+		snapshotPath_ = cszSnapshotPath ? cszSnapshotPath : _T("");
+		snapshotMs_ = dwSnapshotSeconds * 1000;
+
+		hStop_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!hStop_) { return false; }
+
+		hThread_ = CreateThread(NULL, 0, PublisherThunk, this, 0, NULL);
+		if (!hThread_) {
+			CloseHandle(hStop_);
+			hStop_ = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	// Closes the pipe and writes the final snapshot
+	void Stop()
+	{
+		if (!hThread_) { return; }
+
+		SetEvent(hStop_);
+		WaitForSingleObject(hThread_, INFINITE);
+		CloseHandle(hThread_);
+		hThread_ = NULL;
+
+		CloseHandle(hStop_);
+		hStop_ = NULL;
+
+		WriteSnapshot();
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static CaptureMetrics metrics;
+	static MetricsPublisher publisher;
+	publisher.Start(&metrics, _T("\\\\.\\pipe\\ClipboardImageSaver.metrics"), szSnapshotPath, 60);
+
+	// From a console:
+	//   type \\.\pipe\ClipboardImageSaver.metrics
+	//   Get-Content \\.\pipe\ClipboardImageSaver.metrics | ConvertFrom-Json
+
+	publisher.Stop();
+
+*/
+
+
+
@@ -0,0 +1,119 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <cstring>  // memcpy
+
+
+
+// Incremental MurmurHash3 (x86, 32-bit). Feeding a buffer in any number of pieces
+// yields the same value as MurmurHash3_32::computeHash over the whole buffer,
+// so the hash can be computed chunk by chunk while the data is copied.
+class MurmurHash3Stream
+{
+private:
+	static constexpr uint32_t c1 = 0xcc9e2d51;
+	static constexpr uint32_t c2 = 0x1b873593;
+
+	uint32_t h1_;
+	uint32_t tail_{};     // Pending bytes, little-endian
+	unsigned cTail_{};    // Number of pending bytes (0-3)
+	size_t cbTotal_{};
+
+private:
+	static uint32_t Rotl(uint32_t x, int r)
+	{
+		return (x << r) | (x >> (32 - r));
+	}
+
+	void MixBlock(uint32_t k1)
+	{
+		k1 *= c1;
+		k1 = Rotl(k1, 15);
+		k1 *= c2;
+
+		h1_ ^= k1;
+		h1_ = Rotl(h1_, 13);
+		h1_ = h1_ * 5 + 0xe6546b64;
+	}
+
+public:
+	explicit MurmurHash3Stream(uint32_t seed = 0) :
+		h1_(seed)
+	{}
+
+	void Update(const void* pData, size_t cbSize)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(pData);
+		cbTotal_ += cbSize;
+
+		// Complete a block left over from the previous call
+		while (cTail_ and cbSize) {
+			tail_ |= (uint32_t)*p++ << (8 * cTail_++);
+			--cbSize;
+			if (cTail_ == 4) {
+				MixBlock(tail_);
+				tail_ = 0;
+				cTail_ = 0;
+			}
+		}
+
+		// Process 4-byte blocks
+		const size_t nblocks = cbSize / 4;
+		for (size_t i{}; i < nblocks; ++i) {
+			uint32_t k1;
+			memcpy(&k1, p + i * 4, sizeof(k1));
+			MixBlock(k1);
+		}
+		p += nblocks * 4;
+		cbSize -= nblocks * 4;
+
+		// Keep the remainder for the next call
+		for (; cbSize; --cbSize) {
+			tail_ |= (uint32_t)*p++ << (8 * cTail_++);
+		}
+	}
+
+	uint32_t Finish() const
+	{
+		uint32_t h1 = h1_;
+
+		if (cTail_) {
+			uint32_t k1 = tail_;
+			k1 *= c1;
+			k1 = Rotl(k1, 15);
+			k1 *= c2;
+			h1 ^= k1;
+		}
+
+		// Finalize the hash
+		h1 ^= (uint32_t)cbTotal_;
+		h1 ^= h1 >> 16;
+		h1 *= 0x85ebca6b;
+		h1 ^= h1 >> 13;
+		h1 *= 0xc2b2ae35;
+		h1 ^= h1 >> 16;
+
+		return h1;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	MurmurHash3Stream hasher;
+	for (SIZE_T cbOffset{}; cbOffset < cbSize; cbOffset += cbChunk) {
+		memcpy(pDest + cbOffset, pSrc + cbOffset, cbChunk);
+		hasher.Update(pDest + cbOffset, cbChunk);
+	}
+	DWORD dwHash = hasher.Finish();
+
+*/
+
+
+
@@ -0,0 +1,216 @@
+#pragma once
+
+// Implementation-specific headers
+#include "TStringHash.h"       // tstring, created directory set
+#include "FilenameTemplate.h"  // Shard directory names
+
+// Standard library headers
+#include <cstring>        // memcpy
+#include <unordered_set>  // Created directories
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Subdirectories captures are spread over
+enum class ShardPolicy : unsigned
+{
+	None,   // Everything in the root
+	Date,   // <root>\YYYY\MM\DD
+	Owner,  // <root>\<owner executable name>
+	Hash    // <root>\<first two hex digits of the content hash>, 256 directories
+};
+
+
+
+// Output root and shard layout of the capture files.
+// FormatDirectory builds "<root>\<shard>\" from the same fields as the file name, so a Hash
+// layout is finished by the worker like a {hash} name. Directories are created on first use
+// by EnsureDirectoryOf and remembered, so a burst into the same shard costs one set lookup per
+// capture instead of a CreateDirectory call. The root is set once, before the workers start;
+// EnsureDirectoryOf may then be called from any thread.
+class OutputLayout
+{
+private:
+	static constexpr size_t kMaxComponents = 3;
+	static constexpr size_t kMaxCreated = 4096;  // The set starts over past this many shards
+
+	TCHAR szRoot_[MAX_PATH]{};  // Full path with its trailing separator
+	size_t cchRoot_{};
+	FilenameTemplate components_[kMaxComponents];
+	size_t cComponents_{};
+	bool isHashUsed_{};
+
+	SRWLOCK lock_ = SRWLOCK_INIT;
+	std::unordered_set<tstring, TStringHash> created_;
+
+private:
+	static bool IsDirectory(LPCTSTR cszPath)
+	{
+		const DWORD dwAttributes = GetFileAttributes(cszPath);
+		return dwAttributes != INVALID_FILE_ATTRIBUTES and (dwAttributes & FILE_ATTRIBUTE_DIRECTORY);
+	}
+
+	// Creates every missing directory of cszDirectory (trailing separator included), root first
+	static bool CreateDirectories(const tstring& directory)
+	{
+		// Past the drive ("C:\") or the share ("\\server\share\"): those cannot be created
+		size_t start = 3;
+		if (directory.compare(0, 2, _T("\\\\")) == 0) {
+			const size_t server = directory.find(_T('\\'), 2);
+			const size_t share = server == tstring::npos ? tstring::npos : directory.find(_T('\\'), server + 1);
+			start = share == tstring::npos ? directory.size() : share + 1;
+		}
+
+		for (size_t separator = directory.find(_T('\\'), start); separator != tstring::npos;
+			separator = directory.find(_T('\\'), separator + 1))
+		{
+			// Existing directories may refuse creation with another error than ERROR_ALREADY_EXISTS
+			const tstring parent = directory.substr(0, separator);
+			if (!CreateDirectory(parent.c_str(), NULL) and GetLastError() != ERROR_ALREADY_EXISTS
+				and !IsDirectory(parent.c_str()))
+			{
+				return false;
+			}
+		}
+
+		return IsDirectory(directory.c_str());
+	}
+
+public:
+	OutputLayout() = default;
+	OutputLayout(const OutputLayout&) = delete;
+	OutputLayout& operator=(const OutputLayout&) = delete;
+
+	// cszRoot may be relative to the working directory; false if it is not a usable path
+	bool Configure(LPCTSTR cszRoot, ShardPolicy policy)
+	{
+		if (!cszRoot or !*cszRoot) { return false; }
+
+		TCHAR szRoot[MAX_PATH]{};
+		DWORD cchRoot = GetFullPathName(cszRoot, MAX_PATH, szRoot, NULL);
+		if (cchRoot == 0 or cchRoot + 1 >= MAX_PATH) { return false; }
+		if (szRoot[cchRoot - 1] != _T('\\')) { szRoot[cchRoot++] = _T('\\'); }
+		szRoot[cchRoot] = _T('\0');
+
+		LPCTSTR cszComponents[kMaxComponents]{};
+		switch (policy) {
+		case ShardPolicy::None:  break;
+		case ShardPolicy::Date:  cszComponents[0] = _T("{year}"); cszComponents[1] = _T("{month}"); cszComponents[2] = _T("{day}"); break;
+		case ShardPolicy::Owner: cszComponents[0] = _T("{owner}"); break;
+		case ShardPolicy::Hash:  cszComponents[0] = _T("{hash:2}"); break;
+		}
+
+		cComponents_ = 0;
+		isHashUsed_ = false;
+		for (LPCTSTR cszComponent : cszComponents) {
+			if (!cszComponent or !components_[cComponents_].Compile(cszComponent)) { break; }
+			isHashUsed_ = isHashUsed_ or components_[cComponents_].IsHashUsed();
+			++cComponents_;
+		}
+
+		_tcscpy_s(szRoot_, szRoot);
+		cchRoot_ = cchRoot;
+
+		AcquireSRWLockExclusive(&lock_);
+		created_.clear();
+		ReleaseSRWLockExclusive(&lock_);
+		return true;
+	}
+
+	// Writes "<root>\<shard>\" and its terminator to szOut; returns its length, or 0 if it does
+	// not fit in cchOut characters
+	size_t FormatDirectory(const FilenameFields& fields, LPCTSTR cszOwner, LPTSTR szOut, size_t cchOut) const
+	{
+		if (!szOut or !cchRoot_ or cchRoot_ >= cchOut) { return 0; }
+
+		memcpy(szOut, szRoot_, (cchRoot_ + 1) * sizeof(TCHAR));
+		size_t cchDirectory = cchRoot_;
+		for (size_t i{}; i < cComponents_; ++i) {
+			const size_t cchComponent = components_[i].Format(fields, cszOwner, szOut + cchDirectory, cchOut - cchDirectory - 1);
+			if (!cchComponent) {
+				szOut[0] = _T('\0');
+				return 0;
+			}
+			cchDirectory += cchComponent;
+			szOut[cchDirectory++] = _T('\\');
+			szOut[cchDirectory] = _T('\0');
+		}
+		return cchDirectory;
+	}
+
+	// Creates the directory of cszPath unless it was created or found before
+	bool EnsureDirectoryOf(LPCTSTR cszPath)
+	{
+		LPCTSTR cszSeparator = cszPath ? _tcsrchr(cszPath, _T('\\')) : NULL;
+		if (!cszSeparator) { return false; }
+		const tstring directory(cszPath, (size_t)(cszSeparator - cszPath) + 1);
+
+		AcquireSRWLockShared(&lock_);
+		const bool isKnown = created_.count(directory) != 0;
+		ReleaseSRWLockShared(&lock_);
+		if (isKnown) { return true; }
+
+		AcquireSRWLockExclusive(&lock_);
+		bool isCreated = created_.count(directory) != 0;
+		if (!isCreated and CreateDirectories(directory)) {
+			if (created_.size() >= kMaxCreated) { created_.clear(); }
+			created_.insert(directory);
+			isCreated = true;
+		}
+		ReleaseSRWLockExclusive(&lock_);
+		return isCreated;
+	}
+
+	// Drops the directory of cszPath from the cache, after it was deleted behind our back
+	void ForgetDirectoryOf(LPCTSTR cszPath)
+	{
+		LPCTSTR cszSeparator = cszPath ? _tcsrchr(cszPath, _T('\\')) : NULL;
+		if (!cszSeparator) { return; }
+
+		AcquireSRWLockExclusive(&lock_);
+		created_.erase(tstring(cszPath, (size_t)(cszSeparator - cszPath) + 1));
+		ReleaseSRWLockExclusive(&lock_);
+	}
+
+	// Full root path with its trailing separator
+	LPCTSTR GetRoot() const { return szRoot_; }
+
+	// The directory depends on the content hash (Hash policy)
+	bool IsHashUsed() const { return isHashUsed_; }
+
+	// "None", "Date", "Owner" or "Hash" (case-insensitive); None for anything else
+	static ShardPolicy ParseShardPolicy(LPCTSTR cszName)
+	{
+		if (cszName and _tcsicmp(cszName, _T("Date")) == 0) { return ShardPolicy::Date; }
+		if (cszName and _tcsicmp(cszName, _T("Owner")) == 0) { return ShardPolicy::Owner; }
+		if (cszName and _tcsicmp(cszName, _T("Hash")) == 0) { return ShardPolicy::Hash; }
+		return ShardPolicy::None;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static OutputLayout layout;
+	layout.Configure(_T("D:\\Captures"), ShardPolicy::Date);
+
+	TCHAR szPath[MAX_PATH];
+	const size_t cchDirectory = layout.FormatDirectory(fields, cszOwner, szPath, MAX_PATH);  // "D:\Captures\2024\05\17\"
+	name.Format(fields, cszOwner, szPath + cchDirectory, MAX_PATH - cchDirectory);
+
+	// Worker, before writing
+	if (layout.EnsureDirectoryOf(szPath)) {
+		writer.Write(szPath, png.data(), png.size());
+	}
+
+*/
+
+
+
@@ -0,0 +1,167 @@
+#pragma once
+
+// Standard library headers
+#include <vector>  // Entries
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+struct OwnerCacheStats
+{
+	UINT64 cLookups{};
+	UINT64 cHits{};
+	UINT64 cEvictions{};  // Least recently used entries dropped for new processes
+	UINT64 cExpired{};    // Entries of exited processes dropped
+};
+
+
+
+// Executable paths of clipboard owners, keyed by process ID.
+// A miss opens the process once, reads its image path and keeps the process handle: while
+// the handle is open Windows cannot give the PID to another process, so a cached PID always
+// names the process it was resolved for and a hit needs no system call at all. Entries of
+// exited processes are swept on misses, which also releases their handles, and the least
+// recently used entry makes room beyond the capacity. Used from the thread that handles
+// clipboard updates only.
+class OwnerCache
+{
+private:
+	struct Entry
+	{
+		DWORD dwProcessId{};
+		HANDLE hProcess{};
+		UINT64 qwLastUsed{};
+		TCHAR szExePath[MAX_PATH]{};
+	};
+
+	std::vector<Entry> entries_;
+	size_t cCapacity_{ 32 };
+	UINT64 qwClock_{};
+	OwnerCacheStats stats_{};
+
+private:
+	// Drops the entries of processes that have exited
+	void Sweep()
+	{
+		for (size_t i = entries_.size(); i-- > 0; ) {
+			if (WaitForSingleObject(entries_[i].hProcess, 0) == WAIT_OBJECT_0) {
+				CloseHandle(entries_[i].hProcess);
+				entries_[i] = entries_.back();
+				entries_.pop_back();
+				++stats_.cExpired;
+			}
+		}
+	}
+
+	bool Resolve(DWORD dwProcessId, Entry* pEntry)
+	{
+		HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, dwProcessId);
+		if (!hProcess) { return false; }
+
+		DWORD dwPathSize = MAX_PATH;
+		if (!QueryFullProcessImageName(hProcess, 0, pEntry->szExePath, &dwPathSize)) {
+			CloseHandle(hProcess);
+			return false;
+		}
+
+		pEntry->dwProcessId = dwProcessId;
+		pEntry->hProcess = hProcess;
+		return true;
+	}
+
+public:
+	OwnerCache() = default;
+	OwnerCache(const OwnerCache&) = delete;
+	OwnerCache& operator=(const OwnerCache&) = delete;
+
+	~OwnerCache()
+	{
+		Clear();
+	}
+
+	void SetCapacity(size_t cCapacity)
+	{
+		cCapacity_ = cCapacity ? cCapacity : 1;
+		while (entries_.size() > cCapacity_) {
+			CloseHandle(entries_.back().hProcess);
+			entries_.pop_back();
+		}
+	}
+
+	// Full executable path, valid until the next call; NULL if the process
+	// cannot be queried
+	LPCTSTR Lookup(DWORD dwProcessId)
+	{
+		if (!dwProcessId) { return NULL; }
+		++stats_.cLookups;
+		++qwClock_;
+
+		for (Entry& entry : entries_) {
+			if (entry.dwProcessId == dwProcessId) {
+				++stats_.cHits;
+				entry.qwLastUsed = qwClock_;
+				return entry.szExePath;
+			}
+		}
+
+		Sweep();
+
+		Entry resolved{};
+		if (!Resolve(dwProcessId, &resolved)) { return NULL; }
+		resolved.qwLastUsed = qwClock_;
+
+		if (entries_.size() < cCapacity_) {
+			entries_.push_back(resolved);
+			return entries_.back().szExePath;
+		}
+
+		Entry* pOldest = &entries_[0];
+		for (Entry& entry : entries_) {
+			if (entry.qwLastUsed < pOldest->qwLastUsed) { pOldest = &entry; }
+		}
+		CloseHandle(pOldest->hProcess);
+		*pOldest = resolved;
+		++stats_.cEvictions;
+		return pOldest->szExePath;
+	}
+
+	void Clear()
+	{
+		for (Entry& entry : entries_) { CloseHandle(entry.hProcess); }
+		entries_.clear();
+	}
+
+	OwnerCacheStats GetStats() const
+	{
+		return stats_;
+	}
+
+	// Percentage of lookups served without a system call
+	UINT GetHitRate() const
+	{
+		return stats_.cLookups ? (UINT)(stats_.cHits * 100 / stats_.cLookups) : 0;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static OwnerCache ownerCache;
+
+	HWND hOwner = GetClipboardOwner();
+	DWORD dwProcessId{};
+	if (hOwner and GetWindowThreadProcessId(hOwner, &dwProcessId)) {
+		LPCTSTR cszExePath = ownerCache.Lookup(dwProcessId);  // "C:\...\chrome.exe", or NULL
+	}
+
+*/
+
+
+
@@ -0,0 +1,257 @@
+#pragma once
+
+// Implementation-specific headers
+#include "TStringHash.h"       // tstring
+#include "WhitelistMatcher.h"  // Compiled rules
+
+// Standard library headers
+#include <vector>  // File buffer
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+#include <shlwapi.h>  // PathRemoveFileSpec
+
+
+
+// Allow and deny rules of one version of the list file
+struct OwnerRules
+{
+	WhitelistMatcher allow;
+	WhitelistMatcher deny;
+};
+
+
+
+// Owner rules kept in a text file of their own, for lists that outgrow the INI value.
+// One rule per line in the WhitelistMatcher syntax; a line starting with '!' is a deny rule,
+// one starting with '#' or ';' a comment. UTF-8 and UTF-16 (with a byte order mark) are read.
+// Each version of the file is compiled into a fresh OwnerRules on a background thread, which
+// watches the file's directory and posts (uNotifyMsg, 0, OwnerRules*) to hNotifyWnd when the
+// file changes. The window takes ownership and swaps the pointer in between two clipboard
+// updates, so matching never waits for a reload and needs no lock.
+class OwnerRuleList
+{
+private:
+	static constexpr DWORD kSettleMs = 200;      // Editors save in several writes
+	static constexpr DWORD kRetryMs = 1000;      // File still locked by its writer
+	static constexpr size_t kMaxFileSize = 64 << 20;
+
+	TCHAR szPath_[MAX_PATH]{};
+	HANDLE hThread_{};
+	HANDLE hStop_{};
+	HWND hNotifyWnd_{};
+	UINT uNotifyMsg_{};
+	WIN32_FILE_ATTRIBUTE_DATA loaded_{};  // Stamp of the version last posted
+
+private:
+	static DWORD WINAPI WatcherThunk(LPVOID lpParam)
+	{
+		static_cast<OwnerRuleList*>(lpParam)->WatcherLoop();
+		return 0;
+	}
+
+	static bool IsSameVersion(const WIN32_FILE_ATTRIBUTE_DATA& a, const WIN32_FILE_ATTRIBUTE_DATA& b)
+	{
+		return CompareFileTime(&a.ftLastWriteTime, &b.ftLastWriteTime) == 0
+			and a.nFileSizeLow == b.nFileSizeLow and a.nFileSizeHigh == b.nFileSizeHigh;
+	}
+
+	// File text as TCHARs, byte order mark removed
+	static bool ReadText(LPCTSTR cszPath, tstring* pText)
+	{
+		HANDLE hFile = CreateFile(cszPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return false; }
+
+		std::vector<char> data;
+		LARGE_INTEGER liSize{};
+		bool isRead = GetFileSizeEx(hFile, &liSize) and liSize.QuadPart < (LONGLONG)kMaxFileSize;
+		if (isRead and liSize.QuadPart > 0) {
+			data.resize((size_t)liSize.QuadPart);
+			DWORD cbRead{};
+			isRead = ReadFile(hFile, data.data(), (DWORD)data.size(), &cbRead, NULL) and cbRead == data.size();
+		}
+		CloseHandle(hFile);
+		if (!isRead) { return false; }
+
+		pText->clear();
+		const size_t cbData = data.size();
+		if (cbData >= 2 and (BYTE)data[0] == 0xFF and (BYTE)data[1] == 0xFE) {
+#ifdef UNICODE
+			pText->assign((const wchar_t*)(data.data() + 2), (cbData - 2) / sizeof(wchar_t));
+#else
+			const int cchWide = (int)((cbData - 2) / sizeof(wchar_t));
+			const int cchText = WideCharToMultiByte(CP_ACP, 0, (LPCWSTR)(data.data() + 2), cchWide, NULL, 0, NULL, NULL);
+			pText->resize((size_t)cchText);
+			if (cchText) { WideCharToMultiByte(CP_ACP, 0, (LPCWSTR)(data.data() + 2), cchWide, &(*pText)[0], cchText, NULL, NULL); }
+#endif
+			return true;
+		}
+
+		const size_t cbBom = cbData >= 3 and (BYTE)data[0] == 0xEF and (BYTE)data[1] == 0xBB and (BYTE)data[2] == 0xBF ? 3 : 0;
+#ifdef UNICODE
+		const int cbUtf8 = (int)(cbData - cbBom);
+		const int cchText = cbUtf8 ? MultiByteToWideChar(CP_UTF8, 0, data.data() + cbBom, cbUtf8, NULL, 0) : 0;
+		pText->resize((size_t)cchText);
+		if (cchText) { MultiByteToWideChar(CP_UTF8, 0, data.data() + cbBom, cbUtf8, &(*pText)[0], cchText); }
+#else
+		pText->assign(data.data() + cbBom, cbData - cbBom);
+#endif
+		return true;
+	}
+
+	void WatcherLoop()
+	{
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+		TCHAR szDirectory[MAX_PATH]{};
+		_tcscpy_s(szDirectory, szPath_);
+		PathRemoveFileSpec(szDirectory);
+		HANDLE hChange = FindFirstChangeNotification(szDirectory, FALSE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+
+		// Without a change handle the file is polled at the retry interval
+		bool isRetryPending = hChange == INVALID_HANDLE_VALUE;
+		for (;;) {
+			const HANDLE handles[2]{ hStop_, hChange };
+			const DWORD cHandles = hChange == INVALID_HANDLE_VALUE ? 1 : 2;
+			const DWORD dwWait = WaitForMultipleObjects(cHandles, handles, FALSE, isRetryPending ? kRetryMs : INFINITE);
+			if (dwWait == WAIT_OBJECT_0 or dwWait == WAIT_FAILED) { break; }
+			if (dwWait == WAIT_OBJECT_0 + 1) {
+				if (WaitForSingleObject(hStop_, kSettleMs) == WAIT_OBJECT_0) { break; }
+				FindNextChangeNotification(hChange);
+			}
+
+			// Most notifications are for other files in the directory (captures, indexes)
+			WIN32_FILE_ATTRIBUTE_DATA current{};
+			const bool isPresent = GetFileAttributesEx(szPath_, GetFileExInfoStandard, &current) != FALSE;
+			isRetryPending = hChange == INVALID_HANDLE_VALUE;
+			if (IsSameVersion(current, loaded_)) { continue; }
+
+			OwnerRules* pRules = new OwnerRules;
+			if (isPresent and !Load(szPath_, pRules)) {
+				delete pRules;
+				isRetryPending = true;
+				continue;
+			}
+			loaded_ = current;
+			if (!PostMessage(hNotifyWnd_, uNotifyMsg_, 0, (LPARAM)pRules)) { delete pRules; }
+		}
+
+		if (hChange != INVALID_HANDLE_VALUE) { FindCloseChangeNotification(hChange); }
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+	}
+
+public:
+	OwnerRuleList() = default;
+	OwnerRuleList(const OwnerRuleList&) = delete;
+	OwnerRuleList& operator=(const OwnerRuleList&) = delete;
+
+	~OwnerRuleList()
+	{
+		Stop();
+	}
+
+	// Compiles the file into *pRules; false if it cannot be read (a missing file included)
+	static bool Load(LPCTSTR cszPath, OwnerRules* pRules)
+	{
+		if (!cszPath or !pRules) { return false; }
+
+		tstring text;
+		if (!ReadText(cszPath, &text)) { return false; }
+
+		tstring allow;
+		tstring deny;
+		allow.reserve(text.size());
+		size_t lineStart{};
+		while (lineStart < text.size()) {
+			size_t lineEnd = text.find_first_of(_T("\r\n"), lineStart);
+			if (lineEnd == tstring::npos) { lineEnd = text.size(); }
+
+			size_t first = lineStart;
+			while (first < lineEnd and (text[first] == _T(' ') or text[first] == _T('\t'))) { ++first; }
+			if (first < lineEnd and text[first] != _T('#') and text[first] != _T(';')) {
+				tstring& rules = text[first] == _T('!') ? deny : allow;
+				if (text[first] == _T('!')) { ++first; }
+				rules.append(text, first, lineEnd - first);
+				rules += _T('\n');
+			}
+			lineStart = lineEnd + 1;
+		}
+
+		pRules->allow.Compile(allow.c_str());
+		pRules->deny.Compile(deny.c_str());
+		return true;
+	}
+
+	// Watches cszPath and posts every new version, starting with the next change.
+	// The version the caller loaded itself should be current when this is called.
+	bool Start(LPCTSTR cszPath, HWND hNotifyWnd, UINT uNotifyMsg)
+	{
+		if (hThread_ or !cszPath or !*cszPath or !hNotifyWnd) { return false; }
+
+		_tcscpy_s(szPath_, cszPath);
+		hNotifyWnd_ = hNotifyWnd;
+		uNotifyMsg_ = uNotifyMsg;
+		loaded_ = {};
+		GetFileAttributesEx(szPath_, GetFileExInfoStandard, &loaded_);
+
+		hStop_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!hStop_) { return false; }
+
+		hThread_ = CreateThread(NULL, 0, WatcherThunk, this, 0, NULL);
+		if (!hThread_) {
+			CloseHandle(hStop_);
+			hStop_ = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	// Versions already posted stay with the window's message queue
+	void Stop()
+	{
+		if (!hThread_) { return; }
+
+		SetEvent(hStop_);
+		WaitForSingleObject(hThread_, INFINITE);
+		CloseHandle(hThread_);
+		hThread_ = NULL;
+
+		CloseHandle(hStop_);
+		hStop_ = NULL;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	// ClipboardImageSaver.rules
+	//   # Allowed everywhere
+	//   mspaint.exe
+	//   C:\Tools\*
+	//   # Never captured, even if allowed
+	//   !keepass*.exe
+
+	static OwnerRules* pRules = new OwnerRules;
+	static OwnerRuleList ruleList;
+	OwnerRuleList::Load(szRulesPath, pRules);
+	ruleList.Start(szRulesPath, hWnd, WM_APP_RULES_RELOADED);
+
+	// WndProc
+	case WM_APP_RULES_RELOADED:
+		delete pRules;
+		pRules = (OwnerRules*)lParam;
+		break;
+
+	bool isAllowed = !pRules->deny.IsMatch(cszOwner) and pRules->allow.IsMatch(cszOwner);
+
+*/
+
+
+
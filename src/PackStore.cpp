@@ -0,0 +1,513 @@
+// Implementation-specific headers
+#include "PackStore.h"
+#include "Deflate.h"  // Crc32
+
+// Standard library headers
+#include <cstring>  // memcpy, memcmp
+
+// POSIX headers
+#if !defined(_WIN32)
+#include <cerrno>      // EINTR
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat, stat
+#include <unistd.h>    // pread, pwrite, fsync
+#endif
+
+
+
+// Anonymous namespace for the file format and the file primitives of each platform
+namespace
+{
+	using PathString = std::basic_string<TCHAR>;
+
+	// Both files start with a 16-byte header; index entries follow it back to back
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t cbEntry;  // sizeof(PackEntry) in the index, 0 in the pack
+	};
+	static_assert(sizeof(FileHeader) == 16, "FileHeader is an on-disk record");
+
+	constexpr char kPackMagic[8] = { 'C', 'I', 'S', 'P', 'A', 'C', 'K', '1' };
+	constexpr char kIndexMagic[8] = { 'C', 'I', 'S', 'I', 'N', 'D', 'X', '1' };
+	constexpr uint32_t kVersion = 1;
+	constexpr uint64_t kHeaderSize = sizeof(FileHeader);
+	constexpr LPCTSTR kPackExtension = _T(".pack");
+	constexpr LPCTSTR kIndexExtension = _T(".idx");
+
+	uint64_t GetEntryOffset(uint64_t nEntry)
+	{
+		return kHeaderSize + nEntry * sizeof(PackEntry);
+	}
+
+	FileHeader MakeHeader(const char (&magic)[8], uint32_t cbEntry)
+	{
+		FileHeader header{};
+		memcpy(header.magic, magic, sizeof(header.magic));
+		header.version = kVersion;
+		header.cbEntry = cbEntry;
+		return header;
+	}
+
+	bool IsHeader(const FileHeader& header, const char (&magic)[8], uint32_t cbEntry)
+	{
+		return memcmp(header.magic, magic, sizeof(magic)) == 0 and header.version == kVersion and header.cbEntry == cbEntry;
+	}
+
+#if defined(_WIN32)
+	constexpr TCHAR kSeparator = _T('\\');
+
+	// Shared for reading, so that PackReader can map the segment being written
+	intptr_t OpenReadWrite(const PathString& path)
+	{
+		const HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		return hFile == INVALID_HANDLE_VALUE ? -1 : (intptr_t)hFile;
+	}
+
+	void CloseFile(intptr_t hFile)
+	{
+		CloseHandle((HANDLE)hFile);
+	}
+
+	bool GetSize(intptr_t hFile, uint64_t* pcbSize)
+	{
+		LARGE_INTEGER liSize{};
+		if (!GetFileSizeEx((HANDLE)hFile, &liSize)) { return false; }
+		*pcbSize = (uint64_t)liSize.QuadPart;
+		return true;
+	}
+
+	// Positioned reads and writes through the OVERLAPPED offset of a synchronous handle
+	bool ReadAt(intptr_t hFile, uint64_t offset, void* pData, uint32_t cbData)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD cbRead{};
+		return ReadFile((HANDLE)hFile, pData, cbData, &cbRead, &overlapped) and cbRead == cbData;
+	}
+
+	bool WriteAt(intptr_t hFile, uint64_t offset, const void* pData, uint32_t cbData)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD cbWritten{};
+		return WriteFile((HANDLE)hFile, pData, cbData, &cbWritten, &overlapped) and cbWritten == cbData;
+	}
+
+	bool Truncate(intptr_t hFile, uint64_t cbSize)
+	{
+		FILE_END_OF_FILE_INFO endOfFile{};
+		endOfFile.EndOfFile.QuadPart = (LONGLONG)cbSize;
+		return SetFileInformationByHandle((HANDLE)hFile, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)) != FALSE;
+	}
+
+	bool FlushFile(intptr_t hFile)
+	{
+		return FlushFileBuffers((HANDLE)hFile) != FALSE;
+	}
+
+	bool IsFile(const PathString& path)
+	{
+		const DWORD dwAttributes = GetFileAttributes(path.c_str());
+		return dwAttributes != INVALID_FILE_ATTRIBUTES and !(dwAttributes & FILE_ATTRIBUTE_DIRECTORY);
+	}
+#else
+	constexpr TCHAR kSeparator = '/';
+
+	intptr_t OpenReadWrite(const PathString& path)
+	{
+		return open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	}
+
+	void CloseFile(intptr_t hFile)
+	{
+		close((int)hFile);
+	}
+
+	bool GetSize(intptr_t hFile, uint64_t* pcbSize)
+	{
+		struct stat status{};
+		if (fstat((int)hFile, &status) != 0) { return false; }
+		*pcbSize = (uint64_t)status.st_size;
+		return true;
+	}
+
+	bool ReadAt(intptr_t hFile, uint64_t offset, void* pData, uint32_t cbData)
+	{
+		for (uint32_t cbDone{}; cbDone < cbData; ) {
+			const ssize_t cbRead = pread((int)hFile, static_cast<uint8_t*>(pData) + cbDone, cbData - cbDone, (off_t)(offset + cbDone));
+			if (cbRead > 0) { cbDone += (uint32_t)cbRead; }
+			else if (cbRead < 0 and errno == EINTR) { continue; }
+			else { return false; }
+		}
+		return true;
+	}
+
+	bool WriteAt(intptr_t hFile, uint64_t offset, const void* pData, uint32_t cbData)
+	{
+		for (uint32_t cbDone{}; cbDone < cbData; ) {
+			const ssize_t cbWritten = pwrite((int)hFile, static_cast<const uint8_t*>(pData) + cbDone, cbData - cbDone, (off_t)(offset + cbDone));
+			if (cbWritten > 0) { cbDone += (uint32_t)cbWritten; }
+			else if (cbWritten < 0 and errno == EINTR) { continue; }
+			else { return false; }
+		}
+		return true;
+	}
+
+	bool Truncate(intptr_t hFile, uint64_t cbSize)
+	{
+		return ftruncate((int)hFile, (off_t)cbSize) == 0;
+	}
+
+	bool FlushFile(intptr_t hFile)
+	{
+		return fsync((int)hFile) == 0;
+	}
+
+	bool IsFile(const PathString& path)
+	{
+		struct stat status{};
+		return stat(path.c_str(), &status) == 0 and S_ISREG(status.st_mode);
+	}
+#endif
+
+	// Executable name of cszOwner in UTF-8, cut at a character boundary to fit szOut
+	void PutOwner(LPCTSTR cszOwner, char (&szOut)[sizeof(PackEntry::szOwner)])
+	{
+		memset(szOut, 0, sizeof(szOut));
+		if (!cszOwner) { return; }
+
+		LPCTSTR cszName = cszOwner;
+		for (LPCTSTR p = cszOwner; *p; ++p) {
+			if (*p == _T('\\') or *p == _T('/')) { cszName = p + 1; }
+		}
+
+#ifdef UNICODE
+		char szName[MAX_PATH * 3]{};
+		const int cbName = WideCharToMultiByte(CP_UTF8, 0, cszName, -1, szName, (int)sizeof(szName), NULL, NULL);
+		size_t cbCopy = cbName > 0 ? (size_t)cbName - 1 : 0;
+#else
+		const char* szName = cszName;
+		size_t cbCopy = strlen(szName);
+#endif
+		if (cbCopy >= sizeof(szOut)) {
+			cbCopy = sizeof(szOut) - 1;
+			while (cbCopy and ((uint8_t)szName[cbCopy] & 0xC0) == 0x80) { --cbCopy; }
+		}
+		memcpy(szOut, szName, cbCopy);
+	}
+}
+
+
+
+PathString PackWriter::GetSegmentPath(const PathString& directory, unsigned nSegment, LPCTSTR cszExtension)
+{
+	TCHAR szName[32]{};
+	_stprintf_s(szName, _countof(szName), _T("captures-%06u"), nSegment);
+
+	PathString path = directory;
+	if (!path.empty() and path.back() != kSeparator and path.back() != _T('/')) { path += kSeparator; }
+	return path + szName + cszExtension;
+}
+
+bool PackWriter::OpenSegment(unsigned nSegment)
+{
+	hPack_ = OpenReadWrite(GetSegmentPath(directory_, nSegment, kPackExtension));
+	hIndex_ = OpenReadWrite(GetSegmentPath(directory_, nSegment, kIndexExtension));
+	uint64_t cbPack{};
+	uint64_t cbIndex{};
+	if (hPack_ == -1 or hIndex_ == -1 or !GetSize(hPack_, &cbPack) or !GetSize(hIndex_, &cbIndex)) {
+		CloseSegment();
+		return false;
+	}
+
+	// New segment, or one whose headers never made it to the disk
+	uint64_t cEntries{};
+	if (cbPack < kHeaderSize or cbIndex < kHeaderSize) {
+		const FileHeader packHeader = MakeHeader(kPackMagic, 0);
+		const FileHeader indexHeader = MakeHeader(kIndexMagic, sizeof(PackEntry));
+		if (!Truncate(hPack_, 0) or !Truncate(hIndex_, 0)
+			or !WriteAt(hPack_, 0, &packHeader, sizeof(packHeader)) or !WriteAt(hIndex_, 0, &indexHeader, sizeof(indexHeader))
+			or !FlushFile(hPack_) or !FlushFile(hIndex_))
+		{
+			CloseSegment();
+			return false;
+		}
+		cbPack = kHeaderSize;
+	}
+	else {
+		FileHeader packHeader{};
+		FileHeader indexHeader{};
+		if (!ReadAt(hPack_, 0, &packHeader, sizeof(packHeader)) or !ReadAt(hIndex_, 0, &indexHeader, sizeof(indexHeader))
+			or !IsHeader(packHeader, kPackMagic, 0) or !IsHeader(indexHeader, kIndexMagic, sizeof(PackEntry)))
+		{
+			CloseSegment();
+			return false;
+		}
+
+		// Resume after the last entry whose data made it to the disk
+		cEntries = (cbIndex - kHeaderSize) / sizeof(PackEntry);
+		std::vector<uint8_t> data;
+		uint64_t cbValid = kHeaderSize;
+		for (; cEntries; --cEntries) {
+			PackEntry entry{};
+			if (!ReadAt(hIndex_, GetEntryOffset(cEntries - 1), &entry, sizeof(entry))) { continue; }
+			if (entry.offset < kHeaderSize or entry.offset > cbPack or entry.cbData > cbPack - entry.offset) { continue; }
+
+			data.resize(entry.cbData);
+			if (ReadAt(hPack_, entry.offset, data.data(), entry.cbData) and Deflate::Crc32(0, data.data(), data.size()) == entry.crc) {
+				cbValid = entry.offset + entry.cbData;
+				break;
+			}
+		}
+
+		if ((cbIndex != GetEntryOffset(cEntries) and !Truncate(hIndex_, GetEntryOffset(cEntries)))
+			or (cbPack != cbValid and !Truncate(hPack_, cbValid)))
+		{
+			CloseSegment();
+			return false;
+		}
+		cbPack = cbValid;
+	}
+
+	nSegment_ = nSegment;
+	cbPack_ = cbPack;
+	cSegmentEntries_ = cEntries;
+	lastFlush_ = std::chrono::steady_clock::now();
+	isDirty_ = false;
+	cSegments_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void PackWriter::CloseSegment()
+{
+	if (hPack_ != -1) { CloseFile(hPack_); }
+	if (hIndex_ != -1) { CloseFile(hIndex_); }
+	hPack_ = -1;
+	hIndex_ = -1;
+}
+
+bool PackWriter::Flush()
+{
+	if (!isDirty_) { return true; }
+
+	const bool isFlushed = FlushFile(hPack_) and FlushFile(hIndex_);
+	lastFlush_ = std::chrono::steady_clock::now();
+	isDirty_ = !isFlushed;
+	return isFlushed;
+}
+
+bool PackWriter::Open(LPCTSTR cszDirectory, const PackWriterOptions& options)
+{
+	Close();
+	if (!cszDirectory or !*cszDirectory) { return false; }
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	directory_ = cszDirectory;
+	if (directory_.back() != kSeparator and directory_.back() != _T('/')) { directory_ += kSeparator; }
+	options_ = options;
+	if (options_.cbMaxSegment < (1 << 20)) { options_.cbMaxSegment = 1 << 20; }
+
+	unsigned nSegment = 1;
+	while (IsFile(GetSegmentPath(directory_, nSegment + 1, kPackExtension))) { ++nSegment; }
+	return OpenSegment(nSegment);
+}
+
+void PackWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (hPack_ == -1) { return; }
+
+	if (options_.durability != WriteDurability::None) { Flush(); }
+	CloseSegment();
+}
+
+bool PackWriter::Append(const void* pData, size_t cbData, uint64_t contentHash, int64_t timeMs, LPCTSTR cszOwner)
+{
+	if (!pData or !cbData or cbData > UINT32_MAX) { return false; }
+
+	// Everything but the offset is known before taking the lock
+	PackEntry entry{};
+	entry.contentHash = contentHash;
+	entry.timeMs = timeMs;
+	entry.cbData = (uint32_t)cbData;
+	entry.crc = Deflate::Crc32(0, static_cast<const uint8_t*>(pData), cbData);
+	PutOwner(cszOwner, entry.szOwner);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	bool isAppended = hPack_ != -1;
+	if (isAppended and cSegmentEntries_ and cbPack_ + cbData > options_.cbMaxSegment) {
+		Flush();
+		CloseSegment();
+		isAppended = OpenSegment(nSegment_ + 1);
+	}
+
+	// The data reaches the disk first, so that a flushed entry never points at missing data
+	entry.offset = cbPack_;
+	const bool isPerFile = options_.durability == WriteDurability::PerFile;
+	isAppended = isAppended
+		and WriteAt(hPack_, entry.offset, pData, entry.cbData)
+		and (!isPerFile or FlushFile(hPack_))
+		and WriteAt(hIndex_, GetEntryOffset(cSegmentEntries_), &entry, sizeof(entry))
+		and (!isPerFile or FlushFile(hIndex_));
+	if (!isAppended) {
+		cFailed_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	cbPack_ += cbData;
+	++cSegmentEntries_;
+	if (options_.durability == WriteDurability::Group) {
+		isDirty_ = true;
+		if (std::chrono::steady_clock::now() - lastFlush_ >= std::chrono::milliseconds(options_.groupFlushMs)) { Flush(); }
+	}
+
+	cEntries_.fetch_add(1, std::memory_order_relaxed);
+	cbWritten_.fetch_add(cbData, std::memory_order_relaxed);
+	return true;
+}
+
+
+
+#if defined(_WIN32)
+bool PackReader::Map(const PathString& path, View* pView)
+{
+	const HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) { return false; }
+	pView->hFile = (intptr_t)hFile;
+
+	LARGE_INTEGER liSize{};
+	const HANDLE hMapping = GetFileSizeEx(hFile, &liSize) and liSize.QuadPart >= (LONGLONG)kHeaderSize
+		? CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	if (!hMapping) {
+		Unmap(pView);
+		return false;
+	}
+	pView->hMapping = (intptr_t)hMapping;
+
+	pView->pData = static_cast<const uint8_t*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+	pView->cbData = (uint64_t)liSize.QuadPart;
+	if (!pView->pData) {
+		Unmap(pView);
+		return false;
+	}
+	return true;
+}
+
+void PackReader::Unmap(View* pView)
+{
+	if (pView->pData) { UnmapViewOfFile(pView->pData); }
+	if (pView->hMapping != -1) { CloseHandle((HANDLE)pView->hMapping); }
+	if (pView->hFile != -1) { CloseHandle((HANDLE)pView->hFile); }
+	*pView = View{};
+}
+#else
+bool PackReader::Map(const PathString& path, View* pView)
+{
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) { return false; }
+
+	// The mapping outlives the descriptor
+	struct stat status{};
+	void* pMapped = fstat(fd, &status) == 0 and (uint64_t)status.st_size >= kHeaderSize
+		? mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (pMapped == MAP_FAILED) { return false; }
+
+	pView->pData = static_cast<const uint8_t*>(pMapped);
+	pView->cbData = (uint64_t)status.st_size;
+	return true;
+}
+
+void PackReader::Unmap(View* pView)
+{
+	if (pView->pData) { munmap(const_cast<uint8_t*>(pView->pData), (size_t)pView->cbData); }
+	*pView = View{};
+}
+#endif
+
+bool PackReader::Open(LPCTSTR cszDirectory)
+{
+	Close();
+	if (!cszDirectory or !*cszDirectory) { return false; }
+
+	const PathString directory = cszDirectory;
+	for (unsigned nSegment = 1; ; ++nSegment) {
+		Segment segment;
+		segment.nSegment = nSegment;
+		if (!Map(PackWriter::GetSegmentPath(directory, nSegment, kPackExtension), &segment.pack)) { break; }
+		if (!Map(PackWriter::GetSegmentPath(directory, nSegment, kIndexExtension), &segment.index)
+			or !IsHeader(*reinterpret_cast<const FileHeader*>(segment.pack.pData), kPackMagic, 0)
+			or !IsHeader(*reinterpret_cast<const FileHeader*>(segment.index.pData), kIndexMagic, sizeof(PackEntry)))
+		{
+			Unmap(&segment.pack);
+			Unmap(&segment.index);
+			break;
+		}
+
+		// Entries are 8-byte aligned in the mapping: the view starts on a page, the header is 16 bytes
+		const PackEntry* pEntries = reinterpret_cast<const PackEntry*>(segment.index.pData + kHeaderSize);
+		const size_t cEntries = (size_t)((segment.index.cbData - kHeaderSize) / sizeof(PackEntry));
+		for (size_t i{}; i < cEntries; ++i) { items_.push_back({ pEntries + i, segments_.size() }); }
+		segments_.push_back(segment);
+	}
+	return !segments_.empty();
+}
+
+void PackReader::Close()
+{
+	for (Segment& segment : segments_) {
+		Unmap(&segment.pack);
+		Unmap(&segment.index);
+	}
+	segments_.clear();
+	items_.clear();
+}
+
+bool PackReader::GetData(size_t i, const uint8_t** ppData, size_t* pcbData, bool isVerified) const
+{
+	if (i >= items_.size() or !ppData or !pcbData) { return false; }
+
+	// An entry written after the mapping, or by a writer that crashed, may point past its end
+	const PackEntry& entry = *items_[i].pEntry;
+	const View& pack = segments_[items_[i].nSegment].pack;
+	if (entry.codec != 0 or entry.offset < kHeaderSize or entry.offset > pack.cbData
+		or entry.cbData > pack.cbData - entry.offset)
+	{
+		return false;
+	}
+
+	const uint8_t* pData = pack.pData + entry.offset;
+	if (isVerified and Deflate::Crc32(0, pData, entry.cbData) != entry.crc) { return false; }
+
+	*ppData = pData;
+	*pcbData = entry.cbData;
+	return true;
+}
+
+void PackReader::GetOwner(const PackEntry& entry, LPTSTR szOwner, size_t cchOwner)
+{
+	if (!szOwner or !cchOwner) { return; }
+
+	size_t cbOwner{};
+	while (cbOwner < sizeof(entry.szOwner) and entry.szOwner[cbOwner]) { ++cbOwner; }
+	if (!cbOwner) {
+		_tcscpy_s(szOwner, cchOwner, _T("unknown"));
+		return;
+	}
+
+#ifdef UNICODE
+	const int cchDone = MultiByteToWideChar(CP_UTF8, 0, entry.szOwner, (int)cbOwner, szOwner, (int)cchOwner - 1);
+	szOwner[cchDone > 0 ? cchDone : 0] = _T('\0');
+#else
+	const size_t cchCopy = cbOwner < cchOwner ? cbOwner : cchOwner - 1;
+	memcpy(szOwner, entry.szOwner, cchCopy);
+	szOwner[cchCopy] = '\0';
+#endif
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+// Implementation-specific headers
+#include "AtomicFileWriter.h"  // WriteDurability
+
+// Standard library headers
+#include <atomic>   // Counters
+#include <chrono>   // Capture time, group flush interval
+#include <cstdint>  // Fixed-width integers
+#include <mutex>    // Appends
+#include <string>   // Paths
+#include <vector>   // Mapped segments
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Index entry of one capture: 64 bytes, written as is (little-endian hosts only)
+struct PackEntry
+{
+	uint64_t contentHash{};  // Dedup key of the capture
+	uint64_t offset{};       // Of the data in its pack segment
+	int64_t timeMs{};        // Capture time, milliseconds since 1970-01-01 UTC
+	uint32_t cbData{};
+	uint32_t crc{};          // CRC-32 of the data
+	uint32_t codec{};        // 0: stored as encoded (PNG); other values are reserved
+	char szOwner[28]{};      // Owner executable name, UTF-8, truncated and zero-padded
+};
+static_assert(sizeof(PackEntry) == 64, "PackEntry is an on-disk record");
+
+// Tuning knobs of PackWriter
+struct PackWriterOptions
+{
+	WriteDurability durability{ WriteDurability::PerFile };
+	DWORD groupFlushMs{ 1000 };
+	uint64_t cbMaxSegment{ 256ull << 20 };  // A new segment starts past this size
+};
+
+struct PackWriterStats
+{
+	UINT64 cEntries{};
+	UINT64 cbWritten{};
+	UINT64 cFailed{};
+	UINT64 cSegments{};  // Segments opened, the resumed one included
+};
+
+
+
+// Append-only capture storage: captures go one after the other into numbered pack segments
+// ("captures-000001.pack") and each gets a fixed-size entry in the index next to it
+// ("captures-000001.idx"). The data is written before its entry, so an entry never points past
+// what was written; on Open the last segment is resumed after dropping the entries whose data
+// fails its CRC and truncating what no entry covers. PerFile flushes both files before Append
+// returns, Group flushes them on the first append past groupFlushMs and on Close, None leaves
+// them to the system cache. Append is safe to call from several threads; Open and Close are not.
+class PackWriter
+{
+private:
+	using PathString = std::basic_string<TCHAR>;
+
+	std::mutex mutex_;
+	PathString directory_;  // With its trailing separator
+	PackWriterOptions options_{};
+	intptr_t hPack_{ -1 };
+	intptr_t hIndex_{ -1 };
+	unsigned nSegment_{};
+	uint64_t cbPack_{};
+	uint64_t cSegmentEntries_{};
+	std::chrono::steady_clock::time_point lastFlush_{};
+	bool isDirty_{};
+
+	std::atomic<uint64_t> cEntries_{};
+	std::atomic<uint64_t> cbWritten_{};
+	std::atomic<uint64_t> cFailed_{};
+	std::atomic<uint64_t> cSegments_{};
+
+private:
+	bool OpenSegment(unsigned nSegment);
+	void CloseSegment();
+	bool Flush();
+
+public:
+	PackWriter() = default;
+	PackWriter(const PackWriter&) = delete;
+	PackWriter& operator=(const PackWriter&) = delete;
+
+	~PackWriter()
+	{
+		Close();
+	}
+
+	// Resumes the last segment of cszDirectory, or starts the first one; the directory must exist
+	bool Open(LPCTSTR cszDirectory, const PackWriterOptions& options);
+
+	// Flushes and closes the current segment
+	void Close();
+
+	bool IsOpen() const { return hPack_ != -1; }
+
+	// Appends one capture; cszOwner is the owner path or name, NULL if unknown
+	bool Append(const void* pData, size_t cbData, uint64_t contentHash, int64_t timeMs, LPCTSTR cszOwner);
+
+	PackWriterStats GetStats() const
+	{
+		return { cEntries_.load(std::memory_order_relaxed), cbWritten_.load(std::memory_order_relaxed),
+			cFailed_.load(std::memory_order_relaxed), cSegments_.load(std::memory_order_relaxed) };
+	}
+
+	// Current time in the unit of PackEntry::timeMs
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	// "<cszDirectory><separator>captures-NNNNNN<cszExtension>"
+	static PathString GetSegmentPath(const PathString& directory, unsigned nSegment, LPCTSTR cszExtension);
+
+};
+
+
+
+// Read-only view of every segment of a pack directory, memory-mapped: entries and data are
+// read in place, without copies. Segments are mapped at their size when Open runs; captures
+// appended later are seen by the next Open.
+class PackReader
+{
+private:
+	struct View
+	{
+		const uint8_t* pData{};
+		uint64_t cbData{};
+		intptr_t hFile{ -1 };
+		intptr_t hMapping{ -1 };
+	};
+
+	struct Segment
+	{
+		View pack;
+		View index;
+		unsigned nSegment{};
+	};
+
+	struct Item
+	{
+		const PackEntry* pEntry;
+		size_t nSegment;  // In segments_
+	};
+
+	std::vector<Segment> segments_;
+	std::vector<Item> items_;
+
+private:
+	static bool Map(const std::basic_string<TCHAR>& path, View* pView);
+	static void Unmap(View* pView);
+
+public:
+	PackReader() = default;
+	PackReader(const PackReader&) = delete;
+	PackReader& operator=(const PackReader&) = delete;
+
+	~PackReader()
+	{
+		Close();
+	}
+
+	// Maps the segments of cszDirectory, from the first one until one is missing
+	bool Open(LPCTSTR cszDirectory);
+
+	void Close();
+
+	// Entries of every segment, in append order
+	size_t GetCount() const { return items_.size(); }
+
+	const PackEntry& GetEntry(size_t i) const { return *items_[i].pEntry; }
+
+	// Number of the segment file holding entry i
+	unsigned GetSegment(size_t i) const { return segments_[items_[i].nSegment].nSegment; }
+
+	// Points *ppData into the mapped pack; false if the entry is out of its segment or, with
+	// isVerified, if the data fails its CRC
+	bool GetData(size_t i, const uint8_t** ppData, size_t* pcbData, bool isVerified = true) const;
+
+	// Owner name of entry i; "unknown" if the capture had none
+	static void GetOwner(const PackEntry& entry, LPTSTR szOwner, size_t cchOwner);
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static PackWriter pack;
+	pack.Open(_T("D:\\Captures"), PackWriterOptions{ WriteDurability::Group, 1000 });
+
+	// Any thread
+	pack.Append(png.data(), png.size(), qwDedupKey, PackWriter::Now(), cszOwner);
+
+	pack.Close();
+
+	// Later, in another process
+	PackReader reader;
+	reader.Open(_T("D:\\Captures"));
+	for (size_t i{}; i < reader.GetCount(); ++i) {
+		const uint8_t* pPng;
+		size_t cbPng;
+		if (reader.GetData(i, &pPng, &cbPng)) {
+			writer.Write(szPath, pPng, cbPng);
+		}
+	}
+
+*/
+
+
+
@@ -0,0 +1,359 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>    // Fixed-width integers
+#include <cstring>    // memcpy
+#include <cmath>      // cos for the DCT table
+#include <vector>     // Row scratch and tree storage
+#include <algorithm>  // nth_element
+#include <utility>    // pair
+
+// SIMD intrinsics
+#if defined(_M_X64) or defined(__SSE2__) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define PHASH_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+
+// Perceptual fingerprint algorithm
+enum class PerceptualAlgorithm : unsigned
+{
+	DifferenceHash,  // dHash: horizontal gradient signs over a 9x8 grid
+	AverageHash,     // aHash: 8x8 cells compared to the mean
+	DctHash          // pHash: low-frequency DCT coefficients compared to the median
+};
+
+
+
+// Portable perceptual fingerprinting over a downscaled luma plane.
+// Pixels come from a row source (DIBDecoder, PngReader), so every format and orientation the
+// decoders accept gives the same fingerprint for the same picture, and no row is read past
+// what the decoder validated.
+namespace PerceptualHash
+{
+	constexpr int kThumbSize = 32;  // Luma plane side length
+	constexpr int kMaxSampledRows = 256;  // Rows sampled from large sources
+
+	// Writes row y (0 = top) as RGB or RGBA bytes; rows are requested top to bottom, with gaps
+	// on large images. Same signature as PngRowProc and DIBDecoder::ReadRowProc.
+	using RowProc = bool (*)(const void* pContext, uint32_t y, uint8_t* pRow);
+
+	// Number of differing bits between two fingerprints
+	inline unsigned HammingDistance(uint64_t a, uint64_t b)
+	{
+		uint64_t x = a ^ b;
+#if defined(_MSC_VER) and defined(_M_X64)
+		return (unsigned)__popcnt64(x);
+#elif defined(__GNUC__)
+		return (unsigned)__builtin_popcountll(x);
+#else
+		unsigned n{};
+		for (; x; x &= x - 1) { ++n; }
+		return n;
+#endif
+	}
+
+	// Converts one RGBA row to 8-bit luma (BT.601 weights scaled by 256)
+	inline void LumaRowRGBA(const uint8_t* pSrc, uint8_t* pDst, int cPixels)
+	{
+		int x{};
+#ifdef PHASH_USE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+		for (; x + 4 <= cPixels; x += 4) {
+			const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * 4));
+
+			// (R*77 + G*150, B*29) pairs per pixel, then fold each pair
+			__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+			__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+			lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+			hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+			lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+			hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+
+			__m128i y = _mm_srli_epi32(_mm_unpacklo_epi64(lo, hi), 8);
+			y = _mm_packs_epi32(y, y);
+			y = _mm_packus_epi16(y, y);
+			const int packed = _mm_cvtsi128_si32(y);
+			memcpy(pDst + x, &packed, 4);
+		}
+#endif
+		for (; x < cPixels; ++x) {
+			const uint8_t* p = pSrc + x * 4;
+			pDst[x] = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
+		}
+	}
+
+	// Converts one RGB row to 8-bit luma
+	inline void LumaRowRGB(const uint8_t* pSrc, uint8_t* pDst, int cPixels)
+	{
+		for (int x{}; x < cPixels; ++x) {
+			const uint8_t* p = pSrc + x * 3;
+			pDst[x] = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
+		}
+	}
+
+	// Box-downscales an RGB(A) image into a kThumbSize x kThumbSize luma plane.
+	// Rows of large images are sampled so the cost stays flat for 4K/8K captures.
+	inline bool BuildLumaThumbnail(RowProc pfnRow, const void* pContext, uint32_t nWidth, uint32_t nHeight,
+		unsigned nChannels, float (&thumb)[kThumbSize][kThumbSize])
+	{
+		if (!pfnRow or !nWidth or !nHeight) { return false; }
+		if (nChannels != 3 and nChannels != 4) { return false; }
+
+		uint64_t sums[kThumbSize][kThumbSize]{};
+		uint32_t counts[kThumbSize][kThumbSize]{};
+
+		std::vector<uint8_t> row((size_t)nWidth * nChannels);
+		std::vector<uint8_t> luma((size_t)nWidth);
+		std::vector<uint8_t> columnBin((size_t)nWidth);
+		for (uint32_t x{}; x < nWidth; ++x) {
+			columnBin[x] = (uint8_t)((uint64_t)x * kThumbSize / nWidth);
+		}
+
+		const uint32_t nRowStep = nHeight > kMaxSampledRows ? nHeight / kMaxSampledRows : 1;
+		for (uint32_t y{}; y < nHeight; y += nRowStep) {
+			if (!pfnRow(pContext, y, row.data())) { return false; }
+			if (nChannels == 4) { LumaRowRGBA(row.data(), luma.data(), (int)nWidth); }
+			else { LumaRowRGB(row.data(), luma.data(), (int)nWidth); }
+
+			const int nBinY = (int)((uint64_t)y * kThumbSize / nHeight);
+			uint64_t* pSums = sums[nBinY];
+			uint32_t* pCounts = counts[nBinY];
+			for (uint32_t x{}; x < nWidth; ++x) {
+				pSums[columnBin[x]] += luma[x];
+				++pCounts[columnBin[x]];
+			}
+		}
+
+		for (int y{}; y < kThumbSize; ++y) {
+			for (int x{}; x < kThumbSize; ++x) {
+				thumb[y][x] = counts[y][x] ? (float)sums[y][x] / counts[y][x] : 0.0f;
+			}
+		}
+		return true;
+	}
+
+	// Averages a rectangle [x0,x1) x [y0,y1) of the luma plane
+	inline float CellMean(const float (&thumb)[kThumbSize][kThumbSize], int x0, int x1, int y0, int y1)
+	{
+		float sum{};
+		for (int y = y0; y < y1; ++y) {
+			for (int x = x0; x < x1; ++x) { sum += thumb[y][x]; }
+		}
+		return sum / (float)((x1 - x0) * (y1 - y0));
+	}
+
+	inline uint64_t DifferenceHash(const float (&thumb)[kThumbSize][kThumbSize])
+	{
+		float grid[8][9];
+		for (int y{}; y < 8; ++y) {
+			for (int x{}; x < 9; ++x) {
+				grid[y][x] = CellMean(thumb,
+					x * kThumbSize / 9, (x + 1) * kThumbSize / 9,
+					y * kThumbSize / 8, (y + 1) * kThumbSize / 8);
+			}
+		}
+
+		uint64_t hash{};
+		for (int y{}; y < 8; ++y) {
+			for (int x{}; x < 8; ++x) {
+				hash = (hash << 1) | (grid[y][x] < grid[y][x + 1] ? 1 : 0);
+			}
+		}
+		return hash;
+	}
+
+	inline uint64_t AverageHash(const float (&thumb)[kThumbSize][kThumbSize])
+	{
+		constexpr int kCell = kThumbSize / 8;
+
+		float grid[64];
+		float mean{};
+		for (int i{}; i < 64; ++i) {
+			const int x = (i % 8) * kCell;
+			const int y = (i / 8) * kCell;
+			grid[i] = CellMean(thumb, x, x + kCell, y, y + kCell);
+			mean += grid[i];
+		}
+		mean /= 64.0f;
+
+		uint64_t hash{};
+		for (int i{}; i < 64; ++i) {
+			hash = (hash << 1) | (grid[i] > mean ? 1 : 0);
+		}
+		return hash;
+	}
+
+	inline uint64_t DctHash(const float (&thumb)[kThumbSize][kThumbSize])
+	{
+		// cos((2x + 1) * u * PI / 2N) for the 8 lowest frequencies
+		static const auto table = []() {
+			std::vector<float> t(8 * kThumbSize);
+			for (int u{}; u < 8; ++u) {
+				for (int x{}; x < kThumbSize; ++x) {
+					t[u * kThumbSize + x] = (float)cos((2 * x + 1) * u * 3.14159265358979 / (2 * kThumbSize));
+				}
+			}
+			return t;
+		}();
+
+		// Separable transform restricted to the top-left 8x8 block
+		float rows[kThumbSize][8];
+		for (int y{}; y < kThumbSize; ++y) {
+			for (int v{}; v < 8; ++v) {
+				float sum{};
+				for (int x{}; x < kThumbSize; ++x) { sum += thumb[y][x] * table[v * kThumbSize + x]; }
+				rows[y][v] = sum;
+			}
+		}
+
+		float coeffs[64];
+		for (int u{}; u < 8; ++u) {
+			for (int v{}; v < 8; ++v) {
+				float sum{};
+				for (int y{}; y < kThumbSize; ++y) { sum += rows[y][v] * table[u * kThumbSize + y]; }
+				coeffs[u * 8 + v] = sum;
+			}
+		}
+
+		// Median of the AC coefficients
+		float sorted[63];
+		memcpy(sorted, coeffs + 1, sizeof(sorted));
+		std::nth_element(sorted, sorted + 31, sorted + 63);
+		const float median = sorted[31];
+
+		uint64_t hash{};
+		for (int i{}; i < 64; ++i) {
+			hash = (hash << 1) | (coeffs[i] > median ? 1 : 0);
+		}
+		return hash;
+	}
+
+	// Computes a 64-bit fingerprint of an RGB(A) image of nChannels bytes per pixel
+	inline bool Compute(PerceptualAlgorithm algorithm, RowProc pfnRow, const void* pContext,
+		uint32_t nWidth, uint32_t nHeight, unsigned nChannels, uint64_t* pHash)
+	{
+		if (!pHash) { return false; }
+
+		float thumb[kThumbSize][kThumbSize];
+		if (!BuildLumaThumbnail(pfnRow, pContext, nWidth, nHeight, nChannels, thumb)) { return false; }
+
+		switch (algorithm) {
+		case PerceptualAlgorithm::AverageHash: *pHash = AverageHash(thumb); break;
+		case PerceptualAlgorithm::DctHash:     *pHash = DctHash(thumb); break;
+		default:                               *pHash = DifferenceHash(thumb); break;
+		}
+		return true;
+	}
+}
+
+
+
+// BK-tree over Hamming distance for "anything within N bits?" queries
+class BKTree
+{
+private:
+	struct Node
+	{
+		uint64_t hash;
+		std::vector<std::pair<uint8_t, uint32_t>> children;  // (distance to parent, node index)
+	};
+
+	std::vector<Node> nodes_;
+
+public:
+	size_t Size() const
+	{
+		return nodes_.size();
+	}
+
+	void Clear()
+	{
+		nodes_.clear();
+	}
+
+	// Adds a fingerprint; exact duplicates are stored once
+	void Insert(uint64_t hash)
+	{
+		if (nodes_.empty()) {
+			nodes_.push_back({ hash, {} });
+			return;
+		}
+
+		uint32_t current{};
+		for (;;) {
+			const uint8_t distance = (uint8_t)PerceptualHash::HammingDistance(hash, nodes_[current].hash);
+			if (distance == 0) { return; }
+
+			bool isDescended{};
+			for (const auto& child : nodes_[current].children) {
+				if (child.first == distance) {
+					current = child.second;
+					isDescended = true;
+					break;
+				}
+			}
+			if (!isDescended) {
+				nodes_[current].children.emplace_back(distance, (uint32_t)nodes_.size());
+				nodes_.push_back({ hash, {} });
+				return;
+			}
+		}
+	}
+
+	// Returns true if any stored fingerprint lies within maxDistance bits
+	bool FindWithin(uint64_t hash, unsigned maxDistance, uint64_t* pMatch = nullptr) const
+	{
+		if (nodes_.empty()) { return false; }
+
+		std::vector<uint32_t> stack{ 0 };
+		while (!stack.empty()) {
+			const Node& node = nodes_[stack.back()];
+			stack.pop_back();
+
+			const unsigned distance = PerceptualHash::HammingDistance(hash, node.hash);
+			if (distance <= maxDistance) {
+				if (pMatch) { *pMatch = node.hash; }
+				return true;
+			}
+
+			// Triangle inequality: only subtrees in [d - max, d + max] can match
+			for (const auto& child : node.children) {
+				if (child.first + maxDistance >= distance and child.first <= distance + maxDistance) {
+					stack.push_back(child.second);
+				}
+			}
+		}
+		return false;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	BKTree history;
+
+	DIBDecoder decoder;
+	uint64_t qwPrint{};
+	if (decoder.Open(pbmi, cbSize, NULL, false) and PerceptualHash::Compute(PerceptualAlgorithm::DifferenceHash,
+		DIBDecoder::ReadRowProc, &decoder, decoder.GetWidth(), decoder.GetHeight(), decoder.GetChannels(), &qwPrint))
+	{
+		if (!history.FindWithin(qwPrint, 4)) {
+			// ...new image...
+			history.Insert(qwPrint);
+		}
+	}
+
+*/
+
+
+
@@ -0,0 +1,383 @@
+// Implementation-specific headers
+#include "PixelConvert.h"
+
+// Standard library headers
+#include <cstring>  // memcpy, memset
+
+// SIMD intrinsics
+#if defined(_M_X64) or defined(_M_IX86) or defined(__x86_64__) or defined(__i386__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#if defined(_M_X64) or defined(__SSE2__) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define PIXEL_CONVERT_SSE2 1
+#endif
+#if PIXEL_CONVERT_X86
+#define PIXEL_CONVERT_AVX2 1
+#endif
+#if defined(__ARM_NEON) or defined(_M_ARM64)
+#define PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// AVX2 functions are compiled for AVX2 individually and only called after the runtime check
+#if PIXEL_CONVERT_AVX2 and (defined(__GNUC__) or defined(__clang__))
+#define PIXEL_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_CONVERT_TARGET_AVX2
+#endif
+
+
+
+// Anonymous namespace for the per-ISA kernels
+namespace
+{
+	// Scalar reference
+
+	void Bgr24ToRgb24Scalar(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels)
+	{
+		for (size_t i{}; i < cPixels; ++i, pSrc += 3, pDst += 3) {
+			const uint8_t b = pSrc[0];
+			pDst[0] = pSrc[2];
+			pDst[1] = pSrc[1];
+			pDst[2] = b;
+		}
+	}
+
+	void Shuffle32To24Scalar(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		const unsigned r = pOrder[0], g = pOrder[1], b = pOrder[2];
+		for (size_t i{}; i < cPixels; ++i, pSrc += 4, pDst += 3) {
+			pDst[0] = pSrc[r];
+			pDst[1] = pSrc[g];
+			pDst[2] = pSrc[b];
+		}
+	}
+
+	void Shuffle32To32Scalar(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		const unsigned r = pOrder[0], g = pOrder[1], b = pOrder[2], a = pOrder[3];
+		for (size_t i{}; i < cPixels; ++i, pSrc += 4, pDst += 4) {
+			const uint8_t pixel[4] = { pSrc[r], pSrc[g], pSrc[b], pSrc[a] };
+			memcpy(pDst, pixel, 4);  // pSrc may alias pDst
+		}
+	}
+
+	bool IsAlphaZeroScalar(const uint8_t* pSrc, size_t cPixels, unsigned nAlphaByte)
+	{
+		uint8_t any{};
+		for (size_t i{}; i < cPixels; ++i) { any |= pSrc[i * 4 + nAlphaByte]; }
+		return !any;
+	}
+
+	constexpr PixelConvert::Kernels kScalarKernels{
+		PixelIsa::Scalar, Bgr24ToRgb24Scalar, Shuffle32To24Scalar, Shuffle32To32Scalar, IsAlphaZeroScalar };
+
+
+#if PIXEL_CONVERT_SSE2
+	// SSE2 has no byte shuffle; channels are moved with 32-bit lane shifts instead
+
+	__m128i Shuffle32SSE2(__m128i v, const uint8_t* pOrder, unsigned cChannels)
+	{
+		const __m128i byteMask = _mm_set1_epi32(0xFF);
+		__m128i result = _mm_setzero_si128();
+		for (unsigned k{}; k < cChannels; ++k) {
+			const __m128i channel = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(8 * pOrder[k])), byteMask);
+			result = _mm_or_si128(result, _mm_sll_epi32(channel, _mm_cvtsi32_si128(8 * k)));
+		}
+		return result;
+	}
+
+	void Bgr24ToRgb24SSE2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels)
+	{
+		// 5 pixels per 16-byte register: byte j takes j+2, j or j-2 depending on j % 3
+		const __m128i keep = _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0);
+		const __m128i fromRight = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0);
+		const __m128i fromLeft = _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0);
+
+		size_t i{};
+		for (; i + 6 <= cPixels; i += 5) {  // The 16th byte stored is rewritten by the next step
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 3));
+			const __m128i result = _mm_or_si128(_mm_and_si128(v, keep),
+				_mm_or_si128(_mm_and_si128(_mm_srli_si128(v, 2), fromRight), _mm_and_si128(_mm_slli_si128(v, 2), fromLeft)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 3), result);
+		}
+		Bgr24ToRgb24Scalar(pSrc + i * 3, pDst + i * 3, cPixels - i);
+	}
+
+	void Shuffle32To24SSE2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		const __m128i low24 = _mm_set1_epi64x(0x0000000000FFFFFFll);
+		const __m128i high24 = _mm_set1_epi64x(0x0000FFFFFF000000ll);
+
+		size_t i{};
+		for (; i + 6 <= cPixels; i += 4) {  // 12 of the 16 bytes stored are valid
+			const __m128i v = Shuffle32SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4)), pOrder, 3);
+			// Close the gap inside each 64-bit lane, then between the lanes
+			const __m128i pairs = _mm_or_si128(_mm_and_si128(v, low24), _mm_and_si128(_mm_srli_epi64(v, 8), high24));
+			const __m128i result = _mm_or_si128(_mm_move_epi64(pairs), _mm_slli_si128(_mm_srli_si128(pairs, 8), 6));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 3), result);
+		}
+		Shuffle32To24Scalar(pSrc + i * 4, pDst + i * 3, cPixels - i, pOrder);
+	}
+
+	void Shuffle32To32SSE2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		size_t i{};
+		for (; i + 4 <= cPixels; i += 4) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 4), Shuffle32SSE2(v, pOrder, 4));
+		}
+		Shuffle32To32Scalar(pSrc + i * 4, pDst + i * 4, cPixels - i, pOrder);
+	}
+
+	bool IsAlphaZeroSSE2(const uint8_t* pSrc, size_t cPixels, unsigned nAlphaByte)
+	{
+		const __m128i alphaMask = _mm_set1_epi32((int)(0xFFu << (8 * nAlphaByte)));
+		__m128i any = _mm_setzero_si128();
+		size_t i{};
+		for (; i + 4 <= cPixels; i += 4) {
+			any = _mm_or_si128(any, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4)));
+		}
+		any = _mm_and_si128(any, alphaMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF) { return false; }
+		return IsAlphaZeroScalar(pSrc + i * 4, cPixels - i, nAlphaByte);
+	}
+
+	constexpr PixelConvert::Kernels kSSE2Kernels{
+		PixelIsa::SSE2, Bgr24ToRgb24SSE2, Shuffle32To24SSE2, Shuffle32To32SSE2, IsAlphaZeroSSE2 };
+#endif
+
+
+#if PIXEL_CONVERT_AVX2
+	// pshufb control for 8 pixels: output channel k of pixel p reads byte 4p + pOrder[k]
+	PIXEL_CONVERT_TARGET_AVX2
+	__m256i ShuffleControl32(const uint8_t* pOrder, unsigned cChannels)
+	{
+		alignas(32) int8_t control[32];
+		for (unsigned lane{}; lane < 2; ++lane) {
+			int8_t* pLane = control + lane * 16;
+			memset(pLane, -1, 16);  // -1 zeroes the byte
+			for (unsigned p{}; p < 4; ++p) {
+				for (unsigned k{}; k < cChannels; ++k) {
+					pLane[p * cChannels + k] = (int8_t)(p * 4 + pOrder[k]);
+				}
+			}
+		}
+		return _mm256_load_si256(reinterpret_cast<const __m256i*>(control));
+	}
+
+	PIXEL_CONVERT_TARGET_AVX2
+	void Bgr24ToRgb24AVX2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels)
+	{
+		// Each lane holds 4 pixels (12 bytes); lanes are then packed into 24 contiguous bytes
+		const __m256i control = _mm256_setr_epi8(
+			2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+			2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+		const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+		size_t i{};
+		for (; i + 11 <= cPixels; i += 8) {  // 24 of the 32 bytes stored are valid
+			const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 3));
+			const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 3 + 12));
+			const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			const __m256i result = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, control), pack);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 3), result);
+		}
+		Bgr24ToRgb24Scalar(pSrc + i * 3, pDst + i * 3, cPixels - i);
+	}
+
+	PIXEL_CONVERT_TARGET_AVX2
+	void Shuffle32To24AVX2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		const __m256i control = ShuffleControl32(pOrder, 3);
+		const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+		size_t i{};
+		for (; i + 11 <= cPixels; i += 8) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i * 4));
+			const __m256i result = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, control), pack);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 3), result);
+		}
+		Shuffle32To24Scalar(pSrc + i * 4, pDst + i * 3, cPixels - i, pOrder);
+	}
+
+	PIXEL_CONVERT_TARGET_AVX2
+	void Shuffle32To32AVX2(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		const __m256i control = ShuffleControl32(pOrder, 4);
+
+		size_t i{};
+		for (; i + 8 <= cPixels; i += 8) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i * 4));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i * 4), _mm256_shuffle_epi8(v, control));
+		}
+		Shuffle32To32Scalar(pSrc + i * 4, pDst + i * 4, cPixels - i, pOrder);
+	}
+
+	PIXEL_CONVERT_TARGET_AVX2
+	bool IsAlphaZeroAVX2(const uint8_t* pSrc, size_t cPixels, unsigned nAlphaByte)
+	{
+		const __m256i alphaMask = _mm256_set1_epi32((int)(0xFFu << (8 * nAlphaByte)));
+		__m256i any = _mm256_setzero_si256();
+		size_t i{};
+		for (; i + 8 <= cPixels; i += 8) {
+			any = _mm256_or_si256(any, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i * 4)));
+		}
+		if (!_mm256_testz_si256(any, alphaMask)) { return false; }
+		return IsAlphaZeroScalar(pSrc + i * 4, cPixels - i, nAlphaByte);
+	}
+
+	constexpr PixelConvert::Kernels kAVX2Kernels{
+		PixelIsa::AVX2, Bgr24ToRgb24AVX2, Shuffle32To24AVX2, Shuffle32To32AVX2, IsAlphaZeroAVX2 };
+#endif
+
+
+#if PIXEL_CONVERT_NEON
+	// Structure loads/stores de-interleave the channels, so any order is a plane swap
+
+	void Bgr24ToRgb24NEON(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels)
+	{
+		size_t i{};
+		for (; i + 16 <= cPixels; i += 16) {
+			uint8x16x3_t v = vld3q_u8(pSrc + i * 3);
+			const uint8x16_t b = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = b;
+			vst3q_u8(pDst + i * 3, v);
+		}
+		Bgr24ToRgb24Scalar(pSrc + i * 3, pDst + i * 3, cPixels - i);
+	}
+
+	void Shuffle32To24NEON(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		size_t i{};
+		for (; i + 16 <= cPixels; i += 16) {
+			const uint8x16x4_t v = vld4q_u8(pSrc + i * 4);
+			uint8x16x3_t result;
+			result.val[0] = v.val[pOrder[0]];
+			result.val[1] = v.val[pOrder[1]];
+			result.val[2] = v.val[pOrder[2]];
+			vst3q_u8(pDst + i * 3, result);
+		}
+		Shuffle32To24Scalar(pSrc + i * 4, pDst + i * 3, cPixels - i, pOrder);
+	}
+
+	void Shuffle32To32NEON(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder)
+	{
+		size_t i{};
+		for (; i + 16 <= cPixels; i += 16) {
+			const uint8x16x4_t v = vld4q_u8(pSrc + i * 4);
+			uint8x16x4_t result;
+			result.val[0] = v.val[pOrder[0]];
+			result.val[1] = v.val[pOrder[1]];
+			result.val[2] = v.val[pOrder[2]];
+			result.val[3] = v.val[pOrder[3]];
+			vst4q_u8(pDst + i * 4, result);
+		}
+		Shuffle32To32Scalar(pSrc + i * 4, pDst + i * 4, cPixels - i, pOrder);
+	}
+
+	bool IsAlphaZeroNEON(const uint8_t* pSrc, size_t cPixels, unsigned nAlphaByte)
+	{
+		uint8x16_t any = vdupq_n_u8(0);
+		size_t i{};
+		for (; i + 16 <= cPixels; i += 16) {
+			any = vorrq_u8(any, vld4q_u8(pSrc + i * 4).val[nAlphaByte]);
+		}
+		uint8_t lanes[16];
+		vst1q_u8(lanes, any);
+		uint8_t reduced{};
+		for (uint8_t lane : lanes) { reduced |= lane; }
+		if (reduced) { return false; }
+		return IsAlphaZeroScalar(pSrc + i * 4, cPixels - i, nAlphaByte);
+	}
+
+	constexpr PixelConvert::Kernels kNEONKernels{
+		PixelIsa::NEON, Bgr24ToRgb24NEON, Shuffle32To24NEON, Shuffle32To32NEON, IsAlphaZeroNEON };
+#endif
+
+
+#if PIXEL_CONVERT_AVX2
+	// CPUID leaf 7 AVX2 bit plus OS support for saving YMM state
+	bool DetectAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4]{};
+		__cpuid(info, 0);
+		if (info[0] < 7) { return false; }
+		__cpuid(info, 1);
+		const bool isOsxsave = (info[2] & (1 << 27)) != 0;
+		const bool isAvx = (info[2] & (1 << 28)) != 0;
+		if (!isOsxsave or !isAvx or (_xgetbv(0) & 0x6) != 0x6) { return false; }
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+}
+
+
+
+bool PixelConvert::IsSupported(PixelIsa isa)
+{
+	switch (isa) {
+	case PixelIsa::Scalar:
+		return true;
+#if PIXEL_CONVERT_SSE2
+	case PixelIsa::SSE2:
+		return true;
+#endif
+#if PIXEL_CONVERT_AVX2
+	case PixelIsa::AVX2: {
+		static const bool isAvx2 = DetectAVX2();
+		return isAvx2;
+	}
+#endif
+#if PIXEL_CONVERT_NEON
+	case PixelIsa::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const PixelConvert::Kernels* PixelConvert::GetKernels(PixelIsa isa)
+{
+	if (!IsSupported(isa)) { return NULL; }
+
+	switch (isa) {
+#if PIXEL_CONVERT_SSE2
+	case PixelIsa::SSE2: return &kSSE2Kernels;
+#endif
+#if PIXEL_CONVERT_AVX2
+	case PixelIsa::AVX2: return &kAVX2Kernels;
+#endif
+#if PIXEL_CONVERT_NEON
+	case PixelIsa::NEON: return &kNEONKernels;
+#endif
+	default: return &kScalarKernels;
+	}
+}
+
+const PixelConvert::Kernels& PixelConvert::GetBestKernels()
+{
+	static const Kernels* pBest = []() {
+		const PixelIsa preferred[] = { PixelIsa::AVX2, PixelIsa::NEON, PixelIsa::SSE2 };
+		for (PixelIsa isa : preferred) {
+			if (const Kernels* pKernels = GetKernels(isa)) { return pKernels; }
+		}
+		return &kScalarKernels;
+	}();
+	return *pBest;
+}
+
+
+
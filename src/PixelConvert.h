@@ -0,0 +1,70 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+
+
+
+// Instruction set a kernel table is built for
+enum class PixelIsa : unsigned
+{
+	Scalar,  // Portable reference
+	SSE2,
+	AVX2,
+	NEON
+};
+
+
+
+// Row conversion kernels from Windows DIB pixel layouts to the byte order PNG expects.
+// 32bpp shuffles take pOrder[k] = source byte of output channel k, so BI_RGB (BGRA),
+// BI_BITFIELDS and CF_DIBV5 masks that are byte-aligned all go through the same kernel.
+// Every SIMD kernel produces exactly the output of the scalar one.
+namespace PixelConvert
+{
+	struct Kernels
+	{
+		PixelIsa isa;
+
+		// 24bpp BGR -> RGB
+		void (*pfnBgr24ToRgb24)(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels);
+
+		// 32bpp -> 3 channels, pOrder[0..2]
+		void (*pfnShuffle32To24)(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder);
+
+		// 32bpp -> 4 channels, pOrder[0..3]
+		void (*pfnShuffle32To32)(const uint8_t* pSrc, uint8_t* pDst, size_t cPixels, const uint8_t* pOrder);
+
+		// True if byte nAlphaByte of every 32bpp pixel is zero (the "no alpha" 32bpp BI_RGB case)
+		bool (*pfnIsAlphaZero)(const uint8_t* pSrc, size_t cPixels, unsigned nAlphaByte);
+	};
+
+	// True if the kernels were compiled in and the CPU/OS can run them
+	bool IsSupported(PixelIsa isa);
+
+	// Kernel table for one instruction set, or NULL if unsupported
+	const Kernels* GetKernels(PixelIsa isa);
+
+	// Fastest supported table, chosen once per process
+	const Kernels& GetBestKernels();
+}
+
+
+
+
+/*
+Usage example:
+
+	const PixelConvert::Kernels& kernels = PixelConvert::GetBestKernels();
+	const uint8_t bgraToRgba[4] = { 2, 1, 0, 3 };
+	kernels.pfnShuffle32To32(pDibRow, pPngRow, width, bgraToRgba);
+
+	// Verify against the reference
+	const PixelConvert::Kernels* pScalar = PixelConvert::GetKernels(PixelIsa::Scalar);
+	pScalar->pfnShuffle32To32(pDibRow, pExpected, width, bgraToRgba);
+
+*/
+
+
+
@@ -0,0 +1,213 @@
+// Implementation-specific headers
+#include "PixelKey.h"
+#include "DIBDecoder.h"  // Every DIB variant as RGB(A) rows
+#include "PngReader.h"   // Streaming PNG rows
+
+// Standard library headers
+#include <cstring>  // memcpy
+#include <vector>   // Row buffers
+#include <new>      // bad_alloc
+
+
+
+// Anonymous namespace for the canonical stream
+namespace
+{
+	// Width and height, 32-bit little-endian
+	void WriteDimensions(uint8_t* pHeader, uint32_t width, uint32_t height)
+	{
+		for (int i{}; i < 4; ++i) {
+			pHeader[i] = (uint8_t)(width >> (i * 8));
+			pHeader[4 + i] = (uint8_t)(height >> (i * 8));
+		}
+	}
+
+	// Starts the canonical stream with its dimensions
+	void BeginImage(ContentHasher* pHasher, HashAlgorithm algorithm, uint32_t width, uint32_t height)
+	{
+		const uint64_t cbTotal = 8 + (uint64_t)width * height * 4;
+		pHasher->Reset(algorithm, cbTotal);
+
+		uint8_t header[8];
+		WriteDimensions(header, width, height);
+		pHasher->Update(header, sizeof(header));
+	}
+
+	// Sample stream: dimensions, then the rows picked by SampledRow
+	void BeginSample(Xxh3Stream* pStream, uint32_t width, uint32_t height)
+	{
+		pStream->Reset();
+
+		uint8_t header[8];
+		WriteDimensions(header, width, height);
+		pStream->Update(header, sizeof(header));
+	}
+
+	// Row of the i-th sample, the middle of the i-th of kSampleRows equal bands (every row of
+	// short images)
+	uint32_t SampledRow(uint32_t i, uint32_t height)
+	{
+		if (height <= PixelKey::kSampleRows) { return i; }
+		return (uint32_t)(((uint64_t)i * 2 + 1) * height / (PixelKey::kSampleRows * 2));
+	}
+
+	// Clears the color of fully transparent pixels; written branch-free so it vectorizes
+	void ClearTransparent(uint8_t* pRgba, uint32_t width)
+	{
+		for (uint32_t x{}; x < width; ++x, pRgba += 4) {
+			const uint8_t keep = (uint8_t)(0 - (pRgba[3] != 0));
+			pRgba[0] &= keep;
+			pRgba[1] &= keep;
+			pRgba[2] &= keep;
+		}
+	}
+
+	// RGB -> opaque RGBA, back to front so it can run in place
+	void ExpandToRgba(uint8_t* pRow, uint32_t width)
+	{
+		for (uint32_t x = width; x--;) {
+			pRow[x * 4 + 3] = 255;
+			pRow[x * 4 + 2] = pRow[x * 3 + 2];
+			pRow[x * 4 + 1] = pRow[x * 3 + 1];
+			pRow[x * 4 + 0] = pRow[x * 3 + 0];
+		}
+	}
+
+	// Decodes DIB row y in canonical form
+	void ReadCanonicalRow(const DIBDecoder& decoder, uint32_t y, uint8_t* pRow)
+	{
+		decoder.ReadRow(y, pRow);
+		if (decoder.GetChannels() == 4) { ClearTransparent(pRow, decoder.GetWidth()); }
+		else { ExpandToRgba(pRow, decoder.GetWidth()); }
+	}
+}
+
+
+
+bool PixelKey::FromDIB(const BITMAPINFO* pbmi, size_t cbSize, HashAlgorithm algorithm,
+	const PixelConvert::Kernels* pKernels, uint64_t* pqwKey, uint64_t* pqwSample)
+{
+	if (!pbmi or !pqwKey) { return false; }
+
+	DIBDecoder decoder;
+	if (!decoder.Open(pbmi, cbSize, pKernels)) { return false; }
+
+	const uint32_t width = decoder.GetWidth();
+	const uint32_t height = decoder.GetHeight();
+
+	try {
+		std::vector<uint8_t> row((size_t)width * 4);
+		ContentHasher hasher;
+		Xxh3Stream sample;
+		uint32_t nextSample{};
+		BeginImage(&hasher, algorithm, width, height);
+		BeginSample(&sample, width, height);
+		for (uint32_t y{}; y < height; ++y) {
+			ReadCanonicalRow(decoder, y, row.data());
+			hasher.Update(row.data(), row.size());
+			if (pqwSample and nextSample < kSampleRows and y == SampledRow(nextSample, height)) {
+				sample.Update(row.data(), row.size());
+				++nextSample;
+			}
+		}
+		*pqwKey = ContentHash::ToDedupKey(algorithm, hasher.Finish(), (size_t)(8 + (uint64_t)width * height * 4));
+		if (pqwSample) { *pqwSample = sample.Finish64(); }
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+bool PixelKey::FromPNG(const uint8_t* pPng, size_t cbPng, HashAlgorithm algorithm, uint64_t* pqwKey, uint64_t* pqwSample)
+{
+	if (!pPng or !pqwKey) { return false; }
+
+	try {
+		PngReader reader;
+		if (!reader.Open(pPng, cbPng)) { return false; }
+
+		const uint32_t width = reader.GetWidth();
+		const uint32_t height = reader.GetHeight();
+		std::vector<uint8_t> row((size_t)width * 4);
+		ContentHasher hasher;
+		Xxh3Stream sample;
+		uint32_t nextSample{};
+		BeginImage(&hasher, algorithm, width, height);
+		BeginSample(&sample, width, height);
+		for (uint32_t y{}; y < height; ++y) {
+			if (!reader.ReadRow(row.data())) { return false; }
+			ClearTransparent(row.data(), width);
+			hasher.Update(row.data(), row.size());
+			if (pqwSample and nextSample < kSampleRows and y == SampledRow(nextSample, height)) {
+				sample.Update(row.data(), row.size());
+				++nextSample;
+			}
+		}
+		*pqwKey = ContentHash::ToDedupKey(algorithm, hasher.Finish(), (size_t)(8 + (uint64_t)width * height * 4));
+		if (pqwSample) { *pqwSample = sample.Finish64(); }
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+bool PixelKey::SampleDIB(const BITMAPINFO* pbmi, size_t cbSize, const PixelConvert::Kernels* pKernels,
+	uint64_t* pqwSample, uint64_t* pqwAltSample)
+{
+	if (!pbmi or !pqwSample or !pqwAltSample) { return false; }
+
+	// No pass over the whole image for its alpha channel: both readings are hashed instead
+	DIBDecoder decoder;
+	if (!decoder.Open(pbmi, cbSize, pKernels, false)) { return false; }
+
+	const uint32_t width = decoder.GetWidth();
+	const uint32_t height = decoder.GetHeight();
+	const uint32_t cSamples = height < kSampleRows ? height : kSampleRows;
+
+	try {
+		std::vector<uint8_t> row((size_t)width * 4);
+		std::vector<uint8_t> opaqueRow;
+		Xxh3Stream sample;
+		Xxh3Stream opaqueSample;
+		bool isAlphaSeen{};
+		BeginSample(&sample, width, height);
+		BeginSample(&opaqueSample, width, height);
+		for (uint32_t i{}; i < cSamples; ++i) {
+			if (!decoder.IsAlphaPossible()) {
+				ReadCanonicalRow(decoder, SampledRow(i, height), row.data());
+				sample.Update(row.data(), row.size());
+				continue;
+			}
+
+			decoder.ReadRow(SampledRow(i, height), row.data());
+			opaqueRow = row;
+			uint8_t alphaBits{};
+			for (uint32_t x{}; x < width; ++x) {
+				alphaBits |= row[x * 4 + 3];
+				opaqueRow[x * 4 + 3] = 255;
+			}
+			isAlphaSeen = isAlphaSeen or alphaBits;
+			ClearTransparent(row.data(), width);
+			sample.Update(row.data(), row.size());
+			opaqueSample.Update(opaqueRow.data(), opaqueRow.size());
+		}
+
+		// Alpha in the sampled rows settles it; otherwise the image is most likely opaque, unless
+		// the rest of it has alpha and the sampled rows are fully transparent
+		*pqwSample = sample.Finish64();
+		*pqwAltSample = *pqwSample;
+		if (decoder.IsAlphaPossible() and !isAlphaSeen) {
+			*pqwSample = opaqueSample.Finish64();
+		}
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+
+
+
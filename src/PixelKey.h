@@ -0,0 +1,77 @@
+#pragma once
+
+// Implementation-specific headers
+#include "ContentHash.h"   // HashAlgorithm, dedup key layout
+#include "PixelConvert.h"  // DIB row kernels
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Format-independent dedup key over decoded pixels.
+// The hashed stream is width and height (32-bit little-endian) followed by the rows as 8-bit
+// RGBA, top row first. Formats without alpha are opaque and fully transparent pixels are
+// cleared to zero, so the same picture gives the same key whether it arrives as CF_PNG or as
+// a DIB, whatever the header version, padding, resolution fields or bit depth. Rows are
+// decoded and hashed one at a time; nothing the size of the image is allocated (except for
+// interlaced PNGs).
+// The sample key hashes the dimensions and kSampleRows rows spread over the image, each across
+// its full width. Images with equal keys have equal samples, so a sample never seen before
+// means a new image without decoding the rest of it.
+namespace PixelKey
+{
+	// Set in the dedup index key kind when keys come from this namespace
+	constexpr uint64_t kKeyKindFlag = 0x100;
+
+	// Rows read for a sample key
+	constexpr uint32_t kSampleRows = 32;
+
+	// False if the DIB cannot be decoded (the caller keeps its byte-level key).
+	// pqwSample, when set, also receives the sample key.
+	bool FromDIB(const BITMAPINFO* pbmi, size_t cbSize, HashAlgorithm algorithm,
+		const PixelConvert::Kernels* pKernels, uint64_t* pqwKey, uint64_t* pqwSample = nullptr);
+
+	// False if the PNG is malformed or unsupported
+	bool FromPNG(const uint8_t* pPng, size_t cbPng, HashAlgorithm algorithm, uint64_t* pqwKey, uint64_t* pqwSample = nullptr);
+
+	// Sample key alone; only the sampled rows are decoded. PNG rows cannot be reached without
+	// inflating everything above them, so PNG samples come from FromPNG.
+	// Whether a 32bpp DIB has alpha depends on the whole image, so when the sampled rows have
+	// none pqwSample assumes an opaque image and pqwAltSample receives the sample it has if
+	// alpha turns up elsewhere; both are the same when the sampled rows settle it.
+	bool SampleDIB(const BITMAPINFO* pbmi, size_t cbSize, const PixelConvert::Kernels* pKernels,
+		uint64_t* pqwSample, uint64_t* pqwAltSample);
+}
+
+
+
+
+/*
+Usage example:
+
+	UINT64 qwKey = ContentHash::ToDedupKey(algorithm, byteHash, cbSize);
+	if (nFormat == CF_PNG) {
+		PixelKey::FromPNG(pData, cbSize, algorithm, &qwKey);
+	}
+	else {
+		PixelKey::FromDIB(reinterpret_cast<const BITMAPINFO*>(pData), cbSize, algorithm, NULL, &qwKey);
+	}
+
+	// Cheap first check on an 8K DIB
+	UINT64 qwSample{};
+	UINT64 qwAltSample{};
+	if (PixelKey::SampleDIB(reinterpret_cast<const BITMAPINFO*>(pData), cbSize, NULL, &qwSample, &qwAltSample) and
+		!sampleIndex.Contains(qwSample) and !sampleIndex.Contains(qwAltSample))
+	{
+		// New image
+	}
+
+*/
+
+
+
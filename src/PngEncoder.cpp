@@ -0,0 +1,329 @@
+// Implementation-specific headers
+#include "PngEncoder.h"
+#include "Deflate.h"
+#include "TraceZones.h"
+
+// Standard library headers
+#include <cstring>    // memcpy, memset
+#include <cstdlib>    // abs
+#include <algorithm>  // min, max
+#include <atomic>     // Worker failure flag
+#include <thread>     // Band workers
+#include <new>        // bad_alloc
+
+#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define PNG_ENCODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+
+// Anonymous namespace for internal helpers
+namespace
+{
+	constexpr uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	constexpr size_t kRowPadding = 16;  // Zero bytes before every raw row, stand in for pixels left of x = 0
+	constexpr unsigned kMaxThreads = 16;
+
+	enum Filter : uint8_t { None, Sub, Up, Average, Paeth, FilterCount };
+
+	int DeflateLevelOf(PngLevel level)
+	{
+		switch (level) {
+		case PngLevel::Fastest:  return 1;
+		case PngLevel::Fast:     return 3;
+		case PngLevel::Smallest: return 9;
+		default:                 return Deflate::kDefaultLevel;
+		}
+	}
+
+	void PutUInt32(uint8_t* p, uint32_t value)
+	{
+		p[0] = (uint8_t)(value >> 24);
+		p[1] = (uint8_t)(value >> 16);
+		p[2] = (uint8_t)(value >> 8);
+		p[3] = (uint8_t)value;
+	}
+
+	void AppendUInt32(std::vector<uint8_t>* pOutput, uint32_t value)
+	{
+		uint8_t bytes[4];
+		PutUInt32(bytes, value);
+		pOutput->insert(pOutput->end(), bytes, bytes + 4);
+	}
+
+	// Appends a whole chunk: length, type, data, CRC over type and data
+	void AppendChunk(std::vector<uint8_t>* pOutput, const char* type, const uint8_t* pData, size_t cbSize)
+	{
+		AppendUInt32(pOutput, (uint32_t)cbSize);
+		pOutput->insert(pOutput->end(), type, type + 4);
+		if (cbSize) { pOutput->insert(pOutput->end(), pData, pData + cbSize); }
+
+		uint32_t crc = Deflate::Crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+		crc = Deflate::Crc32(crc, pData, cbSize);
+		AppendUInt32(pOutput, crc);
+	}
+
+	uint8_t PaethPredictor(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = abs(p - a);
+		const int pb = abs(p - b);
+		const int pc = abs(p - c);
+		if (pa <= pb and pa <= pc) { return (uint8_t)a; }
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	// Applies one filter to cb bytes. pCur/pPrev point at x = 0 and have bpp readable bytes before them.
+	void FilterRowScalar(Filter filter, const uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp, uint8_t* pOut)
+	{
+		const uint8_t* pCurLeft = pCur - bpp;
+		const uint8_t* pPrevLeft = pPrev - bpp;
+		for (size_t i{}; i < cb; ++i) {
+			const uint8_t a = pCurLeft[i];
+			const uint8_t b = pPrev[i];
+			const uint8_t c = pPrevLeft[i];
+			switch (filter) {
+			case Sub:     pOut[i] = (uint8_t)(pCur[i] - a); break;
+			case Up:      pOut[i] = (uint8_t)(pCur[i] - b); break;
+			case Average: pOut[i] = (uint8_t)(pCur[i] - ((a + b) >> 1)); break;
+			case Paeth:   pOut[i] = (uint8_t)(pCur[i] - PaethPredictor(a, b, c)); break;
+			default:      pOut[i] = pCur[i]; break;
+			}
+		}
+	}
+
+	// Sum of the filtered bytes read as signed values, the usual libpng heuristic
+	uint64_t FilterCostScalar(const uint8_t* p, size_t cb)
+	{
+		uint64_t cost{};
+		for (size_t i{}; i < cb; ++i) { cost += (uint64_t)abs((int8_t)p[i]); }
+		return cost;
+	}
+
+#if PNG_ENCODER_SSE2
+	// Paeth on 8 pixels widened to 16 bits
+	__m128i PaethPredictor8(__m128i a, __m128i b, __m128i c)
+	{
+		const __m128i pa = _mm_sub_epi16(b, c);         // p - a
+		const __m128i pb = _mm_sub_epi16(a, c);         // p - b
+		const __m128i pc = _mm_add_epi16(pa, pb);       // p - c
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i absA = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		const __m128i absB = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		const __m128i absC = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+		// a if pa <= pb and pa <= pc, else b if pb <= pc, else c
+		const __m128i useBorC = _mm_or_si128(_mm_cmpgt_epi16(absA, absB), _mm_cmpgt_epi16(absA, absC));
+		const __m128i useC = _mm_cmpgt_epi16(absB, absC);
+		const __m128i bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+		return _mm_or_si128(_mm_and_si128(useBorC, bOrC), _mm_andnot_si128(useBorC, a));
+	}
+
+	void FilterRow(Filter filter, const uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp, uint8_t* pOut)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi8(1);
+		size_t i{};
+		for (; i + 16 <= cb; i += 16) {
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCur + i));
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCur + i - bpp));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPrev + i));
+			__m128i result;
+			switch (filter) {
+			case Sub:
+				result = _mm_sub_epi8(x, a);
+				break;
+			case Up:
+				result = _mm_sub_epi8(x, b);
+				break;
+			case Average: {
+				// avg_epu8 rounds up; subtract the carry to get floor((a + b) / 2)
+				const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+				result = _mm_sub_epi8(x, avg);
+				break;
+			}
+			case Paeth: {
+				const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPrev + i - bpp));
+				const __m128i lo = PaethPredictor8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+				const __m128i hi = PaethPredictor8(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+				result = _mm_sub_epi8(x, _mm_packus_epi16(lo, hi));
+				break;
+			}
+			default:
+				result = x;
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i), result);
+		}
+		FilterRowScalar(filter, pCur + i, pPrev + i, cb - i, bpp, pOut + i);
+	}
+
+	uint64_t FilterCost(const uint8_t* p, size_t cb)
+	{
+		// |int8| == min(v, -v) as unsigned bytes; psadbw sums them
+		const __m128i zero = _mm_setzero_si128();
+		__m128i sum = zero;
+		size_t i{};
+		for (; i + 16 <= cb; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			const __m128i absV = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+			sum = _mm_add_epi64(sum, _mm_sad_epu8(absV, zero));
+		}
+		const uint64_t cost = (uint64_t)_mm_cvtsi128_si32(sum) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+		return cost + FilterCostScalar(p + i, cb - i);
+	}
+#else
+	void FilterRow(Filter filter, const uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp, uint8_t* pOut)
+	{
+		FilterRowScalar(filter, pCur, pPrev, cb, bpp, pOut);
+	}
+
+	uint64_t FilterCost(const uint8_t* p, size_t cb)
+	{
+		return FilterCostScalar(p, cb);
+	}
+#endif
+
+	// Filters rows [yBegin, yEnd) into pFiltered (1 + cbRow bytes per row)
+	bool FilterBand(const PngImage& image, uint32_t yBegin, uint32_t yEnd, uint8_t* pFiltered)
+	{
+		const size_t bpp = image.channels;
+		const size_t cbRow = (size_t)image.width * bpp;
+
+		// Two raw rows plus one candidate per filter, each behind kRowPadding zero bytes
+		const size_t cbSlot = kRowPadding + cbRow;
+		std::vector<uint8_t> scratch(cbSlot * (2 + FilterCount));
+		uint8_t* pPrev = scratch.data() + kRowPadding;
+		uint8_t* pCur = pPrev + cbSlot;
+		uint8_t* pCandidates = pCur + cbSlot;
+
+		// The row above the band seeds Up/Average/Paeth; row -1 is all zeros
+		if (yBegin > 0 and !image.pfnRow(image.pContext, yBegin - 1, pPrev)) { return false; }
+
+		for (uint32_t y = yBegin; y < yEnd; ++y) {
+			if (!image.pfnRow(image.pContext, y, pCur)) { return false; }
+
+			uint8_t* pDst = pFiltered + (size_t)y * (1 + cbRow);
+			uint64_t bestCost = UINT64_MAX;
+			unsigned bestFilter{};
+			for (unsigned filter{}; filter < FilterCount; ++filter) {
+				uint8_t* pCandidate = pCandidates + filter * cbSlot;
+				FilterRow((Filter)filter, pCur, pPrev, cbRow, bpp, pCandidate);
+				const uint64_t cost = FilterCost(pCandidate, cbRow);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestFilter = filter;
+				}
+			}
+			pDst[0] = (uint8_t)bestFilter;
+			memcpy(pDst + 1, pCandidates + bestFilter * cbSlot, cbRow);
+
+			std::swap(pPrev, pCur);
+		}
+		return true;
+	}
+
+	// Runs fn(0..cJobs-1) on up to cJobs threads, the last job on the calling thread
+	template<typename Fn>
+	void RunParallel(unsigned cJobs, Fn fn)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(cJobs);
+		for (unsigned i = 1; i < cJobs; ++i) {
+			threads.emplace_back(fn, i - 1);
+		}
+		fn(cJobs - 1);
+		for (std::thread& thread : threads) { thread.join(); }
+	}
+}
+
+
+
+bool EncodePng(const PngImage& image, const PngEncodeOptions& options, std::vector<uint8_t>* pOutput)
+{
+	TRACE_ZONE("EncodePng");
+	if (!pOutput or !image.pfnRow) { return false; }
+	if (image.channels != 3 and image.channels != 4) { return false; }
+	if (!image.width or !image.height or image.width > 0x7FFFFFFF or image.height > 0x7FFFFFFF) { return false; }
+
+	const size_t cbRow = (size_t)image.width * image.channels;
+	const size_t cbFiltered = (size_t)image.height * (1 + cbRow);
+	const int level = DeflateLevelOf(options.level);
+
+	unsigned cThreads = options.cThreads ? options.cThreads : std::thread::hardware_concurrency();
+	cThreads = std::max(1u, std::min(cThreads, kMaxThreads));
+
+	std::vector<uint8_t> filtered;
+	try {
+		filtered.resize(cbFiltered);
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+
+	// Phase 1: filter row bands
+	const unsigned cFilterBands = std::min<unsigned>(cThreads, image.height);
+	std::atomic<bool> isFailed{};
+	RunParallel(cFilterBands, [&](unsigned band) {
+		const uint32_t yBegin = (uint32_t)((uint64_t)image.height * band / cFilterBands);
+		const uint32_t yEnd = (uint32_t)((uint64_t)image.height * (band + 1) / cFilterBands);
+		if (!FilterBand(image, yBegin, yEnd, filtered.data())) { isFailed = true; }
+	});
+	if (isFailed) { return false; }
+
+	// Phase 2: deflate byte ranges, each primed with the window before it
+	const size_t cbMinBand = std::max<size_t>(options.cbMinBand, Deflate::kWindowSize);
+	const unsigned cDeflateBands = (unsigned)std::max<size_t>(1, std::min<size_t>(cThreads, cbFiltered / cbMinBand));
+
+	struct Band
+	{
+		size_t begin{};
+		size_t end{};
+		uint32_t adler{};
+		std::vector<uint8_t> data;  // Compressed bytes of the range
+	};
+	std::vector<Band> bands(cDeflateBands);
+	for (unsigned i{}; i < cDeflateBands; ++i) {
+		bands[i].begin = cbFiltered * i / cDeflateBands;
+		bands[i].end = cbFiltered * (i + 1) / cDeflateBands;
+	}
+
+	RunParallel(cDeflateBands, [&](unsigned i) {
+		Band& band = bands[i];
+		const size_t dictBegin = band.begin > Deflate::kWindowSize ? band.begin - Deflate::kWindowSize : 0;
+		band.data.reserve((band.end - band.begin) / 2 + 1024);
+		if (i == 0) { Deflate::WriteZlibHeader(level, &band.data); }
+		Deflate::CompressRange(filtered.data(), dictBegin, band.begin, band.end, level, i + 1 == cDeflateBands, &band.data);
+		band.adler = Deflate::Adler32(1, filtered.data() + band.begin, band.end - band.begin);
+	});
+
+	uint32_t adler = bands[0].adler;
+	for (unsigned i = 1; i < cDeflateBands; ++i) {
+		adler = Deflate::Adler32Combine(adler, bands[i].adler, bands[i].end - bands[i].begin);
+	}
+	AppendUInt32(&bands.back().data, adler);
+
+	// Signature, IHDR, one IDAT per band, IEND
+	size_t cbTotal = sizeof(kSignature) + 25 + 12;
+	for (const Band& band : bands) { cbTotal += 12 + band.data.size(); }
+	pOutput->clear();
+	pOutput->reserve(cbTotal);
+	pOutput->insert(pOutput->end(), kSignature, kSignature + sizeof(kSignature));
+
+	uint8_t ihdr[13]{};
+	PutUInt32(ihdr, image.width);
+	PutUInt32(ihdr + 4, image.height);
+	ihdr[8] = 8;                                 // Bit depth
+	ihdr[9] = image.channels == 4 ? 6 : 2;       // Truecolor with or without alpha
+	AppendChunk(pOutput, "IHDR", ihdr, sizeof(ihdr));
+
+	for (const Band& band : bands) {
+		AppendChunk(pOutput, "IDAT", band.data.data(), band.data.size());
+	}
+	AppendChunk(pOutput, "IEND", NULL, 0);
+	return true;
+}
+
+
+
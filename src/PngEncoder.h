@@ -0,0 +1,77 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Output buffer
+
+
+
+// Speed/size trade-off of EncodePng
+enum class PngLevel : unsigned
+{
+	Fastest,   // Greedy matching, short chains
+	Fast,
+	Default,   // Lazy matching, zlib level 6
+	Smallest   // Lazy matching, long chains
+};
+
+
+
+// Tuning knobs of EncodePng
+struct PngEncodeOptions
+{
+	PngLevel level{ PngLevel::Default };
+	unsigned cThreads{};                 // 0 = one per logical processor
+	size_t cbMinBand{ 256 * 1024 };      // Smallest amount of filtered data given to one deflate thread
+};
+
+
+
+// Produces the unfiltered row y (width * channels bytes, RGB or RGBA order) into pRow.
+// Called concurrently from several threads, each row exactly once or twice.
+using PngRowProc = bool (*)(const void* pContext, uint32_t y, uint8_t* pRow);
+
+// Source image of EncodePng, pulled row by row
+struct PngImage
+{
+	uint32_t width{};
+	uint32_t height{};
+	unsigned channels{};     // 3 (RGB) or 4 (RGBA), 8 bits each
+	PngRowProc pfnRow{};
+	const void* pContext{};
+};
+
+
+
+// Portable multithreaded PNG encoder.
+// Rows are filtered in parallel bands (per-row filter picked by the minimum sum of
+// absolute differences, SSE2 when available), then the filtered image is split into
+// byte ranges deflated on separate threads, each primed with the 32 KB before it, and
+// stitched into one zlib stream written as one IDAT chunk per range.
+bool EncodePng(const PngImage& image, const PngEncodeOptions& options, std::vector<uint8_t>* pOutput);
+
+
+
+
+/*
+Usage example:
+
+	bool GetRow(const void* pContext, uint32_t y, uint8_t* pRow)
+	{
+		const Image* pImage = static_cast<const Image*>(pContext);
+		memcpy(pRow, pImage->pixels + y * pImage->stride, pImage->width * 4);
+		return true;
+	}
+
+	PngImage image{ width, height, 4, GetRow, &source };
+	PngEncodeOptions options{ PngLevel::Fast };
+	std::vector<uint8_t> png;
+	if (EncodePng(image, options, &png)) {
+		// write png.data(), png.size()
+	}
+
+*/
+
+
+
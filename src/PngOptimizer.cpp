@@ -0,0 +1,337 @@
+// Implementation-specific headers
+#include "PngOptimizer.h"
+#include "Inflate.h"
+
+// Standard library headers
+#include <cstring>    // memcmp, memcpy
+#include <cstdlib>    // abs
+#include <algorithm>  // min
+#include <new>        // bad_alloc
+
+
+
+// Anonymous namespace for chunk parsing and scanline filters
+namespace
+{
+	constexpr uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	constexpr uint64_t kMaxFilteredSize = (uint64_t)1 << 30;   // Refuse images that would not fit comfortably in memory
+	constexpr size_t kBandSize = (size_t)4 << 20;             // Deflate input per cancellation check
+	constexpr size_t kMaxChunkData = 0x7FFFFFFF;
+
+	enum Filter : uint8_t { None, Sub, Up, Average, Paeth, FilterCount };
+
+	// Whole-image filter choices tried per file; Adaptive picks per row by the minimum sum of absolute differences
+	enum class Strategy { None, Sub, Up, Average, Paeth, Adaptive, Original, Count };
+
+	// Adam7 pass origins and steps; a non-interlaced image is the single pass { 0, 0, 1, 1 }
+	struct Pass
+	{
+		uint32_t x0, y0, dx, dy;
+	};
+	constexpr Pass kAdam7[7] = {
+		{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+		{ 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+
+	// Rows of one pass inside the filtered stream
+	struct PassLayout
+	{
+		size_t offset;    // Filter byte of the first row
+		size_t cbRow;     // Pixel bytes per row, without the filter byte
+		uint32_t height;
+	};
+
+	struct Chunk
+	{
+		const uint8_t* pType;
+		const uint8_t* pData;
+		uint32_t cbSize;
+	};
+
+	uint32_t GetUInt32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	void AppendUInt32(std::vector<uint8_t>* pOutput, uint32_t value)
+	{
+		const uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+		pOutput->insert(pOutput->end(), bytes, bytes + 4);
+	}
+
+	void AppendChunk(std::vector<uint8_t>* pOutput, const uint8_t* pType, const uint8_t* pData, size_t cbSize)
+	{
+		AppendUInt32(pOutput, (uint32_t)cbSize);
+		pOutput->insert(pOutput->end(), pType, pType + 4);
+		if (cbSize) { pOutput->insert(pOutput->end(), pData, pData + cbSize); }
+
+		uint32_t crc = Deflate::Crc32(0, pType, 4);
+		crc = Deflate::Crc32(crc, pData, cbSize);
+		AppendUInt32(pOutput, crc);
+	}
+
+	bool IsType(const Chunk& chunk, const char* type)
+	{
+		return memcmp(chunk.pType, type, 4) == 0;
+	}
+
+	// Ancillary chunks that change how the pixels are displayed, all placed before PLTE
+	bool IsColorSpace(const Chunk& chunk)
+	{
+		return IsType(chunk, "iCCP") or IsType(chunk, "sRGB") or IsType(chunk, "gAMA") or IsType(chunk, "cHRM")
+			or IsType(chunk, "sBIT") or IsType(chunk, "cICP") or IsType(chunk, "mDCV") or IsType(chunk, "cLLI");
+	}
+
+	// Samples per pixel for a valid color type and bit depth combination, 0 otherwise
+	unsigned ChannelsOf(uint8_t colorType, uint8_t bitDepth)
+	{
+		const bool isLowDepth = bitDepth == 1 or bitDepth == 2 or bitDepth == 4;
+		switch (colorType) {
+		case 0: return isLowDepth or bitDepth == 8 or bitDepth == 16 ? 1 : 0;  // Gray
+		case 2: return bitDepth == 8 or bitDepth == 16 ? 3 : 0;                // RGB
+		case 3: return isLowDepth or bitDepth == 8 ? 1 : 0;                    // Palette
+		case 4: return bitDepth == 8 or bitDepth == 16 ? 2 : 0;                // Gray + alpha
+		case 6: return bitDepth == 8 or bitDepth == 16 ? 4 : 0;                // RGBA
+		default: return 0;
+		}
+	}
+
+	uint8_t PaethPredictor(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = abs(p - a);
+		const int pb = abs(p - b);
+		const int pc = abs(p - c);
+		if (pa <= pb and pa <= pc) { return (uint8_t)a; }
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	// Filters cb raw bytes; pPrev is the previous raw row of the same pass or NULL for the first one
+	void FilterRow(Filter filter, const uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp, uint8_t* pOut)
+	{
+		for (size_t i{}; i < cb; ++i) {
+			const int a = i >= bpp ? pCur[i - bpp] : 0;
+			const int b = pPrev ? pPrev[i] : 0;
+			const int c = pPrev and i >= bpp ? pPrev[i - bpp] : 0;
+			switch (filter) {
+			case Sub:     pOut[i] = (uint8_t)(pCur[i] - a); break;
+			case Up:      pOut[i] = (uint8_t)(pCur[i] - b); break;
+			case Average: pOut[i] = (uint8_t)(pCur[i] - ((a + b) >> 1)); break;
+			case Paeth:   pOut[i] = (uint8_t)(pCur[i] - PaethPredictor(a, b, c)); break;
+			default:      pOut[i] = pCur[i]; break;
+			}
+		}
+	}
+
+	// Reverses FilterRow in place
+	void UnfilterRow(Filter filter, uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp)
+	{
+		for (size_t i{}; i < cb; ++i) {
+			const int a = i >= bpp ? pCur[i - bpp] : 0;
+			const int b = pPrev ? pPrev[i] : 0;
+			const int c = pPrev and i >= bpp ? pPrev[i - bpp] : 0;
+			switch (filter) {
+			case Sub:     pCur[i] = (uint8_t)(pCur[i] + a); break;
+			case Up:      pCur[i] = (uint8_t)(pCur[i] + b); break;
+			case Average: pCur[i] = (uint8_t)(pCur[i] + ((a + b) >> 1)); break;
+			case Paeth:   pCur[i] = (uint8_t)(pCur[i] + PaethPredictor(a, b, c)); break;
+			default: break;
+			}
+		}
+	}
+
+	uint64_t SumOfAbsolute(const uint8_t* pData, size_t cb)
+	{
+		uint64_t sum{};
+		for (size_t i{}; i < cb; ++i) { sum += (uint64_t)abs((int8_t)pData[i]); }
+		return sum;
+	}
+
+	// Re-filters the raw rows (filter bytes hold the original choices) into pFiltered
+	void ApplyStrategy(Strategy strategy, const std::vector<uint8_t>& raw, const std::vector<PassLayout>& passes,
+		size_t bpp, std::vector<uint8_t>* pFiltered, std::vector<uint8_t>* pScratch)
+	{
+		pFiltered->resize(raw.size());
+		for (const PassLayout& pass : passes) {
+			pScratch->resize(pass.cbRow);
+			for (uint32_t y{}; y < pass.height; ++y) {
+				const size_t rowOffset = pass.offset + y * (pass.cbRow + 1);
+				const uint8_t* pCur = raw.data() + rowOffset + 1;
+				const uint8_t* pPrev = y ? pCur - (pass.cbRow + 1) : NULL;
+				uint8_t* pOut = pFiltered->data() + rowOffset;
+
+				Filter filter = (Filter)strategy;
+				if (strategy == Strategy::Original) { filter = (Filter)raw[rowOffset]; }
+				else if (strategy == Strategy::Adaptive) {
+					uint64_t bestSum = UINT64_MAX;
+					for (uint8_t candidate{}; candidate < FilterCount; ++candidate) {
+						FilterRow((Filter)candidate, pCur, pPrev, pass.cbRow, bpp, pScratch->data());
+						const uint64_t sum = SumOfAbsolute(pScratch->data(), pass.cbRow);
+						if (sum < bestSum) {
+							bestSum = sum;
+							filter = (Filter)candidate;
+						}
+					}
+				}
+
+				pOut[0] = filter;
+				FilterRow(filter, pCur, pPrev, pass.cbRow, bpp, pOut + 1);
+			}
+		}
+	}
+
+	// zlib stream over pData in bands, so a cancellation request is noticed within one band
+	bool CompressCancellable(const std::vector<uint8_t>& data, int level, const std::atomic<bool>* pCancel,
+		std::vector<uint8_t>* pOutput)
+	{
+		pOutput->clear();
+		Deflate::WriteZlibHeader(level, pOutput);
+		for (size_t begin{};; begin += kBandSize) {
+			if (pCancel and pCancel->load(std::memory_order_relaxed)) { return false; }
+
+			const size_t end = std::min(data.size(), begin + kBandSize);
+			const size_t dictBegin = begin > Deflate::kWindowSize ? begin - Deflate::kWindowSize : 0;
+			Deflate::CompressRange(data.data(), dictBegin, begin, end, level, end == data.size(), pOutput);
+			if (end == data.size()) { break; }
+		}
+		AppendUInt32(pOutput, Deflate::Adler32(1, data.data(), data.size()));
+		return true;
+	}
+}
+
+
+
+bool PngOptimizer::Optimize(const uint8_t* pPng, size_t cbPng, const PngOptimizeOptions& options, std::vector<uint8_t>* pOutput)
+{
+	if (!pPng or !pOutput or cbPng < sizeof(kSignature)) { return false; }
+	if (memcmp(pPng, kSignature, sizeof(kSignature)) != 0) { return false; }
+
+	// Walk the chunks, verifying every CRC
+	const Chunk* pHeader{};
+	const Chunk* pPalette{};
+	const Chunk* pTransparency{};
+	std::vector<const Chunk*> colorSpace;
+	std::vector<Chunk> chunks;
+	Inflater inflater;
+	bool isEndSeen{};
+
+	for (size_t pos = sizeof(kSignature); !isEndSeen;) {
+		if (cbPng - pos < 12) { return false; }
+		const uint32_t cbData = GetUInt32(pPng + pos);
+		if (cbData > kMaxChunkData or cbData > cbPng - pos - 12) { return false; }
+
+		const Chunk chunk{ pPng + pos + 4, pPng + pos + 8, cbData };
+		if (Deflate::Crc32(0, chunk.pType, 4 + (size_t)cbData) != GetUInt32(chunk.pData + cbData)) { return false; }
+		pos += 12 + (size_t)cbData;
+		chunks.push_back(chunk);
+
+		if (IsType(chunk, "IHDR")) {
+			if (chunks.size() != 1 or cbData != 13) { return false; }
+		}
+		else if (chunks.size() == 1) {
+			return false;  // IHDR must come first
+		}
+		else if (IsType(chunk, "IDAT")) {
+			inflater.AppendInput(chunk.pData, cbData);
+		}
+		else if (IsType(chunk, "IEND")) {
+			isEndSeen = true;
+		}
+		else if (!IsType(chunk, "PLTE") and !IsType(chunk, "tRNS") and !(chunk.pType[0] & 0x20)) {
+			return false;  // Unknown critical chunk
+		}
+	}
+	for (const Chunk& chunk : chunks) {
+		if (IsType(chunk, "IHDR")) { pHeader = &chunk; }
+		else if (IsType(chunk, "PLTE")) { pPalette = &chunk; }
+		else if (IsType(chunk, "tRNS")) { pTransparency = &chunk; }
+		else if (IsColorSpace(chunk)) { colorSpace.push_back(&chunk); }
+	}
+
+	// Header fields
+	const uint8_t* pFields = pHeader->pData;
+	const uint32_t width = GetUInt32(pFields);
+	const uint32_t height = GetUInt32(pFields + 4);
+	const uint8_t bitDepth = pFields[8];
+	const uint8_t colorType = pFields[9];
+	const unsigned channels = ChannelsOf(colorType, bitDepth);
+	if (!width or !height or !channels) { return false; }
+	if (pFields[10] != 0 or pFields[11] != 0 or pFields[12] > 1) { return false; }
+	if (colorType == 3 and !pPalette) { return false; }
+
+	// Byte layout of every pass in the filtered stream
+	const uint64_t bitsPerPixel = (uint64_t)channels * bitDepth;
+	const size_t bpp = (size_t)std::max<uint64_t>(1, bitsPerPixel / 8);
+	std::vector<PassLayout> passes;
+	uint64_t cbFiltered{};
+	const bool isInterlaced = pFields[12] == 1;
+	for (unsigned i{}; i < (isInterlaced ? 7u : 1u); ++i) {
+		const Pass step = isInterlaced ? kAdam7[i] : Pass{ 0, 0, 1, 1 };
+		const uint32_t passWidth = width > step.x0 ? (width - step.x0 + step.dx - 1) / step.dx : 0;
+		const uint32_t passHeight = height > step.y0 ? (height - step.y0 + step.dy - 1) / step.dy : 0;
+		if (!passWidth or !passHeight) { continue; }
+
+		const uint64_t cbRow = (passWidth * bitsPerPixel + 7) / 8;
+		passes.push_back({ (size_t)cbFiltered, (size_t)cbRow, passHeight });
+		cbFiltered += passHeight * (cbRow + 1);
+		if (cbFiltered > kMaxFilteredSize) { return false; }
+	}
+
+	try {
+		// Inflate and undo the original filters; the filter bytes are kept for the Original strategy
+		std::vector<uint8_t> raw((size_t)cbFiltered);
+		if (inflater.Read(raw.data(), raw.size()) != raw.size() or inflater.GetStatus() != InflateStatus::Done) {
+			return false;
+		}
+		for (const PassLayout& pass : passes) {
+			for (uint32_t y{}; y < pass.height; ++y) {
+				uint8_t* pRow = raw.data() + pass.offset + y * (pass.cbRow + 1);
+				if (pRow[0] >= FilterCount) { return false; }
+				UnfilterRow((Filter)pRow[0], pRow + 1, y ? pRow + 1 - (pass.cbRow + 1) : NULL, pass.cbRow, bpp);
+			}
+		}
+
+		// Rank the filter strategies by a quick trial compression, then spend the effort on the winner.
+		// Low bit depth and palette images rarely gain from prediction, but trying costs little.
+		std::vector<uint8_t> filtered;
+		std::vector<uint8_t> scratch;
+		std::vector<uint8_t> trial;
+		Strategy bestStrategy = Strategy::Original;
+		size_t cbBestTrial = SIZE_MAX;
+		for (int strategy{}; strategy < (int)Strategy::Count; ++strategy) {
+			ApplyStrategy((Strategy)strategy, raw, passes, bpp, &filtered, &scratch);
+			if (!CompressCancellable(filtered, options.trialLevel, options.pCancel, &trial)) { return false; }
+			if (trial.size() < cbBestTrial) {
+				cbBestTrial = trial.size();
+				bestStrategy = (Strategy)strategy;
+			}
+		}
+
+		ApplyStrategy(bestStrategy, raw, passes, bpp, &filtered, &scratch);
+		raw = {};
+		std::vector<uint8_t> compressed;
+		if (!CompressCancellable(filtered, options.level, options.pCancel, &compressed)) { return false; }
+		filtered = {};
+
+		// Critical chunks, tRNS and the color space; text, time, physical size and the other
+		// metadata are dropped
+		pOutput->clear();
+		pOutput->insert(pOutput->end(), kSignature, kSignature + sizeof(kSignature));
+		AppendChunk(pOutput, pHeader->pType, pHeader->pData, pHeader->cbSize);
+		for (const Chunk* pChunk : colorSpace) { AppendChunk(pOutput, pChunk->pType, pChunk->pData, pChunk->cbSize); }
+		if (pPalette) { AppendChunk(pOutput, pPalette->pType, pPalette->pData, pPalette->cbSize); }
+		if (pTransparency) { AppendChunk(pOutput, pTransparency->pType, pTransparency->pData, pTransparency->cbSize); }
+		for (size_t offset{}; offset < compressed.size(); offset += kMaxChunkData) {
+			const size_t cbChunk = std::min(compressed.size() - offset, kMaxChunkData);
+			AppendChunk(pOutput, reinterpret_cast<const uint8_t*>("IDAT"), compressed.data() + offset, cbChunk);
+		}
+		AppendChunk(pOutput, reinterpret_cast<const uint8_t*>("IEND"), NULL, 0);
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+
+
+
@@ -0,0 +1,52 @@
+#pragma once
+
+// Implementation-specific headers
+#include "Deflate.h"  // Compression levels
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <atomic>   // Cancellation flag
+#include <vector>   // Output buffer
+
+
+
+// Tuning knobs of PngOptimizer::Optimize
+struct PngOptimizeOptions
+{
+	int level{ Deflate::kOptimalLevel };        // Final IDAT compression
+	int trialLevel{ Deflate::kDefaultLevel };   // Used to rank the filter strategies
+	const std::atomic<bool>* pCancel{};         // Polled between compression bands
+};
+
+
+
+// Lossless PNG re-encoder for files written by other applications.
+// Keeps the pixels, the critical chunks and the ancillary chunks that change how pixels
+// render (tRNS and the color space: iCCP, sRGB, gAMA, cHRM, sBIT, cICP, mDCV, cLLI), drops
+// the metadata (text, time, physical size and the like), re-filters each scanline with the
+// strategy that compresses best, and recompresses IDAT at high effort. Every bit depth, color
+// type and Adam7 interlacing are supported; the caller decides whether the result is worth keeping.
+namespace PngOptimizer
+{
+	// False for malformed or unsupported files and when cancelled
+	bool Optimize(const uint8_t* pPng, size_t cbPng, const PngOptimizeOptions& options, std::vector<uint8_t>* pOutput);
+}
+
+
+
+
+/*
+Usage example:
+
+	std::vector<uint8_t> optimized;
+	if (PngOptimizer::Optimize(png.data(), png.size(), PngOptimizeOptions{}, &optimized) and
+		optimized.size() < png.size())
+	{
+		// replace the file with optimized
+	}
+
+*/
+
+
+
@@ -0,0 +1,453 @@
+// Implementation-specific headers
+#include "PngReader.h"
+#include "Deflate.h"  // Crc32
+
+// Standard library headers
+#include <cstring>    // memcmp, memcpy
+#include <cstdlib>    // abs
+#include <algorithm>  // max
+
+// SIMD intrinsics
+#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define PNG_READER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+
+// Anonymous namespace for chunk parsing and scanline filters
+namespace
+{
+	constexpr uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	constexpr uint64_t kMaxPixels = (uint64_t)1 << 28;  // 1 GB as RGBA
+	constexpr size_t kMaxChunkData = 0x7FFFFFFF;
+
+	enum Filter : uint8_t { None, Sub, Up, Average, Paeth, FilterCount };
+
+	// Adam7 pass origins and steps
+	struct Pass
+	{
+		uint32_t x0, y0, dx, dy;
+	};
+	constexpr Pass kAdam7[7] = {
+		{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+		{ 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+
+	uint32_t GetUInt32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	uint16_t GetUInt16(const uint8_t* p)
+	{
+		return (uint16_t)((p[0] << 8) | p[1]);
+	}
+
+	// Samples per pixel for a valid color type and bit depth combination, 0 otherwise
+	unsigned ChannelsOf(uint8_t colorType, uint8_t bitDepth)
+	{
+		const bool isLowDepth = bitDepth == 1 or bitDepth == 2 or bitDepth == 4;
+		switch (colorType) {
+		case 0: return isLowDepth or bitDepth == 8 or bitDepth == 16 ? 1 : 0;  // Gray
+		case 2: return bitDepth == 8 or bitDepth == 16 ? 3 : 0;                // RGB
+		case 3: return isLowDepth or bitDepth == 8 ? 1 : 0;                    // Palette
+		case 4: return bitDepth == 8 or bitDepth == 16 ? 2 : 0;                // Gray + alpha
+		case 6: return bitDepth == 8 or bitDepth == 16 ? 4 : 0;                // RGBA
+		default: return 0;
+		}
+	}
+
+	uint8_t PaethPredictor(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = abs(p - a);
+		const int pb = abs(p - b);
+		const int pc = abs(p - c);
+		if (pa <= pb and pa <= pc) { return (uint8_t)a; }
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	// Reverses a scanline filter in place; pPrev is all zeros for the first row of a pass.
+	// One loop per filter keeps the per-byte work branch-free.
+	void UnfilterRowScalar(Filter filter, uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp)
+	{
+		switch (filter) {
+		case Sub:
+			for (size_t i = bpp; i < cb; ++i) { pCur[i] = (uint8_t)(pCur[i] + pCur[i - bpp]); }
+			break;
+		case Up:
+			for (size_t i{}; i < cb; ++i) { pCur[i] = (uint8_t)(pCur[i] + pPrev[i]); }
+			break;
+		case Average:
+			for (size_t i{}; i < bpp and i < cb; ++i) { pCur[i] = (uint8_t)(pCur[i] + (pPrev[i] >> 1)); }
+			for (size_t i = bpp; i < cb; ++i) { pCur[i] = (uint8_t)(pCur[i] + ((pCur[i - bpp] + pPrev[i]) >> 1)); }
+			break;
+		case Paeth:
+			for (size_t i{}; i < bpp and i < cb; ++i) { pCur[i] = (uint8_t)(pCur[i] + pPrev[i]); }
+			for (size_t i = bpp; i < cb; ++i) {
+				pCur[i] = (uint8_t)(pCur[i] + PaethPredictor(pCur[i - bpp], pPrev[i], pPrev[i - bpp]));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+#if PNG_READER_SSE2
+	// Paeth on 8 pixels widened to 16 bits
+	__m128i PaethPredictor8(__m128i a, __m128i b, __m128i c)
+	{
+		const __m128i pa = _mm_sub_epi16(b, c);         // p - a
+		const __m128i pb = _mm_sub_epi16(a, c);         // p - b
+		const __m128i pc = _mm_add_epi16(pa, pb);       // p - c
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i absA = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		const __m128i absB = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		const __m128i absC = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+		// a if pa <= pb and pa <= pc, else b if pb <= pc, else c
+		const __m128i useBorC = _mm_or_si128(_mm_cmpgt_epi16(absA, absB), _mm_cmpgt_epi16(absA, absC));
+		const __m128i useC = _mm_cmpgt_epi16(absB, absC);
+		const __m128i bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+		return _mm_or_si128(_mm_and_si128(useBorC, bOrC), _mm_andnot_si128(useBorC, a));
+	}
+
+	__m128i LoadPixel(const uint8_t* p, size_t bpp)
+	{
+		uint32_t value{};
+		memcpy(&value, p, bpp);
+		return _mm_cvtsi32_si128((int)value);
+	}
+
+	void StorePixel(uint8_t* p, __m128i v, size_t bpp)
+	{
+		const uint32_t value = (uint32_t)_mm_cvtsi128_si32(v);
+		memcpy(p, &value, bpp);
+	}
+
+	// Up runs 16 bytes at a time. Sub, Average and Paeth depend on the pixel to the left, so
+	// for 3- and 4-byte pixels they keep one pixel per register (as libpng does); other pixel
+	// sizes take the scalar loops.
+	void UnfilterRow(Filter filter, uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp)
+	{
+		if (filter == Up) {
+			size_t i{};
+			for (; i + 16 <= cb; i += 16) {
+				const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCur + i));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPrev + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pCur + i), _mm_add_epi8(x, b));
+			}
+			UnfilterRowScalar(Up, pCur + i, pPrev + i, cb - i, bpp);
+			return;
+		}
+		if ((bpp != 3 and bpp != 4) or filter == None) {
+			UnfilterRowScalar(filter, pCur, pPrev, cb, bpp);
+			return;
+		}
+
+		const __m128i zero = _mm_setzero_si128();
+		__m128i a = zero;  // Reconstructed pixel to the left
+		switch (filter) {
+		case Sub:
+			for (size_t i{}; i < cb; i += bpp) {
+				a = _mm_add_epi8(LoadPixel(pCur + i, bpp), a);
+				StorePixel(pCur + i, a, bpp);
+			}
+			break;
+		case Average: {
+			const __m128i one = _mm_set1_epi8(1);
+			for (size_t i{}; i < cb; i += bpp) {
+				const __m128i b = LoadPixel(pPrev + i, bpp);
+				const __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));  // Rounded down
+				a = _mm_add_epi8(LoadPixel(pCur + i, bpp), average);
+				StorePixel(pCur + i, a, bpp);
+			}
+			break;
+		}
+		default: {
+			__m128i c = zero;  // Pixel above the left one
+			for (size_t i{}; i < cb; i += bpp) {
+				const __m128i b = LoadPixel(pPrev + i, bpp);
+				const __m128i predictor = PaethPredictor8(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+				a = _mm_add_epi8(LoadPixel(pCur + i, bpp), _mm_packus_epi16(predictor, predictor));
+				StorePixel(pCur + i, a, bpp);
+				c = b;
+			}
+			break;
+		}
+		}
+	}
+#else
+	void UnfilterRow(Filter filter, uint8_t* pCur, const uint8_t* pPrev, size_t cb, size_t bpp)
+	{
+		UnfilterRowScalar(filter, pCur, pPrev, cb, bpp);
+	}
+#endif
+
+	// Sample i of a packed 1/2/4-bit row
+	unsigned PackedSample(const uint8_t* pRow, uint32_t i, unsigned bitDepth)
+	{
+		const unsigned bit = i * bitDepth;
+		return (pRow[bit >> 3] >> (8 - bitDepth - (bit & 7))) & ((1u << bitDepth) - 1);
+	}
+}
+
+
+
+bool PngReader::Open(const uint8_t* pPng, size_t cbPng)
+{
+	width_ = height_ = 0;
+	hasColorKey_ = false;
+	isFailed_ = false;
+	nextRow_ = 0;
+	canvas_.clear();
+	inflater_.Reset();
+
+	if (!pPng or cbPng < sizeof(kSignature)) { return false; }
+	if (memcmp(pPng, kSignature, sizeof(kSignature)) != 0) { return false; }
+
+	// Walk the chunks
+	const uint8_t* pHeader{};
+	const uint8_t* pPalette{};
+	const uint8_t* pTransparency{};
+	uint32_t cbPalette{};
+	uint32_t cbTransparency{};
+	bool isEndSeen{};
+
+	for (size_t pos = sizeof(kSignature); !isEndSeen;) {
+		if (cbPng - pos < 12) { return false; }
+		const uint32_t cbData = GetUInt32(pPng + pos);
+		if (cbData > kMaxChunkData or cbData > cbPng - pos - 12) { return false; }
+
+		const uint8_t* pType = pPng + pos + 4;
+		const uint8_t* pData = pPng + pos + 8;
+		pos += 12 + (size_t)cbData;
+
+		const bool isData = memcmp(pType, "IDAT", 4) == 0;
+		if (!isData and Deflate::Crc32(0, pType, 4 + (size_t)cbData) != GetUInt32(pData + cbData)) { return false; }
+
+		if (memcmp(pType, "IHDR", 4) == 0) {
+			if (pHeader or cbData != 13) { return false; }
+			pHeader = pData;
+		}
+		else if (!pHeader) {
+			return false;  // IHDR must come first
+		}
+		else if (isData) {
+			inflater_.AppendInput(pData, cbData);
+		}
+		else if (memcmp(pType, "IEND", 4) == 0) {
+			isEndSeen = true;
+		}
+		else if (memcmp(pType, "PLTE", 4) == 0) {
+			pPalette = pData;
+			cbPalette = cbData;
+		}
+		else if (memcmp(pType, "tRNS", 4) == 0) {
+			pTransparency = pData;
+			cbTransparency = cbData;
+		}
+		else if (!(pType[0] & 0x20)) {
+			return false;  // Unknown critical chunk
+		}
+	}
+
+	// Header fields
+	const uint32_t width = GetUInt32(pHeader);
+	const uint32_t height = GetUInt32(pHeader + 4);
+	bitDepth_ = pHeader[8];
+	colorType_ = pHeader[9];
+	const unsigned channels = ChannelsOf(colorType_, bitDepth_);
+	if (!width or !height or !channels) { return false; }
+	if (pHeader[10] != 0 or pHeader[11] != 0 or pHeader[12] > 1) { return false; }
+	if ((uint64_t)width * height > kMaxPixels) { return false; }
+	isInterlaced_ = pHeader[12] == 1;
+	bitsPerPixel_ = channels * bitDepth_;
+	bpp_ = std::max(1u, bitsPerPixel_ / 8);
+
+	// Palette and transparency
+	if (colorType_ == 3) {
+		if (!pPalette or cbPalette % 3 or cbPalette > 768) { return false; }
+		for (unsigned i{}; i < 256; ++i) {
+			const bool isDefined = i < cbPalette / 3;
+			palette_[i][0] = isDefined ? pPalette[i * 3] : 0;
+			palette_[i][1] = isDefined ? pPalette[i * 3 + 1] : 0;
+			palette_[i][2] = isDefined ? pPalette[i * 3 + 2] : 0;
+			palette_[i][3] = i < cbTransparency ? pTransparency[i] : 255;
+		}
+	}
+	else if (pTransparency and colorType_ == 0 and cbTransparency == 2) {
+		hasColorKey_ = true;
+		colorKey_[0] = GetUInt16(pTransparency);
+	}
+	else if (pTransparency and colorType_ == 2 and cbTransparency == 6) {
+		hasColorKey_ = true;
+		for (unsigned k{}; k < 3; ++k) { colorKey_[k] = GetUInt16(pTransparency + k * 2); }
+	}
+
+	width_ = width;
+	height_ = height;
+	if (!isInterlaced_) {
+		const size_t cbRow = (size_t)(((uint64_t)width_ * bitsPerPixel_ + 7) / 8);
+		current_.resize(cbRow + 1);
+		previous_.assign(cbRow + 1, 0);
+	}
+	return true;
+}
+
+// Inflates and unfilters one scanline of cbRow bytes; the result is left in previous_ + 1
+bool PngReader::ReadScanline(size_t cbRow)
+{
+	if (inflater_.Read(current_.data(), cbRow + 1) != cbRow + 1) { return false; }
+	if (current_[0] >= FilterCount) { return false; }
+
+	UnfilterRow((Filter)current_[0], current_.data() + 1, previous_.data() + 1, cbRow, bpp_);
+	current_.swap(previous_);
+	return true;
+}
+
+void PngReader::ExpandRow(const uint8_t* pRaw, uint32_t cPixels, uint8_t* pRgba) const
+{
+	const bool is16 = bitDepth_ == 16;
+	switch (colorType_) {
+	case 0:
+		if (bitDepth_ < 8) {
+			const unsigned maxValue = (1u << bitDepth_) - 1;
+			for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+				const unsigned value = PackedSample(pRaw, x, bitDepth_);
+				pRgba[0] = pRgba[1] = pRgba[2] = (uint8_t)(value * 255 / maxValue);
+				pRgba[3] = hasColorKey_ and value == colorKey_[0] ? 0 : 255;
+			}
+		}
+		else {
+			for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+				const unsigned value = is16 ? GetUInt16(pRaw + x * 2) : pRaw[x];
+				pRgba[0] = pRgba[1] = pRgba[2] = pRaw[is16 ? x * 2 : x];
+				pRgba[3] = hasColorKey_ and value == colorKey_[0] ? 0 : 255;
+			}
+		}
+		break;
+
+	case 2:
+		for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+			if (is16) {
+				const uint8_t* p = pRaw + x * 6;
+				pRgba[0] = p[0];
+				pRgba[1] = p[2];
+				pRgba[2] = p[4];
+				pRgba[3] = hasColorKey_ and GetUInt16(p) == colorKey_[0] and GetUInt16(p + 2) == colorKey_[1] and
+					GetUInt16(p + 4) == colorKey_[2] ? 0 : 255;
+			}
+			else {
+				const uint8_t* p = pRaw + x * 3;
+				pRgba[0] = p[0];
+				pRgba[1] = p[1];
+				pRgba[2] = p[2];
+				pRgba[3] = hasColorKey_ and p[0] == colorKey_[0] and p[1] == colorKey_[1] and p[2] == colorKey_[2] ? 0 : 255;
+			}
+		}
+		break;
+
+	case 3:
+		for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+			const unsigned index = bitDepth_ == 8 ? pRaw[x] : PackedSample(pRaw, x, bitDepth_);
+			memcpy(pRgba, palette_[index], 4);
+		}
+		break;
+
+	case 4:
+		for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+			const uint8_t* p = pRaw + x * (is16 ? 4 : 2);
+			pRgba[0] = pRgba[1] = pRgba[2] = p[0];
+			pRgba[3] = p[is16 ? 2 : 1];
+		}
+		break;
+
+	default:
+		if (!is16) {
+			memcpy(pRgba, pRaw, (size_t)cPixels * 4);
+			break;
+		}
+		for (uint32_t x{}; x < cPixels; ++x, pRgba += 4) {
+			const uint8_t* p = pRaw + x * 8;
+			pRgba[0] = p[0];
+			pRgba[1] = p[2];
+			pRgba[2] = p[4];
+			pRgba[3] = p[6];
+		}
+		break;
+	}
+}
+
+bool PngReader::DecodeInterlaced()
+{
+	canvas_.assign((size_t)width_ * height_ * 4, 0);
+	std::vector<uint8_t> rgba;
+
+	for (const Pass& step : kAdam7) {
+		const uint32_t passWidth = width_ > step.x0 ? (width_ - step.x0 + step.dx - 1) / step.dx : 0;
+		const uint32_t passHeight = height_ > step.y0 ? (height_ - step.y0 + step.dy - 1) / step.dy : 0;
+		if (!passWidth or !passHeight) { continue; }
+
+		const size_t cbRow = (size_t)(((uint64_t)passWidth * bitsPerPixel_ + 7) / 8);
+		current_.resize(cbRow + 1);
+		previous_.assign(cbRow + 1, 0);
+		rgba.resize((size_t)passWidth * 4);
+
+		for (uint32_t y{}; y < passHeight; ++y) {
+			if (!ReadScanline(cbRow)) { return false; }
+			ExpandRow(previous_.data() + 1, passWidth, rgba.data());
+
+			uint8_t* pOut = canvas_.data() + ((size_t)(step.y0 + y * step.dy) * width_ + step.x0) * 4;
+			for (uint32_t x{}; x < passWidth; ++x) {
+				memcpy(pOut + (size_t)x * step.dx * 4, rgba.data() + (size_t)x * 4, 4);
+			}
+		}
+	}
+	return inflater_.GetStatus() == InflateStatus::Done;
+}
+
+bool PngReader::ReadRow(uint8_t* pRgba)
+{
+	if (!pRgba or isFailed_ or nextRow_ >= height_) { return false; }
+
+	if (isInterlaced_) {
+		if (canvas_.empty() and !DecodeInterlaced()) {
+			isFailed_ = true;
+			return false;
+		}
+		memcpy(pRgba, canvas_.data() + (size_t)nextRow_ * width_ * 4, (size_t)width_ * 4);
+		++nextRow_;
+		return true;
+	}
+
+	if (!ReadScanline(current_.size() - 1)) {
+		isFailed_ = true;
+		return false;
+	}
+	ExpandRow(previous_.data() + 1, width_, pRgba);
+
+	// The inflater runs ahead, so the zlib trailer has been checked by the last row
+	if (++nextRow_ == height_ and inflater_.GetStatus() != InflateStatus::Done) {
+		isFailed_ = true;
+		return false;
+	}
+	return true;
+}
+
+bool PngReader::ReadRowProc(const void* pContext, uint32_t y, uint8_t* pRgba)
+{
+	PngReader* pReader = static_cast<PngReader*>(const_cast<void*>(pContext));
+	if (y < pReader->nextRow_) { return false; }
+
+	// Interlaced images are decoded whole: rows are skipped without decoding them
+	if (pReader->isInterlaced_ and !pReader->canvas_.empty()) { pReader->nextRow_ = y; }
+	while (pReader->nextRow_ < y) {
+		if (!pReader->ReadRow(pRgba)) { return false; }
+	}
+	return pReader->ReadRow(pRgba);
+}
+
+
+
+
@@ -0,0 +1,79 @@
+#pragma once
+
+// Implementation-specific headers
+#include "Inflate.h"  // Streaming IDAT decoder
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Row buffers
+
+
+
+// Streaming PNG decoder producing 8-bit RGBA rows, top row first.
+// Only two scanlines are held for non-interlaced images; Adam7 images are decoded whole on
+// the first ReadRow. Every color type and bit depth is accepted: 16-bit samples keep their
+// high byte, palette and gray images are expanded and tRNS becomes alpha. Chunk CRCs are
+// checked for everything except IDAT, whose payload is covered by the zlib checksum.
+// The PNG buffer must stay valid while rows are read.
+class PngReader
+{
+private:
+	uint32_t width_{};
+	uint32_t height_{};
+	uint8_t bitDepth_{};
+	uint8_t colorType_{};
+	bool isInterlaced_{};
+	unsigned bitsPerPixel_{};
+	size_t bpp_{};                   // Filter distance in bytes
+
+	uint8_t palette_[256][4]{};      // RGBA, alpha from tRNS
+	bool hasColorKey_{};
+	uint16_t colorKey_[3]{};         // tRNS for gray (one sample) or RGB
+
+	Inflater inflater_;
+	std::vector<uint8_t> current_;   // Filter byte + one scanline
+	std::vector<uint8_t> previous_;  // Unfiltered scanline above, zero before the first row
+	std::vector<uint8_t> canvas_;    // Whole RGBA image, Adam7 only
+	uint32_t nextRow_{};
+	bool isFailed_{};                // Corrupt data seen, no more rows
+
+private:
+	bool ReadScanline(size_t cbRow);
+	void ExpandRow(const uint8_t* pRaw, uint32_t cPixels, uint8_t* pRgba) const;
+	bool DecodeInterlaced();
+
+public:
+	// Parses the chunks and prepares the first row; false for malformed or unsupported files
+	bool Open(const uint8_t* pPng, size_t cbPng);
+
+	uint32_t GetWidth() const { return width_; }
+	uint32_t GetHeight() const { return height_; }
+
+	// Writes the next row as width * 4 bytes; false past the last row or on corrupt data
+	bool ReadRow(uint8_t* pRgba);
+
+	// Row source for PngImage and PerceptualHash (pContext is the reader): writes row y, decoding
+	// and dropping the rows before it; rows must be requested in increasing order
+	static bool ReadRowProc(const void* pContext, uint32_t y, uint8_t* pRgba);
+
+};
+
+
+
+
+/*
+Usage example:
+
+	PngReader reader;
+	if (reader.Open(pPng, cbPng)) {
+		std::vector<uint8_t> row((size_t)reader.GetWidth() * 4);
+		for (uint32_t y{}; y < reader.GetHeight(); ++y) {
+			if (!reader.ReadRow(row.data())) { break; }
+		}
+	}
+
+*/
+
+
+
@@ -0,0 +1,245 @@
+// Implementation-specific headers
+#include "Qoi.h"
+#include "TraceZones.h"
+
+// Standard library headers
+#include <cstring>  // memcpy, memcmp
+#include <new>      // bad_alloc
+
+
+
+// Anonymous namespace for the format constants
+namespace
+{
+	constexpr uint8_t kOpIndex = 0x00;  // 00xxxxxx
+	constexpr uint8_t kOpDiff  = 0x40;  // 01xxxxxx
+	constexpr uint8_t kOpLuma  = 0x80;  // 10xxxxxx
+	constexpr uint8_t kOpRun   = 0xC0;  // 11xxxxxx
+	constexpr uint8_t kOpRgb   = 0xFE;
+	constexpr uint8_t kOpRgba  = 0xFF;
+	constexpr uint8_t kMask2   = 0xC0;
+
+	constexpr uint8_t kMagic[4] = { 'q', 'o', 'i', 'f' };
+	constexpr uint8_t kPadding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	constexpr uint64_t kMaxPixels = (uint64_t)1 << 28;
+
+	struct Rgba
+	{
+		uint8_t r, g, b, a;
+
+		bool operator==(const Rgba& other) const
+		{
+			return r == other.r and g == other.g and b == other.b and a == other.a;
+		}
+	};
+
+	inline unsigned HashOf(const Rgba& px)
+	{
+		return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+	}
+
+	void PutUInt32(uint8_t* p, uint32_t value)
+	{
+		p[0] = (uint8_t)(value >> 24);
+		p[1] = (uint8_t)(value >> 16);
+		p[2] = (uint8_t)(value >> 8);
+		p[3] = (uint8_t)value;
+	}
+
+	uint32_t GetUInt32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+}
+
+
+
+bool Qoi::Encode(const PngImage& image, std::vector<uint8_t>* pOutput)
+{
+	TRACE_ZONE("Qoi::Encode");
+	if (!pOutput or !image.pfnRow) { return false; }
+	if (image.channels != 3 and image.channels != 4) { return false; }
+	if (!image.width or !image.height or (uint64_t)image.width * image.height > kMaxPixels) { return false; }
+
+	const unsigned channels = image.channels;
+	const size_t cPixels = (size_t)image.width * image.height;
+	std::vector<uint8_t> row((size_t)image.width * channels);
+
+	// Worst case is one RGBA op per pixel; reserve for the common case and let the vector grow
+	pOutput->clear();
+	pOutput->reserve(kHeaderSize + cPixels + sizeof(kPadding));
+	pOutput->resize(kHeaderSize);
+	uint8_t* pHeader = pOutput->data();
+	memcpy(pHeader, kMagic, 4);
+	PutUInt32(pHeader + 4, image.width);
+	PutUInt32(pHeader + 8, image.height);
+	pHeader[12] = (uint8_t)channels;
+	pHeader[13] = 0;  // sRGB with linear alpha
+
+	Rgba index[64]{};
+	Rgba prev{ 0, 0, 0, 255 };
+	unsigned run{};
+	size_t cEncoded{};
+	uint8_t ops[5];
+
+	for (uint32_t y{}; y < image.height; ++y) {
+		if (!image.pfnRow(image.pContext, y, row.data())) { return false; }
+
+		const uint8_t* pSrc = row.data();
+		for (uint32_t x{}; x < image.width; ++x, pSrc += channels) {
+			const Rgba px{ pSrc[0], pSrc[1], pSrc[2], channels == 4 ? pSrc[3] : (uint8_t)255 };
+			++cEncoded;
+
+			if (px == prev) {
+				if (++run == 62 or cEncoded == cPixels) {
+					pOutput->push_back((uint8_t)(kOpRun | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run) {
+				pOutput->push_back((uint8_t)(kOpRun | (run - 1)));
+				run = 0;
+			}
+
+			const unsigned hash = HashOf(px);
+			size_t cOps = 1;
+			if (index[hash] == px) {
+				ops[0] = (uint8_t)(kOpIndex | hash);
+			}
+			else {
+				index[hash] = px;
+				if (px.a == prev.a) {
+					const int dr = (int8_t)(px.r - prev.r);
+					const int dg = (int8_t)(px.g - prev.g);
+					const int db = (int8_t)(px.b - prev.b);
+					const int drg = dr - dg;
+					const int dbg = db - dg;
+
+					if (dr >= -2 and dr <= 1 and dg >= -2 and dg <= 1 and db >= -2 and db <= 1) {
+						ops[0] = (uint8_t)(kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+					}
+					else if (dg >= -32 and dg <= 31 and drg >= -8 and drg <= 7 and dbg >= -8 and dbg <= 7) {
+						ops[0] = (uint8_t)(kOpLuma | (dg + 32));
+						ops[1] = (uint8_t)(((drg + 8) << 4) | (dbg + 8));
+						cOps = 2;
+					}
+					else {
+						ops[0] = kOpRgb;
+						ops[1] = px.r;
+						ops[2] = px.g;
+						ops[3] = px.b;
+						cOps = 4;
+					}
+				}
+				else {
+					ops[0] = kOpRgba;
+					ops[1] = px.r;
+					ops[2] = px.g;
+					ops[3] = px.b;
+					ops[4] = px.a;
+					cOps = 5;
+				}
+			}
+			pOutput->insert(pOutput->end(), ops, ops + cOps);
+			prev = px;
+		}
+	}
+
+	pOutput->insert(pOutput->end(), kPadding, kPadding + sizeof(kPadding));
+	return true;
+}
+
+bool Qoi::Decode(const uint8_t* pData, size_t cbSize, QoiImage* pImage)
+{
+	if (!pData or !pImage or cbSize < kHeaderSize + sizeof(kPadding)) { return false; }
+	if (memcmp(pData, kMagic, 4) != 0) { return false; }
+
+	const uint32_t width = GetUInt32(pData + 4);
+	const uint32_t height = GetUInt32(pData + 8);
+	const unsigned channels = pData[12];
+	if (!width or !height or (uint64_t)width * height > kMaxPixels) { return false; }
+	if (channels != 3 and channels != 4) { return false; }
+
+	const size_t cPixels = (size_t)width * height;
+	try {
+		pImage->pixels.resize(cPixels * channels);
+	}
+	catch (const std::bad_alloc&) {
+		return false;
+	}
+	pImage->width = width;
+	pImage->height = height;
+	pImage->channels = channels;
+
+	Rgba index[64]{};
+	Rgba px{ 0, 0, 0, 255 };
+	unsigned run{};
+	size_t pos = kHeaderSize;
+	const size_t end = cbSize - sizeof(kPadding);
+	uint8_t* pDst = pImage->pixels.data();
+
+	for (size_t i{}; i < cPixels; ++i, pDst += channels) {
+		if (run) {
+			--run;
+		}
+		else {
+			if (pos >= end) { return false; }  // Truncated stream
+			const uint8_t op = pData[pos++];
+
+			if (op == kOpRgb) {
+				if (pos + 3 > end) { return false; }
+				px.r = pData[pos];
+				px.g = pData[pos + 1];
+				px.b = pData[pos + 2];
+				pos += 3;
+			}
+			else if (op == kOpRgba) {
+				if (pos + 4 > end) { return false; }
+				px.r = pData[pos];
+				px.g = pData[pos + 1];
+				px.b = pData[pos + 2];
+				px.a = pData[pos + 3];
+				pos += 4;
+			}
+			else if ((op & kMask2) == kOpIndex) {
+				px = index[op];
+			}
+			else if ((op & kMask2) == kOpDiff) {
+				px.r += (uint8_t)(((op >> 4) & 3) - 2);
+				px.g += (uint8_t)(((op >> 2) & 3) - 2);
+				px.b += (uint8_t)((op & 3) - 2);
+			}
+			else if ((op & kMask2) == kOpLuma) {
+				if (pos >= end) { return false; }
+				const uint8_t next = pData[pos++];
+				const int dg = (op & 0x3F) - 32;
+				px.r += (uint8_t)(dg - 8 + ((next >> 4) & 0x0F));
+				px.g += (uint8_t)dg;
+				px.b += (uint8_t)(dg - 8 + (next & 0x0F));
+			}
+			else {
+				run = op & 0x3F;
+			}
+			index[HashOf(px)] = px;
+		}
+
+		pDst[0] = px.r;
+		pDst[1] = px.g;
+		pDst[2] = px.b;
+		if (channels == 4) { pDst[3] = px.a; }
+	}
+	return true;
+}
+
+bool Qoi::ReadRowProc(const void* pContext, uint32_t y, uint8_t* pRow)
+{
+	const QoiImage* pImage = static_cast<const QoiImage*>(pContext);
+	const size_t cbRow = (size_t)pImage->width * pImage->channels;
+	memcpy(pRow, pImage->pixels.data() + y * cbRow, cbRow);
+	return true;
+}
+
+
+
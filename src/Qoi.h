@@ -0,0 +1,59 @@
+#pragma once
+
+// Implementation-specific headers
+#include "PngEncoder.h"  // PngImage row source
+
+// Standard library headers
+#include <cstdint>  // Fixed-width integers
+#include <cstddef>  // size_t
+#include <vector>   // Buffers
+
+
+
+// Decoded QOI image, rows top to bottom
+struct QoiImage
+{
+	uint32_t width{};
+	uint32_t height{};
+	unsigned channels{};          // 3 (RGB) or 4 (RGBA)
+	std::vector<uint8_t> pixels;  // width * channels bytes per row
+};
+
+
+
+// "Quite OK Image" codec (qoiformat.org). Encoding is a single pass with a 64-entry
+// color cache and costs a few cycles per pixel, which makes it a cheap spool format
+// for captures that are converted to PNG later.
+namespace Qoi
+{
+	constexpr size_t kHeaderSize = 14;
+
+	// Encodes the same row-pulled source EncodePng takes
+	bool Encode(const PngImage& image, std::vector<uint8_t>* pOutput);
+
+	// Validates and decodes a whole file
+	bool Decode(const uint8_t* pData, size_t cbSize, QoiImage* pImage);
+
+	// PngRowProc over a QoiImage, for transcoding
+	bool ReadRowProc(const void* pContext, uint32_t y, uint8_t* pRow);
+}
+
+
+
+
+/*
+Usage example:
+
+	std::vector<uint8_t> qoi;
+	Qoi::Encode(PngImage{ width, height, 4, GetRow, &source }, &qoi);
+
+	QoiImage image;
+	if (Qoi::Decode(qoi.data(), qoi.size(), &image)) {
+		PngImage source{ image.width, image.height, image.channels, Qoi::ReadRowProc, &image };
+		EncodePng(source, PngEncodeOptions{}, &png);
+	}
+
+*/
+
+
+
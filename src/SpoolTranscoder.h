@@ -0,0 +1,300 @@
+#pragma once
+
+// Implementation-specific headers
+#include "TStringHash.h"       // tstring
+#include "AtomicFileWriter.h"  // PNG output
+#include "PngEncoder.h"        // Final encode
+#include "Qoi.h"               // Spool format
+#include "TraceZones.h"        // Worker timeline
+
+// Standard library headers
+#include <atomic>     // Stop flag and counters
+#include <deque>      // Pending spool files
+#include <vector>     // File buffers
+#include <algorithm>  // sort
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Called on the worker thread with the path of every PNG the transcoder finishes
+using SpoolCompletedProc = void (*)(LPCTSTR cszPngPath);
+
+
+
+// Background converter from QOI spool files to PNG.
+// Captures in spool mode are written as "<name>.qoi"; the transcoder turns each one into
+// "<name>.png" on a single background-priority thread and deletes the spool file. Work that
+// is left over at exit is picked up again on the next Start, by the worker scanning the spool
+// directory and its shard subdirectories.
+class SpoolTranscoder
+{
+private:
+	static constexpr LPCTSTR kSpoolExtension = _T(".qoi");
+	static constexpr LPCTSTR kFailedExtension = _T(".qoi.failed");  // Undecodable spool files are parked here
+	static constexpr unsigned kMaxScanDepth = 3;                     // Shard levels below the spool directory
+
+	std::deque<tstring> pending_;
+	SRWLOCK lock_ = SRWLOCK_INIT;
+	HANDLE hThread_{};
+	HANDLE hWakeup_{};
+	std::atomic<bool> isStopping_{};
+	std::atomic<unsigned> cCompleted_{};
+	std::atomic<unsigned> cFailed_{};
+
+	PngEncodeOptions options_{};
+	AtomicFileWriter* pWriter_{};
+	tstring scanDirectory_;  // Leftovers to resume, scanned by the worker
+	HWND hNotifyWnd_{};
+	UINT uNotifyMsg_{};
+	SpoolCompletedProc pfnCompleted_{};
+
+private:
+	static DWORD WINAPI WorkerThunk(LPVOID lpParam)
+	{
+		static_cast<SpoolTranscoder*>(lpParam)->WorkerLoop();
+		return 0;
+	}
+
+	static bool ReadWholeFile(LPCTSTR cszPath, std::vector<uint8_t>* pData)
+	{
+		HANDLE hFile = CreateFile(cszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) { return false; }
+
+		LARGE_INTEGER liSize{};
+		bool isRead{};
+		if (GetFileSizeEx(hFile, &liSize) and liSize.QuadPart > 0 and liSize.QuadPart < MAXDWORD) {
+			pData->resize((size_t)liSize.QuadPart);
+			DWORD cbRead{};
+			isRead = ReadFile(hFile, pData->data(), (DWORD)pData->size(), &cbRead, NULL) and cbRead == pData->size();
+		}
+		CloseHandle(hFile);
+		return isRead;
+	}
+
+	bool Transcode(const tstring& spoolPath)
+	{
+		std::vector<uint8_t> spool;
+		QoiImage image;
+		if (!ReadWholeFile(spoolPath.c_str(), &spool) or !Qoi::Decode(spool.data(), spool.size(), &image)) {
+			MoveFileEx(spoolPath.c_str(), (spoolPath.substr(0, spoolPath.size() - _tcslen(kSpoolExtension)) + kFailedExtension).c_str(),
+				MOVEFILE_REPLACE_EXISTING);
+			return false;
+		}
+		spool = {};
+
+		const PngImage source{ image.width, image.height, image.channels, Qoi::ReadRowProc, &image };
+		std::vector<uint8_t> png;
+		if (!EncodePng(source, options_, &png)) { return false; }
+
+		const tstring pngPath = spoolPath.substr(0, spoolPath.size() - _tcslen(kSpoolExtension)) + _T(".png");
+		if (!pWriter_->Write(pngPath.c_str(), png.data(), png.size())) { return false; }
+
+		DeleteFile(spoolPath.c_str());
+		if (pfnCompleted_) { pfnCompleted_(pngPath.c_str()); }
+		return true;
+	}
+
+	void WorkerLoop()
+	{
+		// Lowers CPU and I/O priority so capture bursts always win
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+		TRACE_THREAD("spool transcoder");
+
+		if (!scanDirectory_.empty()) { EnqueueLeftovers(); }
+
+		for (;;) {
+			WaitForSingleObject(hWakeup_, INFINITE);
+			if (isStopping_.load(std::memory_order_acquire)) { break; }
+
+			tstring spoolPath;
+			AcquireSRWLockExclusive(&lock_);
+			if (!pending_.empty()) {
+				spoolPath = std::move(pending_.front());
+				pending_.pop_front();
+			}
+			ReleaseSRWLockExclusive(&lock_);
+			if (spoolPath.empty()) { continue; }
+
+			if (Transcode(spoolPath)) { ++cCompleted_; }
+			else { ++cFailed_; }
+
+			if (hNotifyWnd_) { PostMessage(hNotifyWnd_, uNotifyMsg_, (WPARAM)GetQueueDepth(), 0); }
+		}
+
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+	}
+
+	// Spool files in directory (with its trailing separator) and in its subdirectories
+	static void FindLeftovers(const tstring& directory, unsigned depth, std::vector<tstring>* pLeftovers)
+	{
+		WIN32_FIND_DATA findData{};
+		HANDLE hFind = FindFirstFile((directory + _T("*") + kSpoolExtension).c_str(), &findData);
+		if (hFind != INVALID_HANDLE_VALUE) {
+			do {
+				if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+					pLeftovers->push_back(directory + findData.cFileName);
+				}
+			} while (FindNextFile(hFind, &findData));
+			FindClose(hFind);
+		}
+		if (depth == kMaxScanDepth) { return; }
+
+		// Asks for directories only; file systems that ignore the hint list every file once
+		hFind = FindFirstFileEx((directory + _T("*")).c_str(), FindExInfoBasic, &findData,
+			FindExSearchLimitToDirectories, NULL, FIND_FIRST_EX_LARGE_FETCH);
+		if (hFind == INVALID_HANDLE_VALUE) { return; }
+		do {
+			const bool isSubdirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				and !(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+				and _tcscmp(findData.cFileName, _T(".")) != 0 and _tcscmp(findData.cFileName, _T("..")) != 0;
+			if (isSubdirectory) {
+				FindLeftovers(directory + findData.cFileName + _T("\\"), depth + 1, pLeftovers);
+			}
+		} while (FindNextFile(hFind, &findData));
+		FindClose(hFind);
+	}
+
+	// Queues spool files left over from a previous run ahead of new ones, oldest name first
+	void EnqueueLeftovers()
+	{
+		std::vector<tstring> leftovers;
+		FindLeftovers(scanDirectory_, 0, &leftovers);
+		if (leftovers.empty()) { return; }
+		std::sort(leftovers.begin(), leftovers.end());
+
+		AcquireSRWLockExclusive(&lock_);
+		pending_.insert(pending_.begin(), leftovers.begin(), leftovers.end());
+		ReleaseSRWLockExclusive(&lock_);
+
+		ReleaseSemaphore(hWakeup_, (LONG)leftovers.size(), NULL);
+	}
+
+public:
+	~SpoolTranscoder()
+	{
+		Stop();
+	}
+
+	// Starts the worker, which first resumes the spool files found in cszDirectory and the
+	// shard directories below it. PNGs are written through pWriter, so a half-written PNG
+	// never carries the final name.
+	// Every finished file posts (uNotifyMsg, queue depth, 0) to hNotifyWnd.
+	bool Start(LPCTSTR cszDirectory, const PngEncodeOptions& options, AtomicFileWriter* pWriter,
+		HWND hNotifyWnd, UINT uNotifyMsg, SpoolCompletedProc pfnCompleted = NULL)
+	{
+		if (hThread_ or !pWriter) { return false; }
+
+		options_ = options;
+		pWriter_ = pWriter;
+		scanDirectory_ = cszDirectory ? cszDirectory : _T("");
+		if (!scanDirectory_.empty() and scanDirectory_.back() != _T('\\')) { scanDirectory_ += _T('\\'); }
+		hNotifyWnd_ = hNotifyWnd;
+		uNotifyMsg_ = uNotifyMsg;
+		pfnCompleted_ = pfnCompleted;
+		isStopping_ = false;
+
+		hWakeup_ = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+		if (!hWakeup_) { return false; }
+
+		hThread_ = CreateThread(NULL, 0, WorkerThunk, this, 0, NULL);
+		if (!hThread_) {
+			CloseHandle(hWakeup_);
+			hWakeup_ = NULL;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Hands a finished spool file to the worker
+	bool Enqueue(LPCTSTR cszSpoolPath)
+	{
+		if (!cszSpoolPath or !hThread_) { return false; }
+
+		AcquireSRWLockExclusive(&lock_);
+		pending_.push_back(cszSpoolPath);
+		ReleaseSRWLockExclusive(&lock_);
+
+		ReleaseSemaphore(hWakeup_, 1, NULL);
+		return true;
+	}
+
+	// Finishes the file in progress; the rest stays on disk for the next Start
+	void Stop()
+	{
+		if (!hThread_) { return; }
+
+		isStopping_.store(true, std::memory_order_release);
+		ReleaseSemaphore(hWakeup_, 1, NULL);
+		WaitForSingleObject(hThread_, INFINITE);
+		CloseHandle(hThread_);
+		hThread_ = NULL;
+
+		CloseHandle(hWakeup_);
+		hWakeup_ = NULL;
+
+		AcquireSRWLockExclusive(&lock_);
+		pending_.clear();
+		ReleaseSRWLockExclusive(&lock_);
+	}
+
+	size_t GetQueueDepth()
+	{
+		AcquireSRWLockShared(&lock_);
+		const size_t cPending = pending_.size();
+		ReleaseSRWLockShared(&lock_);
+		return cPending;
+	}
+
+	unsigned GetCompletedCount() const
+	{
+		return cCompleted_.load(std::memory_order_relaxed);
+	}
+
+	unsigned GetFailedCount() const
+	{
+		return cFailed_.load(std::memory_order_relaxed);
+	}
+
+	// Spool file name for a final PNG name: "<name>.png" -> "<name>.qoi"
+	static bool GetSpoolPath(LPCTSTR cszPngPath, LPTSTR szSpoolPath, size_t cchSpoolPath)
+	{
+		if (!cszPngPath or !szSpoolPath) { return false; }
+
+		LPCTSTR cszExtension = _tcsrchr(cszPngPath, _T('.'));
+		const size_t cchStem = cszExtension ? (size_t)(cszExtension - cszPngPath) : _tcslen(cszPngPath);
+		if (cchStem + _tcslen(kSpoolExtension) + 1 > cchSpoolPath) { return false; }
+
+		_tcsncpy_s(szSpoolPath, cchSpoolPath, cszPngPath, cchStem);
+		_tcscat_s(szSpoolPath, cchSpoolPath, kSpoolExtension);
+		return true;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static AtomicFileWriter writer;
+	static SpoolTranscoder transcoder;
+	transcoder.Start(szOutputDirectory, PngEncodeOptions{ PngLevel::Default, 1 }, &writer, hWnd, WM_APP_SPOOL_PROGRESS);
+
+	TCHAR szSpoolPath[MAX_PATH];
+	SpoolTranscoder::GetSpoolPath(szPngPath, szSpoolPath, MAX_PATH);
+	// ...write the QOI file to szSpoolPath...
+	transcoder.Enqueue(szSpoolPath);
+
+	// WndProc
+	case WM_APP_SPOOL_PROGRESS:
+		// wParam = files still queued
+
+*/
+
+
+
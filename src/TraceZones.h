@@ -0,0 +1,213 @@
+#pragma once
+
+// Scoped trace zones for a Chrome/Perfetto timeline of the capture path.
+// Build with CIS_TRACE_ZONES=1 to record them; otherwise TRACE_ZONE and TRACE_THREAD expand
+// to nothing and this header declares nothing else.
+#ifndef CIS_TRACE_ZONES
+#define CIS_TRACE_ZONES 0
+#endif
+
+#if CIS_TRACE_ZONES
+
+// Standard library headers
+#include <atomic>   // Ring heads and registry
+#include <cstdint>  // Fixed-width integers
+#include <cstdio>   // snprintf
+#include <string>   // JSON text
+#include <vector>   // Event snapshots
+
+// Windows system headers
+#include <windows.h>  // QueryPerformanceCounter
+
+
+
+// Every thread that enters a zone gets a ring of the last kCapacity zones, written by that
+// thread only: closing a zone is three relaxed stores and one release store, no lock and no
+// allocation. Rings are registered once and live until exit. A dump copies each ring and
+// drops the entries its thread overwrote meanwhile, so it can run on any thread at any time.
+namespace Trace
+{
+	constexpr size_t kCapacity = 8192;  // Zones kept per thread, a power of two
+	constexpr size_t kMaxThreads = 64;
+
+	struct Event
+	{
+		std::atomic<const char*> pszName{};  // String literal
+		std::atomic<int64_t> llBegin{};      // Performance counter ticks
+		std::atomic<int64_t> llEnd{};
+	};
+
+	struct Ring
+	{
+		Event events[kCapacity];
+		std::atomic<uint64_t> head{};                 // Zones written so far
+		std::atomic<const char*> pszThreadName{};
+		unsigned nThread{};                           // Small id for the timeline, 1 upward
+	};
+
+	inline std::atomic<Ring*> g_rings[kMaxThreads]{};
+	inline std::atomic<unsigned> g_cRings{};
+
+	inline int64_t Now()
+	{
+		LARGE_INTEGER li;
+		QueryPerformanceCounter(&li);
+		return li.QuadPart;
+	}
+
+	inline double TicksPerMicrosecond()
+	{
+		static const double ticksPerUs = []() {
+			LARGE_INTEGER li;
+			QueryPerformanceFrequency(&li);
+			return (double)li.QuadPart / 1e6;
+		}();
+		return ticksPerUs;
+	}
+
+	// This thread's ring; NULL once kMaxThreads threads have one
+	inline Ring* GetRing()
+	{
+		thread_local Ring* pRing = []() -> Ring* {
+			const unsigned nSlot = g_cRings.fetch_add(1, std::memory_order_relaxed);
+			if (nSlot >= kMaxThreads) { return nullptr; }
+			Ring* pNew = new Ring;
+			pNew->nThread = nSlot + 1;
+			g_rings[nSlot].store(pNew, std::memory_order_release);
+			return pNew;
+		}();
+		return pRing;
+	}
+
+	inline void Record(const char* pszName, int64_t llBegin, int64_t llEnd)
+	{
+		Ring* pRing = GetRing();
+		if (!pRing) { return; }
+
+		const uint64_t head = pRing->head.load(std::memory_order_relaxed);
+		Event& event = pRing->events[head & (kCapacity - 1)];
+		event.pszName.store(pszName, std::memory_order_relaxed);
+		event.llBegin.store(llBegin, std::memory_order_relaxed);
+		event.llEnd.store(llEnd, std::memory_order_relaxed);
+		pRing->head.store(head + 1, std::memory_order_release);
+	}
+
+	// Label of the calling thread on the timeline (a string literal)
+	inline void NameThread(const char* pszName)
+	{
+		if (Ring* pRing = GetRing()) { pRing->pszThreadName.store(pszName, std::memory_order_relaxed); }
+	}
+
+	// Chrome trace event format ("X" complete events, microseconds), loadable in
+	// chrome://tracing and ui.perfetto.dev. Only zones that ended at or after llSince.
+	inline std::string ToChromeJson(int64_t llSince = 0)
+	{
+		const double ticksPerUs = TicksPerMicrosecond();
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool isFirst = true;
+		char szEvent[256];
+
+		const unsigned cRings = g_cRings.load(std::memory_order_relaxed);
+		for (unsigned i{}; i < cRings and i < kMaxThreads; ++i) {
+			const Ring* pRing = g_rings[i].load(std::memory_order_acquire);
+			if (!pRing) { continue; }
+
+			// Copy, then keep only what the writer cannot have overwritten during the copy
+			const uint64_t head = pRing->head.load(std::memory_order_acquire);
+			const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+			struct Copy { const char* pszName; int64_t llBegin; int64_t llEnd; };
+			std::vector<Copy> copies;
+			copies.reserve((size_t)(head - first));
+			for (uint64_t n = first; n < head; ++n) {
+				const Event& event = pRing->events[n & (kCapacity - 1)];
+				copies.push_back({ event.pszName.load(std::memory_order_relaxed),
+					event.llBegin.load(std::memory_order_relaxed), event.llEnd.load(std::memory_order_relaxed) });
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t headAfter = pRing->head.load(std::memory_order_relaxed);
+			const uint64_t firstValid = headAfter > kCapacity ? headAfter - kCapacity : 0;
+
+			const char* pszThreadName = pRing->pszThreadName.load(std::memory_order_relaxed);
+			snprintf(szEvent, sizeof(szEvent),
+				"%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				isFirst ? "" : ",\n", pRing->nThread, pszThreadName ? pszThreadName : "thread");
+			json += szEvent;
+			isFirst = false;
+
+			for (uint64_t n = first > firstValid ? first : firstValid; n < head; ++n) {
+				const Copy& copy = copies[(size_t)(n - first)];
+				if (!copy.pszName or copy.llEnd < llSince) { continue; }
+				snprintf(szEvent, sizeof(szEvent),
+					",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.1f,\"dur\":%.1f}",
+					copy.pszName, pRing->nThread, (double)copy.llBegin / ticksPerUs,
+					(double)(copy.llEnd - copy.llBegin) / ticksPerUs);
+				json += szEvent;
+			}
+		}
+
+		json += "\n]}\n";
+		return json;
+	}
+
+	inline int64_t MillisecondsToTicks(double milliseconds)
+	{
+		return (int64_t)(milliseconds * 1000 * TicksPerMicrosecond());
+	}
+}
+
+
+
+// Records the time from its construction to the end of its scope
+class TraceZone
+{
+private:
+	const char* pszName_;
+	int64_t llBegin_;
+
+public:
+	explicit TraceZone(const char* pszName) : pszName_{ pszName }, llBegin_{ Trace::Now() } {}
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+	~TraceZone()
+	{
+		Trace::Record(pszName_, llBegin_, Trace::Now());
+	}
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone_, __LINE__){ name }
+#define TRACE_THREAD(name) Trace::NameThread(name)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+
+#endif // CIS_TRACE_ZONES
+
+
+
+
+/*
+Usage example:
+
+	// cl /DCIS_TRACE_ZONES=1 ...
+	DWORD WINAPI WorkerThread(LPVOID)
+	{
+		TRACE_THREAD("capture worker");
+		{
+			TRACE_ZONE("Encode");
+			EncodePng(image, options, &png);
+		}
+	}
+
+#if CIS_TRACE_ZONES
+	const std::string json = Trace::ToChromeJson();  // Save as .json, open in ui.perfetto.dev
+#endif
+
+*/
+
+
+
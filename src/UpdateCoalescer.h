@@ -0,0 +1,147 @@
+#pragma once
+
+// Standard library headers
+#include <algorithm>  // min, max
+
+// Windows system headers
+#include <windows.h>
+
+
+
+// Tuning knobs of UpdateCoalescer
+struct UpdateCoalescerOptions
+{
+	DWORD minWindowMs{ 50 };   // Quiet time after the last update before it is processed
+	DWORD maxWindowMs{ 500 };  // Upper bound of the adaptive window
+	DWORD maxDelayMs{ 1000 };  // Longest an update waits while updates keep arriving
+	UINT costFactor{ 2 };      // Window = average processing cost x factor, within the bounds
+};
+
+struct UpdateCoalescerStats
+{
+	UINT64 cUpdates{};    // Updates received
+	UINT64 cCoalesced{};  // Updates folded into one still pending
+	UINT64 cProcessed{};  // Times the pending state was handed to the caller
+};
+
+
+
+// Trailing-edge, latest-wins scheduling of clipboard updates.
+// An update is not processed when it arrives but once no other update has followed for the
+// window, so a burst collapses into one pass over its final state, and that final state is
+// never dropped. The window follows the measured processing cost, so slow captures coalesce
+// more, and an unbroken stream is still sampled every maxDelayMs. The caller owns the timer
+// and the clock (milliseconds); single-threaded, like the message loop it serves.
+class UpdateCoalescer
+{
+private:
+	UpdateCoalescerOptions options_{};
+	UpdateCoalescerStats stats_{};
+	bool isPending_{};
+	ULONGLONG ullFirstPendingMs_{};
+	ULONGLONG ullLastUpdateMs_{};
+	double averageCostMs_{};
+
+private:
+	DWORD GetDelay(ULONGLONG ullNowMs) const
+	{
+		const ULONGLONG ullDueMs = (std::min)(ullLastUpdateMs_ + GetWindow(), ullFirstPendingMs_ + options_.maxDelayMs);
+		return ullDueMs > ullNowMs ? (DWORD)(ullDueMs - ullNowMs) : 0;
+	}
+
+public:
+	void SetOptions(const UpdateCoalescerOptions& options)
+	{
+		options_ = options;
+		options_.maxWindowMs = (std::max)(options_.maxWindowMs, options_.minWindowMs);
+	}
+
+	// Records an update; returns the delay until it is due, for the caller to (re)arm its timer
+	DWORD OnUpdate(ULONGLONG ullNowMs)
+	{
+		++stats_.cUpdates;
+		if (isPending_) {
+			++stats_.cCoalesced;
+		}
+		else {
+			isPending_ = true;
+			ullFirstPendingMs_ = ullNowMs;
+		}
+		ullLastUpdateMs_ = ullNowMs;
+		return GetDelay(ullNowMs);
+	}
+
+	// Called when the timer fires. True if the pending state must be processed now (it is then
+	// no longer pending); otherwise *pdwDelayMs receives the time left, 0 if nothing is pending.
+	bool IsDue(ULONGLONG ullNowMs, DWORD* pdwDelayMs)
+	{
+		if (pdwDelayMs) { *pdwDelayMs = 0; }
+		if (!isPending_) { return false; }
+
+		const DWORD dwDelayMs = GetDelay(ullNowMs);
+		if (dwDelayMs) {
+			if (pdwDelayMs) { *pdwDelayMs = dwDelayMs; }
+			return false;
+		}
+
+		isPending_ = false;
+		++stats_.cProcessed;
+		return true;
+	}
+
+	// Feeds the cost of the pass IsDue asked for into the window (moving average)
+	void OnProcessed(double costMs)
+	{
+		averageCostMs_ = stats_.cProcessed > 1 ? averageCostMs_ + (costMs - averageCostMs_) / 4 : costMs;
+	}
+
+	// Current quiet time required after the last update
+	DWORD GetWindow() const
+	{
+		const double windowMs = averageCostMs_ * options_.costFactor;
+		if (windowMs <= options_.minWindowMs) { return options_.minWindowMs; }
+		return windowMs >= options_.maxWindowMs ? options_.maxWindowMs : (DWORD)windowMs;
+	}
+
+	bool IsPending() const
+	{
+		return isPending_;
+	}
+
+	UpdateCoalescerStats GetStats() const
+	{
+		return stats_;
+	}
+
+};
+
+
+
+
+/*
+Usage example:
+
+	static UpdateCoalescer coalescer;
+
+	// WndProc
+	case WM_CLIPBOARDUPDATE:
+		SetTimer(hWnd, IDT_CLIPBOARD_COALESCE, coalescer.OnUpdate(GetTickCount64()), NULL);
+		break;
+
+	case WM_TIMER:
+		KillTimer(hWnd, IDT_CLIPBOARD_COALESCE);
+		DWORD dwDelayMs{};
+		if (coalescer.IsDue(GetTickCount64(), &dwDelayMs)) {
+			const LONGLONG llStart = CaptureTimings::Now();
+			ProcessClipboard();
+			coalescer.OnProcessed(CaptureTimings::ToMilliseconds(CaptureTimings::Now() - llStart));
+		}
+		else if (dwDelayMs) {
+			SetTimer(hWnd, IDT_CLIPBOARD_COALESCE, dwDelayMs, NULL);
+		}
+		break;
+
+*/
+
+
+
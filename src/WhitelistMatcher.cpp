@@ -0,0 +1,233 @@
+// Implementation-specific headers
+#include "WhitelistMatcher.h"
+
+// Standard library headers
+#include <cstring>      // memcmp
+#include <cwctype>      // towlower
+#include <type_traits>  // make_unsigned
+
+
+
+// Anonymous namespace for folding and hashing
+namespace
+{
+	// Longer rules are ignored and longer owners never match
+	constexpr size_t kMaxSubject = 1024;
+
+	using UnsignedChar = std::make_unsigned_t<TCHAR>;
+
+	TCHAR Fold(TCHAR c)
+	{
+		if (c >= _T('A') and c <= _T('Z')) { return (TCHAR)(c + (_T('a') - _T('A'))); }
+		if (c == _T('/')) { return _T('\\'); }
+		if constexpr (sizeof(TCHAR) > 1) {
+			if ((UnsignedChar)c > 0x7F) { return (TCHAR)towlower((wint_t)c); }
+		}
+		return c;
+	}
+
+	bool IsWildcard(TCHAR c)
+	{
+		return c == _T('*') or c == _T('?');
+	}
+
+	// FNV-1a over the characters
+	uint32_t HashText(const TCHAR* pText, size_t cchText)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i{}; i < cchText; ++i) {
+			hash = (hash ^ (uint32_t)(UnsignedChar)pText[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	uint64_t EdgeKey(uint32_t node, TCHAR c)
+	{
+		return (uint64_t)node << 32 | (UnsignedChar)c;
+	}
+}
+
+
+
+size_t WhitelistMatcher::Compile(LPCTSTR cszRules)
+{
+	text_.clear();
+	patterns_.clear();
+	for (size_t i{}; i < SubjectCount; ++i) {
+		literals_[i].clear();
+		slots_[i].clear();
+		prefixes_[i] = Trie{};
+		suffixes_[i] = Trie{};
+		unanchored_[i].clear();
+	}
+	cRules_ = 0;
+	if (!cszRules) { return 0; }
+
+	const TCHAR* pLine = cszRules;
+	for (const TCHAR* p = cszRules; ; ++p) {
+		if (*p == _T('\r') or *p == _T('\n') or !*p) {
+			AddRule(pLine, (size_t)(p - pLine));
+			pLine = p + 1;
+		}
+		if (!*p) { break; }
+	}
+
+	BuildSlots(Name);
+	BuildSlots(Path);
+	return cRules_;
+}
+
+void WhitelistMatcher::AddRule(const TCHAR* pRule, size_t cchRule)
+{
+	while (cchRule and (*pRule == _T(' ') or *pRule == _T('\t'))) { ++pRule; --cchRule; }
+	while (cchRule and (pRule[cchRule - 1] == _T(' ') or pRule[cchRule - 1] == _T('\t'))) { --cchRule; }
+	if (!cchRule or cchRule > kMaxSubject) { return; }
+
+	const Span span{ (uint32_t)text_.size(), (uint32_t)cchRule };
+	bool isPath{};
+	size_t cchPrefix = cchRule;  // Literal characters before the first wildcard
+	size_t cchSuffix{};          // and after the last one
+	for (size_t i{}; i < cchRule; ++i) {
+		const TCHAR c = Fold(pRule[i]);
+		text_.push_back(c);
+		if (c == _T('\\') or c == _T(':')) { isPath = true; }
+		if (IsWildcard(c)) {
+			if (cchPrefix == cchRule) { cchPrefix = i; }
+			cchSuffix = cchRule - i - 1;
+		}
+	}
+	++cRules_;
+
+	const Subject subject = isPath ? Path : Name;
+	if (cchPrefix == cchRule) {
+		literals_[subject].push_back(span);
+		return;
+	}
+
+	const uint32_t index = (uint32_t)patterns_.size();
+	patterns_.push_back({ span });
+	if (!cchPrefix and !cchSuffix) {
+		unanchored_[subject].push_back(index);
+		return;
+	}
+
+	// File the pattern under its longer literal end
+	const bool isForward = cchPrefix >= cchSuffix;
+	Trie& trie = isForward ? prefixes_[subject] : suffixes_[subject];
+	const size_t cchAnchor = isForward ? cchPrefix : cchSuffix;
+	uint32_t node{};
+	for (size_t i{}; i < cchAnchor; ++i) {
+		const TCHAR c = text_[span.offset + (isForward ? i : cchRule - 1 - i)];
+		auto it = trie.edges.find(EdgeKey(node, c));
+		if (it == trie.edges.end()) {
+			it = trie.edges.emplace(EdgeKey(node, c), (uint32_t)trie.heads.size()).first;
+			trie.heads.push_back(0);
+		}
+		node = it->second;
+	}
+	patterns_[index].next = trie.heads[node];
+	trie.heads[node] = index + 1;
+}
+
+void WhitelistMatcher::BuildSlots(Subject subject)
+{
+	const std::vector<Span>& literals = literals_[subject];
+	if (literals.empty()) { return; }
+
+	size_t cSlots = 16;
+	while (cSlots < literals.size() * 2) { cSlots *= 2; }
+	std::vector<uint32_t>& slots = slots_[subject];
+	slots.assign(cSlots, 0);
+
+	for (size_t i{}; i < literals.size(); ++i) {
+		size_t slot = HashText(&text_[literals[i].offset], literals[i].length) & (cSlots - 1);
+		while (slots[slot]) { slot = (slot + 1) & (cSlots - 1); }
+		slots[slot] = (uint32_t)i + 1;
+	}
+}
+
+bool WhitelistMatcher::IsLiteral(Subject subject, const TCHAR* pSubject, size_t cchSubject) const
+{
+	const std::vector<uint32_t>& slots = slots_[subject];
+	if (slots.empty()) { return false; }
+
+	const size_t mask = slots.size() - 1;
+	for (size_t slot = HashText(pSubject, cchSubject) & mask; slots[slot]; slot = (slot + 1) & mask) {
+		const Span& literal = literals_[subject][slots[slot] - 1];
+		if (literal.length == cchSubject and memcmp(&text_[literal.offset], pSubject, cchSubject * sizeof(TCHAR)) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool WhitelistMatcher::IsPatternMatch(Subject subject, const TCHAR* pSubject, size_t cchSubject) const
+{
+	for (uint32_t index : unanchored_[subject]) {
+		if (IsGlobMatch(patterns_[index], pSubject, cchSubject)) { return true; }
+	}
+
+	// One walk per trie; the patterns met on the way share the subject's literal end
+	for (int direction{}; direction < 2; ++direction) {
+		const Trie& trie = direction == 0 ? prefixes_[subject] : suffixes_[subject];
+		uint32_t node{};
+		for (size_t i{}; i < cchSubject; ++i) {
+			const auto it = trie.edges.find(EdgeKey(node, pSubject[direction == 0 ? i : cchSubject - 1 - i]));
+			if (it == trie.edges.end()) { break; }
+			node = it->second;
+			for (uint32_t next = trie.heads[node]; next; next = patterns_[next - 1].next) {
+				if (IsGlobMatch(patterns_[next - 1], pSubject, cchSubject)) { return true; }
+			}
+		}
+	}
+	return false;
+}
+
+// '*' backtracks to its last position only, which is linear in practice
+bool WhitelistMatcher::IsGlobMatch(const Pattern& pattern, const TCHAR* pSubject, size_t cchSubject) const
+{
+	const TCHAR* pPattern = &text_[pattern.text.offset];
+	const size_t cchPattern = pattern.text.length;
+	size_t p{}, s{};
+	size_t star = cchPattern;
+	size_t mark{};
+	while (s < cchSubject) {
+		if (p < cchPattern and (pPattern[p] == _T('?') or pPattern[p] == pSubject[s])) {
+			++p;
+			++s;
+		}
+		else if (p < cchPattern and pPattern[p] == _T('*')) {
+			star = p++;
+			mark = s;
+		}
+		else if (star != cchPattern) {
+			p = star + 1;
+			s = ++mark;
+		}
+		else {
+			return false;
+		}
+	}
+	while (p < cchPattern and pPattern[p] == _T('*')) { ++p; }
+	return p == cchPattern;
+}
+
+bool WhitelistMatcher::IsMatch(LPCTSTR cszOwner) const
+{
+	if (!cszOwner or !*cszOwner or !cRules_) { return false; }
+
+	// Fold into a stack buffer; the name is what follows the last separator
+	TCHAR szFolded[kMaxSubject];
+	size_t cchOwner{};
+	size_t nameStart{};
+	for (; cszOwner[cchOwner]; ++cchOwner) {
+		if (cchOwner == kMaxSubject) { return false; }
+		szFolded[cchOwner] = Fold(cszOwner[cchOwner]);
+		if (szFolded[cchOwner] == _T('\\')) { nameStart = cchOwner + 1; }
+	}
+
+	const TCHAR* pName = szFolded + nameStart;
+	const size_t cchName = cchOwner - nameStart;
+	if (IsLiteral(Name, pName, cchName) or IsPatternMatch(Name, pName, cchName)) { return true; }
+	return nameStart and (IsLiteral(Path, szFolded, cchOwner) or IsPatternMatch(Path, szFolded, cchOwner));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Standard library headers
+#include <cstdint>        // Fixed-width integers
+#include <vector>         // Compiled rules
+#include <unordered_map>  // Trie edges
+
+// Windows system headers
+#include <windows.h>
+#include <tchar.h>
+
+
+
+// Whitelist compiled once, matched without allocating.
+// Rules are separated by line breaks and matched case-insensitively, with '/' read as '\'.
+// A rule without a path separator applies to the executable name, one with a separator to the
+// full path. '*' stands for any run of characters (separators included) and '?' for exactly
+// one, so "chrome.exe", "snip*.exe" and "C:\Tools\*" are all rules. Literal rules go to an
+// open-addressing hash table. Each pattern is filed under its longer literal end: its prefix
+// in a trie walked forward over the subject, or its suffix in a trie walked backward. A lookup
+// follows one path per trie and only runs the glob of the patterns it meets on the way, plus
+// those starting and ending with a wildcard.
+class WhitelistMatcher
+{
+private:
+	struct Span
+	{
+		uint32_t offset{};
+		uint32_t length{};
+	};
+
+	struct Pattern
+	{
+		Span text;
+		uint32_t next{};  // Next pattern filed at the same trie node, index + 1
+	};
+
+	// Literal prefixes (forward) or suffixes (backward) of patterns
+	struct Trie
+	{
+		std::unordered_map<uint64_t, uint32_t> edges;  // (node << 32 | character) -> child
+		std::vector<uint32_t> heads{ 0 };              // First pattern ending at each node, index + 1
+	};
+
+	enum Subject { Name, Path, SubjectCount };
+
+	std::vector<TCHAR> text_;  // Folded rule text
+	std::vector<Span> literals_[SubjectCount];
+	std::vector<uint32_t> slots_[SubjectCount];  // Literal index + 1, 0 = empty
+	std::vector<Pattern> patterns_;
+	Trie prefixes_[SubjectCount];
+	Trie suffixes_[SubjectCount];
+	std::vector<uint32_t> unanchored_[SubjectCount];  // Patterns with a wildcard at both ends
+	size_t cRules_{};
+
+private:
+	void AddRule(const TCHAR* pRule, size_t cchRule);
+	void BuildSlots(Subject subject);
+	bool IsLiteral(Subject subject, const TCHAR* pSubject, size_t cchSubject) const;
+	bool IsPatternMatch(Subject subject, const TCHAR* pSubject, size_t cchSubject) const;
+	bool IsGlobMatch(const Pattern& pattern, const TCHAR* pSubject, size_t cchSubject) const;
+
+public:
+	// Replaces the rules; returns how many were compiled
+	size_t Compile(LPCTSTR cszRules);
+
+	// cszOwner is the full executable path, or only the executable name (path rules then never
+	// match)
+	bool IsMatch(LPCTSTR cszOwner) const;
+
+	size_t GetRuleCount() const { return cRules_; }
+
+};
+
+
+
+
+/*
+Usage example:
+
+	WhitelistMatcher whitelist;
+	whitelist.Compile(_T("chrome.exe\r\nsnip*.exe\r\nC:\\Tools\\*"));
+
+	whitelist.IsMatch(_T("C:\\Program Files\\Google\\Chrome\\Application\\chrome.exe"));  // true
+	whitelist.IsMatch(_T("C:\\Windows\\SnippingTool.exe"));                                // true
+	whitelist.IsMatch(_T("c:/tools/grab.exe"));                                            // true
+	whitelist.IsMatch(_T("notepad.exe"));                                                  // false
+
+*/
+
+
+
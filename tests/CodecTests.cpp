@@ -0,0 +1,864 @@
+// Codec and hash checks (portable, runs on Linux): XXH3 against reference digests, Deflate and
+// Inflate round trips and zlib interoperability, PngReader over every color type and bit depth,
+// EncodePng, Qoi, PngOptimizer losslessness and PackStore recovery after a torn write.
+//
+// zlib is the independent reference: it decodes what Deflate and EncodePng write and encodes the
+// streams and PNG files Inflate and PngReader are checked on. The XXH3 digests were computed with
+// the xxhash Python package (xxh3_64_intdigest, xxh3_128_intdigest) over the same test pattern.
+//
+// Build and run on Linux:
+//   g++ -O2 -std=c++17 -pthread -I bench/compat -I bench -I src tests/CodecTests.cpp src/{ContentHash,PixelConvert,PngEncoder,Deflate,PngReader,Inflate,Qoi,PngOptimizer,PackStore}.cpp -lz -o codec_tests
+//   ./codec_tests [options]
+//
+// Options:
+//   --only LIST   Subset of xxh3,deflate,inflate,png,qoi,optimizer,pack (default all)
+//   --temp DIR    Where the pack checks create their scratch directory (default /tmp)
+//
+// Prints a line per failed check and a summary per group; exits with 1 if any check failed.
+
+// Implementation-specific headers
+#include "ContentHash.h"      // XXH3
+#include "Deflate.h"          // Compressor
+#include "Inflate.h"          // Decompressor
+#include "PngEncoder.h"       // EncodePng
+#include "PngReader.h"        // PNG rows
+#include "PngOptimizer.h"     // Lossless re-encoder
+#include "Qoi.h"              // Spool codec
+#include "PackStore.h"        // Pack segments
+#include "BenchCommon.h"      // SplitList
+#include "SyntheticCorpus.h"  // Test images
+
+// Standard library headers
+#include <cstdarg>  // va_list
+#include <cstdio>   // printf
+#include <cstring>  // memcmp, strcmp
+#include <random>   // Test data
+#include <string>   // Paths
+#include <vector>   // Buffers
+
+// Reference implementation
+#include <zlib.h>
+
+// POSIX headers
+#include <fcntl.h>     // open
+#include <sys/stat.h>  // mkdir
+#include <unistd.h>    // ftruncate, rmdir
+
+
+
+// Anonymous namespace for the checks
+namespace
+{
+	using namespace BenchCommon;
+
+	unsigned g_cChecks;
+	unsigned g_cFailed;
+
+	// Counts a check and reports it when it fails
+	bool Check(bool isOk, const char* pszFormat, ...)
+	{
+		++g_cChecks;
+		if (isOk) { return true; }
+
+		++g_cFailed;
+		va_list args;
+		va_start(args, pszFormat);
+		printf("  FAILED: ");
+		vprintf(pszFormat, args);
+		printf("\n");
+		va_end(args);
+		return false;
+	}
+
+	// Bytes of the pattern the reference digests were computed over
+	std::vector<uint8_t> Pattern(size_t cbSize)
+	{
+		std::vector<uint8_t> data(cbSize);
+		for (size_t i{}; i < cbSize; ++i) { data[i] = (uint8_t)((uint32_t)(i * 2654435761u) >> 24); }
+		return data;
+	}
+
+
+
+	// XXH3
+
+	struct Xxh3Vector
+	{
+		size_t cbSize;
+		uint64_t hash64;
+		uint64_t low128;
+		uint64_t high128;
+	};
+
+	// One length per XXH3 code path: 0, 1-3, 4-8, 9-16, 17-128, 129-240, and the long loop
+	// around the stripe, block and buffer boundaries
+	const Xxh3Vector kXxh3Vectors[] = {
+		{ 0, 0x2D06800538D394C2ULL, 0x6001C324468D497FULL, 0x99AA06D3014798D8ULL },
+		{ 1, 0xC44BDFF4074EECDBULL, 0xC44BDFF4074EECDBULL, 0xA6CD5E9392000F6AULL },
+		{ 2, 0xB0A5D4F167A89D5EULL, 0xB0A5D4F167A89D5EULL, 0x5008D8F8CD45F8ECULL },
+		{ 3, 0xE14090F554A5EA90ULL, 0xE14090F554A5EA90ULL, 0x977FCBC0448B49F6ULL },
+		{ 4, 0x2E8D078A566E9749ULL, 0x4EE6926F0426173EULL, 0x4E82B36688C5328FULL },
+		{ 7, 0xE6F7770846C47DF5ULL, 0x5669EDE136B8C8B5ULL, 0xCB234CB3AD8748A9ULL },
+		{ 8, 0xCD1C7F88482FCAEFULL, 0x79D85ADAEEFD615EULL, 0x7B4966A681F18D57ULL },
+		{ 9, 0xBFE43DEF699FA9E3ULL, 0xEE5940D4DF4715AEULL, 0x200D098A7113E15FULL },
+		{ 16, 0x81E9EB8634460BB9ULL, 0x37286A19CF622308ULL, 0x78E8AB538D3ACAABULL },
+		{ 17, 0x9998430FD0A655BEULL, 0x33BED349EC1C0CE7ULL, 0x1EA709ADA2B9C32EULL },
+		{ 64, 0x22A06B30C4C72936ULL, 0xA6E3FFEEDC6985DDULL, 0x5834551911DE3391ULL },
+		{ 128, 0x75ECA5C5D5594884ULL, 0xE1F0636051CCD2BEULL, 0x5AC741C59C95D36AULL },
+		{ 129, 0xA05DA42E7A4E4667ULL, 0xCFB3FED667226458ULL, 0x1240F4D960139642ULL },
+		{ 200, 0xE07BFBC15015BF69ULL, 0x3572CB319F206EA7ULL, 0xDDC90E87387183A2ULL },
+		{ 240, 0x5EB2467C8C9E3969ULL, 0xB2E6947C477A4AB0ULL, 0x640A6149838A7599ULL },
+		{ 241, 0x2D431E984C441F15ULL, 0x2D431E984C441F15ULL, 0xE817E20E53E42A8CULL },
+		{ 255, 0x6CB5279BB1267B3BULL, 0x6CB5279BB1267B3BULL, 0x881E14B0B5C3E339ULL },
+		{ 256, 0x1369AAF85F8B805AULL, 0x1369AAF85F8B805AULL, 0x96B9C38548DD27EEULL },
+		{ 1023, 0x4E30BB611FAA8F67ULL, 0x4E30BB611FAA8F67ULL, 0x5687286DD310B7DBULL },
+		{ 1024, 0xE99DEF1145F12936ULL, 0xE99DEF1145F12936ULL, 0xDF4C8B9FF9715101ULL },
+		{ 1025, 0x83CBA9B371E4E7F4ULL, 0x83CBA9B371E4E7F4ULL, 0x63E845AAB7EB695FULL },
+		{ 4096, 0x9BF67F8DEFF876AEULL, 0x9BF67F8DEFF876AEULL, 0x3203F3B99AD3538DULL },
+		{ 100000, 0x920056915640359FULL, 0x920056915640359FULL, 0x169BF5C50B17F183ULL },
+		{ 1048583, 0x5FD8FB33BEE063B1ULL, 0x5FD8FB33BEE063B1ULL, 0x5C604C404B778C7EULL },
+	};
+
+	// Tree hash of kTreeMinSize bytes and more: XXH3 of the leaf XXH3-128 digests and the size
+	const Xxh3Vector kTreeVector = { (9 << 20) + 5, 0x79AFDB82876730ABULL, 0x999D54DA8B25BD17ULL, 0x8C49D3B54A78E9D2ULL };
+
+	void TestXxh3()
+	{
+		const PixelIsa isas[] = { PixelIsa::Scalar, PixelIsa::SSE2, PixelIsa::AVX2, PixelIsa::NEON };
+		const PixelIsa bestIsa = ContentHash::GetIsa();
+		const size_t pieces[] = { 1, 7, 63, 64, 255, 1000, 4099 };
+
+		for (PixelIsa isa : isas) {
+			if (!ContentHash::SelectIsa(isa)) { continue; }
+
+			for (const Xxh3Vector& vector : kXxh3Vectors) {
+				const std::vector<uint8_t> data = Pattern(vector.cbSize);
+
+				Xxh3Stream stream;
+				stream.Update(data.data(), data.size());
+				Check(stream.Finish64() == vector.hash64, "XXH3-64 of %zu bytes (isa %u)", vector.cbSize, (unsigned)isa);
+				Check(stream.Finish128() == Hash128{ vector.low128, vector.high128 }, "XXH3-128 of %zu bytes (isa %u)", vector.cbSize, (unsigned)isa);
+
+				// Any split of the input gives the same digest
+				for (size_t cbPiece : pieces) {
+					stream.Reset();
+					for (size_t cbOffset{}; cbOffset < data.size(); cbOffset += cbPiece) {
+						stream.Update(data.data() + cbOffset, std::min(cbPiece, data.size() - cbOffset));
+					}
+					Check(stream.Finish64() == vector.hash64 and stream.Finish128() == Hash128{ vector.low128, vector.high128 },
+						"XXH3 of %zu bytes in %zu-byte pieces", vector.cbSize, cbPiece);
+				}
+
+				Check(ContentHash::Compute(HashAlgorithm::Xxh3_64, data.data(), data.size()).low == vector.hash64,
+					"ContentHash::Compute XXH3-64 of %zu bytes", vector.cbSize);
+				Check(ContentHash::Compute(HashAlgorithm::Xxh3_128, data.data(), data.size()) == Hash128{ vector.low128, vector.high128 },
+					"ContentHash::Compute XXH3-128 of %zu bytes", vector.cbSize);
+			}
+
+			// Tree hash: the same on one thread, several threads, incrementally and with a copy
+			const std::vector<uint8_t> data = Pattern(kTreeVector.cbSize);
+			std::vector<uint8_t> copy(data.size());
+			for (unsigned cThreads : { 1u, 4u }) {
+				Check(ContentHash::Compute(HashAlgorithm::Xxh3_64, data.data(), data.size(), cThreads).low == kTreeVector.hash64,
+					"tree XXH3-64 on %u threads", cThreads);
+				Check(ContentHash::Compute(HashAlgorithm::Xxh3_128, data.data(), data.size(), cThreads, copy.data()) ==
+					Hash128{ kTreeVector.low128, kTreeVector.high128 } and copy == data, "tree XXH3-128 with copy on %u threads", cThreads);
+			}
+			ContentHasher hasher(HashAlgorithm::Xxh3_128, data.size());
+			for (size_t cbOffset{}; cbOffset < data.size(); cbOffset += 333333) {
+				hasher.Update(data.data() + cbOffset, std::min<size_t>(333333, data.size() - cbOffset));
+			}
+			Check(hasher.Finish() == Hash128{ kTreeVector.low128, kTreeVector.high128 }, "incremental tree XXH3-128");
+		}
+		ContentHash::SelectIsa(bestIsa);
+	}
+
+
+
+	// Deflate and Inflate
+
+	// Inputs with different match structure: none, long runs, short repeats, far repeats
+	std::vector<std::vector<uint8_t>> DeflateCorpora()
+	{
+		std::mt19937 rng(7);
+		std::vector<std::vector<uint8_t>> corpora;
+		corpora.push_back({});
+		corpora.push_back({ 42 });
+		corpora.push_back(std::vector<uint8_t>(100000, 0));
+
+		std::vector<uint8_t> random(150000);
+		for (uint8_t& b : random) { b = (uint8_t)rng(); }
+		corpora.push_back(random);
+
+		const char* words[] = { "clipboard ", "image ", "saver ", "capture ", "png ", "deflate ", "the ", "a ", "\n" };
+		std::string text;
+		while (text.size() < 200000) { text += words[rng() % 9]; }
+		corpora.push_back(std::vector<uint8_t>(text.begin(), text.end()));
+
+		// A block repeated at the window size and just past it
+		std::vector<uint8_t> far(40000);
+		for (uint8_t& b : far) { b = (uint8_t)rng(); }
+		std::vector<uint8_t> repeats(far.begin(), far.begin() + Deflate::kWindowSize);
+		repeats.insert(repeats.end(), far.begin(), far.begin() + 1000);
+		repeats.insert(repeats.end(), far.begin(), far.end());
+		repeats.insert(repeats.end(), far.begin(), far.end());
+		corpora.push_back(repeats);
+
+		SyntheticCorpus::Canvas canvas;
+		SyntheticCorpus::DrawCorpus("ui", 320, 200, &canvas);
+		corpora.push_back(canvas.bgra);
+		return corpora;
+	}
+
+	// Single-threaded and range-split zlib streams at every level, decoded by Inflate and zlib
+	void TestDeflate()
+	{
+		const std::vector<std::vector<uint8_t>> corpora = DeflateCorpora();
+		for (size_t nCorpus{}; nCorpus < corpora.size(); ++nCorpus) {
+			const std::vector<uint8_t>& data = corpora[nCorpus];
+			for (int level = Deflate::kMinLevel; level <= Deflate::kOptimalLevel; ++level) {
+				std::vector<uint8_t> compressed;
+				Deflate::ZlibCompress(data.data(), data.size(), level, &compressed);
+
+				std::vector<uint8_t> inflated;
+				Check(Inflater::Decompress(compressed.data(), compressed.size(), data.size(), &inflated) and inflated == data,
+					"Deflate level %d, corpus %zu: Inflate round trip", level, nCorpus);
+
+				std::vector<uint8_t> reference(data.size() + 1);
+				uLongf cbReference = (uLongf)reference.size();
+				Check(uncompress(reference.data(), &cbReference, compressed.data(), (uLong)compressed.size()) == Z_OK and
+					cbReference == data.size() and memcmp(reference.data(), data.data(), data.size()) == 0,
+					"Deflate level %d, corpus %zu: zlib uncompress", level, nCorpus);
+			}
+
+			// Ranges compressed apart and concatenated, as the PNG encoder's threads do
+			for (int level : { 1, Deflate::kDefaultLevel, Deflate::kMaxLevel }) {
+				std::vector<uint8_t> compressed;
+				Deflate::WriteZlibHeader(level, &compressed);
+				const size_t cbRange = data.size() / 3 + 1;
+				for (size_t begin{}; begin < data.size() or begin == 0; begin += cbRange) {
+					const size_t end = std::min(data.size(), begin + cbRange);
+					const size_t dictBegin = begin > Deflate::kWindowSize ? begin - Deflate::kWindowSize : 0;
+					Deflate::CompressRange(data.data(), dictBegin, begin, end, level, end == data.size(), &compressed);
+					if (end == data.size()) { break; }
+				}
+				const uint32_t adler = Deflate::Adler32(1, data.data(), data.size());
+				for (int shift = 24; shift >= 0; shift -= 8) { compressed.push_back((uint8_t)(adler >> shift)); }
+
+				std::vector<uint8_t> reference(data.size() + 1);
+				uLongf cbReference = (uLongf)reference.size();
+				Check(uncompress(reference.data(), &cbReference, compressed.data(), (uLong)compressed.size()) == Z_OK and
+					cbReference == data.size() and memcmp(reference.data(), data.data(), data.size()) == 0,
+					"Deflate ranges level %d, corpus %zu: zlib uncompress", level, nCorpus);
+			}
+
+			Check(Deflate::Adler32(1, data.data(), data.size()) == adler32(1, data.data(), (uInt)data.size()),
+				"Adler32 of corpus %zu", nCorpus);
+			Check(Deflate::Crc32(0, data.data(), data.size()) == crc32(0, data.data(), (uInt)data.size()),
+				"Crc32 of corpus %zu", nCorpus);
+		}
+	}
+
+	// zlib stream of the data with the given level, strategy and window bits (negative: raw deflate)
+	std::vector<uint8_t> ZlibReference(const std::vector<uint8_t>& data, int level, int strategy, int windowBits)
+	{
+		z_stream stream{};
+		deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, strategy);
+		std::vector<uint8_t> compressed(deflateBound(&stream, (uLong)data.size()));
+		stream.next_in = const_cast<Bytef*>(data.data());
+		stream.avail_in = (uInt)data.size();
+		stream.next_out = compressed.data();
+		stream.avail_out = (uInt)compressed.size();
+		deflate(&stream, Z_FINISH);
+		compressed.resize(stream.total_out);
+		deflateEnd(&stream);
+		return compressed;
+	}
+
+	// Reads a stream fed in cbSpan-byte spans, cbRead bytes at a time
+	std::vector<uint8_t> InflatePieces(const std::vector<uint8_t>& compressed, bool isZlib, size_t cbSpan, size_t cbRead, InflateStatus* pStatus)
+	{
+		Inflater inflater;
+		inflater.Reset(isZlib);
+		for (size_t cbOffset{}; cbOffset < compressed.size(); cbOffset += cbSpan) {
+			inflater.AppendInput(compressed.data() + cbOffset, std::min(cbSpan, compressed.size() - cbOffset));
+		}
+		std::vector<uint8_t> output;
+		std::vector<uint8_t> piece(cbRead);
+		for (;;) {
+			const size_t cbProduced = inflater.Read(piece.data(), piece.size());
+			output.insert(output.end(), piece.begin(), piece.begin() + cbProduced);
+			if (cbProduced < piece.size()) { break; }
+		}
+		*pStatus = inflater.GetStatus();
+		return output;
+	}
+
+	// zlib-encoded streams of every level and strategy, split into spans and read in pieces
+	void TestInflate()
+	{
+		const std::vector<std::vector<uint8_t>> corpora = DeflateCorpora();
+		const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED };
+		for (size_t nCorpus{}; nCorpus < corpora.size(); ++nCorpus) {
+			const std::vector<uint8_t>& data = corpora[nCorpus];
+			for (int level = 0; level <= 9; ++level) {
+				for (int strategy : strategies) {
+					const std::vector<uint8_t> compressed = ZlibReference(data, level, strategy, 15);
+					std::vector<uint8_t> inflated;
+					Check(Inflater::Decompress(compressed.data(), compressed.size(), data.size(), &inflated) and inflated == data,
+						"Inflate of zlib level %d strategy %d, corpus %zu", level, strategy, nCorpus);
+				}
+			}
+
+			InflateStatus status{};
+			const std::vector<uint8_t> zlibStream = ZlibReference(data, 6, Z_DEFAULT_STRATEGY, 15);
+			const std::vector<uint8_t> rawStream = ZlibReference(data, 6, Z_DEFAULT_STRATEGY, -15);
+			for (size_t cbSpan : { (size_t)1, (size_t)7, (size_t)65536 }) {
+				for (size_t cbRead : { (size_t)1, (size_t)13, (size_t)4096 }) {
+					if (cbSpan == 1 and cbRead == 1 and data.size() > 100000) { continue; }  // Slow and covered by the others
+					Check(InflatePieces(zlibStream, true, cbSpan, cbRead, &status) == data and status == InflateStatus::Done,
+						"Inflate of corpus %zu in %zu-byte spans, %zu-byte reads", nCorpus, cbSpan, cbRead);
+					Check(InflatePieces(rawStream, false, cbSpan, cbRead, &status) == data and status == InflateStatus::Done,
+						"raw Inflate of corpus %zu in %zu-byte spans, %zu-byte reads", nCorpus, cbSpan, cbRead);
+				}
+			}
+
+			// Damaged streams must fail, not produce output that looks complete
+			std::vector<uint8_t> truncated(zlibStream.begin(), zlibStream.end() - 1);
+			InflatePieces(truncated, true, 4096, 4096, &status);
+			Check(status == InflateStatus::Truncated, "Inflate of truncated corpus %zu: status %d", nCorpus, (int)status);
+
+			std::vector<uint8_t> damaged = zlibStream;
+			damaged.back() ^= 1;  // Adler-32
+			std::vector<uint8_t> inflated;
+			Check(!Inflater::Decompress(damaged.data(), damaged.size(), data.size(), &inflated), "Inflate of corpus %zu with a bad checksum", nCorpus);
+			Check(!Inflater::Decompress(zlibStream.data(), zlibStream.size(), data.size() + 1, &inflated), "Inflate of corpus %zu with a wrong size", nCorpus);
+		}
+	}
+
+
+
+	// PNG
+
+	// Test image in PNG sample terms, with the RGBA rows PngReader has to produce
+	struct PngCase
+	{
+		uint32_t width{};
+		uint32_t height{};
+		uint8_t colorType{};
+		uint8_t bitDepth{};
+		bool isInterlaced{};
+		bool hasTransparency{};
+		std::vector<uint16_t> samples;  // width * height * channels
+		std::vector<uint8_t> rgba;      // Expected rows
+		std::vector<uint8_t> png;
+	};
+
+	unsigned ChannelsOf(uint8_t colorType)
+	{
+		return colorType == 2 ? 3 : colorType == 4 ? 2 : colorType == 6 ? 4 : 1;
+	}
+
+	void AppendChunk(std::vector<uint8_t>* pPng, const char* pszType, const std::vector<uint8_t>& data)
+	{
+		const uint32_t cbData = (uint32_t)data.size();
+		for (int shift = 24; shift >= 0; shift -= 8) { pPng->push_back((uint8_t)(cbData >> shift)); }
+		const size_t cbStart = pPng->size();
+		pPng->insert(pPng->end(), pszType, pszType + 4);
+		pPng->insert(pPng->end(), data.begin(), data.end());
+		const uint32_t crc = (uint32_t)crc32(0, pPng->data() + cbStart, (uInt)(pPng->size() - cbStart));
+		for (int shift = 24; shift >= 0; shift -= 8) { pPng->push_back((uint8_t)(crc >> shift)); }
+	}
+
+	uint8_t Paeth(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = abs(p - a);
+		const int pb = abs(p - b);
+		const int pc = abs(p - c);
+		return (uint8_t)(pa <= pb and pa <= pc ? a : pb <= pc ? b : c);
+	}
+
+	// Packs and filters the pixels of a (sub)image; rows cycle through the five filter types
+	void AppendFilteredRows(const PngCase& image, const std::vector<uint32_t>& xs, const std::vector<uint32_t>& ys, std::vector<uint8_t>* pRaw)
+	{
+		if (xs.empty() or ys.empty()) { return; }
+
+		const unsigned cChannels = ChannelsOf(image.colorType);
+		const size_t cbRow = ((size_t)xs.size() * cChannels * image.bitDepth + 7) / 8;
+		const size_t bpp = std::max<size_t>(1, cChannels * image.bitDepth / 8);
+		std::vector<uint8_t> previous(cbRow, 0);
+		for (size_t row{}; row < ys.size(); ++row) {
+			std::vector<uint8_t> line(cbRow, 0);
+			size_t nBit{};
+			for (uint32_t x : xs) {
+				for (unsigned c{}; c < cChannels; ++c) {
+					const uint16_t sample = image.samples[((size_t)ys[row] * image.width + x) * cChannels + c];
+					if (image.bitDepth == 16) {
+						line[nBit / 8] = (uint8_t)(sample >> 8);
+						line[nBit / 8 + 1] = (uint8_t)sample;
+					}
+					else if (image.bitDepth == 8) {
+						line[nBit / 8] = (uint8_t)sample;
+					}
+					else {
+						line[nBit / 8] |= (uint8_t)(sample << (8 - image.bitDepth - nBit % 8));
+					}
+					nBit += image.bitDepth;
+				}
+			}
+
+			const uint8_t filter = (uint8_t)(row % 5);
+			pRaw->push_back(filter);
+			for (size_t i{}; i < cbRow; ++i) {
+				const int a = i >= bpp ? line[i - bpp] : 0;
+				const int b = previous[i];
+				const int c = i >= bpp ? previous[i - bpp] : 0;
+				const int predicted = filter == 1 ? a : filter == 2 ? b : filter == 3 ? (a + b) / 2 : filter == 4 ? Paeth(a, b, c) : 0;
+				pRaw->push_back((uint8_t)(line[i] - predicted));
+			}
+			previous = line;
+		}
+	}
+
+	// Random samples, the expected RGBA rows and the PNG file (zlib-compressed, IDAT split in pieces)
+	PngCase MakePngCase(uint32_t width, uint32_t height, uint8_t colorType, uint8_t bitDepth, bool isInterlaced, bool hasTransparency,
+		const std::vector<const char*>& ancillary = {})
+	{
+		std::mt19937 rng(width * 131 + height * 7 + colorType * 17 + bitDepth);
+		PngCase image;
+		image.width = width;
+		image.height = height;
+		image.colorType = colorType;
+		image.bitDepth = bitDepth;
+		image.isInterlaced = isInterlaced;
+		image.hasTransparency = hasTransparency;
+		const unsigned cChannels = ChannelsOf(colorType);
+		const uint32_t maxSample = (1u << bitDepth) - 1;
+		const uint32_t cColors = colorType == 3 ? std::min<uint32_t>(maxSample + 1, 200) : 0;
+		image.samples.resize((size_t)width * height * cChannels);
+		for (uint16_t& sample : image.samples) { sample = (uint16_t)(rng() % (colorType == 3 ? cColors : maxSample + 1)); }
+
+		// Color key of gray and RGB images: the first pixel's value, so it does occur
+		std::vector<uint8_t> palette(cColors * 3);
+		for (uint8_t& b : palette) { b = (uint8_t)rng(); }
+		std::vector<uint8_t> paletteAlpha(cColors / 2);
+		for (uint8_t& b : paletteAlpha) { b = (uint8_t)rng(); }
+		const uint16_t* pKey = image.samples.data();
+
+		image.rgba.resize((size_t)width * height * 4);
+		for (size_t i{}; i < (size_t)width * height; ++i) {
+			const uint16_t* pSample = &image.samples[i * cChannels];
+			uint8_t* pOut = &image.rgba[i * 4];
+			const auto Scale = [&](uint16_t sample) { return (uint8_t)(bitDepth == 16 ? sample >> 8 : sample * 255 / maxSample); };
+			if (colorType == 3) {
+				memcpy(pOut, &palette[pSample[0] * 3], 3);
+				pOut[3] = hasTransparency and pSample[0] < paletteAlpha.size() ? paletteAlpha[pSample[0]] : 255;
+				continue;
+			}
+			const bool isGray = cChannels <= 2;
+			for (unsigned c{}; c < 3; ++c) { pOut[c] = Scale(pSample[isGray ? 0 : c]); }
+			if (colorType == 4 or colorType == 6) {
+				pOut[3] = Scale(pSample[cChannels - 1]);
+			}
+			else {
+				const bool isKey = hasTransparency and memcmp(pSample, pKey, cChannels * sizeof(uint16_t)) == 0;
+				pOut[3] = isKey ? 0 : 255;
+			}
+		}
+
+		// Filtered scanlines, Adam7 passes one after the other
+		std::vector<uint8_t> raw;
+		std::vector<uint32_t> xs;
+		std::vector<uint32_t> ys;
+		const uint32_t passes[7][4] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+		for (const auto& pass : passes) {
+			xs.clear();
+			ys.clear();
+			const uint32_t x0 = isInterlaced ? pass[0] : 0, y0 = isInterlaced ? pass[1] : 0;
+			const uint32_t dx = isInterlaced ? pass[2] : 1, dy = isInterlaced ? pass[3] : 1;
+			for (uint32_t x = x0; x < width; x += dx) { xs.push_back(x); }
+			for (uint32_t y = y0; y < height; y += dy) { ys.push_back(y); }
+			AppendFilteredRows(image, xs, ys, &raw);
+			if (!isInterlaced) { break; }
+		}
+
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		image.png.assign(signature, signature + 8);
+		std::vector<uint8_t> header(13);
+		for (int i{}; i < 4; ++i) {
+			header[i] = (uint8_t)(width >> (24 - 8 * i));
+			header[4 + i] = (uint8_t)(height >> (24 - 8 * i));
+		}
+		header[8] = bitDepth;
+		header[9] = colorType;
+		header[12] = isInterlaced ? 1 : 0;
+		AppendChunk(&image.png, "IHDR", header);
+		for (const char* pszType : ancillary) { AppendChunk(&image.png, pszType, std::vector<uint8_t>(4, 1)); }
+		if (colorType == 3) { AppendChunk(&image.png, "PLTE", palette); }
+		if (hasTransparency) {
+			std::vector<uint8_t> transparency = paletteAlpha;
+			if (colorType != 3) {
+				transparency.clear();
+				for (unsigned c{}; c < cChannels; ++c) {
+					transparency.push_back((uint8_t)(pKey[c] >> 8));
+					transparency.push_back((uint8_t)pKey[c]);
+				}
+			}
+			AppendChunk(&image.png, "tRNS", transparency);
+		}
+
+		std::vector<uint8_t> compressed(compressBound((uLong)raw.size()));
+		uLongf cbCompressed = (uLongf)compressed.size();
+		compress2(compressed.data(), &cbCompressed, raw.data(), (uLong)raw.size(), 6);
+		for (size_t cbOffset{}; cbOffset < cbCompressed; cbOffset += 1000) {
+			const size_t cbPart = std::min<size_t>(1000, cbCompressed - cbOffset);
+			AppendChunk(&image.png, "IDAT", std::vector<uint8_t>(compressed.begin() + cbOffset, compressed.begin() + cbOffset + cbPart));
+		}
+		AppendChunk(&image.png, "IEND", {});
+		return image;
+	}
+
+	// Every color type and bit depth PNG allows, plain and interlaced, with and without tRNS
+	std::vector<PngCase> PngCases(const std::vector<const char*>& ancillary = {})
+	{
+		const uint8_t formats[][2] = { { 0, 1 }, { 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 16 }, { 2, 8 }, { 2, 16 },
+			{ 3, 1 }, { 3, 2 }, { 3, 4 }, { 3, 8 }, { 4, 8 }, { 4, 16 }, { 6, 8 }, { 6, 16 } };
+		const uint32_t sizes[][2] = { { 1, 1 }, { 7, 5 }, { 33, 17 } };
+		std::vector<PngCase> cases;
+		for (const auto& format : formats) {
+			for (const auto& size : sizes) {
+				for (bool isInterlaced : { false, true }) {
+					const bool canBeTransparent = format[0] == 0 or format[0] == 2 or format[0] == 3;
+					cases.push_back(MakePngCase(size[0], size[1], format[0], format[1], isInterlaced, false, ancillary));
+					if (canBeTransparent) { cases.push_back(MakePngCase(size[0], size[1], format[0], format[1], isInterlaced, true, ancillary)); }
+				}
+			}
+		}
+		return cases;
+	}
+
+	std::string Describe(const PngCase& image)
+	{
+		char szName[96];
+		snprintf(szName, sizeof(szName), "%ux%u color type %u, %u bits%s%s", image.width, image.height, image.colorType,
+			image.bitDepth, image.isInterlaced ? ", interlaced" : "", image.hasTransparency ? ", tRNS" : "");
+		return szName;
+	}
+
+	// All rows of a PNG as RGBA, empty if it does not decode
+	std::vector<uint8_t> ReadPng(const std::vector<uint8_t>& png, uint32_t* pWidth, uint32_t* pHeight)
+	{
+		PngReader reader;
+		if (!reader.Open(png.data(), png.size())) { return {}; }
+		*pWidth = reader.GetWidth();
+		*pHeight = reader.GetHeight();
+		std::vector<uint8_t> rgba((size_t)reader.GetWidth() * reader.GetHeight() * 4);
+		for (uint32_t y{}; y < reader.GetHeight(); ++y) {
+			if (!reader.ReadRow(&rgba[(size_t)y * reader.GetWidth() * 4])) { return {}; }
+		}
+		return rgba;
+	}
+
+	bool CanvasRgbRowProc(const void* pContext, uint32_t y, uint8_t* pRow)
+	{
+		const SyntheticCorpus::Canvas* pCanvas = static_cast<const SyntheticCorpus::Canvas*>(pContext);
+		const uint8_t* pSrc = &pCanvas->bgra[(size_t)y * pCanvas->width * 4];
+		for (uint32_t x{}; x < pCanvas->width; ++x, pSrc += 4) {
+			*pRow++ = pSrc[2];
+			*pRow++ = pSrc[1];
+			*pRow++ = pSrc[0];
+		}
+		return true;
+	}
+
+	void TestPng()
+	{
+		for (const PngCase& image : PngCases()) {
+			uint32_t width{}, height{};
+			const std::vector<uint8_t> rgba = ReadPng(image.png, &width, &height);
+			Check(width == image.width and height == image.height and rgba == image.rgba, "PngReader of %s", Describe(image).c_str());
+
+			// Row source skipping rows, as the fingerprint reads them
+			PngReader reader;
+			std::vector<uint8_t> row((size_t)image.width * 4);
+			bool isSame = reader.Open(image.png.data(), image.png.size());
+			for (uint32_t y{}; isSame and y < image.height; y += 3) {
+				isSame = PngReader::ReadRowProc(&reader, y, row.data()) and
+					memcmp(row.data(), &image.rgba[(size_t)y * image.width * 4], row.size()) == 0;
+			}
+			Check(isSame, "PngReader::ReadRowProc of %s", Describe(image).c_str());
+
+			// A damaged IHDR CRC and a missing IDAT end must not decode
+			std::vector<uint8_t> damaged = image.png;
+			damaged[8 + 8 + 13] ^= 1;
+			Check(!reader.Open(damaged.data(), damaged.size()), "PngReader of %s with a bad IHDR CRC", Describe(image).c_str());
+			const std::vector<uint8_t> truncated(image.png.begin(), image.png.end() - 12 - 12);
+			Check(ReadPng(truncated, &width, &height).empty(), "PngReader of %s without its last IDAT bytes", Describe(image).c_str());
+		}
+
+		// EncodePng at every level, RGB and RGBA, checked by PngReader and by zlib
+		SyntheticCorpus::Canvas canvas;
+		SyntheticCorpus::DrawCorpus("ui", 301, 157, &canvas);
+		for (PngLevel level : { PngLevel::Fastest, PngLevel::Fast, PngLevel::Default, PngLevel::Smallest }) {
+			for (unsigned cChannels : { 3u, 4u }) {
+				PngEncodeOptions options{};
+				options.level = level;
+				options.cbMinBand = 4096;  // Several deflate threads even for a small image
+				const PngImage image{ canvas.width, canvas.height, cChannels,
+					cChannels == 4 ? SyntheticCorpus::CanvasRowProc : CanvasRgbRowProc, &canvas };
+				std::vector<uint8_t> png;
+				if (!Check(EncodePng(image, options, &png), "EncodePng level %u, %u channels", (unsigned)level, cChannels)) { continue; }
+
+				uint32_t width{}, height{};
+				const std::vector<uint8_t> rgba = ReadPng(png, &width, &height);
+				bool isSame = width == canvas.width and height == canvas.height;
+				for (size_t i{}; isSame and i < rgba.size(); i += 4) {
+					isSame = rgba[i] == canvas.bgra[i + 2] and rgba[i + 1] == canvas.bgra[i + 1] and rgba[i + 2] == canvas.bgra[i] and
+						rgba[i + 3] == (cChannels == 4 ? canvas.bgra[i + 3] : 255);
+				}
+				Check(isSame, "EncodePng level %u, %u channels: PngReader round trip", (unsigned)level, cChannels);
+
+				// IDAT data concatenated is one zlib stream of the filtered rows
+				std::vector<uint8_t> idat;
+				for (size_t pos = 8; pos + 12 <= png.size();) {
+					const uint32_t cbData = (uint32_t)png[pos] << 24 | (uint32_t)png[pos + 1] << 16 | (uint32_t)png[pos + 2] << 8 | png[pos + 3];
+					if (memcmp(&png[pos + 4], "IDAT", 4) == 0) { idat.insert(idat.end(), png.begin() + pos + 8, png.begin() + pos + 8 + cbData); }
+					pos += 12 + cbData;
+				}
+				const size_t cbFiltered = (size_t)canvas.height * (1 + canvas.width * cChannels);
+				std::vector<uint8_t> filtered(cbFiltered + 1);
+				uLongf cbInflated = (uLongf)filtered.size();
+				Check(uncompress(filtered.data(), &cbInflated, idat.data(), (uLong)idat.size()) == Z_OK and cbInflated == cbFiltered,
+					"EncodePng level %u, %u channels: zlib uncompress of IDAT", (unsigned)level, cChannels);
+			}
+		}
+	}
+
+
+
+	// Qoi
+
+	void TestQoi()
+	{
+		const uint32_t sizes[][2] = { { 1, 1 }, { 64, 1 }, { 1, 64 }, { 97, 61 } };
+		for (const char* pszKind : { "ui", "photo", "gradient" }) {
+			for (const auto& size : sizes) {
+				SyntheticCorpus::Canvas canvas;
+				SyntheticCorpus::DrawCorpus(pszKind, size[0], size[1], &canvas);
+				for (unsigned cChannels : { 3u, 4u }) {
+					// Drop-shadow-like alpha so that RGBA images have more than one alpha value
+					for (size_t i{}; cChannels == 4 and i < canvas.bgra.size(); i += 4) { canvas.bgra[i + 3] = (uint8_t)(i * 7 / 4); }
+
+					const PngImage image{ canvas.width, canvas.height, cChannels,
+						cChannels == 4 ? SyntheticCorpus::CanvasRowProc : CanvasRgbRowProc, &canvas };
+					std::vector<uint8_t> qoi;
+					QoiImage decoded;
+					const bool isDecoded = Qoi::Encode(image, &qoi) and Qoi::Decode(qoi.data(), qoi.size(), &decoded);
+					bool isSame = isDecoded and decoded.width == canvas.width and decoded.height == canvas.height and decoded.channels == cChannels;
+					std::vector<uint8_t> expected(canvas.width * cChannels);
+					std::vector<uint8_t> row(canvas.width * cChannels);
+					for (uint32_t y{}; isSame and y < canvas.height; ++y) {
+						image.pfnRow(image.pContext, y, expected.data());
+						isSame = memcmp(&decoded.pixels[(size_t)y * row.size()], expected.data(), row.size()) == 0 and
+							Qoi::ReadRowProc(&decoded, y, row.data()) and row == expected;
+					}
+					Check(isSame, "Qoi round trip of %s %ux%u, %u channels", pszKind, size[0], size[1], cChannels);
+
+					const std::vector<uint8_t> truncated(qoi.begin(), qoi.end() - 9);
+					Check(!Qoi::Decode(truncated.data(), truncated.size(), &decoded), "Qoi of truncated %s %ux%u", pszKind, size[0], size[1]);
+					std::vector<uint8_t> damaged = qoi;
+					damaged[0] ^= 1;
+					Check(!Qoi::Decode(damaged.data(), damaged.size(), &decoded), "Qoi of %s %ux%u with a bad magic", pszKind, size[0], size[1]);
+				}
+			}
+		}
+	}
+
+
+
+	// PngOptimizer
+
+	bool HasChunk(const std::vector<uint8_t>& png, const char* pszType)
+	{
+		for (size_t pos = 8; pos + 12 <= png.size();) {
+			const uint32_t cbData = (uint32_t)png[pos] << 24 | (uint32_t)png[pos + 1] << 16 | (uint32_t)png[pos + 2] << 8 | png[pos + 3];
+			if (memcmp(&png[pos + 4], pszType, 4) == 0) { return true; }
+			pos += 12 + cbData;
+		}
+		return false;
+	}
+
+	void TestOptimizer()
+	{
+		PngOptimizeOptions options{};
+		options.level = Deflate::kMaxLevel;  // The optimal level is checked once below, it is slow
+		for (const PngCase& image : PngCases({ "gAMA", "tEXt" })) {
+			std::vector<uint8_t> optimized;
+			if (!Check(PngOptimizer::Optimize(image.png.data(), image.png.size(), options, &optimized), "PngOptimizer of %s", Describe(image).c_str())) {
+				continue;
+			}
+			uint32_t width{}, height{};
+			Check(ReadPng(optimized, &width, &height) == image.rgba and width == image.width and height == image.height,
+				"PngOptimizer of %s: pixels kept", Describe(image).c_str());
+			Check(HasChunk(optimized, "gAMA") and !HasChunk(optimized, "tEXt"), "PngOptimizer of %s: gAMA kept, tEXt dropped", Describe(image).c_str());
+		}
+
+		SyntheticCorpus::Canvas canvas;
+		SyntheticCorpus::DrawCorpus("text", 256, 128, &canvas);
+		std::vector<uint8_t> png;
+		std::vector<uint8_t> optimized;
+		EncodePng(PngImage{ canvas.width, canvas.height, 4, SyntheticCorpus::CanvasRowProc, &canvas }, PngEncodeOptions{}, &png);
+		uint32_t width{}, height{};
+		Check(PngOptimizer::Optimize(png.data(), png.size(), PngOptimizeOptions{}, &optimized) and
+			ReadPng(optimized, &width, &height) == ReadPng(png, &width, &height), "PngOptimizer at the optimal level: pixels kept");
+	}
+
+
+
+	// PackStore
+
+	struct Capture
+	{
+		std::vector<uint8_t> data;
+		uint64_t contentHash;
+	};
+
+	Capture MakeCapture(std::mt19937* pRng)
+	{
+		Capture capture{ std::vector<uint8_t>(100 + (*pRng)() % 5000), (*pRng)() };
+		for (uint8_t& b : capture.data) { b = (uint8_t)(*pRng)(); }
+		return capture;
+	}
+
+	void Append(PackWriter* pWriter, const Capture& capture)
+	{
+		Check(pWriter->Append(capture.data.data(), capture.data.size(), capture.contentHash, PackWriter::Now(), _T("mspaint.exe")),
+			"PackWriter::Append");
+	}
+
+	// Every entry of the directory matches the expected captures, in order, and passes its CRC
+	void CheckPack(const std::string& directory, const std::vector<Capture>& captures, const char* pszStep)
+	{
+		PackReader reader;
+		if (!Check(reader.Open(directory.c_str()), "%s: PackReader::Open", pszStep)) { return; }
+		Check(reader.GetCount() == captures.size(), "%s: %zu entries, expected %zu", pszStep, reader.GetCount(), captures.size());
+		for (size_t i{}; i < reader.GetCount() and i < captures.size(); ++i) {
+			const uint8_t* pData{};
+			size_t cbData{};
+			Check(reader.GetData(i, &pData, &cbData) and cbData == captures[i].data.size() and
+				memcmp(pData, captures[i].data.data(), cbData) == 0 and reader.GetEntry(i).contentHash == captures[i].contentHash,
+				"%s: entry %zu", pszStep, i);
+		}
+	}
+
+	bool Resize(const std::string& path, long long cbDelta)
+	{
+		struct stat st{};
+		return stat(path.c_str(), &st) == 0 and truncate(path.c_str(), st.st_size + cbDelta) == 0;
+	}
+
+	void TestPack(const char* pszTemp)
+	{
+		std::string directory = std::string(pszTemp) + "/codec_tests_XXXXXX";
+		if (!Check(mkdtemp(&directory[0]) != NULL, "mkdtemp in %s", pszTemp)) { return; }
+		const std::string pack = PackWriter::GetSegmentPath(directory, 1, _T(".pack"));
+		const std::string index = PackWriter::GetSegmentPath(directory, 1, _T(".idx"));
+
+		std::mt19937 rng(99);
+		std::vector<Capture> captures;
+		PackWriter writer;
+		Check(writer.Open(directory.c_str(), PackWriterOptions{}), "PackWriter::Open of an empty directory");
+		for (int i{}; i < 20; ++i) {
+			captures.push_back(MakeCapture(&rng));
+			Append(&writer, captures.back());
+		}
+		writer.Close();
+		CheckPack(directory, captures, "20 appends");
+
+		// Torn write: the last capture's data cut short, half an entry after its entry
+		Resize(pack, -5);
+		Resize(index, sizeof(PackEntry) / 2);
+		captures.pop_back();
+		Check(writer.Open(directory.c_str(), PackWriterOptions{}), "PackWriter::Open after a torn write");
+		for (int i{}; i < 3; ++i) {
+			captures.push_back(MakeCapture(&rng));
+			Append(&writer, captures.back());
+		}
+		writer.Close();
+		CheckPack(directory, captures, "resume after a torn write");
+
+		// Data that never got its entry is cut off before the next append
+		Resize(pack, 777);
+		Check(writer.Open(directory.c_str(), PackWriterOptions{}), "PackWriter::Open after data without an entry");
+		captures.push_back(MakeCapture(&rng));
+		Append(&writer, captures.back());
+		writer.Close();
+		CheckPack(directory, captures, "resume after data without an entry");
+
+		// Small segments: appends roll over to new files and the reader walks all of them
+		PackWriterOptions options{};
+		options.cbMaxSegment = 16 << 10;
+		Check(writer.Open(directory.c_str(), options), "PackWriter::Open with small segments");
+		for (int i{}; i < 30; ++i) {
+			captures.push_back(MakeCapture(&rng));
+			Append(&writer, captures.back());
+		}
+		Check(writer.GetStats().cSegments > 1, "segment rollover");
+		writer.Close();
+		CheckPack(directory, captures, "several segments");
+
+		for (unsigned nSegment = 1; ; ++nSegment) {
+			const bool isRemoved = unlink(PackWriter::GetSegmentPath(directory, nSegment, _T(".pack")).c_str()) == 0;
+			unlink(PackWriter::GetSegmentPath(directory, nSegment, _T(".idx")).c_str());
+			if (!isRemoved) { break; }
+		}
+		rmdir(directory.c_str());
+	}
+}
+
+
+
+int main(int argc, char** argv)
+{
+	const char* pszOnly = "xxh3,deflate,inflate,png,qoi,optimizer,pack";
+	const char* pszTemp = "/tmp";
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--only") == 0 and hasValue) { pszOnly = argv[++i]; }
+		else if (strcmp(argv[i], "--temp") == 0 and hasValue) { pszTemp = argv[++i]; }
+		else {
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	struct Group
+	{
+		const char* pszName;
+		void (*pfnRun)(const char* pszTemp);
+	};
+	const Group groups[] = {
+		{ "xxh3", [](const char*) { TestXxh3(); } },
+		{ "deflate", [](const char*) { TestDeflate(); } },
+		{ "inflate", [](const char*) { TestInflate(); } },
+		{ "png", [](const char*) { TestPng(); } },
+		{ "qoi", [](const char*) { TestQoi(); } },
+		{ "optimizer", [](const char*) { TestOptimizer(); } },
+		{ "pack", TestPack },
+	};
+
+	const std::vector<std::string> only = SplitList(pszOnly);
+	for (const Group& group : groups) {
+		if (!Contains(only, group.pszName)) { continue; }
+		const unsigned cChecks = g_cChecks;
+		const unsigned cFailed = g_cFailed;
+		printf("%s\n", group.pszName);
+		fflush(stdout);
+		group.pfnRun(pszTemp);
+		printf("  %u checks, %u failed\n", g_cChecks - cChecks, g_cFailed - cFailed);
+	}
+
+	printf("%s: %u checks, %u failed\n", g_cFailed ? "FAILED" : "OK", g_cChecks, g_cFailed);
+	return g_cFailed ? 1 : 0;
+}
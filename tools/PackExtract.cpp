@@ -0,0 +1,205 @@
+// Pack extraction: lists, checks and materializes the captures of a pack directory ([Pack]
+// Enabled) as individual PNG files. Segments are memory-mapped by PackReader and each capture
+// is written straight from the mapping, so extracting a few files out of a large pack only
+// reads those files. The pack can stay open in the running application.
+//
+// Build (TCHAR must be char: no UNICODE on Windows):
+//   g++ -O2 -std=c++17 -pthread -I bench/compat -I src tools/PackExtract.cpp src/{PackStore,Deflate,FilenameTemplate}.cpp -o pack_extract
+//   cl /O2 /std:c++17 /EHsc /I src tools\PackExtract.cpp src\PackStore.cpp src\Deflate.cpp src\FilenameTemplate.cpp
+//
+//   ./pack_extract D:\Captures --owner mspaint --list
+//   ./pack_extract D:\Captures --hash 5b0e --out D:\Extracted
+//
+// Options:
+//   --list              Prints the matching entries (the default without --out)
+//   --out DIR           Writes the matching captures there (the directory must exist)
+//   --name TEMPLATE     Names of the written files, see FilenameTemplate.h (default
+//                       {date}_{time}_{owner}_{seq:6}); {seq} is the entry number, 1 upward
+//   --hash HEX          Entries whose content hash starts with these hex digits
+//   --owner NAME        Entries of this owner executable, with or without its extension
+//   --first N           Entries from number N on
+//   --last N            Entries up to number N
+//   --verify            Checks the CRC of every matching entry; exits with 1 if one fails
+
+// Implementation-specific headers
+#include "PackStore.h"         // Pack segments
+#include "FilenameTemplate.h"  // Output names
+#include "AtomicFileWriter.h"  // Output files
+
+// Standard library headers
+#include <cstdio>   // printf
+#include <cstdlib>  // strtoull
+#include <cstring>  // strcmp, strlen
+#include <ctime>    // localtime
+#include <string>   // Paths
+
+static_assert(sizeof(TCHAR) == 1, "PackExtract is built without UNICODE");
+
+
+
+// Anonymous namespace for the entry filters
+namespace
+{
+#if defined(_WIN32)
+	constexpr char kSeparator = '\\';
+#else
+	constexpr char kSeparator = '/';
+#endif
+
+	struct Filter
+	{
+		uint64_t hashPrefix{};
+		unsigned cHashDigits{};
+		const char* pszOwner{};
+		uint64_t nFirst{ 1 };
+		uint64_t nLast{ UINT64_MAX };
+	};
+
+	bool ParseHashPrefix(const char* pszHex, Filter* pFilter)
+	{
+		const size_t cDigits = strlen(pszHex);
+		if (!cDigits or cDigits > 16) { return false; }
+
+		char* pEnd{};
+		pFilter->hashPrefix = strtoull(pszHex, &pEnd, 16) << (64 - 4 * cDigits);
+		pFilter->cHashDigits = (unsigned)cDigits;
+		return *pEnd == '\0';
+	}
+
+	// "mspaint" and "mspaint.exe" both match mspaint.exe
+	bool IsOwnerMatch(const char* pszOwner, const char* pszName)
+	{
+		if (_tcsicmp(pszOwner, pszName) == 0) { return true; }
+		const char* pszExtension = strrchr(pszOwner, '.');
+		return pszExtension and _tcsicmp(std::string(pszOwner, pszExtension).c_str(), pszName) == 0;
+	}
+
+	bool IsMatch(const Filter& filter, uint64_t nEntry, const PackEntry& entry, const char* pszOwner)
+	{
+		if (nEntry < filter.nFirst or nEntry > filter.nLast) { return false; }
+		if (filter.cHashDigits and (entry.contentHash >> (64 - 4 * filter.cHashDigits)) != (filter.hashPrefix >> (64 - 4 * filter.cHashDigits))) {
+			return false;
+		}
+		return !filter.pszOwner or IsOwnerMatch(pszOwner, filter.pszOwner);
+	}
+
+	// Local time of the entry, as the application names its files
+	FilenameFields GetFields(const PackEntry& entry, uint64_t nEntry)
+	{
+		const time_t seconds = (time_t)(entry.timeMs / 1000);
+		const tm* pTime = localtime(&seconds);
+		FilenameFields fields{};
+		if (pTime) {
+			fields = { (WORD)(pTime->tm_year + 1900), (WORD)(pTime->tm_mon + 1), (WORD)pTime->tm_mday,
+				(WORD)pTime->tm_hour, (WORD)pTime->tm_min, (WORD)pTime->tm_sec, (WORD)(entry.timeMs % 1000) };
+		}
+		fields.sequence = nEntry;
+		fields.contentHash = entry.contentHash;
+		return fields;
+	}
+}
+
+
+
+int main(int argc, char** argv)
+{
+	const char* pszPackDirectory = NULL;
+	const char* pszOutputDirectory = NULL;
+	const char* pszNameTemplate = "{date}_{time}_{owner}_{seq:6}";
+	bool isListed{};
+	bool isVerified{};
+	Filter filter;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--list") == 0) { isListed = true; }
+		else if (strcmp(argv[i], "--verify") == 0) { isVerified = true; }
+		else if (strcmp(argv[i], "--out") == 0 and hasValue) { pszOutputDirectory = argv[++i]; }
+		else if (strcmp(argv[i], "--name") == 0 and hasValue) { pszNameTemplate = argv[++i]; }
+		else if (strcmp(argv[i], "--owner") == 0 and hasValue) { filter.pszOwner = argv[++i]; }
+		else if (strcmp(argv[i], "--first") == 0 and hasValue) { filter.nFirst = strtoull(argv[++i], NULL, 10); }
+		else if (strcmp(argv[i], "--last") == 0 and hasValue) { filter.nLast = strtoull(argv[++i], NULL, 10); }
+		else if (strcmp(argv[i], "--hash") == 0 and hasValue) {
+			if (!ParseHashPrefix(argv[++i], &filter)) {
+				fprintf(stderr, "--hash takes 1 to 16 hex digits\n");
+				return 2;
+			}
+		}
+		else if (argv[i][0] != '-' and !pszPackDirectory) { pszPackDirectory = argv[i]; }
+		else {
+			fprintf(stderr, "Unknown option %s (see the comment at the top of PackExtract.cpp)\n", argv[i]);
+			return 2;
+		}
+	}
+	if (!pszPackDirectory) {
+		fprintf(stderr, "Usage: pack_extract PACK_DIRECTORY [--list] [--out DIR] [--name TEMPLATE] [--hash HEX] [--owner NAME] [--first N] [--last N] [--verify]\n");
+		return 2;
+	}
+
+	FilenameTemplate nameTemplate;
+	if (pszOutputDirectory and !nameTemplate.Compile(pszNameTemplate)) {
+		fprintf(stderr, "Invalid --name template %s\n", pszNameTemplate);
+		return 2;
+	}
+	if (!pszOutputDirectory and !isVerified) { isListed = true; }
+
+	PackReader reader;
+	if (!reader.Open(pszPackDirectory)) {
+		fprintf(stderr, "No pack segments in %s\n", pszPackDirectory);
+		return 2;
+	}
+
+	// Extracted files can be extracted again: left to the system cache
+	AtomicFileWriter writer;
+	writer.Start(AtomicFileWriterOptions{ WriteDurability::None });
+	std::string prefix = pszOutputDirectory ? pszOutputDirectory : "";
+	if (!prefix.empty() and prefix.back() != kSeparator and prefix.back() != '/') { prefix += kSeparator; }
+
+	if (isListed) { printf("%8s %7s %-23s %10s %-16s %s\n", "entry", "segment", "time", "bytes", "hash", "owner"); }
+	size_t cMatched{};
+	size_t cBad{};
+	size_t cWritten{};
+	uint64_t cbWritten{};
+	for (size_t i{}; i < reader.GetCount(); ++i) {
+		const uint64_t nEntry = i + 1;
+		const PackEntry& entry = reader.GetEntry(i);
+		char szOwner[sizeof(entry.szOwner) + 1];
+		PackReader::GetOwner(entry, szOwner, sizeof(szOwner));
+		if (!IsMatch(filter, nEntry, entry, szOwner)) { continue; }
+		++cMatched;
+
+		const FilenameFields fields = GetFields(entry, nEntry);
+		const uint8_t* pData{};
+		size_t cbData{};
+		const bool isReadable = reader.GetData(i, &pData, &cbData, isVerified or pszOutputDirectory);
+		if (isListed) {
+			printf("%8llu %7u %04u-%02u-%02u %02u:%02u:%02u.%03u %10u %016llx %s%s\n",
+				(unsigned long long)nEntry, reader.GetSegment(i), fields.wYear, fields.wMonth, fields.wDay,
+				fields.wHour, fields.wMinute, fields.wSecond, fields.wMilliseconds, entry.cbData,
+				(unsigned long long)entry.contentHash, szOwner, isReadable ? "" : "  (damaged)");
+		}
+		if (!isReadable) {
+			++cBad;
+			continue;
+		}
+		if (!pszOutputDirectory) { continue; }
+
+		char szName[MAX_PATH];
+		const size_t cchName = nameTemplate.Format(fields, szOwner, szName, MAX_PATH - 4);
+		const std::string path = prefix + std::string(szName, cchName) + ".png";
+		if (!cchName or !writer.Write(path.c_str(), pData, cbData)) {
+			fprintf(stderr, "Cannot write %s\n", path.c_str());
+			writer.Stop();
+			return 1;
+		}
+		++cWritten;
+		cbWritten += cbData;
+	}
+	writer.Stop();
+
+	printf("%zu of %zu entries matched", cMatched, reader.GetCount());
+	if (pszOutputDirectory) { printf(", %zu written (%.1f MB)", cWritten, cbWritten / 1e6); }
+	if (cBad) { printf(", %zu damaged", cBad); }
+	printf("\n");
+	return cBad and isVerified ? 1 : 0;
+}